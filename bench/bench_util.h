@@ -0,0 +1,51 @@
+#pragma once
+
+// Shared by the benchmarks so they all report the same key=value format:
+//   <key> n=<samples> p50=<us> p99=<us> p999=<us> max=<us>
+// where the key names the unit, e.g. "ipc.latency_us".
+
+#include <QString>
+#include <QTextStream>
+#include <QtGlobal>
+#include <algorithm>
+#include <vector>
+
+struct Percentiles {
+	qint64 p50 = 0;
+	qint64 p99 = 0;
+	qint64 p999 = 0;
+	qint64 max = 0;
+};
+
+// Of samples in nanoseconds
+inline Percentiles percentiles(std::vector<qint64> v)
+{
+	Percentiles p;
+	if (v.empty()) return p;
+	std::sort(v.begin(), v.end());
+	auto at = [&v](double q) { return v[size_t(q * double(v.size() - 1))]; };
+	p.p50 = at(0.50);
+	p.p99 = at(0.99);
+	p.p999 = at(0.999);
+	p.max = v.back();
+	return p;
+}
+
+// One line for samples in nanoseconds, printed in microseconds
+inline void printPercentiles(QTextStream &out, const char *key, const std::vector<qint64> &ns)
+{
+	const Percentiles p = percentiles(ns);
+	out << key << " n=" << ns.size()
+	    << " p50=" << p.p50 / 1000.0
+	    << " p99=" << p.p99 / 1000.0
+	    << " p999=" << p.p999 / 1000.0
+	    << " max=" << p.max / 1000.0 << "\n";
+}
+
+// Keeps the service's info logging out of the measured output
+inline void quietMessageHandler(QtMsgType type, const QMessageLogContext &, const QString &msg)
+{
+	if (type == QtWarningMsg || type == QtCriticalMsg || type == QtFatalMsg) {
+		QTextStream(stderr) << msg << "\n";
+	}
+}
@@ -0,0 +1,221 @@
+// End-to-end dispatch benchmark: MQTT message -> ActionDispatcher -> backend.
+//
+// The daemon runs headless with a RecordingActionBackend installed, so every
+// matched action is timestamped instead of executed and the benchmark is safe
+// on any machine. Latency is measured from the moment a message is handed to
+// the transport until the backend records it.
+//
+//   mpm_dispatch_bench [--messages N] [--rate R] [--actions K]
+//                      [--broker HOST[:PORT]] [--qos Q]
+//
+// Without --broker, messages are queued onto the service thread from a
+// producer thread, the same hop QMqttClient's socket notifications take. With
+// --broker the daemon connects to a real broker and a second client publishes
+// to it, which adds the network stack and the broker to the measured path.
+//
+// Output is key=value lines so runs can be diffed or scraped for regressions.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QMqttClient>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "service/mqtt_daemon.h"
+#include "actions/backend.h"
+#include "bench_util.h"
+
+namespace {
+
+void writeBenchSettings(const QString &path, const QString &userId, int actionCount,
+                        const QString &host, int port, bool connect)
+{
+	QSettings s(path, QSettings::IniFormat);
+	s.setValue("user/customId", userId);
+	s.setValue("mqtt/host", host);
+	s.setValue("mqtt/port", port);
+	s.setValue("options/autoConnect", connect);
+	s.setValue("options/autoReconnect", false);
+	s.beginWriteArray("actions");
+	for (int i = 0; i < actionCount; ++i) {
+		s.setArrayIndex(i);
+		s.setValue("name", QString("action%1").arg(i));
+		s.setValue("message", "RUN");
+		s.setValue("type", "Lock");
+	}
+	s.endArray();
+	s.sync();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCommandLineParser parser;
+	parser.setApplicationDescription("MPM end-to-end dispatch benchmark");
+	parser.addHelpOption();
+	QCommandLineOption messagesOpt("messages", "Messages to send.", "N", "20000");
+	QCommandLineOption rateOpt("rate", "Messages per second; 0 sends as fast as possible.", "R", "0");
+	QCommandLineOption actionsOpt("actions", "Configured actions, addressed round-robin.", "K", "16");
+	QCommandLineOption brokerOpt("broker", "Go through a real broker.", "HOST[:PORT]");
+	QCommandLineOption qosOpt("qos", "Publish QoS with --broker.", "Q", "0");
+	parser.addOptions({messagesOpt, rateOpt, actionsOpt, brokerOpt, qosOpt});
+	parser.process(app);
+
+	const int messages = qMax(1, parser.value(messagesOpt).toInt());
+	const int rate = qMax(0, parser.value(rateOpt).toInt());
+	const int actions = qMax(1, parser.value(actionsOpt).toInt());
+	const quint8 qos = quint8(qBound(0, parser.value(qosOpt).toInt(), 2));
+	const bool viaBroker = parser.isSet(brokerOpt);
+	QString host = QStringLiteral("127.0.0.1");
+	int port = 1883;
+	if (viaBroker) {
+		const QStringList hp = parser.value(brokerOpt).split(':');
+		host = hp.value(0);
+		if (hp.size() > 1) port = hp.at(1).toInt();
+	}
+
+	QTemporaryDir tmp;
+	if (!tmp.isValid()) {
+		QTextStream(stderr) << "Cannot create temporary directory\n";
+		return 1;
+	}
+	const QString userId = QString("bench-%1").arg(QCoreApplication::applicationPid());
+	const QString iniPath = tmp.filePath("MqttPowerManager.ini");
+	writeBenchSettings(iniPath, userId, actions, host, port, viaBroker);
+	// Isolate from any real installation before the daemon touches settings
+	qputenv("MPM_SETTINGS_PATH", iniPath.toUtf8());
+	qputenv("MPM_STATUS_PAGE", QByteArray("MPMBenchStatus-") + QByteArray::number(QCoreApplication::applicationPid()));
+	qInstallMessageHandler(quietMessageHandler);
+
+	auto recorder = std::make_unique<RecordingActionBackend>(messages);
+	RecordingActionBackend *rec = recorder.get();
+	MqttDaemon daemon;
+	daemon.setActionBackend(std::move(recorder));
+	daemon.start();
+
+	std::vector<QString> topics;
+	std::vector<uint> nameHashes;
+	for (int i = 0; i < actions; ++i) {
+		topics.push_back(QString("mqttpowermanager/%1/action%2").arg(userId).arg(i));
+		nameHashes.push_back(qHash(QString("action%1").arg(i)));
+	}
+	std::vector<qint64> sentNs(size_t(messages), 0);
+	qint64 firstSendNs = 0;
+
+	auto finish = [&]() {
+		std::vector<qint64> latency;
+		latency.reserve(size_t(messages));
+		int misordered = 0;
+		qint64 lastNs = 0;
+		const int n = rec->count();
+		for (int i = 0; i < n; ++i) {
+			RecordingActionBackend::Invocation inv;
+			if (!rec->at(i, &inv)) continue;
+			// The k-th record should be the k-th message; a lost message shifts
+			// the rest, which shows up here rather than as bogus latencies
+			if (inv.nameHash != nameHashes[size_t(i % actions)]) {
+				++misordered;
+				continue;
+			}
+			latency.push_back(inv.timestampNs - sentNs[size_t(i)]);
+			lastNs = qMax(lastNs, inv.timestampNs);
+		}
+		const double sec = double(lastNs - firstSendNs) / 1e9;
+		QTextStream out(stdout);
+		out << "mode=" << (viaBroker ? "broker" : "in-process") << " messages=" << messages
+		    << " rate=" << rate << " actions=" << actions;
+		if (viaBroker) out << " qos=" << qos;
+		out << "\n";
+		out << "dispatch.executed=" << n << " dispatch.lost=" << (messages - n)
+		    << " dispatch.misordered=" << misordered
+		    << " dispatch.mps=" << (sec > 0 ? double(latency.size()) / sec : 0.0) << "\n";
+		const auto &c = daemon.counters();
+		out << "daemon.received=" << c.messagesReceived << " daemon.ignored=" << c.messagesIgnored
+		    << " daemon.executed=" << c.actionsExecuted << "\n";
+		printPercentiles(out, "dispatch.latency_us", latency);
+		out.flush();
+		QCoreApplication::quit();
+	};
+
+	// Done once everything arrived, or after a quiet second (lost messages)
+	int lastCount = -1;
+	QTimer watch;
+	watch.setInterval(1000);
+	QObject::connect(&watch, &QTimer::timeout, &app, [&]() {
+		const int n = rec->count();
+		if (n >= messages || n == lastCount) {
+			watch.stop();
+			finish();
+		}
+		lastCount = n;
+	});
+
+	std::unique_ptr<QThread> producer;
+	QMqttClient publisher;
+	if (!viaBroker) {
+		producer.reset(QThread::create([&]() {
+			const unsigned long intervalUs = rate > 0 ? 1000000UL / unsigned(rate) : 0;
+			firstSendNs = RecordingActionBackend::nowNs();
+			for (int i = 0; i < messages; ++i) {
+				const QString &topic = topics[size_t(i % actions)];
+				sentNs[size_t(i)] = RecordingActionBackend::nowNs();
+				QMetaObject::invokeMethod(&daemon, [&daemon, topic]() {
+					daemon.dispatchMessage(QByteArrayLiteral("RUN"), topic);
+				}, Qt::QueuedConnection);
+				if (intervalUs) QThread::usleep(intervalUs);
+			}
+		}));
+		QObject::connect(producer.get(), &QThread::finished, &watch, qOverload<>(&QTimer::start));
+		producer->start();
+	} else {
+		publisher.setHostname(host);
+		publisher.setPort(quint16(port));
+		publisher.setClientId(userId + "-pub");
+		int next = 0;
+		QTimer pump;
+		pump.setInterval(rate > 0 ? qMax(1, 1000 / rate) : 0);
+		const int perTick = rate > 0 ? qMax(1, rate / 1000) : 256;
+		QObject::connect(&pump, &QTimer::timeout, &app, [&]() {
+			for (int k = 0; k < perTick && next < messages; ++k, ++next) {
+				sentNs[size_t(next)] = RecordingActionBackend::nowNs();
+				publisher.publish(QMqttTopicName(topics[size_t(next % actions)]), QByteArrayLiteral("RUN"), qos);
+			}
+			if (next >= messages) {
+				pump.stop();
+				watch.start();
+			}
+		});
+		// Start once both sides hold a session; the daemon subscribes in onConnected
+		bool daemonReady = false;
+		auto maybeStart = [&]() {
+			if (!daemonReady || publisher.state() != QMqttClient::Connected || pump.isActive() || next > 0) return;
+			QTimer::singleShot(200, &app, [&]() {
+				firstSendNs = RecordingActionBackend::nowNs();
+				pump.start();
+			});
+		};
+		QObject::connect(&daemon, &MqttDaemon::sessionReady, &app, [&]() { daemonReady = true; maybeStart(); });
+		QObject::connect(&publisher, &QMqttClient::connected, &app, maybeStart);
+		QObject::connect(&publisher, &QMqttClient::errorChanged, &app, [&](QMqttClient::ClientError e) {
+			if (e == QMqttClient::NoError) return;
+			QTextStream(stderr) << "Publisher error " << int(e) << "\n";
+			QCoreApplication::exit(1);
+		});
+		publisher.connectToHost();
+		const int rc = app.exec();
+		publisher.disconnectFromHost();
+		return rc;
+	}
+
+	const int rc = app.exec();
+	if (producer) producer->wait();
+	return rc;
+}
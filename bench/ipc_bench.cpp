@@ -0,0 +1,203 @@
+// IPC throughput and latency benchmark for the service core.
+//
+// Runs MqttDaemon + IpcServer headless against a throwaway INI (no broker: the
+// daemon stays disconnected and acts as the stand-in), drives the IPC endpoint
+// from N concurrent blocking clients issuing a mix of commands, and injects
+// MQTT messages into the daemon's dispatch path from a probe thread to see how
+// long they wait on the service thread with and without IPC load.
+//
+//   mpm_ipc_bench [--clients N] [--requests M] [--probe-hz H] [--baseline-ms T]
+//                 [--actions K] [--log FILE]
+//
+// With --log the service logger is active and the caller-side cost per log
+// line is reported as well.
+//
+// Output is key=value lines so runs can be diffed or scraped for regressions.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QThread>
+#include <QTimer>
+#include <QSettings>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "service/mqtt_daemon.h"
+#include "service/ipc_server.h"
+#include "common/service_ipc_client.h"
+#include "common/logging.h"
+#include "bench_util.h"
+
+namespace {
+
+void writeBenchSettings(const QString &path, int actionCount)
+{
+	QSettings s(path, QSettings::IniFormat);
+	s.setValue("user/customId", "bench");
+	s.setValue("mqtt/host", "127.0.0.1");
+	s.setValue("options/autoConnect", false);
+	s.setValue("options/autoReconnect", false);
+	// Expected messages never match the probe payload, so nothing is executed
+	s.beginWriteArray("actions");
+	for (int i = 0; i < actionCount; ++i) {
+		s.setArrayIndex(i);
+		s.setValue("name", QString("action%1").arg(i));
+		s.setValue("message", "NEVER");
+		s.setValue("type", "Lock");
+	}
+	s.endArray();
+	s.sync();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCommandLineParser parser;
+	parser.setApplicationDescription("MPM service IPC benchmark");
+	parser.addHelpOption();
+	QCommandLineOption clientsOpt("clients", "Concurrent IPC clients.", "N", "4");
+	QCommandLineOption requestsOpt("requests", "Requests per client.", "M", "2000");
+	QCommandLineOption probeOpt("probe-hz", "Injected MQTT messages per second.", "H", "500");
+	QCommandLineOption baselineOpt("baseline-ms", "Probe-only phase length.", "T", "2000");
+	QCommandLineOption actionsOpt("actions", "Configured actions the dispatcher scans.", "K", "16");
+	QCommandLineOption logOpt("log", "Log to FILE through the service logger instead of discarding.", "FILE");
+	parser.addOptions({clientsOpt, requestsOpt, probeOpt, baselineOpt, actionsOpt, logOpt});
+	parser.process(app);
+
+	const int clients = qMax(1, parser.value(clientsOpt).toInt());
+	const int requests = qMax(1, parser.value(requestsOpt).toInt());
+	const int probeHz = qBound(1, parser.value(probeOpt).toInt(), 100000);
+	const int baselineMs = qMax(100, parser.value(baselineOpt).toInt());
+
+	QTemporaryDir tmp;
+	if (!tmp.isValid()) {
+		QTextStream(stderr) << "Cannot create temporary directory\n";
+		return 1;
+	}
+	const QString iniPath = tmp.filePath("MqttPowerManager.ini");
+	writeBenchSettings(iniPath, qMax(0, parser.value(actionsOpt).toInt()));
+	// Isolate from any real installation before the daemon touches settings
+	qputenv("MPM_SETTINGS_PATH", iniPath.toUtf8());
+	qputenv("MPM_STATUS_PAGE", QByteArray("MPMBenchStatus-") + QByteArray::number(QCoreApplication::applicationPid()));
+	const QString serverName = QString("MPMBenchIpc-%1").arg(QCoreApplication::applicationPid());
+
+	if (parser.isSet(logOpt)) {
+		initializeFileLogger(parser.value(logOpt), true);
+		enableInMemoryLogCapture();
+	} else {
+		qInstallMessageHandler(quietMessageHandler);
+	}
+
+	MqttDaemon daemon;
+	daemon.start();
+	IpcServer ipc(&daemon);
+	ipc.start(serverName);
+
+	QElapsedTimer clock;
+	clock.start();
+
+	// Dispatch probe: a message "arrives" on another thread and is queued to the
+	// service thread, the same hop QMqttClient's socket notifications take
+	std::vector<qint64> baselineDispatch;
+	std::vector<qint64> loadDispatch;
+	std::vector<qint64> *dispatchSink = &baselineDispatch;
+	std::atomic<bool> probing{true};
+	const QString probeTopic = QStringLiteral("mqttpowermanager/bench/probe");
+	std::unique_ptr<QThread> probe(QThread::create([&]() {
+		const unsigned long intervalUs = 1000000UL / unsigned(probeHz);
+		while (probing.load(std::memory_order_relaxed)) {
+			const qint64 sent = clock.nsecsElapsed();
+			QMetaObject::invokeMethod(&daemon, [&, sent]() {
+				daemon.dispatchMessage(QByteArrayLiteral("PROBE"), probeTopic);
+				dispatchSink->push_back(clock.nsecsElapsed() - sent);
+			}, Qt::QueuedConnection);
+			QThread::usleep(intervalUs);
+		}
+	}));
+	probe->start();
+
+	const QList<QByteArray> mix = {
+		QByteArrayLiteral("status2"),
+		QByteArrayLiteral("status"),
+		QByteArrayLiteral("getlogs"),
+		QByteArrayLiteral("config-hash"),
+		QByteArrayLiteral("batch\nstatus\ncounters"),
+	};
+	std::vector<std::vector<qint64>> ipcLatency(size_t(clients));
+	std::atomic<int> ipcErrors{0};
+	std::vector<std::unique_ptr<QThread>> workers;
+	int remaining = clients;
+	qint64 loadStartNs = 0;
+	qint64 loadEndNs = 0;
+
+	auto finish = [&]() {
+		probing.store(false);
+		probe->wait();
+		// Drain probes still queued on the service thread
+		QCoreApplication::processEvents();
+
+		std::vector<qint64> all;
+		for (const auto &v : ipcLatency) all.insert(all.end(), v.begin(), v.end());
+		const double loadSec = double(loadEndNs - loadStartNs) / 1e9;
+		QTextStream out(stdout);
+		out << "clients=" << clients << " requests_per_client=" << requests << " probe_hz=" << probeHz << "\n";
+		out << "ipc.requests=" << all.size() << " ipc.errors=" << ipcErrors.load()
+		    << " ipc.rps=" << (loadSec > 0 ? double(all.size()) / loadSec : 0.0) << "\n";
+		printPercentiles(out, "ipc.latency_us", all);
+		printPercentiles(out, "dispatch.baseline_us", baselineDispatch);
+		printPercentiles(out, "dispatch.load_us", loadDispatch);
+		const Percentiles base = percentiles(baselineDispatch);
+		const Percentiles load = percentiles(loadDispatch);
+		out << "dispatch.p50_degradation=" << (base.p50 > 0 ? double(load.p50) / double(base.p50) : 0.0)
+		    << " dispatch.p99_degradation=" << (base.p99 > 0 ? double(load.p99) / double(base.p99) : 0.0) << "\n";
+		if (parser.isSet(logOpt)) {
+			// Caller-side cost of one log line with the async writer behind it
+			std::vector<qint64> logNs;
+			logNs.reserve(20000);
+			for (int i = 0; i < 20000; ++i) {
+				const qint64 t0 = clock.nsecsElapsed();
+				qInfo() << "bench log line" << i;
+				logNs.push_back(clock.nsecsElapsed() - t0);
+			}
+			printPercentiles(out, "log.hot_path_us", logNs);
+			out << "log.dropped=" << droppedLogLines() << "\n";
+		}
+		out.flush();
+		QCoreApplication::quit();
+	};
+
+	QTimer::singleShot(baselineMs, &app, [&]() {
+		dispatchSink = &loadDispatch;
+		loadStartNs = clock.nsecsElapsed();
+		for (int c = 0; c < clients; ++c) {
+			std::vector<qint64> *lat = &ipcLatency[size_t(c)];
+			lat->reserve(size_t(requests));
+			std::unique_ptr<QThread> t(QThread::create([&, lat, c]() {
+				for (int i = 0; i < requests; ++i) {
+					const QByteArray &cmd = mix[(c + i) % mix.size()];
+					const qint64 t0 = clock.nsecsElapsed();
+					const QByteArray resp = ServiceIpcClient::sendLocal(cmd, serverName, 2000);
+					lat->push_back(clock.nsecsElapsed() - t0);
+					if (resp.isEmpty() && cmd != "getlogs") ipcErrors.fetch_add(1, std::memory_order_relaxed);
+				}
+			}));
+			QObject::connect(t.get(), &QThread::finished, &app, [&]() {
+				if (--remaining > 0) return;
+				loadEndNs = clock.nsecsElapsed();
+				finish();
+			}, Qt::QueuedConnection);
+			t->start();
+			workers.push_back(std::move(t));
+		}
+	});
+
+	const int rc = app.exec();
+	for (auto &t : workers) t->wait();
+	return rc;
+}
@@ -0,0 +1,131 @@
+// Payload parsing benchmark.
+//
+// Measures what one inbound message costs before any action runs: routing a
+// plain text payload, reading a JSON command with the streaming reader the
+// dispatcher uses, the same read through a QJsonDocument DOM for comparison,
+// and routing a JSON command end to end. A last phase times the reader on
+// randomly damaged copies of the JSON payload (bytes flipped, inserted,
+// truncated). Whether it accepts and rejects the right inputs is checked by
+// mpm_json_payload_test and mpm_json_payload_fuzz, not here.
+//
+//   mpm_payload_bench [--iterations N] [--payload JSON] [--seed S]
+//
+// Output is key=value lines so runs can be diffed or scraped for regressions.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <random>
+
+#include "actions/dispatcher.h"
+#include "actions/json_payload.h"
+
+namespace {
+
+const QString kTopic = QStringLiteral("mqttpowermanager/bench/pc");
+
+void printRate(QTextStream &out, const char *key, qint64 n, qint64 elapsedNs)
+{
+	out << key << " n=" << n
+	    << " ns_per_msg=" << double(elapsedNs) / double(qMax<qint64>(1, n))
+	    << " msgs_per_s=" << qint64(double(n) * 1e9 / double(qMax<qint64>(1, elapsedNs))) << "\n";
+}
+
+ActionConfig benchAction(PayloadFormat format, const QString &message)
+{
+	ActionConfig a;
+	a.customName = QStringLiteral("pc");
+	a.typeName = QStringLiteral("Shutdown");
+	a.type = ActionTypeRegistry::instance().find(a.typeName);
+	a.expectedMessage = message;
+	a.payloadFormat = format;
+	return a;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCommandLineParser parser;
+	parser.setApplicationDescription("MPM payload parsing benchmark");
+	parser.addHelpOption();
+	QCommandLineOption iterationsOpt("iterations", "Messages per phase.", "N", "1000000");
+	QCommandLineOption payloadOpt("payload", "JSON command to parse.", "JSON",
+	                              R"({"cmd":"shutdown","delay":60,"force":true})");
+	QCommandLineOption seedOpt("seed", "Seed for the damaged-input phase.", "S", "1");
+	parser.addOptions({iterationsOpt, payloadOpt, seedOpt});
+	parser.process(app);
+
+	const int iterations = qMax(1, parser.value(iterationsOpt).toInt());
+	const QByteArray json = parser.value(payloadOpt).toUtf8();
+	QTextStream out(stdout);
+
+	const ActionTypeInfo *shutdown = ActionTypeRegistry::instance().info(ActionTypeRegistry::instance().find("Shutdown"));
+	const QVector<PayloadField> schema = shutdown ? shutdown->payload : QVector<PayloadField>();
+	QVarLengthArray<JsonScalar, 8> fields(schema.size());
+	JsonScalar cmd;
+	const char *error = nullptr;
+	if (!readJsonPayload(json, schema, &cmd, fields.data(), &error)) {
+		QTextStream(stderr) << "Payload does not fit the Shutdown schema: " << error << "\n";
+		return 1;
+	}
+	const QString command = cmd.toString();
+	QElapsedTimer timer;
+	int matched = 0;
+
+	{
+		ActionDispatcher d;
+		d.setActions({benchAction(PayloadFormat::Text, QStringLiteral("PRESS"))});
+		const QByteArray press("PRESS");
+		timer.start();
+		for (int i = 0; i < iterations; ++i) matched += d.route(kTopic, press).kind == ActionDispatcher::Route::Run;
+		printRate(out, "text_route", iterations, timer.nsecsElapsed());
+	}
+
+	timer.start();
+	for (int i = 0; i < iterations; ++i) matched += readJsonPayload(json, schema, &cmd, fields.data(), &error);
+	printRate(out, "json_stream", iterations, timer.nsecsElapsed());
+
+	timer.start();
+	for (int i = 0; i < iterations; ++i) {
+		const QJsonObject o = QJsonDocument::fromJson(json).object();
+		matched += o.value("cmd").isString() && o.value("delay").toInt() >= 0 && !o.value("force").isString();
+	}
+	printRate(out, "json_dom", iterations, timer.nsecsElapsed());
+
+	{
+		ActionDispatcher d;
+		d.setActions({benchAction(PayloadFormat::Json, command)});
+		timer.start();
+		for (int i = 0; i < iterations; ++i) matched += d.route(kTopic, json).kind == ActionDispatcher::Route::Run;
+		printRate(out, "json_route", iterations, timer.nsecsElapsed());
+	}
+
+	// Damaged input: the cost of rejecting it
+	std::mt19937 rng(parser.value(seedOpt).toUInt());
+	qint64 rejected = 0;
+	qint64 damagedNs = 0;
+	for (int i = 0; i < iterations; ++i) {
+		QByteArray damaged = json;
+		const int edits = 1 + int(rng() % 4);
+		for (int e = 0; e < edits && !damaged.isEmpty(); ++e) {
+			const int pos = int(rng() % uint(damaged.size()));
+			switch (rng() % 3) {
+			case 0: damaged[pos] = char(rng()); break;
+			case 1: damaged.insert(pos, char(rng() % 128)); break;
+			default: damaged.truncate(pos); break;
+			}
+		}
+		timer.start();
+		if (!readJsonPayload(damaged, schema, &cmd, fields.data(), &error)) ++rejected;
+		damagedNs += timer.nsecsElapsed();
+	}
+	printRate(out, "json_damaged", iterations, damagedNs);
+	out << "json_damaged_rejected=" << rejected << "\n";
+	out << "matched=" << matched << "\n";
+	return 0;
+}
@@ -0,0 +1,108 @@
+// Credential decrypt-path benchmark.
+//
+// Measures the secret store the service uses (DPAPI on Windows, the file
+// store elsewhere) and the SecretCache in front of it: protect, a cold
+// unprotect, a cache hit as seen by a reload with unchanged ciphertext, and a
+// reload where the GUI stored new ciphertext.
+//
+//   mpm_secret_bench [--iterations N] [--store dpapi|file] [--secret-bytes B]
+//
+// Output is key=value lines so runs can be diffed or scraped for regressions.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <memory>
+#include <vector>
+
+#include "common/secret_store.h"
+#include "bench_util.h"
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCommandLineParser parser;
+	parser.setApplicationDescription("MPM credential decrypt benchmark");
+	parser.addHelpOption();
+	QCommandLineOption iterationsOpt("iterations", "Operations per phase.", "N", "2000");
+#ifdef Q_OS_WIN
+	QCommandLineOption storeOpt("store", "Backend: dpapi or file.", "NAME", "dpapi");
+#else
+	QCommandLineOption storeOpt("store", "Backend: file (dpapi is Windows only).", "NAME", "file");
+#endif
+	QCommandLineOption bytesOpt("secret-bytes", "Length of the test secret.", "B", "24");
+	parser.addOptions({iterationsOpt, storeOpt, bytesOpt});
+	parser.process(app);
+
+	const int iterations = qMax(1, parser.value(iterationsOpt).toInt());
+	const QByteArray secret(qBound(1, parser.value(bytesOpt).toInt(), 4096), 'x');
+	QTextStream out(stdout);
+
+	QTemporaryDir tmp;
+	if (!tmp.isValid()) {
+		QTextStream(stderr) << "Cannot create temporary directory\n";
+		return 1;
+	}
+	std::unique_ptr<SecretStore> store;
+	if (parser.value(storeOpt) == "dpapi") store = createDpapiSecretStore();
+	else store = createFileSecretStore(tmp.filePath("secret.key"));
+	if (!store) {
+		QTextStream(stderr) << "Store " << parser.value(storeOpt) << " is not available in this build\n";
+		return 1;
+	}
+	out << "store=" << store->name() << "\n";
+
+	std::vector<qint64> ns;
+	ns.reserve(size_t(iterations));
+	QElapsedTimer t;
+
+	// Also primes the file store's key, so later phases exclude key loading
+	QByteArray stored = store->protect(secret);
+	if (stored.isEmpty()) {
+		QTextStream(stderr) << "protect failed for store " << store->name() << "\n";
+		return 1;
+	}
+	for (int i = 0; i < iterations; ++i) {
+		t.start();
+		stored = store->protect(secret);
+		ns.push_back(t.nsecsElapsed());
+	}
+	printPercentiles(out, "secret.protect_us", ns);
+
+	ns.clear();
+	SecretBuffer plain;
+	for (int i = 0; i < iterations; ++i) {
+		t.start();
+		store->unprotect(stored, &plain);
+		ns.push_back(t.nsecsElapsed());
+	}
+	printPercentiles(out, "secret.unprotect_us", ns);
+	out << "locked=" << (plain.isLocked() ? 1 : 0) << "\n";
+
+	// What a reload costs when the INI kept the same ciphertext
+	SecretCache cache(*store);
+	cache.reveal(stored);
+	ns.clear();
+	for (int i = 0; i < iterations; ++i) {
+		t.start();
+		cache.reveal(stored);
+		ns.push_back(t.nsecsElapsed());
+	}
+	printPercentiles(out, "secret.reload_unchanged_us", ns);
+
+	// The GUI re-protected the password: one decrypt per change
+	std::vector<QByteArray> variants;
+	for (int i = 0; i < qMin(iterations, 256); ++i) variants.push_back(store->protect(secret));
+	ns.clear();
+	const quint64 before = cache.decryptCount();
+	for (int i = 0; i < iterations; ++i) {
+		t.start();
+		cache.reveal(variants[size_t(i) % variants.size()]);
+		ns.push_back(t.nsecsElapsed());
+	}
+	printPercentiles(out, "secret.reload_changed_us", ns);
+	out << "decrypts_per_change=" << double(cache.decryptCount() - before) / iterations << "\n";
+	return 0;
+}
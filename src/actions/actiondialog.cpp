@@ -1,4 +1,5 @@
 #include "actiondialog.h"
+#include "command_template.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QLabel>
@@ -7,11 +8,8 @@
 #include <QDialogButtonBox>
 #include <QPushButton>
 #include <QFileDialog>
-
-static QStringList actionTypeStrings()
-{
-    return {"Shutdown", "Restart", "Suspend", "Sleep", "OpenExe", "Lock"};
-}
+#include <QMessageBox>
+#include <QSignalBlocker>
 
 ActionDialog::ActionDialog(QWidget *parent) : QDialog(parent)
 {
@@ -37,7 +35,7 @@ void ActionDialog::buildUi()
         auto *row = new QHBoxLayout();
         row->addWidget(new QLabel("Type:", this));
         m_typeCombo = new QComboBox(this);
-        m_typeCombo->addItems(actionTypeStrings());
+        m_typeCombo->addItems(ActionTypeRegistry::instance().names());
         row->addWidget(m_typeCombo);
         layout->addLayout(row);
         connect(m_typeCombo, qOverload<int>(&QComboBox::currentIndexChanged), this, &ActionDialog::onTypeChanged);
@@ -53,61 +51,136 @@ void ActionDialog::buildUi()
         layout->addLayout(row);
     }
 
-    // Exe row
+    // Payload format
     {
         auto *row = new QHBoxLayout();
-        m_exeRow = new QWidget(this);
-        auto *inner = new QHBoxLayout(m_exeRow);
-        inner->setContentsMargins(0,0,0,0);
-        inner->addWidget(new QLabel("Executable:", this));
-        m_exeEdit = new QLineEdit(this);
-        inner->addWidget(m_exeEdit);
-        auto *browse = new QPushButton("Browse...", this);
-        inner->addWidget(browse);
-        layout->addWidget(m_exeRow);
-        connect(browse, &QPushButton::clicked, this, &ActionDialog::onBrowseExe);
+        row->addWidget(new QLabel("Payload:", this));
+        m_formatCombo = new QComboBox(this);
+        m_formatCombo->addItem("Text (whole message)");
+        m_formatCombo->addItem("JSON (message is the \"cmd\" member)");
+        row->addWidget(m_formatCombo);
+        layout->addLayout(row);
     }
 
+    // Parameter rows of the selected type
+    m_paramsBox = new QWidget(this);
+    m_paramsLayout = new QVBoxLayout(m_paramsBox);
+    m_paramsLayout->setContentsMargins(0,0,0,0);
+    layout->addWidget(m_paramsBox);
+
     // Buttons
     m_buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
     layout->addWidget(m_buttons);
-    connect(m_buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+    connect(m_buttons, &QDialogButtonBox::accepted, this, &ActionDialog::onAccept);
     connect(m_buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
 
     onTypeChanged(m_typeCombo->currentIndex());
 }
 
+void ActionDialog::buildParamRows(const QString &typeName)
+{
+    // Keep what was typed so far in case the user switches back
+    for (auto it = m_paramEdits.cbegin(); it != m_paramEdits.cend(); ++it) {
+        m_initialParams.insert(it.key(), it.value()->text().trimmed());
+    }
+    m_paramEdits.clear();
+    while (QLayoutItem *item = m_paramsLayout->takeAt(0)) {
+        if (item->widget()) item->widget()->deleteLater();
+        delete item;
+    }
+
+    QVector<ActionParam> params;
+    const ActionTypeRegistry &types = ActionTypeRegistry::instance();
+    if (const ActionTypeInfo *t = types.info(types.find(typeName))) {
+        params = t->params;
+    } else {
+        // Unknown (plugin not installed): offer whatever the INI had as text
+        for (auto it = m_initialParams.cbegin(); it != m_initialParams.cend(); ++it) {
+            params.push_back({it.key(), it.key() + ':', ActionParam::Text, false});
+        }
+    }
+
+    for (const ActionParam &p : params) {
+        auto *rowWidget = new QWidget(m_paramsBox);
+        auto *row = new QHBoxLayout(rowWidget);
+        row->setContentsMargins(0,0,0,0);
+        row->addWidget(new QLabel(p.label, rowWidget));
+        auto *edit = new QLineEdit(rowWidget);
+        edit->setText(m_initialParams.value(p.key));
+        row->addWidget(edit);
+        if (p.kind == ActionParam::FilePath) {
+            auto *browse = new QPushButton("Browse...", rowWidget);
+            row->addWidget(browse);
+            connect(browse, &QPushButton::clicked, this, [this, edit]() {
+                const QString path = QFileDialog::getOpenFileName(this, "Select executable", QString(),
+                                                                  "Executables (*.exe);;All files (*.*)");
+                if (!path.isEmpty()) edit->setText(path);
+            });
+        }
+        m_paramsLayout->addWidget(rowWidget);
+        m_paramEdits.insert(p.key, edit);
+    }
+    m_paramsBox->setVisible(!params.isEmpty());
+}
+
 void ActionDialog::onTypeChanged(int)
 {
-    const QString typeStr = m_typeCombo->currentText();
-    const bool isOpen = typeStr.compare("OpenExe", Qt::CaseInsensitive) == 0;
-    m_exeRow->setVisible(isOpen);
+    buildParamRows(m_typeCombo->currentText());
 }
 
 void ActionDialog::setInitial(const Result &init)
 {
     m_nameEdit->setText(init.customName);
     m_msgEdit->setText(init.expectedMessage);
-    m_exeEdit->setText(init.exePath);
-    const QString typeStr = ActionsRegistry::toString(init.type);
-    int idx = actionTypeStrings().indexOf(typeStr);
+    m_formatCombo->setCurrentIndex(init.payloadFormat == PayloadFormat::Json ? 1 : 0);
+    m_paramEdits.clear();  // don't fold the defaults' (empty) edits into init
+    m_initialParams = init.params;
+    int idx = m_typeCombo->findText(init.typeName, Qt::MatchFixedString);
+    if (idx < 0 && !init.typeName.isEmpty()) {
+        m_typeCombo->addItem(init.typeName);
+        idx = m_typeCombo->count() - 1;
+    }
     if (idx < 0) idx = 0;
+    const QSignalBlocker blocker(m_typeCombo);
     m_typeCombo->setCurrentIndex(idx);
+    buildParamRows(m_typeCombo->currentText());
 }
 
-ActionDialog::Result ActionDialog::getResult() const
+void ActionDialog::onAccept()
 {
-    ActionType type;
-    const QString typeStr = m_typeCombo->currentText();
-    if (!ActionsRegistry::fromString(typeStr, type)) type = ActionType::Shutdown;
-    return { m_nameEdit->text().trimmed(), type, m_msgEdit->text().trimmed(), m_exeEdit->text().trimmed() };
+    // Same compile the dispatcher does, so a bad template is caught here
+    // rather than as an action that silently never matches. Without
+    // arguments the message is a literal and always valid.
+    const Result r = getResult();
+    if (r.param("args").isEmpty()) {
+        accept();
+        return;
+    }
+    PayloadPattern pattern;
+    ArgumentPlan plan;
+    QString error;
+    if (!PayloadPattern::compile(r.expectedMessage, &pattern, &error)) {
+        QMessageBox::warning(this, "Invalid message", "Expected MQTT message: " + error);
+        return;
+    }
+    if (!ArgumentPlan::compile(r.param("args"), pattern, &plan, &error)) {
+        QMessageBox::warning(this, "Invalid arguments", "Arguments: " + error);
+        return;
+    }
+    accept();
 }
 
-void ActionDialog::onBrowseExe()
+ActionDialog::Result ActionDialog::getResult() const
 {
-    const QString path = QFileDialog::getOpenFileName(this, "Select executable", QString(),
-                                                      "Executables (*.exe);;All files (*.*)");
-    if (!path.isEmpty()) m_exeEdit->setText(path);
+    Result r;
+    r.customName = m_nameEdit->text().trimmed();
+    r.expectedMessage = m_msgEdit->text().trimmed();
+    r.payloadFormat = m_formatCombo->currentIndex() == 1 ? PayloadFormat::Json : PayloadFormat::Text;
+    r.typeName = m_typeCombo->currentText();
+    r.type = ActionTypeRegistry::instance().find(r.typeName);
+    for (auto it = m_paramEdits.cbegin(); it != m_paramEdits.cend(); ++it) {
+        const QString v = it.value()->text().trimmed();
+        if (!v.isEmpty()) r.params.insert(it.key(), v);
+    }
+    return r;
 }
-
-
@@ -2,22 +2,19 @@
 #define ACTIONDIALOG_H
 
 #include <QDialog>
+#include <QMap>
 #include "actions.h"
 
 class QLineEdit;
 class QComboBox;
 class QDialogButtonBox;
+class QVBoxLayout;
 
 class ActionDialog : public QDialog
 {
     Q_OBJECT
 public:
-    struct Result {
-        QString customName;
-        ActionType type;
-        QString expectedMessage;
-        QString exePath; // only for OpenExe
-    };
+    using Result = ActionConfig;
 
     explicit ActionDialog(QWidget *parent = nullptr);
     void setInitial(const Result &init);
@@ -25,18 +22,20 @@ public:
 
 private slots:
     void onTypeChanged(int index);
-    void onBrowseExe();
+    void onAccept();
 
 private:
     QLineEdit *m_nameEdit;
     QComboBox *m_typeCombo;
     QLineEdit *m_msgEdit;
-    QLineEdit *m_exeEdit;
+    QComboBox *m_formatCombo;
     QDialogButtonBox *m_buttons;
-    QWidget *m_exeRow;
+    QWidget *m_paramsBox;
+    QVBoxLayout *m_paramsLayout;
+    QMap<QString, QLineEdit *> m_paramEdits;  // key: ActionParam::key
+    QMap<QString, QString> m_initialParams;   // survive switching the type back and forth
     void buildUi();
+    void buildParamRows(const QString &typeName);
 };
 
 #endif // ACTIONDIALOG_H
-
-
@@ -1,140 +1,277 @@
 #include "actions.h"
-#include <QProcess>
-#include <QOperatingSystemVersion>
+#include "actions_platform.h"
+#include "../common/log_categories.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
 #include <QFileInfo>
+#include <QLibrary>
+#include <QSettings>
+#include <QStringList>
 
+#ifdef Q_OS_WIN
 #include <windows.h>
-#include <powrprof.h>
-#include <wtsapi32.h>
-#include <userenv.h>
-#pragma comment(lib, "Wtsapi32.lib")
-#pragma comment(lib, "Userenv.lib")
-
-static bool runInActiveUserSession(const wchar_t *application, const wchar_t *commandLine)
-{
-	DWORD currentSession = 0;
-	ProcessIdToSessionId(GetCurrentProcessId(), &currentSession);
-	DWORD activeSession = WTSGetActiveConsoleSessionId();
-	if (activeSession == 0xFFFFFFFF || activeSession == currentSession) {
-		return false; // Not a service context or no active session
-	}
-	HANDLE userToken = nullptr;
-	if (!WTSQueryUserToken(activeSession, &userToken)) return false;
-	HANDLE primary = nullptr;
-	if (!DuplicateTokenEx(userToken, TOKEN_ALL_ACCESS, nullptr, SecurityImpersonation, TokenPrimary, &primary)) {
-		CloseHandle(userToken);
+#include <Aclapi.h>
+#include <sddl.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// The built-in types, in picker order. Adding one is a row here plus its
+// handler in each actions_<os>.cpp.
+void registerBuiltinTypes(ActionTypeRegistry &r)
+{
+	// {"cmd":"...","delay":60,"force":true}
+	// A negative delay is refused, not read as "now"
+	const QVector<PayloadField> powerOff{{QStringLiteral("delay"), PayloadField::Int, false, 0, NativeActions::kMaxPowerOffDelaySec},
+	                                     {QStringLiteral("force"), PayloadField::Bool, false}};
+	r.add({QStringLiteral("Shutdown"), {}, &NativeActions::shutdown, powerOff});
+	r.add({QStringLiteral("Restart"), {}, &NativeActions::restart, powerOff});
+	r.add({QStringLiteral("Suspend"), {}, &NativeActions::suspend});
+	r.add({QStringLiteral("Sleep"), {}, &NativeActions::sleep});
+	r.add({QStringLiteral("Hibernate"), {}, &NativeActions::hibernate});
+	r.add({QStringLiteral("OpenExe"),
+	       {{QStringLiteral("exePath"), QStringLiteral("Executable:"), ActionParam::FilePath, true},
+	        {QStringLiteral("args"), QStringLiteral("Arguments:"), ActionParam::Text, false}},
+	       &NativeActions::openExe});
+	r.add({QStringLiteral("Lock"), {}, &NativeActions::lock});
+}
+
+#ifdef Q_OS_WIN
+bool isTrustedSid(PSID sid)
+{
+	if (IsWellKnownSid(sid, WinLocalSystemSid) || IsWellKnownSid(sid, WinBuiltinAdministratorsSid)) return true;
+	LPWSTR text = nullptr;
+	if (!ConvertSidToStringSidW(sid, &text)) return false;
+	// NT SERVICE\TrustedInstaller, owner of most of Program Files
+	const bool trusted = QString::fromWCharArray(text) == QLatin1String("S-1-5-80-956008885-3418522649-1831038044-1853292631-2271478464");
+	LocalFree(text);
+	return trusted;
+}
+#endif
+
+// True for a process that runs with more rights than whoever could drop a
+// library into a plugin directory: root or setuid on POSIX, an elevated or
+// LocalSystem token (the Windows service) on Windows
+bool isPrivilegedProcess()
+{
+#ifdef Q_OS_WIN
+	HANDLE token = nullptr;
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token)) return true;
+	TOKEN_ELEVATION elev{};
+	DWORD size = 0;
+	const bool elevated = GetTokenInformation(token, TokenElevation, &elev, sizeof(elev), &size) && elev.TokenIsElevated;
+	BYTE userBuf[SECURITY_MAX_SID_SIZE + sizeof(TOKEN_USER)];
+	const bool system = GetTokenInformation(token, TokenUser, userBuf, sizeof(userBuf), &size)
+	                    && IsWellKnownSid(reinterpret_cast<TOKEN_USER *>(userBuf)->User.Sid, WinLocalSystemSid);
+	CloseHandle(token);
+	return elevated || system;
+#else
+	return ::geteuid() == 0 || ::geteuid() != ::getuid();
+#endif
+}
+
+// Whether only administrators (and on POSIX the process's own user) can
+// change path; a library anyone else can replace runs their code with our
+// rights. For an ancestor directory only the rights to rename or re-permission
+// what is inside it count: creating a sibling is harmless.
+bool isAdminOnlyWritable(const QString &path, bool ancestor = false)
+{
+#ifdef Q_OS_WIN
+	const std::wstring wpath = QDir::toNativeSeparators(path).toStdWString();
+	PSID owner = nullptr;
+	PACL dacl = nullptr;
+	PSECURITY_DESCRIPTOR sd = nullptr;
+	if (GetNamedSecurityInfoW(wpath.c_str(), SE_FILE_OBJECT, OWNER_SECURITY_INFORMATION | DACL_SECURITY_INFORMATION,
+	                          &owner, nullptr, &dacl, nullptr, &sd) != ERROR_SUCCESS) {
 		return false;
 	}
-	CloseHandle(userToken);
-	void *envBlock = nullptr;
-	CreateEnvironmentBlock(&envBlock, primary, FALSE);
-	STARTUPINFOW si{}; si.cb = sizeof(si);
-	PROCESS_INFORMATION pi{};
-	BOOL ok = CreateProcessAsUserW(primary, application, (LPWSTR)commandLine,
-		nullptr, nullptr, FALSE, CREATE_UNICODE_ENVIRONMENT | CREATE_NEW_CONSOLE,
-		envBlock, nullptr, &si, &pi);
-	if (ok) {
-		CloseHandle(pi.hThread);
-		CloseHandle(pi.hProcess);
+	// A null DACL grants everyone everything
+	bool ok = owner && dacl && isTrustedSid(owner);
+	constexpr ACCESS_MASK kReplaceRights = FILE_DELETE_CHILD | DELETE | WRITE_DAC | WRITE_OWNER | GENERIC_ALL;
+	constexpr ACCESS_MASK kWriteRights = kReplaceRights | FILE_WRITE_DATA | FILE_APPEND_DATA | FILE_WRITE_EA
+	                                   | FILE_WRITE_ATTRIBUTES | GENERIC_WRITE;
+	const ACCESS_MASK rights = ancestor ? kReplaceRights : kWriteRights;
+	for (DWORD i = 0; ok && i < dacl->AceCount; ++i) {
+		void *ace = nullptr;
+		if (!GetAce(dacl, i, &ace)) {
+			ok = false;
+			break;
+		}
+		const auto *header = static_cast<ACE_HEADER *>(ace);
+		if (header->AceType != ACCESS_ALLOWED_ACE_TYPE || (header->AceFlags & INHERIT_ONLY_ACE)) continue;
+		const auto *allowed = static_cast<ACCESS_ALLOWED_ACE *>(ace);
+		if ((allowed->Mask & rights) && !isTrustedSid(PSID(&allowed->SidStart))) ok = false;
 	}
-	if (envBlock) DestroyEnvironmentBlock(envBlock);
-	CloseHandle(primary);
+	LocalFree(sd);
 	return ok;
+#else
+	struct stat st;
+	if (::stat(QFile::encodeName(path).constData(), &st) != 0) return false;
+	const bool trustedOwner = st.st_uid == 0 || st.st_uid == ::geteuid();
+	// In a sticky directory such as /tmp others can only rename their own entries
+	const bool othersWrite = st.st_mode & (S_IWGRP | S_IWOTH);
+	return trustedOwner && (!othersWrite || (ancestor && (st.st_mode & S_ISVTX)));
+#endif
 }
 
-static bool executeWin(ActionType type, const QString &exePath)
+// The directory and every directory above it: whoever can rename one of them
+// can swap the whole tree
+bool isTrustedPluginDir(const QString &dir)
 {
-	// Service-aware handling for session-bound actions
-	if (type == ActionType::OpenExe) {
-		if (exePath.isEmpty()) return false;
-		// Try to run in active user session when running as a service
-		const std::wstring wexe = exePath.toStdWString();
-		if (runInActiveUserSession(wexe.c_str(), (LPWSTR)wexe.c_str())) return true;
-		return QProcess::startDetached(exePath);
-	}
-	if (type == ActionType::Lock) {
-		// Prefer to lock in the active user session
-		std::wstring cmd = L"rundll32.exe user32.dll,LockWorkStation";
-		if (runInActiveUserSession(L"C:\\Windows\\System32\\rundll32.exe", (LPWSTR)cmd.c_str())) return true;
-		if (LockWorkStation()) return true;
-		return QProcess::startDetached("rundll32.exe", {"user32.dll,LockWorkStation"});
-	}
-	// Privileged system power actions can be done from service context
-	auto enablePrivilege = [](const wchar_t *privName) -> bool {
-		HANDLE token = nullptr;
-		if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+	const QString canonical = QFileInfo(dir).canonicalFilePath();
+	if (canonical.isEmpty()) return false;
+	QDir d(canonical);
+	for (bool ancestor = false;; ancestor = true) {
+		if (!isAdminOnlyWritable(d.path(), ancestor)) {
+			qCWarning(lcActions) << "Not loading action plugins from" << dir << ":" << d.path() << "is writable by non-administrators";
 			return false;
 		}
-		LUID luid{};
-		const BOOL okLookup = LookupPrivilegeValueW(nullptr, privName, &luid);
-		if (!okLookup) {
-			CloseHandle(token);
-			return false;
-		}
-		TOKEN_PRIVILEGES tp{};
-		tp.PrivilegeCount = 1;
-		tp.Privileges[0].Luid = luid;
-		tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
-		const BOOL okAdjust = AdjustTokenPrivileges(token, FALSE, &tp, sizeof(tp), nullptr, nullptr);
-		const DWORD err = GetLastError();
-		CloseHandle(token);
-		return okAdjust && (err == ERROR_SUCCESS);
-	};
-
-	if (type == ActionType::Shutdown) {
-		// Try with proper privilege otherwise fall back to shutdown command
-		enablePrivilege(SE_SHUTDOWN_NAME);
-		if (ExitWindowsEx(EWX_POWEROFF | EWX_FORCEIFHUNG, SHTDN_REASON_MAJOR_APPLICATION | SHTDN_REASON_MINOR_OTHER | SHTDN_REASON_FLAG_PLANNED)) {
-			return true;
-		}
-		return QProcess::startDetached("shutdown", {"/s", "/t", "0"});
+		if (d.isRoot() || !d.cdUp()) return true;
 	}
-	if (type == ActionType::Restart) {
-		enablePrivilege(SE_SHUTDOWN_NAME);
-		if (ExitWindowsEx(EWX_REBOOT | EWX_FORCEIFHUNG, SHTDN_REASON_MAJOR_APPLICATION | SHTDN_REASON_MINOR_OTHER | SHTDN_REASON_FLAG_PLANNED)) {
-			return true;
-		}
-		return QProcess::startDetached("shutdown", {"/r", "/t", "0"});
-	}
-	if (type == ActionType::Suspend || type == ActionType::Sleep) {
-		enablePrivilege(SE_SHUTDOWN_NAME);
-		if (SetSuspendState(FALSE, TRUE, FALSE)) {
-			return true;
-		}
-		return QProcess::startDetached("rundll32.exe", {"powrprof.dll,SetSuspendState", "0", "1", "0"});
+}
+
+QString defaultPluginDir()
+{
+	const QString env = qEnvironmentVariable("MPM_ACTION_PLUGIN_DIR");
+	if (!env.isEmpty()) {
+		// Services get their environment from whoever configured them, not
+		// necessarily an administrator; they only load from their own install
+		if (!isPrivilegedProcess()) return env;
+		qCWarning(lcActions) << "Ignoring MPM_ACTION_PLUGIN_DIR in a privileged process";
 	}
-	return false;
+	if (!QCoreApplication::instance()) return QString();
+	return QCoreApplication::applicationDirPath() + QStringLiteral("/actions");
 }
 
-bool ActionsRegistry::execute(ActionType type, const QString &exePath)
+} // namespace
+
+ActionTypeRegistry::ActionTypeRegistry()
 {
-	if (executeWin(type, exePath)) return true;
-	return false;
+	registerBuiltinTypes(*this);
 }
 
-QString ActionsRegistry::toString(ActionType type)
+ActionTypeRegistry &ActionTypeRegistry::instance()
 {
-	switch (type) {
-	case ActionType::Shutdown: return QStringLiteral("Shutdown");
-	case ActionType::Restart:  return QStringLiteral("Restart");
-	case ActionType::Suspend:  return QStringLiteral("Suspend");
-	case ActionType::Sleep:    return QStringLiteral("Sleep");
-	case ActionType::OpenExe:  return QStringLiteral("OpenExe");
-	case ActionType::Lock:     return QStringLiteral("Lock");
-	}
-	return QStringLiteral("Shutdown");
+	static ActionTypeRegistry *s_instance = []() {
+		auto *r = new ActionTypeRegistry;
+		const QString dir = defaultPluginDir();
+		if (!dir.isEmpty() && QDir(dir).exists() && (!isPrivilegedProcess() || isTrustedPluginDir(dir))) r->loadPlugins(dir);
+		return r;
+	}();
+	return *s_instance;
+}
+
+ActionTypeId ActionTypeRegistry::add(ActionTypeInfo info)
+{
+	const QString key = info.name.trimmed().toCaseFolded();
+	if (key.isEmpty() || m_byFoldedName.contains(key)) return kUnknownActionType;
+	const ActionTypeId id = m_types.size();
+	m_types.push_back(std::move(info));
+	m_byFoldedName.insert(key, id);
+	return id;
+}
+
+ActionTypeId ActionTypeRegistry::find(const QString &name) const
+{
+	return m_byFoldedName.value(name.trimmed().toCaseFolded(), kUnknownActionType);
+}
+
+const ActionTypeInfo *ActionTypeRegistry::info(ActionTypeId id) const
+{
+	return id >= 0 && id < m_types.size() ? &m_types[id] : nullptr;
+}
+
+QString ActionTypeRegistry::name(ActionTypeId id) const
+{
+	const ActionTypeInfo *t = info(id);
+	return t ? t->name : QString();
 }
 
-bool ActionsRegistry::fromString(const QString &str, ActionType &outType)
+QStringList ActionTypeRegistry::names() const
 {
-	const QString s = str.trimmed();
-	if (s.compare("Shutdown", Qt::CaseInsensitive) == 0) { outType = ActionType::Shutdown; return true; }
-	if (s.compare("Restart", Qt::CaseInsensitive) == 0)  { outType = ActionType::Restart;  return true; }
-	if (s.compare("Suspend", Qt::CaseInsensitive) == 0)  { outType = ActionType::Suspend;  return true; }
-	if (s.compare("Sleep", Qt::CaseInsensitive) == 0)    { outType = ActionType::Sleep;    return true; }
-	if (s.compare("OpenExe", Qt::CaseInsensitive) == 0)  { outType = ActionType::OpenExe;  return true; }
-	if (s.compare("Lock", Qt::CaseInsensitive) == 0)     { outType = ActionType::Lock;     return true; }
-	return false;
+	QStringList out;
+	out.reserve(m_types.size());
+	for (const ActionTypeInfo &t : m_types) out << t.name;
+	return out;
 }
 
+int ActionTypeRegistry::loadPlugins(const QString &dir)
+{
+	using AbiFn = int (*)();
+	using RegisterFn = void (*)(ActionTypeRegistry *);
+	int loaded = 0;
+	const bool privileged = isPrivilegedProcess();
+	const QFileInfoList files = QDir(dir).entryInfoList(QDir::Files, QDir::Name);
+	for (const QFileInfo &fi : files) {
+		if (!QLibrary::isLibrary(fi.fileName())) continue;
+		if (privileged && !isAdminOnlyWritable(fi.canonicalFilePath())) {
+			qCWarning(lcActions) << "Action plugin" << fi.fileName() << "is writable by non-administrators; not loading it";
+			continue;
+		}
+		// Never unloaded: registered handlers point into the library
+		QLibrary lib(fi.absoluteFilePath());
+		if (!lib.load()) {
+			qCWarning(lcActions) << "Action plugin" << fi.fileName() << "failed to load:" << lib.errorString();
+			continue;
+		}
+		const auto abi = reinterpret_cast<AbiFn>(lib.resolve("mpm_action_plugin_abi"));
+		const auto reg = reinterpret_cast<RegisterFn>(lib.resolve("mpm_register_action_types"));
+		if (!abi || !reg || abi() != kPluginAbi) {
+			qCWarning(lcActions) << "Action plugin" << fi.fileName() << "is not compatible (ABI" << kPluginAbi << "expected)";
+			lib.unload();
+			continue;
+		}
+		const int before = m_types.size();
+		reg(this);
+		qCInfo(lcActions) << "Action plugin" << fi.fileName() << "registered" << (m_types.size() - before) << "type(s)";
+		++loaded;
+	}
+	return loaded;
+}
 
+QVector<ActionConfig> ActionTypeRegistry::readActions(QSettings &S) const
+{
+	QVector<ActionConfig> actions;
+	const int size = S.beginReadArray("actions");
+	actions.reserve(size);
+	for (int i = 0; i < size; ++i) {
+		S.setArrayIndex(i);
+		ActionConfig a;
+		a.customName = S.value("name").toString();
+		if (a.customName.isEmpty()) continue;
+		a.expectedMessage = S.value("message", "PRESS").toString();
+		a.typeName = S.value("type", "Shutdown").toString().trimmed();
+		a.type = find(a.typeName);
+		if (S.value("payload").toString().compare("json", Qt::CaseInsensitive) == 0) a.payloadFormat = PayloadFormat::Json;
+		if (const ActionTypeInfo *t = info(a.type)) {
+			a.typeName = t->name;
+			for (const ActionParam &p : t->params) {
+				const QString v = S.value(p.key).toString();
+				if (!v.isEmpty()) a.params.insert(p.key, v);
+			}
+		} else {
+			// Probably a plugin that isn't installed here; keep its settings so
+			// the GUI writes them back untouched
+			qCWarning(lcActions) << "Action" << a.customName << "has unknown type" << a.typeName;
+			for (const QString &key : S.childKeys()) {
+				if (key != "name" && key != "message" && key != "type" && key != "payload") a.params.insert(key, S.value(key).toString());
+			}
+		}
+		actions.push_back(std::move(a));
+	}
+	S.endArray();
+	return actions;
+}
+
+QVariantMap ActionTypeRegistry::toSettingsRow(const ActionConfig &action)
+{
+	QVariantMap row{{"name", action.customName}, {"message", action.expectedMessage}, {"type", action.typeName}};
+	if (action.payloadFormat == PayloadFormat::Json) row.insert("payload", QStringLiteral("json"));
+	for (auto it = action.params.cbegin(); it != action.params.cend(); ++it) row.insert(it.key(), it.value());
+	return row;
+}
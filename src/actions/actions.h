@@ -1,23 +1,120 @@
 #ifndef ACTIONS_H
 #define ACTIONS_H
 
+#include <QHash>
+#include <QMap>
 #include <QString>
+#include <QStringList>
+#include <QVariantMap>
+#include <QVector>
+#include <functional>
+#include <limits>
 
-enum class ActionType {
-    Shutdown,
-    Restart,
-    Suspend,
-    Sleep,
-    OpenExe,
-    Lock
+class QSettings;
+
+// Index of a registered action type; only meaningful within one process, so
+// anything persisted stores the type name instead
+using ActionTypeId = int;
+constexpr ActionTypeId kUnknownActionType = -1;
+
+// How an action reads its message: the whole payload against the expected
+// message, or a JSON object whose "cmd" member is matched instead and whose
+// other members fill the type's payload fields
+enum class PayloadFormat { Text, Json };
+
+// One configured action, as stored in the [actions] array of the INI
+struct ActionConfig {
+    QString customName;       // Used in MQTT topic suffix
+    QString typeName;         // as written in the INI; kept even if no such type is registered
+    ActionTypeId type = kUnknownActionType;
+    QString expectedMessage;  // e.g. PRESS
+    PayloadFormat payloadFormat = PayloadFormat::Text;
+    QMap<QString, QString> params;  // values for the type's parameter schema, e.g. exePath
+    QString param(const QString &key) const { return params.value(key); }
+    bool operator==(const ActionConfig &o) const {
+        return customName == o.customName && typeName == o.typeName && expectedMessage == o.expectedMessage
+            && payloadFormat == o.payloadFormat && params == o.params;
+    }
+    bool operator!=(const ActionConfig &o) const { return !(*this == o); }
 };
 
-namespace ActionsRegistry {
-    QString toString(ActionType type);
-    bool fromString(const QString &str, ActionType &outType);
-    bool execute(ActionType type, const QString &exePath = QString());
-}
+// One parameter an action type takes; drives the INI keys and ActionDialog
+struct ActionParam {
+    enum Kind { Text, FilePath };
+    QString key;      // INI key inside the action entry
+    QString label;    // dialog label
+    Kind kind = Text;
+    bool required = false;
+};
 
-#endif // ACTIONS_H
+// One member a JSON payload may carry for an action type, e.g. "delay"
+struct PayloadField {
+    enum Kind { String, Int, Bool };
+    QString key;      // ASCII
+    Kind kind = String;
+    bool required = false;
+    // Int: a payload outside [min, max] doesn't match
+    qint64 min = std::numeric_limits<qint64>::min();
+    qint64 max = std::numeric_limits<qint64>::max();
+};
+
+// What one message asks of an action on top of its configuration
+struct ActionCall {
+    QStringList args;     // the action's "args" template (see ArgumentPlan), filled in
+    QVariantMap fields;   // JSON payload members by PayloadField::key; absent ones are missing
+};
+
+// Everything the program knows about one action type
+struct ActionTypeInfo {
+    QString name;                                         // canonical spelling, e.g. "OpenExe"
+    QVector<ActionParam> params;
+    // What the "native" backend does. Macro steps call it from pool threads,
+    // possibly several at once and alongside the event loop, so it must be
+    // reentrant and must not touch QObjects living on another thread.
+    std::function<bool(const ActionConfig &, const ActionCall &)> run;
+    QVector<PayloadField> payload;                        // schema of JSON payloads
+};
+
+// Action types by name. Built-in types are registered on first use, followed
+// by plugins: shared libraries in $MPM_ACTION_PLUGIN_DIR (default: "actions"
+// next to the executable) exporting
+//   extern "C" int mpm_action_plugin_abi();                  // kPluginAbi
+//   extern "C" void mpm_register_action_types(ActionTypeRegistry *);
+// A privileged process (root, an elevated or LocalSystem service) ignores
+// MPM_ACTION_PLUGIN_DIR and skips directories and libraries that anyone but
+// administrators could modify.
+// Register from the main thread during startup only; lookups afterwards are
+// read-only and safe from any thread.
+class ActionTypeRegistry {
+public:
+    // 3: handlers take an ActionCall; 4: PayloadField ranges; 5: handlers run
+    // on worker threads, concurrently
+    static constexpr int kPluginAbi = 5;
+
+    static ActionTypeRegistry &instance();
+
+    // Returns the new id, or kUnknownActionType if the name is taken or empty
+    ActionTypeId add(ActionTypeInfo info);
+    // O(1): one hash lookup on the case-folded name
+    ActionTypeId find(const QString &name) const;
+    const ActionTypeInfo *info(ActionTypeId id) const;
+    QString name(ActionTypeId id) const;
+    // Registration order, for pickers
+    QStringList names() const;
+
+    // Loads every plugin in dir; returns how many registered successfully
+    int loadPlugins(const QString &dir);
 
+    // Reads the [actions] array in one pass; the single parser for GUI and service
+    QVector<ActionConfig> readActions(QSettings &settings) const;
+    // One row for SettingsWriter::setArray("actions", ...)
+    static QVariantMap toSettingsRow(const ActionConfig &action);
 
+private:
+    ActionTypeRegistry();
+
+    QVector<ActionTypeInfo> m_types;
+    QHash<QString, ActionTypeId> m_byFoldedName;
+};
+
+#endif // ACTIONS_H
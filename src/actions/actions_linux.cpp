@@ -0,0 +1,73 @@
+// Linux action backend: power management and session locking as direct
+// method calls on systemd-logind (org.freedesktop.login1) over a D-Bus
+// connection that stays open for the life of the process.
+//
+// MPM_LOGIND_BUS picks the bus: unset or "system" for the real logind,
+// "session" or a D-Bus address (unix:path=...) to run against a private
+// dbus-daemon with a mock login1 object.
+
+#include "actions_platform.h"
+#include "../common/log_categories.h"
+#include <QDateTime>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QProcess>
+#include <QStringList>
+
+static QDBusConnection logindBus()
+{
+	static const QDBusConnection bus = []() {
+		const QString which = qEnvironmentVariable("MPM_LOGIND_BUS");
+		if (which.isEmpty() || which == "system") return QDBusConnection::systemBus();
+		if (which == "session") return QDBusConnection::sessionBus();
+		return QDBusConnection::connectToBus(which, QStringLiteral("mpm-logind"));
+	}();
+	return bus;
+}
+
+// Calls one Manager method; false if logind is unreachable or refuses (e.g.
+// polkit denies it). For the power methods args is {false}: interactive=false,
+// never wait for a polkit password prompt.
+static bool callLogind(const char *method, const QVariantList &args)
+{
+	const QDBusConnection bus = logindBus();
+	if (!bus.isConnected()) return false;
+	QDBusMessage msg = QDBusMessage::createMethodCall(
+		QStringLiteral("org.freedesktop.login1"), QStringLiteral("/org/freedesktop/login1"),
+		QStringLiteral("org.freedesktop.login1.Manager"), QLatin1String(method));
+	msg.setArguments(args);
+	const QDBusMessage reply = bus.call(msg, QDBus::Block, 5000);
+	if (reply.type() == QDBusMessage::ErrorMessage) {
+		qCWarning(lcActions) << "logind" << method << "failed:" << reply.errorName() << reply.errorMessage();
+		return false;
+	}
+	return true;
+}
+
+namespace NativeActions {
+
+// A JSON "delay" becomes ScheduleShutdown, which also warns logged-in users.
+// logind has no "force": it already ignores inhibitors for privileged callers.
+static bool powerOff(const char *method, const char *scheduleType, const ActionCall &call)
+{
+	const qint64 delay = qMin(call.fields.value(QStringLiteral("delay")).toLongLong(), kMaxPowerOffDelaySec);
+	if (delay <= 0) return callLogind(method, {false});
+	const quint64 atUsec = quint64(QDateTime::currentMSecsSinceEpoch() + delay * 1000) * 1000;
+	return callLogind("ScheduleShutdown", {QString::fromLatin1(scheduleType), QVariant::fromValue(atUsec)});
+}
+
+bool shutdown(const ActionConfig &, const ActionCall &call) { return powerOff("PowerOff", "poweroff", call); }
+bool restart(const ActionConfig &, const ActionCall &call) { return powerOff("Reboot", "reboot", call); }
+bool suspend(const ActionConfig &, const ActionCall &) { return callLogind("Suspend", {false}); }
+// logind has no separate "sleep"; it maps to suspend-to-RAM as on Windows
+bool sleep(const ActionConfig &, const ActionCall &) { return callLogind("Suspend", {false}); }
+bool hibernate(const ActionConfig &, const ActionCall &) { return callLogind("Hibernate", {false}); }
+bool lock(const ActionConfig &, const ActionCall &) { return callLogind("LockSessions", {}); }
+
+bool openExe(const ActionConfig &action, const ActionCall &call)
+{
+	const QString exePath = action.param("exePath");
+	return !exePath.isEmpty() && QProcess::startDetached(exePath, call.args);
+}
+
+} // namespace NativeActions
@@ -0,0 +1,21 @@
+#ifndef ACTIONS_PLATFORM_H
+#define ACTIONS_PLATFORM_H
+
+#include "actions.h"
+
+// Handlers of the built-in action types, implemented once per OS
+// (actions_win.cpp, actions_linux.cpp) and registered in actions.cpp.
+namespace NativeActions {
+// Longest "delay" a JSON payload may ask for (Windows' MAX_SHUTDOWN_TIMEOUT)
+constexpr qint64 kMaxPowerOffDelaySec = 10LL * 365 * 24 * 60 * 60;
+
+bool shutdown(const ActionConfig &action, const ActionCall &call);
+bool restart(const ActionConfig &action, const ActionCall &call);
+bool suspend(const ActionConfig &action, const ActionCall &call);
+bool sleep(const ActionConfig &action, const ActionCall &call);
+bool hibernate(const ActionConfig &action, const ActionCall &call);
+bool lock(const ActionConfig &action, const ActionCall &call);
+bool openExe(const ActionConfig &action, const ActionCall &call);
+}
+
+#endif // ACTIONS_PLATFORM_H
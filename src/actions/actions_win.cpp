@@ -0,0 +1,174 @@
+// Windows action backend: power management through the Win32 API, and
+// session-bound actions routed into the active user's session when running
+// as a service.
+
+#include "actions_platform.h"
+#include <QProcess>
+#include <windows.h>
+#include <powrprof.h>
+#include <wtsapi32.h>
+#include <userenv.h>
+#pragma comment(lib, "Wtsapi32.lib")
+#pragma comment(lib, "Userenv.lib")
+
+static bool runInActiveUserSession(const wchar_t *application, const wchar_t *commandLine)
+{
+	DWORD currentSession = 0;
+	ProcessIdToSessionId(GetCurrentProcessId(), &currentSession);
+	DWORD activeSession = WTSGetActiveConsoleSessionId();
+	if (activeSession == 0xFFFFFFFF || activeSession == currentSession) {
+		return false; // Not a service context or no active session
+	}
+	HANDLE userToken = nullptr;
+	if (!WTSQueryUserToken(activeSession, &userToken)) return false;
+	HANDLE primary = nullptr;
+	if (!DuplicateTokenEx(userToken, TOKEN_ALL_ACCESS, nullptr, SecurityImpersonation, TokenPrimary, &primary)) {
+		CloseHandle(userToken);
+		return false;
+	}
+	CloseHandle(userToken);
+	void *envBlock = nullptr;
+	CreateEnvironmentBlock(&envBlock, primary, FALSE);
+	STARTUPINFOW si{}; si.cb = sizeof(si);
+	PROCESS_INFORMATION pi{};
+	BOOL ok = CreateProcessAsUserW(primary, application, (LPWSTR)commandLine,
+		nullptr, nullptr, FALSE, CREATE_UNICODE_ENVIRONMENT | CREATE_NEW_CONSOLE,
+		envBlock, nullptr, &si, &pi);
+	if (ok) {
+		CloseHandle(pi.hThread);
+		CloseHandle(pi.hProcess);
+	}
+	if (envBlock) DestroyEnvironmentBlock(envBlock);
+	CloseHandle(primary);
+	return ok;
+}
+
+// Appends arg so CommandLineToArgvW reads it back as one argument: quoted,
+// with backslashes doubled only where they precede a quote
+static void appendQuotedArg(std::wstring &cmd, const QString &arg)
+{
+	const std::wstring w = arg.toStdWString();
+	if (!w.empty() && w.find_first_of(L" \t\"") == std::wstring::npos) {
+		cmd += w;
+		return;
+	}
+	cmd.push_back(L'"');
+	size_t backslashes = 0;
+	for (const wchar_t c : w) {
+		if (c == L'\\') {
+			++backslashes;
+			continue;
+		}
+		if (c == L'"') backslashes = backslashes * 2 + 1;
+		cmd.append(backslashes, L'\\');
+		backslashes = 0;
+		cmd.push_back(c);
+	}
+	cmd.append(backslashes * 2, L'\\');
+	cmd.push_back(L'"');
+}
+
+// Privileged system power actions can be done from service context
+static bool enablePrivilege(const wchar_t *privName)
+{
+	HANDLE token = nullptr;
+	if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) {
+		return false;
+	}
+	LUID luid{};
+	const BOOL okLookup = LookupPrivilegeValueW(nullptr, privName, &luid);
+	if (!okLookup) {
+		CloseHandle(token);
+		return false;
+	}
+	TOKEN_PRIVILEGES tp{};
+	tp.PrivilegeCount = 1;
+	tp.Privileges[0].Luid = luid;
+	tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+	const BOOL okAdjust = AdjustTokenPrivileges(token, FALSE, &tp, sizeof(tp), nullptr, nullptr);
+	const DWORD err = GetLastError();
+	CloseHandle(token);
+	return okAdjust && (err == ERROR_SUCCESS);
+}
+
+// Shutdown and Restart, with the JSON "delay" (seconds, shown to the user as
+// a countdown) and "force" (close apps without asking) fields
+static bool powerOff(bool reboot, const ActionCall &call)
+{
+	const qint64 delay = qBound<qint64>(0, call.fields.value(QStringLiteral("delay")).toLongLong(), NativeActions::kMaxPowerOffDelaySec);
+	const bool force = call.fields.value(QStringLiteral("force")).toBool();
+	const DWORD reason = SHTDN_REASON_MAJOR_APPLICATION | SHTDN_REASON_MINOR_OTHER | SHTDN_REASON_FLAG_PLANNED;
+	// Try with proper privilege otherwise fall back to shutdown command
+	enablePrivilege(SE_SHUTDOWN_NAME);
+	if (delay > 0) {
+		if (InitiateSystemShutdownExW(nullptr, nullptr, DWORD(delay), force, reboot, reason)) return true;
+	} else if (ExitWindowsEx((reboot ? EWX_REBOOT : EWX_POWEROFF) | (force ? EWX_FORCE : EWX_FORCEIFHUNG), reason)) {
+		return true;
+	}
+	QStringList args{reboot ? "/r" : "/s", "/t", QString::number(delay)};
+	if (force) args << "/f";
+	return QProcess::startDetached("shutdown", args);
+}
+
+namespace NativeActions {
+
+bool openExe(const ActionConfig &action, const ActionCall &call)
+{
+	// Service-aware handling for session-bound actions
+	const QString exePath = action.param("exePath");
+	if (exePath.isEmpty()) return false;
+	// Try to run in active user session when running as a service
+	const std::wstring wexe = exePath.toStdWString();
+	std::wstring cmd;
+	appendQuotedArg(cmd, exePath);
+	for (const QString &arg : call.args) {
+		cmd.push_back(L' ');
+		appendQuotedArg(cmd, arg);
+	}
+	if (runInActiveUserSession(wexe.c_str(), cmd.c_str())) return true;
+	return QProcess::startDetached(exePath, call.args);
+}
+
+bool lock(const ActionConfig &, const ActionCall &)
+{
+	// Prefer to lock in the active user session
+	std::wstring cmd = L"rundll32.exe user32.dll,LockWorkStation";
+	if (runInActiveUserSession(L"C:\\Windows\\System32\\rundll32.exe", (LPWSTR)cmd.c_str())) return true;
+	if (LockWorkStation()) return true;
+	return QProcess::startDetached("rundll32.exe", {"user32.dll,LockWorkStation"});
+}
+
+bool shutdown(const ActionConfig &, const ActionCall &call)
+{
+	return powerOff(false, call);
+}
+
+bool restart(const ActionConfig &, const ActionCall &call)
+{
+	return powerOff(true, call);
+}
+
+bool suspend(const ActionConfig &, const ActionCall &)
+{
+	enablePrivilege(SE_SHUTDOWN_NAME);
+	if (SetSuspendState(FALSE, TRUE, FALSE)) {
+		return true;
+	}
+	return QProcess::startDetached("rundll32.exe", {"powrprof.dll,SetSuspendState", "0", "1", "0"});
+}
+
+bool sleep(const ActionConfig &action, const ActionCall &call)
+{
+	return suspend(action, call);
+}
+
+bool hibernate(const ActionConfig &, const ActionCall &)
+{
+	enablePrivilege(SE_SHUTDOWN_NAME);
+	if (SetSuspendState(TRUE, TRUE, FALSE)) {
+		return true;
+	}
+	return QProcess::startDetached("shutdown", {"/h"});
+}
+
+} // namespace NativeActions
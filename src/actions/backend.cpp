@@ -0,0 +1,133 @@
+#include "backend.h"
+#include "../common/log_categories.h"
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <chrono>
+
+namespace {
+
+struct BackendRegistry {
+	QMutex mutex;
+	QMap<QString, ActionBackendFactory> factories;   // key: lower-case name
+
+	BackendRegistry()
+	{
+		factories.insert(QStringLiteral("native"), []() -> std::unique_ptr<ActionBackend> {
+			return std::make_unique<NativeActionBackend>();
+		});
+		factories.insert(QStringLiteral("print-only"), []() -> std::unique_ptr<ActionBackend> {
+			return std::make_unique<PrintOnlyActionBackend>();
+		});
+		factories.insert(QStringLiteral("recording"), []() -> std::unique_ptr<ActionBackend> {
+			return std::make_unique<RecordingActionBackend>();
+		});
+	}
+};
+
+BackendRegistry &registry()
+{
+	static BackendRegistry r;
+	return r;
+}
+
+} // namespace
+
+bool registerActionBackend(const QString &name, ActionBackendFactory factory)
+{
+	const QString key = name.trimmed().toLower();
+	if (key.isEmpty() || !factory) return false;
+	BackendRegistry &r = registry();
+	QMutexLocker lock(&r.mutex);
+	if (r.factories.contains(key)) return false;
+	r.factories.insert(key, std::move(factory));
+	return true;
+}
+
+std::unique_ptr<ActionBackend> createActionBackend(const QString &name)
+{
+	ActionBackendFactory factory;
+	{
+		BackendRegistry &r = registry();
+		QMutexLocker lock(&r.mutex);
+		factory = r.factories.value(name.trimmed().toLower());
+	}
+	return factory ? factory() : nullptr;
+}
+
+QStringList actionBackendNames()
+{
+	BackendRegistry &r = registry();
+	QMutexLocker lock(&r.mutex);
+	return r.factories.keys();
+}
+
+bool NativeActionBackend::execute(const ActionConfig &action, const ActionCall &call)
+{
+	const ActionTypeInfo *t = ActionTypeRegistry::instance().info(action.type);
+	if (!t || !t->run) {
+		qCWarning(lcActions) << "No handler for action type" << action.typeName;
+		return false;
+	}
+	return t->run(action, call);
+}
+
+bool PrintOnlyActionBackend::execute(const ActionConfig &action, const ActionCall &call)
+{
+	qCInfo(lcActions) << "Print only mode enabled — not running" << action.customName
+	                  << "type=" << action.typeName << "args=" << call.args << "fields=" << call.fields;
+	return true;
+}
+
+RecordingActionBackend::RecordingActionBackend(int capacity)
+	: m_slots(new Slot[size_t(qMax(1, capacity))]), m_capacity(qMax(1, capacity))
+{
+}
+
+bool RecordingActionBackend::execute(const ActionConfig &action, const ActionCall &)
+{
+	const qint64 now = nowNs();
+	const quint64 index = m_claimed.fetch_add(1, std::memory_order_relaxed);
+	if (index >= quint64(m_capacity)) return true;
+	Slot &slot = m_slots[size_t(index)];
+	slot.invocation.timestampNs = now;
+	slot.invocation.type = action.type;
+	slot.invocation.nameHash = qHash(action.customName.toLower());
+	slot.ready.store(true, std::memory_order_release);
+	return true;
+}
+
+int RecordingActionBackend::count() const
+{
+	return int(qMin<quint64>(m_claimed.load(std::memory_order_acquire), quint64(m_capacity)));
+}
+
+bool RecordingActionBackend::at(int i, Invocation *out) const
+{
+	if (i < 0 || i >= count()) return false;
+	const Slot &slot = m_slots[size_t(i)];
+	if (!slot.ready.load(std::memory_order_acquire)) return false;
+	if (out) *out = slot.invocation;
+	return true;
+}
+
+quint64 RecordingActionBackend::dropped() const
+{
+	const quint64 claimed = m_claimed.load(std::memory_order_acquire);
+	return claimed > quint64(m_capacity) ? claimed - quint64(m_capacity) : 0;
+}
+
+void RecordingActionBackend::clear()
+{
+	const int n = count();
+	for (int i = 0; i < n; ++i) m_slots[size_t(i)].ready.store(false, std::memory_order_relaxed);
+	m_claimed.store(0, std::memory_order_release);
+}
+
+qint64 RecordingActionBackend::nowNs()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
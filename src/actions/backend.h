@@ -0,0 +1,90 @@
+#ifndef ACTIONS_BACKEND_H
+#define ACTIONS_BACKEND_H
+
+#include <QString>
+#include <QStringList>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "actions.h"
+
+// Carries out a routed action. ActionDispatcher decides which action a
+// message means; the backend decides what running it does: the OS ("native"),
+// a log line ("print-only", what options/printOnly selects) or a timestamped
+// record ("recording", for benchmarks and dry runs on any machine).
+class ActionBackend {
+public:
+	virtual ~ActionBackend() = default;
+	// Name it was registered under
+	virtual QString name() const = 0;
+	// call: what the message asked for on top of the configuration. Macro
+	// steps call this from worker threads, several at a time, so it must be
+	// thread-safe, and so must the ActionTypeInfo::run handlers it calls.
+	virtual bool execute(const ActionConfig &action, const ActionCall &call) = 0;
+	// True if execute() only pretends: its successes are dry runs, counted
+	// and reported apart from actions that really ran
+	virtual bool simulates() const { return false; }
+};
+
+using ActionBackendFactory = std::function<std::unique_ptr<ActionBackend>()>;
+
+// "native", "print-only" and "recording" are built in. Returns false if the
+// name is already taken. Names are case-insensitive.
+bool registerActionBackend(const QString &name, ActionBackendFactory factory);
+// nullptr for unknown names
+std::unique_ptr<ActionBackend> createActionBackend(const QString &name);
+QStringList actionBackendNames();
+
+// Runs the handler the action's type registered (see ActionTypeRegistry)
+class NativeActionBackend : public ActionBackend {
+public:
+	QString name() const override { return QStringLiteral("native"); }
+	bool execute(const ActionConfig &action, const ActionCall &call) override;
+};
+
+// Logs what would run and reports a simulated success without touching the system
+class PrintOnlyActionBackend : public ActionBackend {
+public:
+	QString name() const override { return QStringLiteral("print-only"); }
+	bool execute(const ActionConfig &action, const ActionCall &call) override;
+	bool simulates() const override { return true; }
+};
+
+// Records one timestamped entry per call into a fixed buffer without locks:
+// a caller claims a slot with one atomic increment and publishes it with a
+// release store, so it is safe from any thread and costs no allocation.
+// Calls beyond the capacity are counted as dropped, not stored.
+class RecordingActionBackend : public ActionBackend {
+public:
+	struct Invocation {
+		qint64 timestampNs = 0;                 // nowNs() clock
+		ActionTypeId type = kUnknownActionType;
+		uint nameHash = 0;                      // qHash of the lower-cased action name
+	};
+
+	explicit RecordingActionBackend(int capacity = 1 << 16);
+	QString name() const override { return QStringLiteral("recording"); }
+	bool execute(const ActionConfig &action, const ActionCall &call) override;
+
+	// Slots claimed so far, at most the capacity
+	int count() const;
+	// False while slot i is still being written
+	bool at(int i, Invocation *out) const;
+	quint64 dropped() const;
+	// Forgets all records; callers must make sure no execute() is running
+	void clear();
+
+	// Monotonic clock the timestamps use, for callers measuring latency
+	static qint64 nowNs();
+
+private:
+	struct Slot {
+		std::atomic<bool> ready{false};
+		Invocation invocation;
+	};
+	std::unique_ptr<Slot[]> m_slots;
+	int m_capacity;
+	std::atomic<quint64> m_claimed{0};
+};
+
+#endif // ACTIONS_BACKEND_H
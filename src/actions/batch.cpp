@@ -0,0 +1,117 @@
+#include "batch.h"
+#include "json_payload.h"
+
+namespace {
+
+bool readStep(const JsonScalar &value, BatchStep *step, QString *error)
+{
+	static const QString actionKey = QStringLiteral("action");
+	static const QString messageKey = QStringLiteral("message");
+	static const QString delayKey = QStringLiteral("delayMs");
+	if (value.type != JsonScalar::Nested) {
+		*error = QStringLiteral("a step is not an object");
+		return false;
+	}
+	JsonObjectReader reader(value);
+	JsonScalar key;
+	JsonScalar member;
+	while (reader.next(&key, &member)) {
+		if (key.equals(actionKey)) {
+			if (member.type != JsonScalar::String) {
+				*error = QStringLiteral("step action is not a string");
+				return false;
+			}
+			step->action = member.toString();
+		} else if (key.equals(messageKey)) {
+			if (member.type == JsonScalar::String) {
+				step->message = member.toString().toUtf8();
+			} else if (member.type == JsonScalar::Nested && *member.data == '{') {
+				step->message = QByteArray(member.data, member.size);
+			} else if (member.type != JsonScalar::Null) {
+				*error = QStringLiteral("step message is not a string or an object");
+				return false;
+			}
+		} else if (key.equals(delayKey)) {
+			qint64 delay = 0;
+			if (!member.toInt64(&delay) || delay < 0 || delay > BatchRequest::kMaxDelayMs) {
+				*error = QStringLiteral("step delayMs must be 0..%1").arg(BatchRequest::kMaxDelayMs);
+				return false;
+			}
+			step->delayMs = int(delay);
+		}
+	}
+	if (reader.error()) {
+		*error = QString::fromLatin1(reader.error());
+		return false;
+	}
+	if (step->action.isEmpty()) {
+		*error = QStringLiteral("a step has no action");
+		return false;
+	}
+	return true;
+}
+
+} // namespace
+
+bool BatchRequest::parse(const QByteArray &payload, BatchRequest *out, QString *error)
+{
+	static const QString idKey = QStringLiteral("id");
+	static const QString stopKey = QStringLiteral("stopOnFailure");
+	static const QString stepsKey = QStringLiteral("steps");
+	QString why;
+	auto fail = [&]() {
+		if (error) *error = why;
+		return false;
+	};
+	BatchRequest r;
+	JsonObjectReader reader(payload);
+	JsonScalar key;
+	JsonScalar value;
+	bool haveSteps = false;
+	while (reader.next(&key, &value)) {
+		if (key.equals(idKey)) {
+			if (value.type != JsonScalar::String) {
+				why = QStringLiteral("id is not a string");
+				return fail();
+			}
+			r.id = value.toString();
+		} else if (key.equals(stopKey)) {
+			if (value.type != JsonScalar::Bool) {
+				why = QStringLiteral("stopOnFailure is not a boolean");
+				return fail();
+			}
+			r.stopOnFailure = value.boolean;
+		} else if (key.equals(stepsKey)) {
+			if (haveSteps || value.type != JsonScalar::Nested || *value.data != '[') {
+				why = QStringLiteral("steps is not an array");
+				return fail();
+			}
+			haveSteps = true;
+			JsonArrayReader steps(value);
+			JsonScalar entry;
+			while (steps.next(&entry)) {
+				if (r.steps.size() == kMaxSteps) {
+					why = QStringLiteral("more than %1 steps").arg(kMaxSteps);
+					return fail();
+				}
+				BatchStep step;
+				if (!readStep(entry, &step, &why)) return fail();
+				r.steps.push_back(std::move(step));
+			}
+			if (steps.error()) {
+				why = QString::fromLatin1(steps.error());
+				return fail();
+			}
+		}
+	}
+	if (reader.error()) {
+		why = QString::fromLatin1(reader.error());
+		return fail();
+	}
+	if (r.steps.isEmpty()) {
+		why = QStringLiteral("no steps");
+		return fail();
+	}
+	*out = std::move(r);
+	return true;
+}
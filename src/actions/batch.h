@@ -0,0 +1,35 @@
+#ifndef ACTIONS_BATCH_H
+#define ACTIONS_BATCH_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// One step of a batch message
+struct BatchStep {
+	QString action;            // configured action name, as in its topic
+	QByteArray message;        // what its own topic would have carried; null: run it like "mpmctl run"
+	int delayMs = 0;           // wait before this step
+};
+
+// Several actions in one publish on mqttpowermanager/<user>/batch:
+//   {"id":"evening","stopOnFailure":true,"steps":[
+//     {"action":"Lock"},
+//     {"action":"Browser","message":"OPEN:https://example.com","delayMs":500},
+//     {"action":"PC","message":{"cmd":"shutdown","delay":60}}]}
+// A string message is used as the payload; an object one is passed on as
+// its JSON text, for actions with JSON payloads.
+struct BatchRequest {
+	static constexpr int kMaxSteps = 32;
+	static constexpr int kMaxDelayMs = 10 * 60 * 1000;
+
+	QString id;                // echoed in the result; optional
+	bool stopOnFailure = true;
+	QVector<BatchStep> steps;
+
+	// False with a reason for malformed JSON, no steps, too many steps, a step
+	// without an action or a delay out of range
+	static bool parse(const QByteArray &payload, BatchRequest *out, QString *error);
+};
+
+#endif // ACTIONS_BATCH_H
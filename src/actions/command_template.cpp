@@ -0,0 +1,233 @@
+#include "command_template.h"
+
+namespace {
+
+// Index of the '}' closing the placeholder opened at open, or -1
+int placeholderEnd(const QString &text, int open)
+{
+	const int close = text.indexOf('}', open + 1);
+	if (close < 0) return -1;
+	const int nested = text.indexOf('{', open + 1);
+	return nested >= 0 && nested < close ? -1 : close;
+}
+
+bool isEscapedBrace(const QString &text, int i)
+{
+	return i + 1 < text.size() && text.at(i + 1) == text.at(i);
+}
+
+} // namespace
+
+bool PayloadPattern::compile(const QString &text, PayloadPattern *out, QString *error)
+{
+	auto fail = [error](const QString &why) {
+		if (error) *error = why;
+		return false;
+	};
+	PayloadPattern p;
+	QString literal;
+	for (int i = 0; i < text.size(); ++i) {
+		const QChar c = text.at(i);
+		if ((c == '{' || c == '}') && isEscapedBrace(text, i)) {
+			literal += c;
+			++i;
+			continue;
+		}
+		if (c == '}') return fail(QStringLiteral("stray '}' at %1").arg(i));
+		if (c != '{') {
+			literal += c;
+			continue;
+		}
+		const int close = placeholderEnd(text, i);
+		if (close < 0) return fail(QStringLiteral("unclosed '{' at %1").arg(i));
+		const QString spec = text.mid(i + 1, close - i - 1);
+		const int colon = spec.indexOf(':');
+		Capture cap;
+		cap.name = (colon < 0 ? spec : spec.left(colon)).trimmed();
+		const QString kind = colon < 0 ? QString() : spec.mid(colon + 1).trimmed().toLower();
+		if (cap.name.isEmpty()) return fail(QStringLiteral("placeholder without a name at %1").arg(i));
+		if (p.captureIndex(cap.name) >= 0) return fail(QStringLiteral("placeholder {%1} used twice").arg(cap.name));
+		if (kind == "int") cap.kind = Int;
+		else if (kind == "word") cap.kind = Word;
+		else if (!kind.isEmpty()) return fail(QStringLiteral("unknown placeholder kind '%1'").arg(kind));
+		// Without a literal in between there is no telling where one ends
+		if (!p.m_captures.isEmpty() && literal.isEmpty()) {
+			return fail(QStringLiteral("placeholders {%1} and {%2} need text between them")
+			                .arg(p.m_captures.last().name, cap.name));
+		}
+		p.m_literalLength += literal.size();
+		p.m_literals.push_back(literal);
+		literal.clear();
+		p.m_captures.push_back(cap);
+		i = close;
+	}
+	p.m_literalLength += literal.size();
+	p.m_literals.push_back(literal);
+	*out = std::move(p);
+	return true;
+}
+
+PayloadPattern PayloadPattern::literal(const QString &text)
+{
+	PayloadPattern p;
+	p.m_literals.push_back(text);
+	p.m_literalLength = text.size();
+	return p;
+}
+
+int PayloadPattern::captureIndex(const QString &name) const
+{
+	for (int i = 0; i < m_captures.size(); ++i) {
+		if (m_captures[i].name == name) return i;
+	}
+	return -1;
+}
+
+bool PayloadPattern::valid(QStringView value, Kind kind)
+{
+	switch (kind) {
+	case Any:
+		return true;
+	case Int: {
+		int i = value.startsWith(QLatin1Char('-')) ? 1 : 0;
+		if (i == value.size()) return false;
+		for (; i < value.size(); ++i) {
+			const ushort u = value.at(i).unicode();
+			if (u < '0' || u > '9') return false;
+		}
+		return true;
+	}
+	case Word:
+		for (const QChar c : value) {
+			if (c.isSpace()) return false;
+		}
+		return true;
+	}
+	return false;
+}
+
+bool PayloadPattern::match(QStringView payload, TemplateCaptures *captures) const
+{
+	if (payload.size() < m_literalLength) return false;
+	if (!hasCaptures()) return payload.compare(QStringView(m_literals.first()), Qt::CaseInsensitive) == 0;
+
+	const QStringView head(m_literals.first());
+	const QStringView tail(m_literals.last());
+	if (!payload.startsWith(head, Qt::CaseInsensitive) || !payload.endsWith(tail, Qt::CaseInsensitive)) return false;
+
+	TemplateCaptures scratch;
+	TemplateCaptures &out = captures ? *captures : scratch;
+	out.clear();
+	const int end = int(payload.size() - tail.size());
+	int pos = int(head.size());
+	for (int i = 0; i < m_captures.size(); ++i) {
+		const bool last = i + 1 == m_captures.size();
+		const QStringView next(m_literals[i + 1]);
+		// from pos + 1: a capture is never empty
+		const int stop = last ? end : int(payload.indexOf(next, pos + 1, Qt::CaseInsensitive));
+		if (stop <= pos || stop + (last ? 0 : int(next.size())) > end) return false;
+		const QStringView value = payload.mid(pos, stop - pos);
+		if (!valid(value, m_captures[i].kind)) return false;
+		out.push_back(value);
+		pos = stop + int(next.size());
+	}
+	return true;
+}
+
+bool ArgumentPlan::compile(const QString &text, const PayloadPattern &pattern, ArgumentPlan *out, QString *error)
+{
+	auto fail = [error](const QString &why) {
+		if (error) *error = why;
+		return false;
+	};
+	ArgumentPlan plan;
+	Arg arg;
+	QString literal;
+	bool inArg = false;
+	bool quoted = false;
+	auto flushLiteral = [&]() {
+		if (literal.isEmpty()) return;
+		arg.literalLength += literal.size();
+		arg.pieces.push_back({literal, -1});
+		literal.clear();
+	};
+	auto endArg = [&]() {
+		flushLiteral();
+		if (inArg) plan.m_args.push_back(arg);
+		arg = Arg();
+		inArg = false;
+	};
+	for (int i = 0; i < text.size(); ++i) {
+		const QChar c = text.at(i);
+		if (c == '"') {
+			quoted = !quoted;
+			inArg = true;   // "" is an empty argument
+			continue;
+		}
+		if (!quoted && c.isSpace()) {
+			endArg();
+			continue;
+		}
+		inArg = true;
+		if ((c == '{' || c == '}') && isEscapedBrace(text, i)) {
+			literal += c;
+			++i;
+			continue;
+		}
+		if (c == '}') return fail(QStringLiteral("stray '}' at %1").arg(i));
+		if (c != '{') {
+			literal += c;
+			continue;
+		}
+		const int close = placeholderEnd(text, i);
+		if (close < 0) return fail(QStringLiteral("unclosed '{' at %1").arg(i));
+		const QString spec = text.mid(i + 1, close - i - 1);
+		const int colon = spec.indexOf(':');
+		const QString name = (colon < 0 ? spec : spec.left(colon)).trimmed();
+		const QString option = colon < 0 ? QString() : spec.mid(colon + 1).trimmed().toLower();
+		if (!option.isEmpty() && option != "dash") return fail(QStringLiteral("unknown argument option '%1'").arg(option));
+		const int index = pattern.captureIndex(name);
+		if (index < 0) return fail(QStringLiteral("{%1} is not a placeholder of the message").arg(name));
+		flushLiteral();
+		// Only a value at the very start of an argument can pass for an option
+		if (arg.pieces.isEmpty() && option.isEmpty() && !plan.m_leading.contains(index)) plan.m_leading.push_back(index);
+		arg.pieces.push_back({QString(), index});
+		i = close;
+	}
+	if (quoted) return fail(QStringLiteral("unclosed '\"'"));
+	endArg();
+	*out = std::move(plan);
+	return true;
+}
+
+bool ArgumentPlan::accepts(const TemplateCaptures &captures) const
+{
+	for (const int i : m_leading) {
+		if (i < captures.size() && captures[i].startsWith(QLatin1Char('-'))) return false;
+	}
+	return true;
+}
+
+QStringList ArgumentPlan::build(const TemplateCaptures &captures) const
+{
+	QStringList out;
+	out.reserve(m_args.size());
+	for (const Arg &a : m_args) {
+		int length = a.literalLength;
+		for (const Piece &p : a.pieces) {
+			if (p.capture >= 0 && p.capture < captures.size()) length += int(captures[p.capture].size());
+		}
+		QString s;
+		s.reserve(length);
+		for (const Piece &p : a.pieces) {
+			if (p.capture < 0) {
+				s += p.literal;
+			} else if (p.capture < captures.size()) {
+				const QStringView v = captures[p.capture];
+				s.append(v.data(), int(v.size()));
+			}
+		}
+		out << s;
+	}
+	return out;
+}
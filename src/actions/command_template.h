@@ -0,0 +1,80 @@
+#ifndef ACTIONS_COMMAND_TEMPLATE_H
+#define ACTIONS_COMMAND_TEMPLATE_H
+
+#include <QString>
+#include <QStringList>
+#include <QStringView>
+#include <QVarLengthArray>
+#include <QVector>
+
+// Values a PayloadPattern extracted, as views into the matched payload;
+// valid only while that payload is alive
+using TemplateCaptures = QVarLengthArray<QStringView, 4>;
+
+// An expected message with named placeholders, e.g. "OPEN:{url}" or
+// "VOL {level:int}", compiled once when actions are loaded. Literal text
+// matches ignoring case, "{{" and "}}" are literal braces, and a placeholder
+// captures the shortest non-empty run up to the next literal. Kinds:
+//   {name}       anything
+//   {name:int}   optional '-' then digits
+//   {name:word}  no whitespace
+// Matching walks the payload once and allocates nothing.
+class PayloadPattern {
+public:
+	// False with a reason for malformed text (unbalanced brace, two
+	// placeholders with no literal between them, unknown kind, ...)
+	static bool compile(const QString &text, PayloadPattern *out, QString *error);
+	// The whole text as one literal, braces included: how actions without an
+	// "args" template match, as they did before placeholders existed
+	static PayloadPattern literal(const QString &text);
+
+	bool hasCaptures() const { return !m_captures.isEmpty(); }
+	// -1 if there is no placeholder of that name
+	int captureIndex(const QString &name) const;
+	bool match(QStringView payload, TemplateCaptures *captures) const;
+
+private:
+	enum Kind { Any, Int, Word };
+	struct Capture {
+		QString name;
+		Kind kind = Any;
+	};
+	static bool valid(QStringView value, Kind kind);
+
+	QVector<QString> m_literals;   // one more than m_captures; outer ones may be empty
+	QVector<Capture> m_captures;
+	int m_literalLength = 0;       // payloads shorter than this can't match
+};
+
+// Command-line arguments with placeholders from a PayloadPattern, e.g.
+// "--new-window {url}", split into arguments once at compile time. Spaces
+// separate arguments and double quotes group them; a captured value always
+// stays inside the argument it was written in, whatever it contains, so a
+// payload can't add arguments of its own. Nor can it turn one into an option:
+// a value that would start an argument with '-' is refused (see accepts())
+// unless the template opts in with {name:dash}, e.g. for "-5" as a number.
+class ArgumentPlan {
+public:
+	static bool compile(const QString &text, const PayloadPattern &pattern, ArgumentPlan *out, QString *error);
+
+	bool isEmpty() const { return m_args.isEmpty(); }
+	// False if a captured value would start an argument with '-' where the
+	// template didn't allow it; such a message must not match
+	bool accepts(const TemplateCaptures &captures) const;
+	// One allocation per argument, sized up front
+	QStringList build(const TemplateCaptures &captures) const;
+
+private:
+	struct Piece {
+		QString literal;
+		int capture = -1;   // index into the captures instead of literal
+	};
+	struct Arg {
+		QVector<Piece> pieces;
+		int literalLength = 0;
+	};
+	QVector<Arg> m_args;
+	QVector<int> m_leading;   // captures that start an argument without :dash
+};
+
+#endif // ACTIONS_COMMAND_TEMPLATE_H
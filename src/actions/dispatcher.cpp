@@ -0,0 +1,146 @@
+#include "dispatcher.h"
+#include "json_payload.h"
+#include "../common/log_categories.h"
+
+#include <algorithm>
+
+bool ActionDispatcher::isInternalTopic(const QString &topic)
+{
+	// Our own retained health flag and forwarded logs arrive on the same wildcard
+	const int slash = topic.lastIndexOf(QLatin1Char('/'));
+	if (slash < 0) return false;
+	const QStringView level = QStringView(topic).mid(slash + 1);
+	return level == QLatin1String(kHealthTopicLevel) || level == QLatin1String(kLogTopicLevel);
+}
+
+void ActionDispatcher::setActions(const QVector<ActionConfig> &actions)
+{
+	m_actions = actions;
+	m_compiled.clear();
+	m_compiled.resize(m_actions.size());
+	for (int i = 0; i < m_actions.size(); ++i) {
+		const ActionConfig &a = m_actions[i];
+		Compiled &c = m_compiled[i];
+		for (const char *reserved : {kBatchTopicLevel, kHealthTopicLevel, kLogTopicLevel}) {
+			if (a.customName.compare(QLatin1String(reserved), Qt::CaseInsensitive) == 0) {
+				qCWarning(lcDispatch) << "Action" << a.customName << "is shadowed by the" << reserved << "topic; rename it";
+			}
+		}
+		const QString args = a.param(QStringLiteral("args"));
+		// Placeholders only feed arguments; without a template the message is
+		// matched exactly, so {"state":"ON"} keeps working
+		if (args.isEmpty()) {
+			c.pattern = PayloadPattern::literal(a.expectedMessage);
+		} else if (!PayloadPattern::compile(a.expectedMessage, &c.pattern, &c.error)) {
+			c.error = QStringLiteral("message: ") + c.error;
+			qCWarning(lcDispatch) << "Action" << a.customName << "message" << a.expectedMessage << "is invalid:" << c.error;
+			continue;
+		} else if (!ArgumentPlan::compile(args, c.pattern, &c.plan, &c.error)) {
+			c.error = QStringLiteral("arguments: ") + c.error;
+			qCWarning(lcDispatch) << "Action" << a.customName << "arguments" << args << "are invalid:" << c.error;
+			continue;
+		}
+		if (a.payloadFormat == PayloadFormat::Json) {
+			if (const ActionTypeInfo *t = ActionTypeRegistry::instance().info(a.type)) c.schema = t->payload;
+		}
+		c.ok = true;
+	}
+}
+
+ActionDispatcher::Route ActionDispatcher::route(const QString &topic, const QByteArray &payload) const
+{
+	Route r;
+	if (isInternalTopic(topic)) {
+		r.kind = Route::Internal;
+		return r;
+	}
+	// Last level of mqttpowermanager/<user>/<action>, without splitting the topic
+	const int slash = topic.lastIndexOf('/');
+	if (slash > 0 && topic.lastIndexOf('/', slash - 1) >= 0) r.actionName = topic.mid(slash + 1);
+	if (r.actionName.compare(QLatin1String(kBatchTopicLevel), Qt::CaseInsensitive) == 0) {
+		r.kind = Route::Batch;
+		return r;
+	}
+	return match(r.actionName, payload);
+}
+
+ActionDispatcher::Route ActionDispatcher::match(const QString &actionName, const QByteArray &payload) const
+{
+	Route r;
+	r.actionName = actionName;
+	QString text;             // decoded once, for text actions
+	bool haveText = false;
+	TemplateCaptures captures;
+	QVarLengthArray<JsonScalar, 8> fields;
+	for (int i = 0; i < m_actions.size(); ++i) {
+		const ActionConfig &a = m_actions[i];
+		const Compiled &c = m_compiled[i];
+		if (!c.ok || a.customName.compare(r.actionName, Qt::CaseInsensitive) != 0) continue;
+		if (a.payloadFormat == PayloadFormat::Json) {
+			fields.resize(c.schema.size());
+			JsonScalar cmd;
+			const char *error = nullptr;
+			if (!readJsonPayload(payload, c.schema, &cmd, fields.data(), &error)) {
+				qCDebug(lcDispatch) << "Action" << a.customName << "rejected payload:" << error;
+				continue;
+			}
+			const QString cmdText = cmd.toString();
+			if (!c.pattern.match(cmdText, &captures)) continue;
+			if (!c.plan.accepts(captures)) {
+				qCWarning(lcDispatch) << "Action" << a.customName << "refused a value that would pass as an option";
+				continue;
+			}
+			r.call.fields = jsonPayloadValues(c.schema, fields.constData());
+			r.call.args = c.plan.build(captures);
+		} else {
+			if (!haveText) {
+				text = QString::fromUtf8(payload);
+				haveText = true;
+			}
+			if (!c.pattern.match(text, &captures)) continue;
+			if (!c.plan.accepts(captures)) {
+				qCWarning(lcDispatch) << "Action" << a.customName << "refused a value that would pass as an option";
+				continue;
+			}
+			r.call.args = c.plan.build(captures);
+		}
+		r.kind = Route::Run;
+		r.action = &a;
+		return r;
+	}
+	return r;
+}
+
+const ActionConfig *ActionDispatcher::findByName(const QString &name) const
+{
+	auto it = std::find_if(m_actions.cbegin(), m_actions.cend(), [&](const ActionConfig &a) {
+		return a.customName.compare(name, Qt::CaseInsensitive) == 0;
+	});
+	return it == m_actions.cend() ? nullptr : &*it;
+}
+
+QString ActionDispatcher::compileError(int index) const
+{
+	return index >= 0 && index < m_compiled.size() ? m_compiled[index].error : QString();
+}
+
+QStringList ActionDispatcher::invalidActions() const
+{
+	QStringList out;
+	for (int i = 0; i < m_compiled.size(); ++i) {
+		if (!m_compiled[i].error.isEmpty()) out << m_actions[i].customName + QStringLiteral(": ") + m_compiled[i].error;
+	}
+	return out;
+}
+
+bool ActionDispatcher::argumentsFor(const ActionConfig *action, QStringList *arguments) const
+{
+	for (int i = 0; i < m_actions.size(); ++i) {
+		if (&m_actions[i] != action) continue;
+		const Compiled &c = m_compiled[i];
+		if (!c.ok || c.pattern.hasCaptures()) return false;
+		if (arguments) *arguments = c.plan.build(TemplateCaptures());
+		return true;
+	}
+	return false;
+}
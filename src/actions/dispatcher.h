@@ -0,0 +1,74 @@
+#ifndef ACTIONS_DISPATCHER_H
+#define ACTIONS_DISPATCHER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include "actions.h"
+#include "command_template.h"
+
+// Decides what an inbound MQTT message means. Shared by the GUI and the
+// service so both match topics and payloads the same way; executing the
+// action (through an ActionBackend), logging and counting stay with the
+// caller. Print-only mode is a backend, so it still routes and counts.
+class ActionDispatcher {
+public:
+	// Last topic level of batch messages; no action can be called this
+	static constexpr const char *kBatchTopicLevel = "batch";
+	// Last topic levels of our own retained health flag and forwarded logs.
+	// Messages there are never dispatched, so these names are reserved too.
+	static constexpr const char *kHealthTopicLevel = "health";
+	static constexpr const char *kLogTopicLevel = "log";
+
+	struct Route {
+		enum Kind {
+			Internal,   // our own health flag or forwarded log; not a command
+			NoMatch,
+			Run,
+			Batch       // a BatchRequest on <prefix>/batch; the caller runs it
+		};
+		Kind kind = NoMatch;
+		QString actionName;                  // last topic level
+		const ActionConfig *action = nullptr; // set for Run; valid until setActions()
+		ActionCall call;                     // set for Run
+	};
+
+	// Compiles each action's expected message (a PayloadPattern) and its
+	// "args" parameter (an ArgumentPlan). Without an "args" template the
+	// message is a plain literal, braces and all. An action whose templates
+	// don't compile is kept but never matches; the reason is logged and
+	// reported by compileError() and invalidActions().
+	void setActions(const QVector<ActionConfig> &actions);
+	const QVector<ActionConfig> &actions() const { return m_actions; }
+	// Why actions()[index] never matches; empty if it compiled
+	QString compileError(int index) const;
+	// "name: reason" for every action that didn't compile
+	QStringList invalidActions() const;
+
+	// Topic is mqttpowermanager/<user>/<action>; the payload must match the
+	// action's expected message. Both comparisons ignore case. For a JSON
+	// action the payload's "cmd" member is matched instead, and the members
+	// its type declares end up in call.fields (see readJsonPayload).
+	Route route(const QString &topic, const QByteArray &payload) const;
+	// The action part of route(): payload as if published to actionName's topic
+	Route match(const QString &actionName, const QByteArray &payload) const;
+	const ActionConfig *findByName(const QString &name) const;
+	// Arguments for running action without a payload (IPC "run"); false if
+	// it isn't one of ours, didn't compile or its message has placeholders
+	bool argumentsFor(const ActionConfig *action, QStringList *arguments) const;
+	static bool isInternalTopic(const QString &topic);
+
+private:
+	struct Compiled {
+		PayloadPattern pattern;
+		ArgumentPlan plan;
+		QVector<PayloadField> schema;   // JSON actions: the type's payload fields
+		QString error;                  // why it didn't compile
+		bool ok = false;
+	};
+	QVector<ActionConfig> m_actions;
+	QVector<Compiled> m_compiled;   // parallel to m_actions
+};
+
+#endif // ACTIONS_DISPATCHER_H
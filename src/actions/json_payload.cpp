@@ -0,0 +1,388 @@
+#include "json_payload.h"
+
+#include <QLatin1String>
+#include <cstring>
+
+namespace {
+
+constexpr int kMaxNesting = 32;
+constexpr int kMaxSchemaFields = 64;   // one bit each in readJsonPayload
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+int hexValue(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+} // namespace
+
+bool JsonScalar::toInt64(qint64 *out) const
+{
+	if (type != Number || !integral) return false;
+	const char *p = data;
+	const char *end = data + size;
+	const bool negative = *p == '-';
+	if (negative) ++p;
+	// Accumulate the magnitude unsigned so INT64_MIN still fits
+	const quint64 limit = negative ? quint64(1) << 63 : (quint64(1) << 63) - 1;
+	quint64 v = 0;
+	for (; p < end; ++p) {
+		const quint64 digit = quint64(*p - '0');
+		if (v > (limit - digit) / 10) return false;
+		v = v * 10 + digit;
+	}
+	if (out) *out = negative ? qint64(0 - v) : qint64(v);
+	return true;
+}
+
+QString JsonScalar::toString() const
+{
+	if (type != String) return QString();
+	if (!escaped) return QString::fromUtf8(data, size);
+	QString out;
+	out.reserve(size);
+	const char *p = data;
+	const char *end = data + size;
+	while (p < end) {
+		const char *run = p;
+		while (p < end && *p != '\\') ++p;
+		if (p > run) out += QString::fromUtf8(run, int(p - run));
+		if (p == end) break;
+		// The reader already checked every escape
+		const char e = p[1];
+		p += 2;
+		switch (e) {
+		case 'b': out += QChar('\b'); break;
+		case 'f': out += QChar('\f'); break;
+		case 'n': out += QChar('\n'); break;
+		case 'r': out += QChar('\r'); break;
+		case 't': out += QChar('\t'); break;
+		case 'u': {
+			ushort unit = 0;
+			for (int i = 0; i < 4; ++i) unit = ushort(unit << 4 | hexValue(p[i]));
+			out += QChar(unit);   // surrogate pairs arrive as two escapes and pair up in UTF-16
+			p += 4;
+			break;
+		}
+		default: out += QLatin1Char(e); break;   // " \ /
+		}
+	}
+	return out;
+}
+
+bool JsonScalar::equals(const QString &ascii) const
+{
+	if (type != String) return false;
+	if (escaped) return toString() == ascii;
+	return ascii == QLatin1String(data, size);
+}
+
+bool JsonReader::fail(const char *why)
+{
+	m_state = Failed;
+	m_error = why;
+	return false;
+}
+
+bool JsonReader::finish()
+{
+	skipSpace();
+	if (m_p != m_end) return fail("data after the value");
+	m_state = Done;
+	m_error = nullptr;
+	return false;
+}
+
+void JsonReader::skipSpace()
+{
+	while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r')) ++m_p;
+}
+
+bool JsonReader::readString(JsonScalar *out)
+{
+	if (m_p == m_end || *m_p != '"') return fail("expected a string");
+	const char *start = ++m_p;
+	bool escaped = false;
+	while (m_p < m_end) {
+		const uchar c = uchar(*m_p);
+		if (c == '"') {
+			out->type = JsonScalar::String;
+			out->data = start;
+			out->size = int(m_p - start);
+			out->escaped = escaped;
+			++m_p;
+			return true;
+		}
+		if (c < 0x20) return fail("control character in string");
+		if (c != '\\') {
+			++m_p;
+			continue;
+		}
+		escaped = true;
+		if (m_end - m_p < 2) break;
+		switch (m_p[1]) {
+		case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+			m_p += 2;
+			break;
+		case 'u':
+			if (m_end - m_p < 6) return fail("truncated \\u escape");
+			for (int i = 2; i < 6; ++i) {
+				if (hexValue(m_p[i]) < 0) return fail("bad \\u escape");
+			}
+			m_p += 6;
+			break;
+		default:
+			return fail("bad escape");
+		}
+	}
+	return fail("unterminated string");
+}
+
+bool JsonReader::readNumber(JsonScalar *out)
+{
+	const char *start = m_p;
+	bool integral = true;
+	if (m_p < m_end && *m_p == '-') ++m_p;
+	if (m_p == m_end || !isDigit(*m_p)) return fail(m_p == start ? "expected a value" : "bad number");
+	if (*m_p == '0') {
+		++m_p;
+	} else {
+		while (m_p < m_end && isDigit(*m_p)) ++m_p;
+	}
+	if (m_p < m_end && *m_p == '.') {
+		integral = false;
+		++m_p;
+		if (m_p == m_end || !isDigit(*m_p)) return fail("bad number");
+		while (m_p < m_end && isDigit(*m_p)) ++m_p;
+	}
+	if (m_p < m_end && (*m_p == 'e' || *m_p == 'E')) {
+		integral = false;
+		++m_p;
+		if (m_p < m_end && (*m_p == '+' || *m_p == '-')) ++m_p;
+		if (m_p == m_end || !isDigit(*m_p)) return fail("bad number");
+		while (m_p < m_end && isDigit(*m_p)) ++m_p;
+	}
+	out->type = JsonScalar::Number;
+	out->data = start;
+	out->size = int(m_p - start);
+	out->integral = integral;
+	return true;
+}
+
+bool JsonReader::readLiteral(const char *word, int length)
+{
+	if (m_end - m_p < length || std::memcmp(m_p, word, size_t(length)) != 0) return fail("unexpected character");
+	m_p += length;
+	return true;
+}
+
+bool JsonReader::readMemberKey(JsonScalar *key)
+{
+	if (!readString(key)) return false;
+	skipSpace();
+	if (m_p == m_end || *m_p != ':') return fail("expected ':'");
+	++m_p;
+	skipSpace();
+	return true;
+}
+
+bool JsonReader::skipNested()
+{
+	// The same grammar as the top level, one container per stack entry, so
+	// [1,,] or {"a" 1} is as malformed inside a member as outside
+	char open[kMaxNesting];
+	int depth = 0;
+	JsonScalar scalar;
+	bool afterValue = false;
+	for (;;) {
+		skipSpace();
+		if (m_p == m_end) return fail("unterminated nested value");
+		if (afterValue) {
+			const bool object = open[depth - 1] == '{';
+			if (*m_p == (object ? '}' : ']')) {
+				++m_p;
+				if (--depth == 0) return true;
+				continue;
+			}
+			if (*m_p != ',') return fail(object ? "expected ',' or '}'" : "expected ',' or ']'");
+			++m_p;
+			skipSpace();
+			if (object && !readMemberKey(&scalar)) return false;
+			afterValue = false;
+			continue;
+		}
+		const char c = *m_p;
+		if (c != '{' && c != '[') {
+			if (!readValue(&scalar)) return false;
+			afterValue = true;
+			continue;
+		}
+		if (depth == kMaxNesting) return fail("nested too deep");
+		open[depth++] = c;
+		++m_p;
+		skipSpace();
+		if (m_p < m_end && *m_p == (c == '{' ? '}' : ']')) {
+			++m_p;
+			if (--depth == 0) return true;
+			afterValue = true;
+		} else if (c == '{' && !readMemberKey(&scalar)) {
+			return false;
+		}
+	}
+}
+
+bool JsonReader::readValue(JsonScalar *out)
+{
+	*out = JsonScalar();
+	if (m_p == m_end) return fail("expected a value");
+	switch (*m_p) {
+	case '"':
+		return readString(out);
+	case '{':
+	case '[':
+		out->type = JsonScalar::Nested;
+		out->data = m_p;
+		if (!skipNested()) return false;
+		out->size = int(m_p - out->data);
+		return true;
+	case 't':
+		out->type = JsonScalar::Bool;
+		out->boolean = true;
+		return readLiteral("true", 4);
+	case 'f':
+		out->type = JsonScalar::Bool;
+		return readLiteral("false", 5);
+	case 'n':
+		out->type = JsonScalar::Null;
+		return readLiteral("null", 4);
+	default:
+		return readNumber(out);
+	}
+}
+
+bool JsonReader::advance(char open, char close)
+{
+	if (m_state == Done || m_state == Failed) return false;
+	skipSpace();
+	if (m_state == Start) {
+		if (m_p == m_end || *m_p != open) return fail(open == '{' ? "expected an object" : "expected an array");
+		++m_p;
+		skipSpace();
+		if (m_p < m_end && *m_p == close) {
+			++m_p;
+			return finish();
+		}
+		m_state = Members;
+		return true;
+	}
+	if (m_p == m_end) return fail(open == '{' ? "unterminated object" : "unterminated array");
+	if (*m_p == close) {
+		++m_p;
+		return finish();
+	}
+	if (*m_p != ',') return fail(open == '{' ? "expected ',' or '}'" : "expected ',' or ']'");
+	++m_p;
+	skipSpace();
+	return true;
+}
+
+bool JsonObjectReader::next(JsonScalar *key, JsonScalar *value)
+{
+	if (!advance('{', '}')) return false;
+	*key = JsonScalar();
+	return readMemberKey(key) && readValue(value);
+}
+
+bool JsonArrayReader::next(JsonScalar *value)
+{
+	if (!advance('[', ']')) return false;
+	return readValue(value);
+}
+
+bool readJsonPayload(const QByteArray &payload, const QVector<PayloadField> &schema,
+                     JsonScalar *cmd, JsonScalar *fields, const char **error)
+{
+	auto fail = [error](const char *why) {
+		if (error) *error = why;
+		return false;
+	};
+	if (schema.size() > kMaxSchemaFields) return fail("schema too large");
+	static const QString cmdKey = QStringLiteral("cmd");
+	*cmd = JsonScalar();
+	for (int i = 0; i < schema.size(); ++i) fields[i] = JsonScalar();
+
+	quint64 seen = 0;
+	bool haveCmd = false;
+	JsonObjectReader reader(payload);
+	JsonScalar key;
+	JsonScalar value;
+	while (reader.next(&key, &value)) {
+		if (key.equals(cmdKey)) {
+			if (haveCmd) return fail("repeated member");
+			if (value.type != JsonScalar::String) return fail("cmd is not a string");
+			*cmd = value;
+			haveCmd = true;
+			continue;
+		}
+		int index = -1;
+		for (int i = 0; i < schema.size(); ++i) {
+			if (key.equals(schema[i].key)) {
+				index = i;
+				break;
+			}
+		}
+		if (index < 0) continue;
+		if (seen & (quint64(1) << index)) return fail("repeated member");
+		seen |= quint64(1) << index;
+		if (value.type == JsonScalar::Null) continue;
+		switch (schema[index].kind) {
+		case PayloadField::String:
+			if (value.type != JsonScalar::String) return fail("member is not a string");
+			break;
+		case PayloadField::Int: {
+			qint64 n = 0;
+			if (!value.toInt64(&n)) return fail("member is not an integer");
+			if (n < schema[index].min || n > schema[index].max) return fail("member out of range");
+			break;
+		}
+		case PayloadField::Bool:
+			if (value.type != JsonScalar::Bool) return fail("member is not a boolean");
+			break;
+		}
+		fields[index] = value;
+	}
+	if (reader.error()) return fail(reader.error());
+	if (!haveCmd) return fail("no cmd");
+	for (int i = 0; i < schema.size(); ++i) {
+		if (schema[i].required && fields[i].type == JsonScalar::Missing) return fail("required member missing");
+	}
+	return true;
+}
+
+QVariantMap jsonPayloadValues(const QVector<PayloadField> &schema, const JsonScalar *fields)
+{
+	QVariantMap out;
+	for (int i = 0; i < schema.size(); ++i) {
+		const JsonScalar &v = fields[i];
+		if (v.type == JsonScalar::Missing) continue;
+		switch (schema[i].kind) {
+		case PayloadField::String:
+			out.insert(schema[i].key, v.toString());
+			break;
+		case PayloadField::Int: {
+			qint64 n = 0;
+			v.toInt64(&n);
+			out.insert(schema[i].key, qlonglong(n));
+			break;
+		}
+		case PayloadField::Bool:
+			out.insert(schema[i].key, v.boolean);
+			break;
+		}
+	}
+	return out;
+}
@@ -0,0 +1,93 @@
+#ifndef ACTIONS_JSON_PAYLOAD_H
+#define ACTIONS_JSON_PAYLOAD_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVariantMap>
+#include <QVector>
+#include "actions.h"
+
+// A JSON value as it sits in the payload bytes; nothing is copied or decoded
+// until asked for
+struct JsonScalar {
+	enum Type { Missing, Null, Bool, Number, String, Nested };
+	Type type = Missing;
+	const char *data = nullptr;   // String: between the quotes, still escaped; Number: the literal
+	int size = 0;
+	bool escaped = false;         // String contains backslash escapes
+	bool integral = false;        // Number without fraction or exponent
+	bool boolean = false;
+
+	// Integral Number that fits
+	bool toInt64(qint64 *out) const;
+	// Decodes escapes and UTF-8; the one call here that allocates
+	QString toString() const;
+	// String equal to an ASCII key, without decoding when there are no escapes
+	bool equals(const QString &ascii) const;
+};
+
+// Pull parser over one JSON object or array held in memory. next() yields
+// the top-level entries in order; nested objects and arrays come back as
+// Nested after being skipped, and their bytes can be handed to another
+// reader. Everything, nested values included (at most 32 deep), is checked
+// against the JSON grammar as it is read. Works in place on the
+// bytes, which must outlive the reader, and never allocates.
+class JsonReader {
+public:
+	// Null once the value and only whitespace after it were read
+	const char *error() const { return m_error; }
+
+protected:
+	enum State { Start, Members, Done, Failed };
+	JsonReader(const char *data, int size) : m_p(data), m_end(data + size) {}
+	// Opens the container on the first call and consumes the separator on
+	// later ones; false at its end (close) or on malformed input
+	bool advance(char open, char close);
+	bool fail(const char *why);
+	bool finish();
+	void skipSpace();
+	bool readString(JsonScalar *out);
+	bool readNumber(JsonScalar *out);
+	bool readLiteral(const char *word, int length);
+	// A member name and its ':'
+	bool readMemberKey(JsonScalar *key);
+	bool skipNested();
+	bool readValue(JsonScalar *out);
+
+	const char *m_p;
+	const char *m_end;
+	State m_state = Start;
+	const char *m_error = "unterminated value";
+};
+
+class JsonObjectReader : public JsonReader {
+public:
+	JsonObjectReader(const char *data, int size) : JsonReader(data, size) {}
+	explicit JsonObjectReader(const QByteArray &json) : JsonReader(json.constData(), json.size()) {}
+	explicit JsonObjectReader(const JsonScalar &nested) : JsonReader(nested.data, nested.size) {}
+
+	// False after the closing brace or on malformed input; then check error()
+	bool next(JsonScalar *key, JsonScalar *value);
+};
+
+class JsonArrayReader : public JsonReader {
+public:
+	JsonArrayReader(const char *data, int size) : JsonReader(data, size) {}
+	explicit JsonArrayReader(const JsonScalar &nested) : JsonReader(nested.data, nested.size) {}
+
+	// False after the closing bracket or on malformed input; then check error()
+	bool next(JsonScalar *value);
+};
+
+// Reads a structured payload: one JSON object whose "cmd" member (a string)
+// goes to *cmd and whose members named in schema go to fields[i] (Missing if
+// absent; null counts as absent). Unknown members are ignored. False with a
+// static reason in *error for malformed JSON, a missing cmd or required
+// member, a repeated member, a value of the wrong kind or an integer outside
+// the field's [min, max].
+bool readJsonPayload(const QByteArray &payload, const QVector<PayloadField> &schema,
+                     JsonScalar *cmd, JsonScalar *fields, const char **error);
+// The fields readJsonPayload filled, for ActionCall::fields
+QVariantMap jsonPayloadValues(const QVector<PayloadField> &schema, const JsonScalar *fields);
+
+#endif // ACTIONS_JSON_PAYLOAD_H
@@ -0,0 +1,129 @@
+#include "macro.h"
+
+#include <QHash>
+#include <QRegularExpression>
+#include <QSettings>
+
+namespace {
+
+// after= may be one value with spaces or commas, or a list QSettings split
+QStringList readIdList(const QVariant &value)
+{
+	static const QRegularExpression separators(QStringLiteral("[\\s,]+"));
+	QStringList ids;
+	for (const QString &part : value.toStringList()) {
+		for (const QString &id : part.split(separators, Qt::SkipEmptyParts)) ids << id;
+	}
+	return ids;
+}
+
+} // namespace
+
+QVector<MacroConfig> MacroConfig::readAll(QSettings &S)
+{
+	QVector<MacroConfig> macros;
+	const int size = S.beginReadArray("macros");
+	macros.reserve(size);
+	for (int i = 0; i < size; ++i) {
+		S.setArrayIndex(i);
+		MacroConfig m;
+		m.name = S.value("name").toString().trimmed();
+		if (m.name.isEmpty()) continue;
+		m.expectedMessage = S.value("message", "PRESS").toString();
+		const int steps = S.beginReadArray("steps");
+		m.steps.reserve(steps);
+		for (int j = 0; j < steps; ++j) {
+			S.setArrayIndex(j);
+			MacroStepConfig step;
+			step.action = S.value("action").toString().trimmed();
+			step.id = S.value("id", step.action).toString().trimmed();
+			if (S.contains("message")) step.message = S.value("message").toString();
+			step.after = readIdList(S.value("after"));
+			step.timeoutMs = S.value("timeoutMs", 0).toInt();
+			m.steps.push_back(step);
+		}
+		S.endArray();
+		macros.push_back(std::move(m));
+	}
+	S.endArray();
+	return macros;
+}
+
+bool MacroGraph::compile(const MacroConfig &config, MacroGraph *out, QString *error)
+{
+	auto fail = [error](const QString &why) {
+		if (error) *error = why;
+		return false;
+	};
+	const int n = config.steps.size();
+	if (n == 0) return fail(QStringLiteral("no steps"));
+	if (n > kMaxSteps) return fail(QStringLiteral("more than %1 steps").arg(kMaxSteps));
+
+	QHash<QString, int> byId;   // case-folded id -> index in config.steps
+	for (int i = 0; i < n; ++i) {
+		const MacroStepConfig &s = config.steps[i];
+		if (s.action.isEmpty()) return fail(QStringLiteral("step %1 has no action").arg(i + 1));
+		if (s.id.isEmpty()) return fail(QStringLiteral("step %1 has no id").arg(i + 1));
+		if (s.timeoutMs < 0 || s.timeoutMs > kMaxTimeoutMs) {
+			return fail(QStringLiteral("step %1: timeoutMs must be 0..%2").arg(s.id).arg(kMaxTimeoutMs));
+		}
+		const QString key = s.id.toCaseFolded();
+		if (byId.contains(key)) return fail(QStringLiteral("two steps are called %1").arg(s.id));
+		byId.insert(key, i);
+	}
+
+	// Kahn's algorithm: waiting[i] counts unfinished dependencies of step i
+	QVector<QVector<int>> after(n);
+	QVector<QVector<int>> dependents(n);
+	QVector<int> waiting(n, 0);
+	for (int i = 0; i < n; ++i) {
+		for (const QString &id : config.steps[i].after) {
+			const int dep = byId.value(id.toCaseFolded(), -1);
+			if (dep < 0) return fail(QStringLiteral("step %1 waits for unknown step %2").arg(config.steps[i].id, id));
+			if (dep == i) return fail(QStringLiteral("step %1 waits for itself").arg(id));
+			if (after[i].contains(dep)) continue;
+			after[i].push_back(dep);
+			dependents[dep].push_back(i);
+			++waiting[i];
+		}
+	}
+	QVector<int> order;
+	QVector<int> level(n, 1);   // steps on the longest chain ending here
+	order.reserve(n);
+	for (int i = 0; i < n; ++i) {
+		if (waiting[i] == 0) order.push_back(i);
+	}
+	for (int k = 0; k < order.size(); ++k) {
+		const int i = order[k];
+		for (const int d : dependents[i]) {
+			level[d] = qMax(level[d], level[i] + 1);
+			if (--waiting[d] == 0) order.push_back(d);
+		}
+	}
+	if (order.size() != n) {
+		for (int i = 0; i < n; ++i) {
+			if (waiting[i] > 0) return fail(QStringLiteral("steps wait for each other in a cycle (through %1)").arg(config.steps[i].id));
+		}
+	}
+
+	MacroGraph g;
+	g.name = config.name;
+	g.expectedMessage = config.expectedMessage;
+	QVector<int> position(n);
+	for (int k = 0; k < n; ++k) position[order[k]] = k;
+	g.steps.resize(n);
+	for (int k = 0; k < n; ++k) {
+		const int i = order[k];
+		const MacroStepConfig &s = config.steps[i];
+		MacroStep &step = g.steps[k];
+		step.id = s.id;
+		step.action = s.action;
+		if (!s.message.isNull()) step.message = s.message.toUtf8();
+		step.timeoutMs = s.timeoutMs > 0 ? s.timeoutMs : kDefaultTimeoutMs;
+		for (const int dep : after[i]) step.after.push_back(position[dep]);
+		for (const int d : dependents[i]) step.dependents.push_back(position[d]);
+		g.depth = qMax(g.depth, level[i]);
+	}
+	*out = std::move(g);
+	return true;
+}
@@ -0,0 +1,76 @@
+#ifndef ACTIONS_MACRO_H
+#define ACTIONS_MACRO_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class QSettings;
+
+// One step of a macro as written in the INI
+struct MacroStepConfig {
+	QString id;                // defaults to the action name
+	QString action;            // configured action name
+	QString message;           // null: run it like "mpmctl run"
+	QStringList after;         // ids of steps that must succeed first
+	int timeoutMs = 0;         // 0: MacroGraph::kDefaultTimeoutMs
+	bool operator==(const MacroStepConfig &o) const {
+		return id == o.id && action == o.action && message == o.message && message.isNull() == o.message.isNull()
+		    && after == o.after && timeoutMs == o.timeoutMs;
+	}
+	bool operator!=(const MacroStepConfig &o) const { return !(*this == o); }
+};
+
+// A macro from the [macros] array of the INI. It is published to like an
+// action (mqttpowermanager/<user>/<name> with the expected message) and runs
+// its steps as a dependency graph:
+//   [macros]
+//   1\name=Evening
+//   1\message=PRESS
+//   1\steps\1\action=Browser
+//   1\steps\2\action=Mail
+//   1\steps\3\action=Lock
+//   1\steps\3\after=Browser Mail
+//   1\steps\3\timeoutMs=5000
+//   1\steps\size=3
+//   size=1
+struct MacroConfig {
+	QString name;
+	QString expectedMessage;   // whole payload, ignoring case
+	QVector<MacroStepConfig> steps;
+	bool operator==(const MacroConfig &o) const {
+		return name == o.name && expectedMessage == o.expectedMessage && steps == o.steps;
+	}
+	bool operator!=(const MacroConfig &o) const { return !(*this == o); }
+
+	static QVector<MacroConfig> readAll(QSettings &settings);
+};
+
+// One step of a compiled macro
+struct MacroStep {
+	QString id;
+	QString action;
+	QByteArray message;        // null: run it like "mpmctl run"
+	int timeoutMs = 0;
+	QVector<int> after;        // indices of the steps it waits for
+	QVector<int> dependents;   // indices of the steps waiting for it
+};
+
+// A macro checked and compiled into a dependency graph: ids resolved to
+// indices, cycles and unknown ids rejected, and the steps listed in an order
+// where every step comes after the ones it waits for.
+struct MacroGraph {
+	static constexpr int kMaxSteps = 64;
+	static constexpr int kDefaultTimeoutMs = 30 * 1000;
+	static constexpr int kMaxTimeoutMs = 10 * 60 * 1000;
+
+	QString name;
+	QString expectedMessage;
+	QVector<MacroStep> steps;  // topological order
+	int depth = 0;             // steps on the longest dependency chain
+
+	static bool compile(const MacroConfig &config, MacroGraph *out, QString *error);
+};
+
+#endif // ACTIONS_MACRO_H
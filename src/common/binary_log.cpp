@@ -0,0 +1,340 @@
+#include "binary_log.h"
+#include "crc32.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr quint32 kFileMagic = 0x424D504D;   // 'MPMB'
+constexpr quint32 kRecordMagic = 0x524D504D; // 'MPMR'
+constexpr quint32 kVersion = 1;
+constexpr qint64 kHeaderBytes = 64;
+constexpr quint32 kAlign = 8;
+
+struct FileHeader {
+	quint32 magic;
+	quint32 version;
+	quint64 capacity;
+	std::atomic<quint64> writePos; // logical; physical offset is writePos % capacity
+	quint64 reserved[5];
+};
+static_assert(sizeof(FileHeader) == kHeaderBytes, "binary log header must stay 64 bytes");
+static_assert(std::atomic<quint64>::is_always_lock_free, "binary log requires lock-free 64-bit atomics");
+
+// CRC covers everything after the crc field
+struct RecordHeader {
+	quint32 magic;
+	quint32 size;        // whole record including padding
+	quint32 crc;
+	quint16 level;
+	quint16 fieldCount;
+	quint64 position;    // logical position the record was written at
+	qint64 timestampMs;
+};
+static_assert(sizeof(RecordHeader) == 32, "unexpected record header padding");
+constexpr size_t kCrcOffset = offsetof(RecordHeader, level);
+
+quint32 alignUp(quint32 n)
+{
+	return (n + kAlign - 1) & ~(kAlign - 1);
+}
+
+template <typename T>
+void put(std::vector<char> &buf, const T &v)
+{
+	const size_t at = buf.size();
+	buf.resize(at + sizeof(T));
+	std::memcpy(buf.data() + at, &v, sizeof(T));
+}
+
+void putBytes(std::vector<char> &buf, const char *p, size_t n)
+{
+	buf.insert(buf.end(), p, p + n);
+}
+
+} // namespace
+
+struct BinaryLogWriter::Impl {
+	FileHeader *header = nullptr;
+	char *data = nullptr;
+	quint64 capacity = 0;
+	qint64 mappedBytes = 0;
+#ifdef Q_OS_WIN
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = nullptr;
+#endif
+};
+
+BinaryLogWriter::BinaryLogWriter() : d(new Impl) {}
+
+BinaryLogWriter::~BinaryLogWriter()
+{
+	close();
+	delete d;
+}
+
+bool BinaryLogWriter::open(const QString &path, qint64 capacityBytes)
+{
+	if (d->header) return true;
+	quint64 capacity = 64 * 1024;
+	while (capacity < quint64(qMax<qint64>(capacityBytes, 0))) capacity <<= 1;
+	const qint64 total = kHeaderBytes + qint64(capacity);
+	QDir().mkpath(QFileInfo(path).absolutePath());
+	void *view = nullptr;
+#ifdef Q_OS_WIN
+	const std::wstring wpath = QDir::toNativeSeparators(path).toStdWString();
+	d->file = CreateFileW(wpath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+	                      nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (d->file == INVALID_HANDLE_VALUE) {
+		qWarning() << "Binary log: cannot open" << path << "err=" << GetLastError();
+		return false;
+	}
+	d->mapping = CreateFileMappingW(d->file, nullptr, PAGE_READWRITE, DWORD(quint64(total) >> 32), DWORD(total & 0xFFFFFFFF), nullptr);
+	if (!d->mapping) {
+		qWarning() << "Binary log: CreateFileMapping failed, err=" << GetLastError();
+		CloseHandle(d->file);
+		d->file = INVALID_HANDLE_VALUE;
+		return false;
+	}
+	view = MapViewOfFile(d->mapping, FILE_MAP_ALL_ACCESS, 0, 0, SIZE_T(total));
+	if (!view) {
+		qWarning() << "Binary log: MapViewOfFile failed, err=" << GetLastError();
+		CloseHandle(d->mapping);
+		CloseHandle(d->file);
+		d->mapping = nullptr;
+		d->file = INVALID_HANDLE_VALUE;
+		return false;
+	}
+#else
+	const QByteArray native = QFile::encodeName(path);
+	const int fd = ::open(native.constData(), O_RDWR | O_CREAT, 0640);
+	if (fd < 0) {
+		qWarning() << "Binary log: cannot open" << path;
+		return false;
+	}
+	struct stat st;
+	if (::fstat(fd, &st) != 0 || (st.st_size != total && ::ftruncate(fd, total) != 0)) {
+		::close(fd);
+		qWarning() << "Binary log: cannot size" << path;
+		return false;
+	}
+	view = ::mmap(nullptr, size_t(total), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED) {
+		qWarning() << "Binary log: mmap failed for" << path;
+		return false;
+	}
+#endif
+	d->header = static_cast<FileHeader *>(view);
+	d->data = static_cast<char *>(view) + kHeaderBytes;
+	d->capacity = capacity;
+	d->mappedBytes = total;
+	if (d->header->magic != kFileMagic || d->header->version != kVersion || d->header->capacity != capacity) {
+		// New file or different geometry: start a fresh ring
+		std::memset(view, 0, size_t(total));
+		d->header->version = kVersion;
+		d->header->capacity = capacity;
+		d->header->writePos.store(0, std::memory_order_relaxed);
+		d->header->magic = kFileMagic;
+	}
+	return true;
+}
+
+bool BinaryLogWriter::isOpen() const
+{
+	return d->header != nullptr;
+}
+
+void BinaryLogWriter::close()
+{
+	if (!d->header) return;
+#ifdef Q_OS_WIN
+	FlushViewOfFile(d->header, 0);
+	UnmapViewOfFile(d->header);
+	if (d->mapping) CloseHandle(d->mapping);
+	if (d->file != INVALID_HANDLE_VALUE) CloseHandle(d->file);
+	d->mapping = nullptr;
+	d->file = INVALID_HANDLE_VALUE;
+#else
+	::msync(d->header, size_t(d->mappedBytes), MS_ASYNC);
+	::munmap(d->header, size_t(d->mappedBytes));
+#endif
+	d->header = nullptr;
+	d->data = nullptr;
+}
+
+void BinaryLogWriter::append(QtMsgType type, const char *category, const QString &message,
+                             std::initializer_list<BinaryLogField> fields)
+{
+	if (!d->header) return;
+	// Encoded on the caller's thread into a reused buffer, then copied in one go
+	thread_local std::vector<char> buf;
+	buf.clear();
+	buf.resize(sizeof(RecordHeader));
+	const quint16 catLen = quint16(category ? qMin<size_t>(std::strlen(category), 0xFFFF) : 0);
+	put(buf, catLen);
+	putBytes(buf, category, catLen);
+	const QByteArray msg = message.toUtf8();
+	put(buf, quint32(msg.size()));
+	putBytes(buf, msg.constData(), size_t(msg.size()));
+	for (const BinaryLogField &f : fields) {
+		const quint8 nameLen = quint8(qMin<size_t>(std::strlen(f.name), 0xFF));
+		put(buf, quint8(f.type));
+		put(buf, nameLen);
+		putBytes(buf, f.name, nameLen);
+		switch (f.type) {
+		case BinaryLogField::Int: put(buf, f.i); break;
+		case BinaryLogField::Double: put(buf, f.d); break;
+		case BinaryLogField::Bool: put(buf, quint8(f.i ? 1 : 0)); break;
+		case BinaryLogField::String:
+			put(buf, quint32(f.s.size()));
+			putBytes(buf, f.s.constData(), size_t(f.s.size()));
+			break;
+		}
+	}
+	const quint32 size = alignUp(quint32(buf.size()));
+	if (size > d->capacity / 2) return; // would overwrite most of the history in one go
+	buf.resize(size, '\0');
+
+	const quint64 pos = d->header->writePos.fetch_add(size, std::memory_order_relaxed);
+	RecordHeader h{};
+	h.magic = kRecordMagic;
+	h.size = size;
+	h.level = quint16(type);
+	h.fieldCount = quint16(fields.size());
+	h.position = pos;
+	h.timestampMs = QDateTime::currentMSecsSinceEpoch();
+	std::memcpy(buf.data(), &h, sizeof(h));
+	h.crc = mpmCrc32(buf.data() + kCrcOffset, size - kCrcOffset);
+	std::memcpy(buf.data() + offsetof(RecordHeader, crc), &h.crc, sizeof(h.crc));
+
+	const quint64 off = pos % d->capacity;
+	const quint64 firstPart = qMin<quint64>(size, d->capacity - off);
+	std::memcpy(d->data + off, buf.data(), size_t(firstPart));
+	if (firstPart < size) std::memcpy(d->data, buf.data() + firstPart, size_t(size - firstPart));
+}
+
+bool BinaryLogReader::load(const QString &path, QString *error)
+{
+	m_records.clear();
+	m_corrupt = 0;
+	QFile f(path);
+	if (!f.open(QIODevice::ReadOnly)) {
+		if (error) *error = f.errorString();
+		return false;
+	}
+	const QByteArray all = f.readAll();
+	if (all.size() < kHeaderBytes) {
+		if (error) *error = QStringLiteral("file too small");
+		return false;
+	}
+	quint32 magic = 0, version = 0;
+	quint64 capacity = 0, writePos = 0;
+	std::memcpy(&magic, all.constData() + offsetof(FileHeader, magic), 4);
+	std::memcpy(&version, all.constData() + offsetof(FileHeader, version), 4);
+	std::memcpy(&capacity, all.constData() + offsetof(FileHeader, capacity), 8);
+	std::memcpy(&writePos, all.constData() + offsetof(FileHeader, writePos), 8);
+	if (magic != kFileMagic || version != kVersion || capacity == 0 || quint64(all.size()) < kHeaderBytes + capacity) {
+		if (error) *error = QStringLiteral("not an MPM binary log");
+		return false;
+	}
+	const char *data = all.constData() + kHeaderBytes;
+	auto copyOut = [&](quint64 pos, char *dst, quint64 len) {
+		const quint64 off = pos % capacity;
+		const quint64 firstPart = qMin(len, capacity - off);
+		std::memcpy(dst, data + off, size_t(firstPart));
+		if (firstPart < len) std::memcpy(dst + firstPart, data, size_t(len - firstPart));
+	};
+
+	// Only the last `capacity` bytes can still be intact
+	quint64 pos = writePos > capacity ? writePos - capacity : 0;
+	pos = (pos + kAlign - 1) & ~quint64(kAlign - 1);
+	bool resyncing = false;
+	std::vector<char> rec;
+	while (pos + sizeof(RecordHeader) <= writePos) {
+		RecordHeader h;
+		copyOut(pos, reinterpret_cast<char *>(&h), sizeof(h));
+		bool valid = h.magic == kRecordMagic && h.position == pos && h.size >= sizeof(RecordHeader)
+		          && h.size % kAlign == 0 && pos + h.size <= writePos && h.size <= capacity;
+		if (valid) {
+			rec.resize(h.size);
+			copyOut(pos, rec.data(), h.size);
+			valid = mpmCrc32(rec.data() + kCrcOffset, h.size - kCrcOffset) == h.crc;
+		}
+		if (!valid) {
+			if (!resyncing) ++m_corrupt;
+			resyncing = true;
+			pos += kAlign;
+			continue;
+		}
+		resyncing = false;
+
+		BinaryLogRecord r;
+		r.position = pos;
+		r.timestampMs = h.timestampMs;
+		r.level = h.level;
+		const char *p = rec.data() + sizeof(RecordHeader);
+		const char *end = rec.data() + h.size;
+		auto take = [&](void *dst, size_t n) {
+			if (size_t(end - p) < n) return false;
+			std::memcpy(dst, p, n);
+			p += n;
+			return true;
+		};
+		quint16 catLen = 0;
+		quint32 msgLen = 0;
+		bool ok = take(&catLen, 2) && size_t(end - p) >= catLen;
+		if (ok) { r.category = QString::fromUtf8(p, catLen); p += catLen; }
+		ok = ok && take(&msgLen, 4) && size_t(end - p) >= msgLen;
+		if (ok) { r.message = QString::fromUtf8(p, int(msgLen)); p += msgLen; }
+		for (int i = 0; ok && i < h.fieldCount; ++i) {
+			quint8 type = 0, nameLen = 0;
+			ok = take(&type, 1) && take(&nameLen, 1) && size_t(end - p) >= nameLen;
+			if (!ok) break;
+			const QString name = QString::fromUtf8(p, nameLen);
+			p += nameLen;
+			QVariant value;
+			if (type == BinaryLogField::Int) {
+				qint64 v = 0;
+				ok = take(&v, 8);
+				value = v;
+			} else if (type == BinaryLogField::Double) {
+				double v = 0;
+				ok = take(&v, 8);
+				value = v;
+			} else if (type == BinaryLogField::Bool) {
+				quint8 v = 0;
+				ok = take(&v, 1);
+				value = bool(v);
+			} else if (type == BinaryLogField::String) {
+				quint32 len = 0;
+				ok = take(&len, 4) && size_t(end - p) >= len;
+				if (ok) { value = QString::fromUtf8(p, int(len)); p += len; }
+			} else {
+				ok = false;
+			}
+			if (ok) r.fields.append(qMakePair(name, value));
+		}
+		m_records.append(r);
+		pos += h.size;
+	}
+	return true;
+}
@@ -0,0 +1,77 @@
+#ifndef MPM_BINARY_LOG_H
+#define MPM_BINARY_LOG_H
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QVariant>
+#include <initializer_list>
+
+// Typed key/value attached to a binary log record
+struct BinaryLogField {
+	enum Type : quint8 { Int = 1, Double = 2, String = 3, Bool = 4 };
+
+	BinaryLogField(const char *n, int v) : name(n), type(Int), i(v) {}
+	BinaryLogField(const char *n, qint64 v) : name(n), type(Int), i(v) {}
+	BinaryLogField(const char *n, quint64 v) : name(n), type(Int), i(qint64(v)) {}
+	BinaryLogField(const char *n, double v) : name(n), type(Double), d(v) {}
+	BinaryLogField(const char *n, bool v) : name(n), type(Bool), i(v ? 1 : 0) {}
+	BinaryLogField(const char *n, const QString &v) : name(n), type(String), s(v.toUtf8()) {}
+	BinaryLogField(const char *n, const char *v) : name(n), type(String), s(v) {}
+
+	const char *name;
+	Type type;
+	qint64 i = 0;
+	double d = 0;
+	QByteArray s;
+};
+
+// Writes records into a memory-mapped ring file. The file is a 64-byte header
+// followed by a power-of-two data area; records are 8-byte aligned, carry their
+// logical position and a CRC-32, and may wrap around the end of the area.
+// Writers reserve space with one atomic add on the shared write position, so
+// append() is safe from any thread and never takes a lock. Because the bytes
+// land in a shared file mapping, the OS keeps them even if the process dies
+// right after the call.
+class BinaryLogWriter {
+public:
+	BinaryLogWriter();
+	~BinaryLogWriter();
+	// Reuses an existing file with the same capacity so records from a crashed run survive
+	bool open(const QString &path, qint64 capacityBytes);
+	bool isOpen() const;
+	void close();
+	void append(QtMsgType type, const char *category, const QString &message,
+	            std::initializer_list<BinaryLogField> fields = {});
+
+private:
+	Q_DISABLE_COPY(BinaryLogWriter)
+	struct Impl;
+	Impl *d;
+};
+
+struct BinaryLogRecord {
+	quint64 position = 0;
+	qint64 timestampMs = 0;
+	int level = 0;  // QtMsgType
+	QString category;
+	QString message;
+	QList<QPair<QString, QVariant>> fields;
+};
+
+// Decodes a ring file offline (no mapping; works on a copy taken after a crash)
+class BinaryLogReader {
+public:
+	bool load(const QString &path, QString *error = nullptr);
+	// Surviving records, oldest first
+	const QList<BinaryLogRecord> &records() const { return m_records; }
+	// Stretches that failed validation (torn writes, partially overwritten records)
+	int corruptRegions() const { return m_corrupt; }
+
+private:
+	QList<BinaryLogRecord> m_records;
+	int m_corrupt = 0;
+};
+
+#endif // MPM_BINARY_LOG_H
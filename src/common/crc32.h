@@ -0,0 +1,27 @@
+#ifndef MPM_CRC32_H
+#define MPM_CRC32_H
+
+#include <QtGlobal>
+#include <array>
+#include <cstddef>
+
+// CRC-32 (IEEE 802.3, as used by gzip). Pass the previous result as `crc` to
+// continue over split buffers.
+inline quint32 mpmCrc32(const void *data, size_t len, quint32 crc = 0)
+{
+	static const std::array<quint32, 256> table = []() {
+		std::array<quint32, 256> t{};
+		for (quint32 i = 0; i < 256; ++i) {
+			quint32 c = i;
+			for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			t[i] = c;
+		}
+		return t;
+	}();
+	const uchar *p = static_cast<const uchar *>(data);
+	crc ^= 0xFFFFFFFFu;
+	for (size_t i = 0; i < len; ++i) crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+	return crc ^ 0xFFFFFFFFu;
+}
+
+#endif // MPM_CRC32_H
@@ -1,5 +1,6 @@
 #include "crypto_win.h"
 
+#ifdef Q_OS_WIN
 #include <windows.h>
 #include <wincrypt.h>
 
@@ -46,6 +47,12 @@ QByteArray dpapiDecryptBase64(const QByteArray &cipherBase64)
 	return plain;
 }
 
- 
+#else
 
+// DPAPI is Windows-only. Other builds store no ciphertext, so callers fall
+// back to the legacy plaintext key.
+QByteArray dpapiEncryptUserScope(const QByteArray &) { return QByteArray(); }
+QByteArray dpapiEncryptMachineScope(const QByteArray &) { return QByteArray(); }
+QByteArray dpapiDecryptBase64(const QByteArray &) { return QByteArray(); }
 
+#endif
@@ -1,4 +1,5 @@
 #include "ipc_auth.h"
+#include "log_categories.h"
 #include "settings.h"
 
 #include <QFile>
@@ -6,8 +7,18 @@
 #include <QCryptographicHash>
 #include <QRandomGenerator>
 #include <QFileInfo>
+#ifdef Q_OS_WIN
 #include <windows.h>
 #include <Aclapi.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <grp.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char kIpcGroup[] = "mpm";
 
 static QString readAllTrimmed(const QString &path)
 {
@@ -17,61 +28,131 @@ static QString readAllTrimmed(const QString &path)
 	return QString::fromUtf8(data).trimmed();
 }
 
+QString mpmIpcServerName()
+{
+	const QString explicitName = qEnvironmentVariable("MPM_IPC_SOCKET");
+	if (!explicitName.isEmpty()) return explicitName;
+#ifdef Q_OS_LINUX
+	const QString dir = QString::fromLatin1(kSystemIpcDir);
+	if (QFileInfo(dir).isDir()) return dir + QStringLiteral("/ipc");
+#endif
+	return QStringLiteral("MPMServiceIpc");
+}
+
 QString ipcTokenFilePath()
 {
 	// Cache to avoid repeated debug logs and recomputation
 	static QString s_cachedTokenPath;
 	if (!s_cachedTokenPath.isEmpty()) return s_cachedTokenPath;
-	// Store token next to settings (now under per-user AppData)
-	QString settingsPath = mpmSharedSettingsFilePath();
-	QFileInfo fi(settingsPath);
-	QDir dir(fi.absolutePath());
-	s_cachedTokenPath = dir.filePath("ipc_token");
-	qDebug() << "[IPC] Using IPC token path:" << s_cachedTokenPath;
+	// Explicit location: the systemd units point the root daemon at the
+	// shared system token this way
+	s_cachedTokenPath = qEnvironmentVariable("MPM_IPC_TOKEN_PATH");
+#ifdef Q_OS_LINUX
+	// A system install's token wins, so clients in the mpm group reach the
+	// root daemon instead of looking under their own ~/.config/MPM
+	if (s_cachedTokenPath.isEmpty() && QFileInfo::exists(QLatin1String(kSystemIpcTokenPath))) {
+		s_cachedTokenPath = QLatin1String(kSystemIpcTokenPath);
+	}
+#endif
+	if (s_cachedTokenPath.isEmpty()) {
+		// Store token next to settings (now under per-user AppData)
+		QString settingsPath = mpmSharedSettingsFilePath();
+		QFileInfo fi(settingsPath);
+		QDir dir(fi.absolutePath());
+		s_cachedTokenPath = dir.filePath("ipc_token");
+	}
+	qCDebug(lcIpc) << "[IPC] Using IPC token path:" << s_cachedTokenPath;
 	return s_cachedTokenPath;
 }
 
+namespace {
+
+// Writes the token with its final permissions from the start
+bool writeTokenFile(const QString &path, const QByteArray &token)
+{
+#ifdef Q_OS_WIN
+	QFile f(path);
+	if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) return false;
+	const bool ok = f.write(token) == token.size() && f.flush();
+	f.close();
+	// Relax DACL to allow Authenticated Users read/write so GUI/user can access token
+	std::wstring wpath = QDir::toNativeSeparators(path).toStdWString();
+	PSECURITY_DESCRIPTOR pSD = nullptr; PACL pOldDacl = nullptr;
+	if (GetNamedSecurityInfoW((LPWSTR)wpath.c_str(), SE_FILE_OBJECT, DACL_SECURITY_INFORMATION,
+							 nullptr, nullptr, &pOldDacl, nullptr, &pSD) == ERROR_SUCCESS) {
+		SID_IDENTIFIER_AUTHORITY ntauth = SECURITY_NT_AUTHORITY;
+		PSID pAuthUsers = nullptr;
+		if (AllocateAndInitializeSid(&ntauth, 1, SECURITY_AUTHENTICATED_USER_RID, 0,0,0,0,0,0,0, &pAuthUsers)) {
+			EXPLICIT_ACCESSW ea{};
+			ea.grfAccessPermissions = FILE_GENERIC_READ | FILE_GENERIC_WRITE;
+			ea.grfAccessMode = GRANT_ACCESS;
+			ea.grfInheritance = NO_INHERITANCE;
+			ea.Trustee.TrusteeForm = TRUSTEE_IS_SID;
+			ea.Trustee.TrusteeType = TRUSTEE_IS_WELL_KNOWN_GROUP;
+			ea.Trustee.ptstrName = (LPWSTR)pAuthUsers;
+			PACL pNewDacl = nullptr;
+			if (SetEntriesInAclW(1, &ea, pOldDacl, &pNewDacl) == ERROR_SUCCESS) {
+				SetNamedSecurityInfoW((LPWSTR)wpath.c_str(), SE_FILE_OBJECT, DACL_SECURITY_INFORMATION,
+									  nullptr, nullptr, pNewDacl, nullptr);
+				if (pNewDacl) LocalFree(pNewDacl);
+			}
+			FreeSid(pAuthUsers);
+		}
+		if (pSD) LocalFree(pSD);
+	}
+	return ok;
+#else
+	// The system token is written by root and read by the mpm group; a
+	// per-user token is shared by the daemon and its clients through the
+	// owner's group
+	bool system = false;
+#ifdef Q_OS_LINUX
+	system = path == QLatin1String(kSystemIpcTokenPath);
+#endif
+	const mode_t mode = system ? 0640 : 0660;
+	const QByteArray native = QFile::encodeName(path);
+	const int fd = ::open(native.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+	if (fd < 0) return false;
+	if (system) {
+		if (const group *g = ::getgrnam(kIpcGroup)) {
+			if (::fchown(fd, uid_t(-1), g->gr_gid) != 0) qCWarning(lcIpc) << "Cannot give" << path << "to group" << kIpcGroup;
+		} else {
+			qCWarning(lcIpc) << "Group" << kIpcGroup << "does not exist; only root can read" << path;
+		}
+	}
+	// An existing file keeps its mode through O_TRUNC; settle it before writing
+	bool ok = ::fchmod(fd, mode) == 0;
+	ssize_t written;
+	do {
+		written = ::write(fd, token.constData(), size_t(token.size()));
+	} while (written < 0 && errno == EINTR);
+	ok = ok && written == token.size();
+	::close(fd);
+	return ok;
+#endif
+}
+
+} // namespace
+
 QString loadOrCreateIpcToken()
 {
 	const QString path = ipcTokenFilePath();
 	QString token = readAllTrimmed(path);
 	if (!token.isEmpty()) return token;
+	QFileInfo fi(path);
+	if (fi.exists() && !fi.isReadable()) {
+		// Don't invent a token the service will never accept
+		qCWarning(lcIpc) << "Cannot read the IPC token" << path << "; is this user in the" << kIpcGroup << "group?";
+		return QString();
+	}
 	// Generate random 32-byte base64 token
 	QByteArray random(32, '\0');
 	for (int i = 0; i < random.size(); ++i) random[i] = static_cast<char>(QRandomGenerator::global()->bounded(256));
 	QString t = random.toBase64(QByteArray::Base64UrlEncoding | QByteArray::OmitTrailingEquals);
-	QFile f(path);
-	if (f.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
-		f.write(t.toUtf8());
-		f.flush();
-		f.close();
-		// Relax DACL to allow Authenticated Users read/write so GUI/user can access token
-		std::wstring wpath = QDir::toNativeSeparators(path).toStdWString();
-		PSECURITY_DESCRIPTOR pSD = nullptr; PACL pOldDacl = nullptr;
-		if (GetNamedSecurityInfoW((LPWSTR)wpath.c_str(), SE_FILE_OBJECT, DACL_SECURITY_INFORMATION,
-								 nullptr, nullptr, &pOldDacl, nullptr, &pSD) == ERROR_SUCCESS) {
-			SID_IDENTIFIER_AUTHORITY ntauth = SECURITY_NT_AUTHORITY;
-			PSID pAuthUsers = nullptr;
-			if (AllocateAndInitializeSid(&ntauth, 1, SECURITY_AUTHENTICATED_USER_RID, 0,0,0,0,0,0,0, &pAuthUsers)) {
-				EXPLICIT_ACCESSW ea{};
-				ea.grfAccessPermissions = FILE_GENERIC_READ | FILE_GENERIC_WRITE;
-				ea.grfAccessMode = GRANT_ACCESS;
-				ea.grfInheritance = NO_INHERITANCE;
-				ea.Trustee.TrusteeForm = TRUSTEE_IS_SID;
-				ea.Trustee.TrusteeType = TRUSTEE_IS_WELL_KNOWN_GROUP;
-				ea.Trustee.ptstrName = (LPWSTR)pAuthUsers;
-				PACL pNewDacl = nullptr;
-				if (SetEntriesInAclW(1, &ea, pOldDacl, &pNewDacl) == ERROR_SUCCESS) {
-					SetNamedSecurityInfoW((LPWSTR)wpath.c_str(), SE_FILE_OBJECT, DACL_SECURITY_INFORMATION,
-										  nullptr, nullptr, pNewDacl, nullptr);
-					if (pNewDacl) LocalFree(pNewDacl);
-				}
-				FreeSid(pAuthUsers);
-			}
-			if (pSD) LocalFree(pSD);
-		}
+	if (!writeTokenFile(path, t.toUtf8())) {
+		// Only the service can create a system token; clients wait for it
+		qCWarning(lcIpc) << "Cannot write the IPC token" << path;
+		return QString();
 	}
 	return t;
 }
-
-
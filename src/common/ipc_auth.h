@@ -2,10 +2,29 @@
 
 #include <QString>
 
-// Returns the path to the IPC token file under the user's AppData next to settings.
+#ifdef Q_OS_LINUX
+// Token shared by the system daemon (root, settings in /etc/mpm) and every
+// client in the "mpm" group: root:mpm, mode 0640
+inline constexpr char kSystemIpcTokenPath[] = "/etc/mpm/ipc_token";
+// Home of the system daemon's IPC socket. Only root can create entries in
+// it, so nobody else can bind the endpoint while the daemon is down.
+inline constexpr char kSystemIpcDir[] = "/run/mpm";
+#endif
+
+// The IPC endpoint passed to QLocalServer/QLocalSocket: $MPM_IPC_SOCKET if
+// set, on Linux kSystemIpcDir + "/ipc" when that directory exists, otherwise
+// the name "MPMServiceIpc" (a named pipe on Windows, a socket in $TMPDIR
+// elsewhere, for per-user runs without a system install).
+QString mpmIpcServerName();
+
+// Returns the path to the IPC token file: $MPM_IPC_TOKEN_PATH if set, on Linux
+// kSystemIpcTokenPath if it exists, otherwise next to the settings INI.
 QString ipcTokenFilePath();
 
-// Loads the IPC token if present, otherwise creates a new random token and saves it.
+// Loads the IPC token if present, otherwise creates a new random token and
+// saves it. Empty if the file exists but can't be read (not in the mpm group)
+// or can't be created (a client facing the system token before the service
+// wrote it).
 QString loadOrCreateIpcToken();
 
 
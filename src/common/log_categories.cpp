@@ -0,0 +1,103 @@
+#include "log_categories.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStringList>
+
+Q_LOGGING_CATEGORY(lcMqtt, "mpm.mqtt", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcDispatch, "mpm.dispatch", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcIpc, "mpm.ipc", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcActions, "mpm.actions", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcSettings, "mpm.settings", QtInfoMsg)
+Q_LOGGING_CATEGORY(lcService, "mpm.service", QtInfoMsg)
+
+namespace {
+
+QMutex g_levelsMutex;
+QMap<QString, QString> g_levels; // category -> level
+
+const QStringList &knownCategories()
+{
+	static const QStringList names = {
+		QStringLiteral("mpm.mqtt"), QStringLiteral("mpm.dispatch"), QStringLiteral("mpm.ipc"),
+		QStringLiteral("mpm.actions"), QStringLiteral("mpm.settings"), QStringLiteral("mpm.service"),
+	};
+	return names;
+}
+
+int levelRank(const QString &level)
+{
+	const QString l = level.trimmed().toLower();
+	if (l == "debug") return 0;
+	if (l == "info") return 1;
+	if (l == "warning" || l == "warn") return 2;
+	if (l == "critical" || l == "error") return 3;
+	return -1;
+}
+
+// Rebuilds the complete rule set; setFilterRules() replaces any previous rules
+void applyRulesLocked()
+{
+	QStringList rules;
+	for (auto it = g_levels.cbegin(); it != g_levels.cend(); ++it) {
+		const int rank = levelRank(it.value());
+		const QString pattern = it.key() == "mpm" ? QStringLiteral("mpm.*") : it.key();
+		rules << QString("%1.debug=%2").arg(pattern, rank <= 0 ? "true" : "false");
+		rules << QString("%1.info=%2").arg(pattern, rank <= 1 ? "true" : "false");
+		rules << QString("%1.warning=%2").arg(pattern, rank <= 2 ? "true" : "false");
+	}
+	QLoggingCategory::setFilterRules(rules.join('\n'));
+}
+
+bool isKnownCategory(const QString &category)
+{
+	return category == "mpm" || knownCategories().contains(category);
+}
+
+} // namespace
+
+bool setLogLevel(const QString &category, const QString &level)
+{
+	const QString cat = category.trimmed().toLower();
+	if (!isKnownCategory(cat) || levelRank(level) < 0) return false;
+	QMutexLocker lock(&g_levelsMutex);
+	// A blanket level supersedes earlier per-category ones
+	if (cat == "mpm") g_levels.clear();
+	g_levels.insert(cat, level.trimmed().toLower());
+	applyRulesLocked();
+	return true;
+}
+
+QMap<QString, QString> readLogLevels(QSettings &settings)
+{
+	QMap<QString, QString> levels;
+	settings.beginGroup("log-levels");
+	for (const QString &key : settings.childKeys()) {
+		const QString cat = key.trimmed().toLower();
+		const QString level = settings.value(key).toString();
+		if (isKnownCategory(cat) && levelRank(level) >= 0) levels.insert(cat, level.trimmed().toLower());
+		else qCWarning(lcSettings) << "Ignoring log level" << key << "=" << level;
+	}
+	settings.endGroup();
+	return levels;
+}
+
+void applyLogLevels(const QMap<QString, QString> &levels)
+{
+	QMutexLocker lock(&g_levelsMutex);
+	g_levels = levels;
+	applyRulesLocked();
+}
+
+void applyLogLevels(QSettings &settings)
+{
+	applyLogLevels(readLogLevels(settings));
+}
+
+QString logLevelSummary()
+{
+	QMutexLocker lock(&g_levelsMutex);
+	QString out;
+	for (auto it = g_levels.cbegin(); it != g_levels.cend(); ++it) out += it.key() + '=' + it.value() + '\n';
+	return out;
+}
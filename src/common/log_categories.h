@@ -0,0 +1,31 @@
+#ifndef MPM_LOG_CATEGORIES_H
+#define MPM_LOG_CATEGORIES_H
+
+#include <QLoggingCategory>
+#include <QMap>
+#include <QSettings>
+#include <QString>
+
+// Service logging categories. Debug output is off by default; the qC* macros
+// test the category before evaluating any of the streamed arguments, so a
+// disabled line costs one branch.
+Q_DECLARE_LOGGING_CATEGORY(lcMqtt)      // mpm.mqtt: broker connection and subscriptions
+Q_DECLARE_LOGGING_CATEGORY(lcDispatch)  // mpm.dispatch: inbound messages and matching
+Q_DECLARE_LOGGING_CATEGORY(lcIpc)       // mpm.ipc: local control endpoint
+Q_DECLARE_LOGGING_CATEGORY(lcActions)   // mpm.actions: action execution
+Q_DECLARE_LOGGING_CATEGORY(lcSettings)  // mpm.settings: settings files and reloads
+Q_DECLARE_LOGGING_CATEGORY(lcService)   // mpm.service: service host lifecycle (SCM, systemd)
+
+// Sets the minimum level ("debug", "info", "warning", "critical") for one
+// category, or for all of them with "mpm". Returns false for unknown input.
+bool setLogLevel(const QString &category, const QString &level);
+// Reads the [log-levels] group of the INI, e.g. "mpm.dispatch=debug",
+// skipping unknown categories and levels
+QMap<QString, QString> readLogLevels(QSettings &settings);
+// Replaces all levels, including ones set earlier at runtime
+void applyLogLevels(const QMap<QString, QString> &levels);
+void applyLogLevels(QSettings &settings);
+// Current overrides as "category=level" lines
+QString logLevelSummary();
+
+#endif // MPM_LOG_CATEGORIES_H
@@ -0,0 +1,100 @@
+#include "log_ring.h"
+
+#include <QString>
+#include <cstring>
+
+// Each record is a 4-byte length followed by the line bytes; records may wrap
+// around the end of the buffer.
+static constexpr int kHeaderBytes = 4;
+
+RecentLogRing::RecentLogRing(int capacityBytes)
+{
+	reset(capacityBytes);
+}
+
+void RecentLogRing::reset(int capacityBytes)
+{
+	m_buf.assign(size_t(qMax(0, capacityBytes)), '\0');
+	m_begin = m_end = 0;
+	m_starts.clear();
+	// Sequence numbers keep counting so existing readers see a gap, not a rewind
+	m_firstSeq = m_nextSeq;
+}
+
+void RecentLogRing::append(const char *data, int len)
+{
+	const quint64 cap = m_buf.size();
+	if (cap <= quint64(kHeaderBytes)) return;
+	len = int(qMin<quint64>(quint64(qMax(0, len)), cap - kHeaderBytes));
+	const quint64 need = quint64(kHeaderBytes + len);
+	while (m_end + need - m_begin > cap) {
+		m_begin += kHeaderBytes + lengthAt(m_begin);
+		m_starts.pop_front();
+		++m_firstSeq;
+	}
+	m_starts.push_back(m_end);
+	const quint32 header = quint32(len);
+	copyIn(m_end, reinterpret_cast<const char *>(&header), kHeaderBytes);
+	copyIn(m_end + kHeaderBytes, data, len);
+	m_end += need;
+	++m_nextSeq;
+}
+
+RecentLogRing::Chunk RecentLogRing::read(quint64 cursor, int maxBytes) const
+{
+	Chunk c;
+	// A new reader, or a cursor from the future (an earlier process): the tail
+	if (cursor == 0 || cursor > lastSeq()) {
+		cursor = lastSeq();
+		qint64 bytes = 0;
+		while (cursor >= m_firstSeq) {
+			bytes += lengthAt(m_starts[size_t(cursor - m_firstSeq)]);
+			if (bytes > maxBytes && cursor < lastSeq()) break;
+			--cursor;
+		}
+	} else if (cursor + 1 < m_firstSeq) {
+		c.missed = m_firstSeq - (cursor + 1);
+		c.text = QStringLiteral("[... %1 earlier log line(s) no longer available ...]\n").arg(c.missed).toUtf8();
+		cursor = m_firstSeq - 1;
+	}
+	c.cursor = cursor;
+	if (cursor + 1 >= m_nextSeq) return c;
+	quint64 pos = m_starts[size_t(cursor + 1 - m_firstSeq)];
+	bool first = true;
+	for (quint64 seq = cursor + 1; seq < m_nextSeq; ++seq) {
+		const int len = int(lengthAt(pos));
+		if (!first && c.text.size() + len > maxBytes) break;
+		const int at = c.text.size();
+		c.text.resize(at + len);
+		copyOut(pos + kHeaderBytes, c.text.data() + at, len);
+		pos += kHeaderBytes + len;
+		c.cursor = seq;
+		first = false;
+	}
+	return c;
+}
+
+void RecentLogRing::copyIn(quint64 pos, const char *src, int len)
+{
+	const size_t cap = m_buf.size();
+	const size_t off = size_t(pos % cap);
+	const size_t firstPart = qMin(size_t(len), cap - off);
+	std::memcpy(m_buf.data() + off, src, firstPart);
+	if (firstPart < size_t(len)) std::memcpy(m_buf.data(), src + firstPart, size_t(len) - firstPart);
+}
+
+void RecentLogRing::copyOut(quint64 pos, char *dst, int len) const
+{
+	const size_t cap = m_buf.size();
+	const size_t off = size_t(pos % cap);
+	const size_t firstPart = qMin(size_t(len), cap - off);
+	std::memcpy(dst, m_buf.data() + off, firstPart);
+	if (firstPart < size_t(len)) std::memcpy(dst + firstPart, m_buf.data(), size_t(len) - firstPart);
+}
+
+quint32 RecentLogRing::lengthAt(quint64 pos) const
+{
+	quint32 len = 0;
+	copyOut(pos, reinterpret_cast<char *>(&len), kHeaderBytes);
+	return len;
+}
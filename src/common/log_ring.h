@@ -0,0 +1,48 @@
+#ifndef MPM_LOG_RING_H
+#define MPM_LOG_RING_H
+
+#include <QByteArray>
+#include <QtGlobal>
+#include <deque>
+#include <vector>
+
+// Fixed-size byte ring of recent log lines. Every line gets a sequence number
+// starting at 1; readers keep their own cursor and ask for what came after it,
+// so any number of observers can follow the log without consuming it. Oldest
+// lines are evicted when space runs out. A cursor of 0 means "no position
+// yet": the reader gets the most recent lines. Not thread-safe; callers lock.
+class RecentLogRing {
+public:
+	struct Chunk {
+		QByteArray text;    // lines after the cursor, prefixed by a gap marker if some were evicted
+		quint64 cursor = 0; // sequence number of the last line returned; pass back to continue
+		quint64 missed = 0; // lines evicted before this reader got to them
+	};
+
+	explicit RecentLogRing(int capacityBytes = 0);
+	void reset(int capacityBytes);
+	int capacity() const { return int(m_buf.size()); }
+
+	void append(const char *data, int len);
+	quint64 lastSeq() const { return m_nextSeq - 1; }
+	// Lines with seq > cursor, at most maxBytes of them (but always at least
+	// one line). Cursor 0, or one this ring never handed out, returns the
+	// newest maxBytes instead, without a gap marker.
+	Chunk read(quint64 cursor, int maxBytes = 64 * 1024) const;
+
+private:
+	void copyIn(quint64 pos, const char *src, int len);
+	void copyOut(quint64 pos, char *dst, int len) const;
+	quint32 lengthAt(quint64 pos) const;
+
+	std::vector<char> m_buf;
+	// Logical byte positions; physical offset is pos % capacity
+	quint64 m_begin = 0;
+	quint64 m_end = 0;
+	quint64 m_firstSeq = 1;
+	quint64 m_nextSeq = 1;
+	// Start position of each stored record; m_starts[i] holds m_firstSeq + i
+	std::deque<quint64> m_starts;
+};
+
+#endif // MPM_LOG_RING_H
@@ -0,0 +1,87 @@
+#include "log_rotation.h"
+#include "crc32.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+
+namespace {
+
+QString segmentPrefix(const QFileInfo &fi)
+{
+	return fi.completeBaseName() + QLatin1Char('-');
+}
+
+} // namespace
+
+QString rotatedLogSegmentPath(const QString &logFilePath, const QDateTime &when)
+{
+	const QFileInfo fi(logFilePath);
+	const QString stem = fi.absoluteDir().filePath(segmentPrefix(fi) + when.toString("yyyyMMdd-HHmmss"));
+	const QString ext = fi.suffix().isEmpty() ? QString() : QLatin1Char('.') + fi.suffix();
+	QString candidate = stem + ext;
+	for (int n = 1; QFile::exists(candidate) || QFile::exists(candidate + ".gz"); ++n) {
+		candidate = QString("%1-%2%3").arg(stem).arg(n).arg(ext);
+	}
+	return candidate;
+}
+
+QStringList rotatedLogSegments(const QString &logFilePath)
+{
+	const QFileInfo fi(logFilePath);
+	const QString ext = fi.suffix().isEmpty() ? QString() : QLatin1Char('.') + fi.suffix();
+	QDir dir = fi.absoluteDir();
+	const QStringList names = dir.entryList({segmentPrefix(fi) + "*" + ext, segmentPrefix(fi) + "*" + ext + ".gz"},
+	                                        QDir::Files, QDir::Name);
+	QStringList paths;
+	for (const QString &n : names) paths << dir.filePath(n);
+	// Same stamp compressed or not sorts by the stamp alone
+	std::sort(paths.begin(), paths.end(), [](const QString &a, const QString &b) {
+		auto key = [](const QString &p) { return p.endsWith(".gz") ? p.left(p.size() - 3) : p; };
+		return key(a) < key(b);
+	});
+	return paths;
+}
+
+bool gzipLogSegment(const QString &src, const QString &dst)
+{
+	QFile in(src);
+	if (!in.open(QIODevice::ReadOnly)) return false;
+	const QByteArray raw = in.readAll();
+	in.close();
+	if (raw.isEmpty()) return QFile::remove(src);
+
+	// qCompress emits a 4-byte length, a 2-byte zlib header, the deflate
+	// stream and a 4-byte Adler-32; gzip wants the bare deflate stream
+	const QByteArray z = qCompress(raw, 6);
+	if (z.size() < 10) return false;
+	const QByteArray deflate = z.mid(6, z.size() - 10);
+
+	QSaveFile out(dst);
+	if (!out.open(QIODevice::WriteOnly)) return false;
+	static const char header[10] = { '\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, '\xff' };
+	out.write(header, sizeof(header));
+	out.write(deflate);
+	uchar trailer[8];
+	qToLittleEndian<quint32>(mpmCrc32(raw.constData(), size_t(raw.size())), trailer);
+	qToLittleEndian<quint32>(quint32(raw.size()), trailer + 4);
+	out.write(reinterpret_cast<const char *>(trailer), sizeof(trailer));
+	if (!out.commit()) return false;
+	return QFile::remove(src);
+}
+
+void compressAndPruneLogSegments(const QString &logFilePath, int keep, bool compress)
+{
+	if (compress) {
+		for (const QString &seg : rotatedLogSegments(logFilePath)) {
+			if (seg.endsWith(".gz")) continue;
+			gzipLogSegment(seg, seg + ".gz");
+		}
+	}
+	if (keep < 0) return;
+	const QStringList segments = rotatedLogSegments(logFilePath);
+	for (int i = 0; i + keep < segments.size(); ++i) QFile::remove(segments.at(i));
+}
@@ -0,0 +1,27 @@
+#ifndef MPM_LOG_ROTATION_H
+#define MPM_LOG_ROTATION_H
+
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+
+// Rotated segments live next to the active log as
+//   <base>-yyyyMMdd-HHmmss[-N].log  (just rotated)
+//   <base>-yyyyMMdd-HHmmss[-N].log.gz
+// so they sort chronologically by name.
+
+// Picks a segment name for a log rotated at the given time; never returns an existing path
+QString rotatedLogSegmentPath(const QString &logFilePath, const QDateTime &when);
+
+// Rotated segments of logFilePath, oldest first (compressed or not)
+QStringList rotatedLogSegments(const QString &logFilePath);
+
+// Writes src as a gzip member to dst (written to a temp name, then renamed)
+// and removes src on success
+bool gzipLogSegment(const QString &src, const QString &dst);
+
+// Compresses leftover plain segments and deletes all but the newest `keep`
+// segments. Meant to run on a background thread.
+void compressAndPruneLogSegments(const QString &logFilePath, int keep, bool compress);
+
+#endif // MPM_LOG_ROTATION_H
@@ -1,5 +1,8 @@
 #include "logging.h"
+#include "log_rotation.h"
+#include "log_ring.h"
 
+#include <QCoreApplication>
 #include <QFile>
 #include <QDateTime>
 #include <QTextStream>
@@ -7,73 +10,517 @@
 #include <QMutexLocker>
 #include <QFileInfo>
 #include <QDir>
+#include <QThreadPool>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
 
-static QFile g_logFile;
-static QMutex g_logMutex;
-static QStringList g_recent;
-static int g_recentMax = 0;
+namespace {
 
-static void mpmMessageHandler(QtMsgType type, const QMessageLogContext &ctx, const QString &msg)
+// QtMsgType values are not ordered by severity
+int severity(QtMsgType type)
 {
-	Q_UNUSED(ctx);
-	QString level;
 	switch (type) {
-	case QtDebugMsg: level = "DEBUG"; break;
-	case QtInfoMsg: level = "INFO"; break;
-	case QtWarningMsg: level = "WARN"; break;
-	case QtCriticalMsg: level = "ERROR"; break;
-	case QtFatalMsg: level = "FATAL"; break;
+	case QtDebugMsg: return 0;
+	case QtInfoMsg: return 1;
+	case QtWarningMsg: return 2;
+	case QtCriticalMsg: return 3;
+	case QtFatalMsg: return 4;
 	}
-	const QString line = QString("%1 [%2] %3\n")
-		.arg(QDateTime::currentDateTime().toString(Qt::ISODate))
-		.arg(level)
-		.arg(msg);
+	return 1;
+}
+
+const char *levelName(QtMsgType type)
+{
+	switch (type) {
+	case QtDebugMsg: return "DEBUG";
+	case QtInfoMsg: return "INFO";
+	case QtWarningMsg: return "WARN";
+	case QtCriticalMsg: return "ERROR";
+	case QtFatalMsg: return "FATAL";
+	}
+	return "INFO";
+}
+
+constexpr int kWriterTickMs = 25;
+
+// >0 while a LogSinkSuppressor lives on this thread
+thread_local int t_sinkSuppressed = 0;
+// Set while this thread writes a line synchronously; a critical line logged
+// from inside that write (the sink, QFile) is queued instead of deadlocking
+thread_local bool t_writingSync = false;
+constexpr int kMaxBatchBytes = 64 * 1024;
+
+// Bounded MPSC queue (Vyukov): each slot carries a sequence number telling
+// producers whether it is free and the consumer whether it is filled. Producers
+// claim a slot with one CAS on the head and never block; a full queue drops.
+class AsyncLogWriter {
+public:
+	explicit AsyncLogWriter(int capacity)
+	{
+		size_t n = 64;
+		while (n < size_t(qMax(64, capacity))) n <<= 1;
+		m_mask = n - 1;
+		m_slots.reset(new Slot[n]);
+		for (size_t i = 0; i < n; ++i) m_slots[i].seq.store(i, std::memory_order_relaxed);
+		m_maintenance.setMaxThreadCount(1);
+	}
+
+	// category must outlive the record; Qt logging category names are static
+	bool push(QtMsgType type, const char *category, const QString &msg)
+	{
+		quint64 pos = m_head.load(std::memory_order_relaxed);
+		Slot *slot = nullptr;
+		for (;;) {
+			slot = &m_slots[pos & m_mask];
+			const quint64 seq = slot->seq.load(std::memory_order_acquire);
+			const qint64 diff = qint64(seq) - qint64(pos);
+			if (diff == 0) {
+				if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+			} else if (diff < 0) {
+				m_dropped.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			} else {
+				pos = m_head.load(std::memory_order_relaxed);
+			}
+		}
+		slot->timestampMs = QDateTime::currentMSecsSinceEpoch();
+		slot->type = type;
+		slot->category = category;
+		slot->forward = t_sinkSuppressed == 0;
+		slot->text = msg.toUtf8();
+		slot->seq.store(pos + 1, std::memory_order_release);
+		if (severity(type) >= m_flushSeverity.load(std::memory_order_relaxed)
+		    || pos - m_tail.load(std::memory_order_relaxed) > m_mask / 2) {
+			wake();
+		}
+		return true;
+	}
+
+	void start()
+	{
+		if (m_thread.joinable()) return;
+		m_running.store(true);
+		m_thread = std::thread([this]() { run(); });
+	}
+
+	void stop()
+	{
+		if (!m_thread.joinable()) return;
+		m_running.store(false);
+		wake();
+		m_thread.join();
+	}
+
+	// Consumer side; the writer thread and fatal/shutdown paths share it
+	void drain(bool forceFlush)
+	{
+		std::lock_guard<std::mutex> lock(m_consumerMutex);
+		drainLocked(forceFlush);
+	}
+
+	// Critical and fatal lines skip the queue: written and flushed by the
+	// calling thread, after the lines queued before them, so a full queue
+	// can't drop the last thing logged before an abort
+	bool writeSync(QtMsgType type, const char *category, const QString &msg)
+	{
+		if (t_writingSync) return false;
+		t_writingSync = true;
+		{
+			std::lock_guard<std::mutex> lock(m_consumerMutex);
+			drainLocked(false);
+			QByteArray line;
+			appendLine(line, QDateTime::currentMSecsSinceEpoch(), type, category, msg.toUtf8());
+			if (m_sink && t_sinkSuppressed == 0) m_sink->consume(type, category, line);
+			writeBatch(line);
+			flushLocked();
+		}
+		t_writingSync = false;
+		return true;
+	}
+
+	void drainLocked(bool forceFlush)
+	{
+		QByteArray batch;
+		bool flushNow = forceFlush;
+		quint64 tail = m_tail.load(std::memory_order_relaxed);
+		for (;;) {
+			Slot &slot = m_slots[tail & m_mask];
+			if (slot.seq.load(std::memory_order_acquire) != tail + 1) break;
+			const int lineStart = batch.size();
+			appendLine(batch, slot.timestampMs, slot.type, slot.category, slot.text);
+			if (m_sink && slot.forward) {
+				m_sink->consume(slot.type, slot.category, QByteArray::fromRawData(batch.constData() + lineStart, batch.size() - lineStart));
+			}
+			if (severity(slot.type) >= m_flushSeverity.load(std::memory_order_relaxed)) flushNow = true;
+			slot.text = QByteArray();
+			slot.seq.store(tail + m_mask + 1, std::memory_order_release);
+			++tail;
+			m_tail.store(tail, std::memory_order_relaxed);
+			if (batch.size() >= kMaxBatchBytes) {
+				writeBatch(batch);
+				batch.clear();
+			}
+		}
+		const quint64 dropped = m_dropped.load(std::memory_order_relaxed);
+		if (dropped != m_droppedReported) {
+			const QString note = QStringLiteral("Logger queue full, dropped %1 line(s)").arg(dropped - m_droppedReported);
+			appendLine(batch, QDateTime::currentMSecsSinceEpoch(), QtWarningMsg, nullptr, note.toUtf8());
+			m_droppedReported = dropped;
+			flushNow = true;
+		}
+		if (!batch.isEmpty()) writeBatch(batch);
+		const qint64 now = QDateTime::currentMSecsSinceEpoch();
+		if (m_dirty && (flushNow || now - m_lastFlushMs >= m_flushIntervalMs.load(std::memory_order_relaxed))) flushLocked();
+	}
+
+	void flushLocked()
+	{
+		if (!m_dirty) return;
+		if (m_file.isOpen()) m_file.flush();
+		if (m_mirrorToStderr.load(std::memory_order_relaxed)) std::fflush(stderr);
+		m_lastFlushMs = QDateTime::currentMSecsSinceEpoch();
+		m_dirty = false;
+	}
+
+	void configure(const LogWriterOptions &options)
+	{
+		m_flushIntervalMs.store(qMax(0, options.flushIntervalMs), std::memory_order_relaxed);
+		m_flushSeverity.store(severity(options.flushLevel), std::memory_order_relaxed);
+		m_mirrorToStderr.store(options.mirrorToStderr, std::memory_order_relaxed);
+		std::lock_guard<std::mutex> lock(m_consumerMutex);
+		m_rotateBytes = qMax<qint64>(0, options.rotateBytes);
+		m_rotateAgeMs = qint64(qMax(0, options.rotateAgeSec)) * 1000;
+		m_retainSegments = qMax(0, options.retainSegments);
+		m_compressSegments = options.compressSegments;
+	}
+
+	// Reopens the log file between batches
+	void openFile(const QString &logFilePath, bool truncate)
+	{
+		drain(true);
+		std::lock_guard<std::mutex> lock(m_consumerMutex);
+		if (m_file.isOpen()) m_file.close();
+		// Ensure parent directory exists
+		QFileInfo fi(logFilePath);
+		QDir dir(fi.absolutePath());
+		dir.mkpath(".");
+		m_file.setFileName(logFilePath);
+		if (truncate) {
+			m_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
+			m_file.close();
+		}
+		m_file.open(QIODevice::Append | QIODevice::Text);
+		m_fileBytes = m_file.size();
+		const QDateTime born = QFileInfo(logFilePath).birthTime();
+		m_fileOpenedMs = (m_fileBytes > 0 && born.isValid()) ? born.toMSecsSinceEpoch() : QDateTime::currentMSecsSinceEpoch();
+		m_nextRotateAttemptMs = 0;
+		// Segments left uncompressed by an earlier run that stopped mid-way
+		if (rotationEnabled()) scheduleMaintenance();
+	}
+
+	void closeFile()
+	{
+		std::lock_guard<std::mutex> lock(m_consumerMutex);
+		if (m_file.isOpen()) m_file.close();
+	}
+
+	void waitForMaintenance(int msecs)
+	{
+		m_maintenance.waitForDone(msecs);
+	}
+
+	void setRecentCapacity(int capacityBytes)
+	{
+		QMutexLocker lock(&m_recentMutex);
+		m_recent.reset(capacityBytes);
+	}
+
+	RecentLogs recentSince(quint64 cursor)
+	{
+		QMutexLocker lock(&m_recentMutex);
+		const RecentLogRing::Chunk c = m_recent.read(cursor);
+		RecentLogs r;
+		r.text = QString::fromUtf8(c.text);
+		r.cursor = c.cursor;
+		r.missed = c.missed;
+		return r;
+	}
+
+	QString takeRecent()
+	{
+		const RecentLogs r = recentSince(m_legacyCursor.load(std::memory_order_relaxed));
+		m_legacyCursor.store(r.cursor, std::memory_order_relaxed);
+		return r.text;
+	}
+
+	quint64 dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+	void setSink(LogSink *sink)
+	{
+		// Waits out a drain in progress, so a detached sink is never called again
+		std::lock_guard<std::mutex> lock(m_consumerMutex);
+		m_sink = sink;
+	}
+
+private:
+	struct Slot {
+		std::atomic<quint64> seq{0};
+		qint64 timestampMs = 0;
+		QtMsgType type = QtInfoMsg;
+		const char *category = nullptr;
+		bool forward = true;
+		QByteArray text;
+	};
+
+	void wake()
+	{
+		// Notifying without the mutex can miss a sleeping writer; the timed wait
+		// in run() bounds that to one tick
+		if (m_sleeping.load(std::memory_order_relaxed)) m_wakeCv.notify_one();
+	}
+
+	bool hasPending() const
+	{
+		return m_head.load(std::memory_order_relaxed) != m_tail.load(std::memory_order_relaxed);
+	}
+
+	void run()
+	{
+		while (m_running.load()) {
+			{
+				std::unique_lock<std::mutex> lock(m_wakeMutex);
+				m_sleeping.store(true, std::memory_order_relaxed);
+				m_wakeCv.wait_for(lock, std::chrono::milliseconds(kWriterTickMs), [this]() {
+					return !m_running.load() || hasPending();
+				});
+				m_sleeping.store(false, std::memory_order_relaxed);
+			}
+			drain(false);
+		}
+		drain(true);
+	}
+
+	void appendLine(QByteArray &batch, qint64 timestampMs, QtMsgType type, const char *category, const QByteArray &text)
+	{
+		// Timestamps only change once per second at this resolution
+		const qint64 sec = timestampMs / 1000;
+		if (sec != m_stampSec) {
+			m_stampSec = sec;
+			m_stamp = QDateTime::fromMSecsSinceEpoch(sec * 1000).toString(Qt::ISODate).toUtf8();
+		}
+		const int start = batch.size();
+		batch.append(m_stamp);
+		batch.append(" [");
+		batch.append(levelName(type));
+		batch.append("] ");
+		// Uncategorised qDebug()/qInfo() lines keep the old format
+		if (category && std::strcmp(category, "default") != 0) {
+			batch.append(category);
+			batch.append(": ");
+		}
+		batch.append(text);
+		batch.append('\n');
+		QMutexLocker lock(&m_recentMutex);
+		m_recent.append(batch.constData() + start, batch.size() - start);
+	}
+
+	bool rotationEnabled() const
+	{
+		return m_rotateBytes > 0 || m_rotateAgeMs > 0;
+	}
+
+	bool rotationDue(qint64 incoming, qint64 now) const
+	{
+		if (!m_file.isOpen() || m_fileBytes == 0 || now < m_nextRotateAttemptMs) return false;
+		if (m_rotateBytes > 0 && m_fileBytes + incoming > m_rotateBytes) return true;
+		return m_rotateAgeMs > 0 && now - m_fileOpenedMs >= m_rotateAgeMs;
+	}
+
+	void rotate(qint64 now)
 	{
-		QMutexLocker lock(&g_logMutex);
-		if (g_logFile.isOpen()) {
-			QTextStream ts(&g_logFile);
-			ts << line;
-			g_logFile.flush();
+		const QString path = m_file.fileName();
+		m_file.close();
+		const QString segment = rotatedLogSegmentPath(path, QDateTime::fromMSecsSinceEpoch(now));
+		if (!QFile::rename(path, segment)) {
+			// Someone holds the file without delete sharing; keep appending and retry later
+			m_file.open(QIODevice::Append | QIODevice::Text);
+			m_nextRotateAttemptMs = now + 60 * 1000;
+			return;
 		}
-		if (g_recentMax > 0) {
-			g_recent.push_back(line);
-			if (g_recent.size() > g_recentMax) g_recent.pop_front();
+		m_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
+		m_fileBytes = 0;
+		m_fileOpenedMs = now;
+		scheduleMaintenance();
+	}
+
+	void scheduleMaintenance()
+	{
+		const QString path = m_file.fileName();
+		const int keep = m_retainSegments;
+		const bool compress = m_compressSegments;
+		m_maintenance.start([path, keep, compress]() {
+			compressAndPruneLogSegments(path, keep, compress);
+		});
+	}
+
+	void writeBatch(const QByteArray &batch)
+	{
+		if (rotationEnabled()) {
+			const qint64 now = QDateTime::currentMSecsSinceEpoch();
+			if (rotationDue(batch.size(), now)) rotate(now);
 		}
+		if (m_file.isOpen()) {
+			m_file.write(batch);
+			m_fileBytes += batch.size();
+		}
+		if (m_mirrorToStderr.load(std::memory_order_relaxed)) std::fwrite(batch.constData(), 1, size_t(batch.size()), stderr);
+		m_dirty = true;
 	}
+
+	std::unique_ptr<Slot[]> m_slots;
+	quint64 m_mask = 0;
+	alignas(64) std::atomic<quint64> m_head{0};
+	alignas(64) std::atomic<quint64> m_tail{0};
+	alignas(64) std::atomic<quint64> m_dropped{0};
+	std::atomic<int> m_flushSeverity{severity(QtWarningMsg)};
+	std::atomic<int> m_flushIntervalMs{1000};
+	std::atomic<bool> m_mirrorToStderr{true};
+	std::atomic<bool> m_running{false};
+	std::atomic<bool> m_sleeping{false};
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wakeCv;
+	std::thread m_thread;
+
+	// Owned by whoever holds m_consumerMutex
+	std::mutex m_consumerMutex;
+	QFile m_file;
+	quint64 m_droppedReported = 0;
+	LogSink *m_sink = nullptr;
+	qint64 m_lastFlushMs = 0;
+	qint64 m_stampSec = -1;
+	QByteArray m_stamp;
+	bool m_dirty = false;
+	qint64 m_fileBytes = 0;
+	qint64 m_fileOpenedMs = 0;
+	qint64 m_nextRotateAttemptMs = 0;
+	qint64 m_rotateBytes = 0;
+	qint64 m_rotateAgeMs = 0;
+	int m_retainSegments = 10;
+	bool m_compressSegments = true;
+	QThreadPool m_maintenance;
+
+	QMutex m_recentMutex;
+	RecentLogRing m_recent;
+	std::atomic<quint64> m_legacyCursor{0};
+};
+
+// Never destroyed: the message handler may run during static destruction
+AsyncLogWriter *g_writer = nullptr;
+std::atomic<bool> g_writerActive{false};
+std::once_flag g_writerOnce;
+// Stays mapped until exit; other threads may be mid-append at shutdown
+BinaryLogWriter *g_binaryLog = nullptr;
+std::atomic<bool> g_binaryLogActive{false};
+
+AsyncLogWriter *writerInstance(int capacity)
+{
+	std::call_once(g_writerOnce, [capacity]() { g_writer = new AsyncLogWriter(capacity); });
+	return g_writer;
+}
+
+void mpmMessageHandler(QtMsgType type, const QMessageLogContext &ctx, const QString &msg)
+{
+	if (g_binaryLogActive.load(std::memory_order_acquire)) {
+		g_binaryLog->append(type, ctx.category, msg);
+	}
+	if (g_writerActive.load(std::memory_order_acquire)) {
+		// Qt aborts right after a fatal message; get it (and errors) to disk now
+		if (severity(type) >= severity(QtCriticalMsg) && g_writer->writeSync(type, ctx.category, msg)) return;
+		g_writer->push(type, ctx.category, msg);
+		if (type == QtFatalMsg) g_writer->drain(true);
+		return;
+	}
+	// Logger not running (before init or after shutdown): write synchronously
+	const QString line = QString("%1 [%2] %3\n")
+		.arg(QDateTime::currentDateTime().toString(Qt::ISODate))
+		.arg(QLatin1String(levelName(type)))
+		.arg(msg);
 	QTextStream serr(stderr);
 	serr << line;
 }
 
-void initializeFileLogger(const QString &logFilePath, bool truncate)
+} // namespace
+
+void initializeFileLogger(const QString &logFilePath, bool truncate, const LogWriterOptions &options)
 {
-	QMutexLocker lock(&g_logMutex);
-	if (g_logFile.isOpen()) g_logFile.close();
-	// Ensure parent directory exists
-	QFileInfo fi(logFilePath);
-	QDir dir(fi.absolutePath());
-	dir.mkpath(".");
-	g_logFile.setFileName(logFilePath);
-	if (truncate) {
-		g_logFile.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text);
-		g_logFile.close();
-	}
-	g_logFile.open(QIODevice::Append | QIODevice::Text);
+	AsyncLogWriter *w = writerInstance(options.queueCapacity);
+	w->configure(options);
+	w->openFile(logFilePath, truncate);
+	w->start();
+	if (!options.binaryLogPath.isEmpty() && !g_binaryLog) {
+		g_binaryLog = new BinaryLogWriter;
+		if (g_binaryLog->open(options.binaryLogPath, options.binaryLogBytes)) {
+			g_binaryLogActive.store(true, std::memory_order_release);
+		}
+	}
+	const bool wasActive = g_writerActive.exchange(true, std::memory_order_acq_rel);
 	qInstallMessageHandler(mpmMessageHandler);
+	if (!wasActive && QCoreApplication::instance()) qAddPostRoutine(shutdownFileLogger);
 }
 
-void enableInMemoryLogCapture(int maxLines)
+void shutdownFileLogger()
 {
-	QMutexLocker lock(&g_logMutex);
-	g_recentMax = qMax(0, maxLines);
-	g_recent.clear();
+	if (!g_writerActive.exchange(false, std::memory_order_acq_rel)) return;
+	g_writer->stop();
+	g_writer->drain(true);
+	g_writer->closeFile();
+	// Unfinished compression is picked up again on the next start
+	g_writer->waitForMaintenance(2000);
 }
 
-QString takeRecentLogs()
+void logBinaryEvent(QtMsgType type, const char *category, const QString &message,
+                    std::initializer_list<BinaryLogField> fields)
 {
-	QMutexLocker lock(&g_logMutex);
-	const QString joined = g_recent.join("");
-	g_recent.clear();
-	return joined;
+	if (g_binaryLogActive.load(std::memory_order_acquire)) g_binaryLog->append(type, category, message, fields);
 }
 
+void setLogSink(LogSink *sink)
+{
+	writerInstance(LogWriterOptions().queueCapacity)->setSink(sink);
+}
 
+LogSinkSuppressor::LogSinkSuppressor()
+{
+	++t_sinkSuppressed;
+}
+
+LogSinkSuppressor::~LogSinkSuppressor()
+{
+	--t_sinkSuppressed;
+}
+
+quint64 droppedLogLines()
+{
+	return g_writer ? g_writer->dropped() : 0;
+}
+
+void enableInMemoryLogCapture(int capacityBytes)
+{
+	writerInstance(LogWriterOptions().queueCapacity)->setRecentCapacity(capacityBytes);
+}
+
+RecentLogs recentLogsSince(quint64 cursor)
+{
+	return g_writer ? g_writer->recentSince(cursor) : RecentLogs();
+}
+
+QString takeRecentLogs()
+{
+	return g_writer ? g_writer->takeRecent() : QString();
+}
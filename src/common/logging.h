@@ -2,16 +2,71 @@
 #define MPM_LOGGING_H
 
 #include <QString>
+#include <QtGlobal>
+#include "binary_log.h"
+
+// Tuning for the background log writer. Producers only copy the message into a
+// lock-free queue; formatting, file I/O and stderr mirroring happen on the
+// writer thread. Critical and fatal lines are the exception: the logging
+// thread writes and flushes them itself, so they are never dropped.
+struct LogWriterOptions {
+	int queueCapacity = 8192;       // records; rounded up to a power of two, fixed after first init
+	int flushIntervalMs = 1000;     // longest a written line may sit in the file buffer
+	QtMsgType flushLevel = QtWarningMsg; // lines at or above this level are flushed immediately
+	bool mirrorToStderr = true;
+	// Rotation runs on the writer thread, compression and pruning on a
+	// background pool; producers never wait for either
+	qint64 rotateBytes = 0;         // rotate when the active file reaches this size; 0 = never
+	int rotateAgeSec = 0;           // rotate when the active file is this old; 0 = never
+	int retainSegments = 10;        // rotated segments kept next to the active file
+	bool compressSegments = true;   // gzip rotated segments
+	// Optional crash-survivable binary log, written on the caller's thread into
+	// a memory-mapped ring file; decode with mpmlogdump
+	QString binaryLogPath;
+	qint64 binaryLogBytes = 4 * 1024 * 1024;
+};
 
 // Installs a Qt message handler that writes logs to the given file.
 // Also mirrors logs to stderr for console runs.
 // If truncate is true, clears the file at install time.
-void initializeFileLogger(const QString &logFilePath, bool truncate = false);
-
-// Optional: capture recent logs in-memory (service can expose them via IPC)
-void enableInMemoryLogCapture(int maxLines = 500);
-QString takeRecentLogs(); // returns and clears captured logs
+void initializeFileLogger(const QString &logFilePath, bool truncate = false, const LogWriterOptions &options = LogWriterOptions());
+// Drains queued lines, stops the writer thread and closes the file. Runs
+// automatically when the QCoreApplication is destroyed.
+void shutdownFileLogger();
+// Lines discarded because the queue was full since the logger started
+quint64 droppedLogLines();
+// Structured record with typed fields for the binary log; no-op unless enabled
+void logBinaryEvent(QtMsgType type, const char *category, const QString &message,
+                    std::initializer_list<BinaryLogField> fields);
 
-#endif // MPM_LOGGING_H
+// Receives every formatted line on the log writer thread. consume() must not
+// block or log; `line` is only valid during the call.
+class LogSink {
+public:
+	virtual ~LogSink() = default;
+	virtual void consume(QtMsgType type, const char *category, const QByteArray &line) = 0;
+};
+// One sink at a time; nullptr detaches. Returns only once the old sink is no
+// longer being called. The caller keeps ownership.
+void setLogSink(LogSink *sink);
+// Lines logged on the current thread while an instance lives are not passed
+// to the sink (used by sinks whose delivery path logs itself)
+class LogSinkSuppressor {
+public:
+	LogSinkSuppressor();
+	~LogSinkSuppressor();
+	Q_DISABLE_COPY(LogSinkSuppressor)
+};
 
+// Optional: keep recent log lines in a fixed-size in-memory ring (service can
+// expose them via IPC). Lines are numbered; readers follow with their own cursor.
+void enableInMemoryLogCapture(int capacityBytes = 256 * 1024);
+struct RecentLogs {
+	QString text;        // lines after the cursor; starts with a gap marker if some were evicted
+	quint64 cursor = 0;  // pass back to continue after the last returned line
+	quint64 missed = 0;  // lines the reader fell behind by
+};
+RecentLogs recentLogsSince(quint64 cursor);
+QString takeRecentLogs(); // legacy single-reader view: lines since the previous call
 
+#endif // MPM_LOGGING_H
@@ -0,0 +1,344 @@
+#include "secret_store.h"
+#include "crypto_win.h"
+#include "settings.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRandomGenerator>
+#include <cstring>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <sddl.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#ifdef MPM_HAVE_OPENSSL
+#include <openssl/evp.h>
+#endif
+
+void secureWipe(void *p, size_t n)
+{
+	if (!p || !n) return;
+#ifdef Q_OS_WIN
+	SecureZeroMemory(p, n);
+#else
+	volatile unsigned char *b = static_cast<volatile unsigned char *>(p);
+	while (n--) *b++ = 0;
+#endif
+}
+
+// ---- SecretBuffer ----
+
+SecretBuffer::SecretBuffer(SecretBuffer &&other) noexcept
+	: m_data(other.m_data), m_size(other.m_size), m_capacity(other.m_capacity), m_locked(other.m_locked)
+{
+	other.m_data = nullptr;
+	other.m_size = 0;
+	other.m_capacity = 0;
+	other.m_locked = false;
+}
+
+SecretBuffer &SecretBuffer::operator=(SecretBuffer &&other) noexcept
+{
+	if (this != &other) {
+		clear();
+		std::swap(m_data, other.m_data);
+		std::swap(m_size, other.m_size);
+		std::swap(m_capacity, other.m_capacity);
+		std::swap(m_locked, other.m_locked);
+	}
+	return *this;
+}
+
+void SecretBuffer::assign(const char *data, int size)
+{
+	clear();
+	if (!data || size <= 0) return;
+	// Whole pages: locking works per page and nothing else shares them
+	const size_t page = 4096;
+	const size_t capacity = (size_t(size) + page - 1) / page * page;
+#ifdef Q_OS_WIN
+	void *p = VirtualAlloc(nullptr, capacity, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+	if (!p) return;
+	m_locked = VirtualLock(p, capacity) != 0;
+#else
+	void *p = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED) return;
+	m_locked = mlock(p, capacity) == 0;
+#endif
+	m_data = static_cast<char *>(p);
+	m_capacity = capacity;
+	std::memcpy(m_data, data, size_t(size));
+	m_size = size;
+}
+
+void SecretBuffer::clear()
+{
+	if (!m_data) return;
+	secureWipe(m_data, m_capacity);
+#ifdef Q_OS_WIN
+	if (m_locked) VirtualUnlock(m_data, m_capacity);
+	VirtualFree(m_data, 0, MEM_RELEASE);
+#else
+	if (m_locked) munlock(m_data, m_capacity);
+	munmap(m_data, m_capacity);
+#endif
+	m_data = nullptr;
+	m_size = 0;
+	m_capacity = 0;
+	m_locked = false;
+}
+
+bool SecretBuffer::equals(const char *data, int size) const
+{
+	return size == m_size && (size == 0 || std::memcmp(m_data, data, size_t(size)) == 0);
+}
+
+namespace {
+
+// ---- DPAPI ----
+
+class DpapiSecretStore : public SecretStore {
+public:
+	QString name() const override { return QStringLiteral("dpapi"); }
+	QByteArray protect(const QByteArray &plain) override { return dpapiEncryptMachineScope(plain); }
+	bool unprotect(const QByteArray &stored, SecretBuffer *out) override
+	{
+		QByteArray plain = dpapiDecryptBase64(stored);
+		if (plain.isEmpty()) return false;
+		out->assign(plain.constData(), plain.size());
+		secureWipe(plain.data(), size_t(plain.size()));
+		return true;
+	}
+};
+
+// ---- File ----
+
+#ifdef MPM_HAVE_OPENSSL
+
+// Sealed value: format byte, nonce, AES-256-GCM ciphertext, tag. The format
+// byte is authenticated as associated data.
+constexpr int kKeyBytes = 32;
+constexpr int kNonceBytes = 12;
+constexpr int kTagBytes = 16;
+const char kFileFormat = '\x02';
+
+const unsigned char *bytes(const char *p)
+{
+	return reinterpret_cast<const unsigned char *>(p);
+}
+
+// Ciphertext followed by the tag; empty on failure
+QByteArray gcmSeal(const SecretBuffer &key, const QByteArray &nonce, const QByteArray &aad, const QByteArray &plain)
+{
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	if (!ctx) return QByteArray();
+	QByteArray out(plain.size() + kTagBytes, Qt::Uninitialized);
+	unsigned char *o = reinterpret_cast<unsigned char *>(out.data());
+	int len = 0;
+	bool ok = EVP_EncryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, bytes(key.data()), bytes(nonce.constData())) == 1
+	       && EVP_EncryptUpdate(ctx, nullptr, &len, bytes(aad.constData()), aad.size()) == 1
+	       && EVP_EncryptUpdate(ctx, o, &len, bytes(plain.constData()), plain.size()) == 1;
+	int total = len;
+	ok = ok && EVP_EncryptFinal_ex(ctx, o + total, &len) == 1;
+	total += len;
+	ok = ok && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_GET_TAG, kTagBytes, o + total) == 1;
+	// Also wipes the key schedule
+	EVP_CIPHER_CTX_free(ctx);
+	if (!ok) return QByteArray();
+	out.resize(total + kTagBytes);
+	return out;
+}
+
+// Decrypts sealed (ciphertext followed by the tag) into *plain; false if the
+// tag doesn't verify
+bool gcmOpen(const SecretBuffer &key, const QByteArray &nonce, const QByteArray &aad, const QByteArray &sealed,
+             QByteArray *plain)
+{
+	if (sealed.size() < kTagBytes) return false;
+	EVP_CIPHER_CTX *ctx = EVP_CIPHER_CTX_new();
+	if (!ctx) return false;
+	const int bodySize = sealed.size() - kTagBytes;
+	QByteArray tag = sealed.right(kTagBytes);
+	plain->resize(bodySize);
+	unsigned char *o = reinterpret_cast<unsigned char *>(plain->data());
+	int len = 0;
+	bool ok = EVP_DecryptInit_ex(ctx, EVP_aes_256_gcm(), nullptr, bytes(key.data()), bytes(nonce.constData())) == 1
+	       && EVP_DecryptUpdate(ctx, nullptr, &len, bytes(aad.constData()), aad.size()) == 1
+	       && EVP_DecryptUpdate(ctx, o, &len, bytes(sealed.constData()), bodySize) == 1;
+	const int total = len;
+	ok = ok && EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_GCM_SET_TAG, kTagBytes, tag.data()) == 1
+	     && EVP_DecryptFinal_ex(ctx, o + total, &len) == 1;
+	EVP_CIPHER_CTX_free(ctx);
+	if (!ok) {
+		secureWipe(plain->data(), size_t(plain->size()));
+		plain->clear();
+	}
+	return ok;
+}
+
+// Creates path holding key, readable by its owner only from the first byte
+// on: there is no moment at which the umask or an inherited ACL applies.
+// False if the file already exists or can't be written.
+bool createKeyFile(const QString &path, const QByteArray &key)
+{
+#ifdef Q_OS_WIN
+	// Protected DACL with a single entry: full access for the owner
+	PSECURITY_DESCRIPTOR sd = nullptr;
+	if (!ConvertStringSecurityDescriptorToSecurityDescriptorW(L"D:P(A;;FA;;;OW)", SDDL_REVISION_1, &sd, nullptr)) return false;
+	SECURITY_ATTRIBUTES sa{};
+	sa.nLength = sizeof sa;
+	sa.lpSecurityDescriptor = sd;
+	const std::wstring wpath = QDir::toNativeSeparators(path).toStdWString();
+	HANDLE h = CreateFileW(wpath.c_str(), GENERIC_WRITE, 0, &sa, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+	LocalFree(sd);
+	if (h == INVALID_HANDLE_VALUE) return false;
+	DWORD written = 0;
+	const bool ok = WriteFile(h, key.constData(), DWORD(key.size()), &written, nullptr) && int(written) == key.size()
+	             && FlushFileBuffers(h);
+	CloseHandle(h);
+#else
+	const QByteArray native = QFile::encodeName(path);
+	const int fd = ::open(native.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+	if (fd < 0) return false;
+	ssize_t written;
+	do {
+		written = ::write(fd, key.constData(), size_t(key.size()));
+	} while (written < 0 && errno == EINTR);
+	const bool ok = written == key.size() && ::fsync(fd) == 0;
+	::close(fd);
+#endif
+	if (!ok) QFile::remove(path);
+	return ok;
+}
+
+class FileSecretStore : public SecretStore {
+public:
+	explicit FileSecretStore(const QString &keyFile) : m_keyFile(keyFile) {}
+	QString name() const override { return QStringLiteral("file"); }
+
+	QByteArray protect(const QByteArray &plain) override
+	{
+		if (plain.isEmpty() || !ensureKey()) return QByteArray();
+		QByteArray nonce(kNonceBytes, Qt::Uninitialized);
+		QRandomGenerator::system()->generate(reinterpret_cast<quint32 *>(nonce.data()),
+		                                     reinterpret_cast<quint32 *>(nonce.data() + kNonceBytes));
+		const QByteArray header(1, kFileFormat);
+		const QByteArray sealed = gcmSeal(m_key, nonce, header, plain);
+		if (sealed.isEmpty()) return QByteArray();
+		return (header + nonce + sealed).toBase64();
+	}
+
+	bool unprotect(const QByteArray &stored, SecretBuffer *out) override
+	{
+		if (stored.isEmpty() || !ensureKey()) return false;
+		const QByteArray raw = QByteArray::fromBase64(stored);
+		if (raw.size() <= 1 + kNonceBytes + kTagBytes || raw.at(0) != kFileFormat) return false;
+		QByteArray plain;
+		if (!gcmOpen(m_key, raw.mid(1, kNonceBytes), raw.left(1), raw.mid(1 + kNonceBytes), &plain)) return false;
+		out->assign(plain.constData(), plain.size());
+		secureWipe(plain.data(), size_t(plain.size()));
+		return true;
+	}
+
+private:
+	bool ensureKey()
+	{
+		QMutexLocker lock(&m_mutex);
+		if (!m_key.isEmpty()) return true;
+		QByteArray key;
+		if (!readKeyFile(&key)) {
+			key.resize(kKeyBytes);
+			QRandomGenerator::system()->generate(reinterpret_cast<quint32 *>(key.data()),
+			                                     reinterpret_cast<quint32 *>(key.data() + kKeyBytes));
+			// Another process may have created it first; use theirs
+			if (!createKeyFile(m_keyFile, key)) {
+				secureWipe(key.data(), size_t(key.size()));
+				if (!readKeyFile(&key)) return false;
+			}
+		}
+		if (key.size() != kKeyBytes) {
+			secureWipe(key.data(), size_t(key.size()));
+			return false;
+		}
+		m_key.assign(key.constData(), key.size());
+		secureWipe(key.data(), size_t(key.size()));
+		return true;
+	}
+
+	bool readKeyFile(QByteArray *key) const
+	{
+		QFile f(m_keyFile);
+		if (!f.open(QIODevice::ReadOnly)) return false;
+		*key = f.readAll();
+		return true;
+	}
+
+	QString m_keyFile;
+	QMutex m_mutex;
+	SecretBuffer m_key;
+};
+
+#endif // MPM_HAVE_OPENSSL
+
+} // namespace
+
+std::unique_ptr<SecretStore> createDpapiSecretStore()
+{
+	return std::unique_ptr<SecretStore>(new DpapiSecretStore);
+}
+
+std::unique_ptr<SecretStore> createFileSecretStore(const QString &keyFile)
+{
+#ifdef MPM_HAVE_OPENSSL
+	return std::unique_ptr<SecretStore>(new FileSecretStore(keyFile));
+#else
+	Q_UNUSED(keyFile);
+	return nullptr;
+#endif
+}
+
+SecretStore &defaultSecretStore()
+{
+	static const std::unique_ptr<SecretStore> store = []() {
+#ifdef Q_OS_WIN
+		return createDpapiSecretStore();
+#else
+		QString keyFile = qEnvironmentVariable("MPM_SECRET_KEY_FILE");
+		if (keyFile.isEmpty()) keyFile = QFileInfo(mpmLocateSharedSettingsFile()).absoluteDir().filePath("secret.key");
+		return createFileSecretStore(keyFile);
+#endif
+	}();
+	return *store;
+}
+
+// ---- SecretCache ----
+
+const SecretBuffer &SecretCache::reveal(const QByteArray &stored, bool *changed)
+{
+	const bool hit = m_valid && stored == m_stored;
+	if (changed) *changed = !hit;
+	if (hit) return m_plain;
+	m_plain.clear();
+	m_stored = stored;
+	m_valid = true;
+	if (!stored.isEmpty()) {
+		++m_decrypts;
+		m_store.unprotect(stored, &m_plain);
+	}
+	return m_plain;
+}
+
+void SecretCache::clear()
+{
+	m_plain.clear();
+	m_stored.clear();
+	m_valid = false;
+}
@@ -0,0 +1,89 @@
+#ifndef MPM_SECRET_STORE_H
+#define MPM_SECRET_STORE_H
+
+#include <QByteArray>
+#include <QString>
+#include <memory>
+
+// Overwrites n bytes in a way the compiler can't drop as a dead store
+void secureWipe(void *p, size_t n);
+
+// Holds one decrypted secret in page-locked memory (VirtualLock / mlock, so it
+// is never written to swap) and wipes it on clear() and destruction. Locking
+// is best effort: if the OS refuses, the buffer still works and isLocked()
+// reports false. Move-only.
+class SecretBuffer {
+public:
+	SecretBuffer() = default;
+	~SecretBuffer() { clear(); }
+	SecretBuffer(SecretBuffer &&other) noexcept;
+	SecretBuffer &operator=(SecretBuffer &&other) noexcept;
+	SecretBuffer(const SecretBuffer &) = delete;
+	SecretBuffer &operator=(const SecretBuffer &) = delete;
+
+	void assign(const char *data, int size);
+	void clear();
+	const char *data() const { return m_data; }
+	int size() const { return m_size; }
+	bool isEmpty() const { return m_size == 0; }
+	bool isLocked() const { return m_locked; }
+	bool equals(const char *data, int size) const;
+	// Copies out of locked memory; for APIs such as QMqttClient::setPassword
+	// that only take a QString
+	QString toString() const { return QString::fromUtf8(m_data, m_size); }
+
+private:
+	char *m_data = nullptr;
+	int m_size = 0;
+	size_t m_capacity = 0;
+	bool m_locked = false;
+};
+
+// Turns a secret into the form stored in the INI and back. The stored form
+// is printable (base64), so it can live in QSettings as-is.
+class SecretStore {
+public:
+	virtual ~SecretStore() = default;
+	virtual QString name() const = 0;
+	// Empty on failure
+	virtual QByteArray protect(const QByteArray &plain) = 0;
+	// Decrypts straight into out; false if stored is empty or doesn't decrypt
+	virtual bool unprotect(const QByteArray &stored, SecretBuffer *out) = 0;
+};
+
+// DPAPI, machine scope, so the service can read what the GUI stored. Windows only.
+std::unique_ptr<SecretStore> createDpapiSecretStore();
+// Portable backend for Linux hosts and tests: AES-256-GCM (OpenSSL libcrypto)
+// with a random 96-bit nonce per value, under a random 256-bit key kept in
+// keyFile, created owner-only on first use (mode 0600 or an owner-only DACL
+// from the moment it exists). The key stays in a SecretBuffer. Protects
+// against reading or tampering with the INI alone, not against whoever can
+// read the key file (root, or the daemon's user). Null in builds without
+// OpenSSL (MPM_HAVE_OPENSSL), which Windows uses DPAPI instead of.
+std::unique_ptr<SecretStore> createFileSecretStore(const QString &keyFile);
+
+// Process-wide store: DPAPI on Windows, otherwise a file store keyed by
+// MPM_SECRET_KEY_FILE or "secret.key" next to the shared INI
+SecretStore &defaultSecretStore();
+
+// Decrypts each stored value once and serves the plaintext from locked memory
+// until the stored value changes or the cache is cleared.
+class SecretCache {
+public:
+	explicit SecretCache(SecretStore &store) : m_store(store) {}
+	// Decrypts only if stored differs from the last call; *changed tells whether it did
+	const SecretBuffer &reveal(const QByteArray &stored, bool *changed = nullptr);
+	// Plaintext from the last reveal()
+	const SecretBuffer &current() const { return m_plain; }
+	void clear();
+	quint64 decryptCount() const { return m_decrypts; }
+
+private:
+	SecretStore &m_store;
+	QByteArray m_stored;
+	SecretBuffer m_plain;
+	bool m_valid = false;
+	quint64 m_decrypts = 0;
+};
+
+#endif // MPM_SECRET_STORE_H
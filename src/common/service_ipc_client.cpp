@@ -1,6 +1,8 @@
 #include "service_ipc_client.h"
 #include <QDebug>
 #include <QSettings>
+#include <QCborArray>
+#include <QCborValue>
 #include "settings.h"
 static int g_lastTransport = 0; // 0=none,1=local,2=tcp
 #include "ipc_auth.h"
@@ -12,12 +14,21 @@ QByteArray ServiceIpcClient::sendLocal(const QByteArray &cmd, const QString &nam
 	if (!sock.waitForConnected(timeoutMs)) return QByteArray();
 	const QString token = loadOrCreateIpcToken();
 	QByteArray payload = token.toUtf8(); payload.append('\n'); payload.append(cmd);
+	// The service dispatches once the request is complete: a newline ends a
+	// command, an empty line a batch, even one without commands
+	const bool batch = cmd == "batch" || cmd == "batch-json" || cmd.startsWith("batch\n") || cmd.startsWith("batch-json\n");
+	payload.append(batch ? "\n\n" : "\n");
 	sock.write(payload);
 	sock.flush();
 	sock.waitForBytesWritten(timeoutMs);
 	if (!sock.waitForReadyRead(timeoutMs)) return QByteArray();
 	g_lastTransport = 1;
-	return sock.readAll();
+	// The service closes the connection after replying; larger replies arrive in chunks
+	QByteArray resp = sock.readAll();
+	while (sock.state() == QLocalSocket::ConnectedState && sock.waitForReadyRead(timeoutMs)) {
+		resp.append(sock.readAll());
+	}
+	return resp;
 }
 
 bool ServiceIpcClient::isAvailable(const QString &name)
@@ -60,4 +71,29 @@ int ServiceIpcClient::lastTransport()
 	return g_lastTransport;
 }
 
+QCborMap ServiceIpcClient::sendBatch(const QList<QByteArray> &cmds, const QString &name, int timeoutMs)
+{
+	QByteArray req("batch");
+	for (const QByteArray &c : cmds) { req.append('\n'); req.append(c); }
+	const QByteArray resp = sendLocal(req, name, timeoutMs);
+	if (resp.isEmpty()) return QCborMap();
+	QCborParserError err;
+	const QCborValue v = QCborValue::fromCbor(resp, &err);
+	if (err.error != QCborError::NoError || !v.isMap()) return QCborMap();
+	return v.toMap();
+}
 
+QCborMap ServiceIpcClient::batchResult(const QCborMap &reply, const QString &cmd)
+{
+	const QCborArray results = reply.value(QStringLiteral("results")).toArray();
+	for (const QCborValue &r : results) {
+		const QCborMap m = r.toMap();
+		if (m.value(QStringLiteral("cmd")).toString() != cmd) continue;
+		if (!m.value(QStringLiteral("ok")).toBool()) return QCborMap();
+		QCborMap data = m.value(QStringLiteral("data")).toMap();
+		// Distinguish "ok without data" from "missing"
+		if (data.isEmpty()) data.insert(QStringLiteral("ok"), true);
+		return data;
+	}
+	return QCborMap();
+}
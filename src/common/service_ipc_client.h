@@ -2,19 +2,28 @@
 
 #include <QObject>
 #include <QLocalSocket>
+#include <QCborMap>
+#include "ipc_auth.h"
 
 class ServiceIpcClient : public QObject {
 	Q_OBJECT
 public:
-	static bool isAvailable(const QString &name = QStringLiteral("MPMServiceIpc"));
-	static QByteArray send(const QByteArray &cmd, const QString &name = QStringLiteral("MPMServiceIpc"), int timeoutMs = 1000);
+	static bool isAvailable(const QString &name = mpmIpcServerName());
+	static QByteArray send(const QByteArray &cmd, const QString &name = mpmIpcServerName(), int timeoutMs = 1000);
 
 	// Transport-specific helpers
-	static bool isAvailableLocal(const QString &name = QStringLiteral("MPMServiceIpc"));
-	static QByteArray sendLocal(const QByteArray &cmd, const QString &name = QStringLiteral("MPMServiceIpc"), int timeoutMs = 1000);
+	static bool isAvailableLocal(const QString &name = mpmIpcServerName());
+	static QByteArray sendLocal(const QByteArray &cmd, const QString &name = mpmIpcServerName(), int timeoutMs = 1000);
 	// Local-only now
-	static QByteArray sendPreferred(int preferredOrder, const QByteArray &cmd, const QString &name = QStringLiteral("MPMServiceIpc"), int timeoutMs = 200);
+	static QByteArray sendPreferred(int preferredOrder, const QByteArray &cmd, const QString &name = mpmIpcServerName(), int timeoutMs = 200);
 	static int lastTransport(); // 0=none,1=local
+
+	// Runs several commands in one round-trip. Returns the decoded reply
+	// ({ "v", "results": [...] }) or an empty map if the service does not answer
+	// or predates batch support.
+	static QCborMap sendBatch(const QList<QByteArray> &cmds, const QString &name = mpmIpcServerName(), int timeoutMs = 1000);
+	// Finds the result entry for cmd in a batch reply; empty if missing or failed
+	static QCborMap batchResult(const QCborMap &reply, const QString &cmd);
 };
 
 
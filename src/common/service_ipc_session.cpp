@@ -0,0 +1,210 @@
+#include "service_ipc_session.h"
+#include "ipc_auth.h"
+
+#include <QCborValue>
+#include <QtEndian>
+#include <vector>
+
+static constexpr quint32 kMaxReplyBytes = 16 * 1024 * 1024;
+
+ServiceIpcSession::ServiceIpcSession(const QString &name, QObject *parent)
+	: QObject(parent), m_name(name)
+{
+	m_clock.start();
+	m_socket = new QLocalSocket(this);
+	connect(m_socket, &QLocalSocket::connected, this, &ServiceIpcSession::onConnected);
+	connect(m_socket, &QLocalSocket::disconnected, this, &ServiceIpcSession::onDisconnected);
+	connect(m_socket, &QLocalSocket::readyRead, this, &ServiceIpcSession::onReadyRead);
+	connect(m_socket, &QLocalSocket::errorOccurred, this, &ServiceIpcSession::onSocketError);
+	m_reconnectTimer.setSingleShot(true);
+	m_reconnectTimer.setInterval(1000);
+	connect(&m_reconnectTimer, &QTimer::timeout, this, &ServiceIpcSession::connectNow);
+	m_timeoutTimer.setSingleShot(true);
+	connect(&m_timeoutTimer, &QTimer::timeout, this, &ServiceIpcSession::onTimeoutCheck);
+}
+
+ServiceIpcSession::~ServiceIpcSession()
+{
+	// Owners are being torn down; don't call back into them
+	m_wantOpen = false;
+	QObject::disconnect(m_socket, nullptr, this, nullptr);
+	m_pending.clear();
+	flush();
+}
+
+void ServiceIpcSession::open()
+{
+	m_wantOpen = true;
+	connectNow();
+}
+
+void ServiceIpcSession::close()
+{
+	m_wantOpen = false;
+	m_reconnectTimer.stop();
+	m_socket->abort();
+	setConnected(false);
+	failPending(false);
+}
+
+void ServiceIpcSession::connectNow()
+{
+	if (!m_wantOpen) return;
+	if (m_socket->state() != QLocalSocket::UnconnectedState) return;
+	m_buffer.clear();
+	m_socket->connectToServer(m_name);
+}
+
+void ServiceIpcSession::request(const QByteArray &cmd, ReplyHandler handler)
+{
+	Pending p;
+	p.cmd = cmd;
+	p.handler = std::move(handler);
+	p.deadlineMs = m_clock.elapsed() + m_requestTimeoutMs;
+	m_pending.push_back(std::move(p));
+	if (m_connected) {
+		sendUnsent();
+	} else {
+		// Try right away instead of waiting for the reconnect backoff
+		m_wantOpen = true;
+		m_reconnectTimer.stop();
+		connectNow();
+	}
+	armTimeout();
+}
+
+void ServiceIpcSession::requestBatch(const QList<QByteArray> &cmds, BatchHandler handler)
+{
+	QByteArray req("batch");
+	for (const QByteArray &c : cmds) { req.append('\n'); req.append(c); }
+	request(req, [handler](bool ok, const QByteArray &reply) {
+		if (!handler) return;
+		if (!ok) { handler(false, QCborMap()); return; }
+		QCborParserError err;
+		const QCborValue v = QCborValue::fromCbor(reply, &err);
+		if (err.error != QCborError::NoError || !v.isMap()) { handler(false, QCborMap()); return; }
+		handler(true, v.toMap());
+	});
+}
+
+void ServiceIpcSession::flush()
+{
+	if (m_socket->state() == QLocalSocket::ConnectedState) m_socket->flush();
+}
+
+void ServiceIpcSession::onConnected()
+{
+	if (m_token.isEmpty()) m_token = loadOrCreateIpcToken().toUtf8();
+	QByteArray hello = m_token;
+	hello.append("\nsession\n");
+	m_socket->write(hello);
+	setConnected(true);
+	sendUnsent();
+	armTimeout();
+}
+
+void ServiceIpcSession::onDisconnected()
+{
+	setConnected(false);
+	m_buffer.clear();
+	// Re-read the token next time in case the service regenerated it
+	m_token.clear();
+	// Requests already on the wire will never be answered
+	failPending(true);
+	if (m_wantOpen) m_reconnectTimer.start();
+}
+
+void ServiceIpcSession::onSocketError(QLocalSocket::LocalSocketError error)
+{
+	Q_UNUSED(error);
+	// Errors on an established session are followed by disconnected()
+	if (m_connected) return;
+	emit connectFailed();
+	failPending(false);
+	if (m_wantOpen) m_reconnectTimer.start();
+}
+
+void ServiceIpcSession::onReadyRead()
+{
+	m_buffer.append(m_socket->readAll());
+	while (m_buffer.size() >= 4) {
+		const quint32 len = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(m_buffer.constData()));
+		if (len > kMaxReplyBytes || m_pending.empty() || !m_pending.front().sent) {
+			// Not our framing (e.g. "unauthorized") or an unsolicited reply
+			m_socket->abort();
+			return;
+		}
+		if (m_buffer.size() < 4 + int(len)) break;
+		const QByteArray reply = m_buffer.mid(4, int(len));
+		m_buffer.remove(0, 4 + int(len));
+		Pending p = std::move(m_pending.front());
+		m_pending.pop_front();
+		if (p.handler) p.handler(true, reply);
+	}
+	armTimeout();
+}
+
+void ServiceIpcSession::onTimeoutCheck()
+{
+	const qint64 now = m_clock.elapsed();
+	bool sentExpired = false;
+	for (auto it = m_pending.begin(); it != m_pending.end();) {
+		if (it->deadlineMs > now) { ++it; continue; }
+		if (it->sent) { sentExpired = true; ++it; continue; }
+		ReplyHandler h = std::move(it->handler);
+		it = m_pending.erase(it);
+		if (h) QMetaObject::invokeMethod(this, [h]() { h(false, QByteArray()); }, Qt::QueuedConnection);
+	}
+	if (sentExpired) {
+		// Replies are matched in order, so a lost one desynchronises the stream
+		m_socket->abort();
+	}
+	armTimeout();
+}
+
+void ServiceIpcSession::writeFrame(const QByteArray &payload)
+{
+	uchar header[4];
+	qToBigEndian<quint32>(quint32(payload.size()), header);
+	m_socket->write(reinterpret_cast<const char *>(header), 4);
+	m_socket->write(payload);
+}
+
+void ServiceIpcSession::sendUnsent()
+{
+	for (Pending &p : m_pending) {
+		if (p.sent) continue;
+		writeFrame(p.cmd);
+		p.sent = true;
+	}
+}
+
+void ServiceIpcSession::failPending(bool sentOnly)
+{
+	std::vector<ReplyHandler> failed;
+	for (auto it = m_pending.begin(); it != m_pending.end();) {
+		if (sentOnly && !it->sent) { ++it; continue; }
+		failed.push_back(std::move(it->handler));
+		it = m_pending.erase(it);
+	}
+	// Always report asynchronously so callers never re-enter from request()
+	for (ReplyHandler &h : failed) {
+		if (h) QMetaObject::invokeMethod(this, [h]() { h(false, QByteArray()); }, Qt::QueuedConnection);
+	}
+	armTimeout();
+}
+
+void ServiceIpcSession::armTimeout()
+{
+	if (m_pending.empty()) { m_timeoutTimer.stop(); return; }
+	qint64 next = m_pending.front().deadlineMs;
+	for (const Pending &p : m_pending) next = qMin(next, p.deadlineMs);
+	m_timeoutTimer.start(int(qMax<qint64>(0, next - m_clock.elapsed())));
+}
+
+void ServiceIpcSession::setConnected(bool connected)
+{
+	if (m_connected == connected) return;
+	m_connected = connected;
+	emit connectedChanged(connected);
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QObject>
+#include <QLocalSocket>
+#include <QCborMap>
+#include "ipc_auth.h"
+#include <QElapsedTimer>
+#include <QTimer>
+#include <functional>
+#include <deque>
+
+// Non-blocking client for the service IPC endpoint. Keeps one persistent
+// session open, pipelines requests over it, fails requests that exceed their
+// timeout and reconnects in the background. Safe to use from the GUI thread:
+// nothing here waits on the socket.
+class ServiceIpcSession : public QObject {
+	Q_OBJECT
+public:
+	using ReplyHandler = std::function<void(bool ok, const QByteArray &reply)>;
+	using BatchHandler = std::function<void(bool ok, const QCborMap &reply)>;
+
+	explicit ServiceIpcSession(const QString &name = mpmIpcServerName(), QObject *parent = nullptr);
+	~ServiceIpcSession() override;
+
+	void setRequestTimeout(int ms) { m_requestTimeoutMs = qMax(1, ms); }
+	void setReconnectInterval(int ms) { m_reconnectTimer.setInterval(qMax(50, ms)); }
+	bool isConnected() const { return m_connected; }
+
+	// Starts connecting; afterwards the session reconnects on its own until close()
+	void open();
+	void close();
+
+	// Queues cmd; the handler runs exactly once, with ok=false on timeout or
+	// when the service is unreachable
+	void request(const QByteArray &cmd, ReplyHandler handler = ReplyHandler());
+	// Structured variant of the "batch" command (see IpcServer)
+	void requestBatch(const QList<QByteArray> &cmds, BatchHandler handler);
+	// Pushes queued bytes to the socket without waiting; used right before exit
+	void flush();
+
+signals:
+	void connectedChanged(bool connected);
+	// A connection attempt failed (service not running or refused)
+	void connectFailed();
+
+private slots:
+	void onConnected();
+	void onDisconnected();
+	void onReadyRead();
+	void onSocketError(QLocalSocket::LocalSocketError error);
+	void onTimeoutCheck();
+
+private:
+	struct Pending {
+		QByteArray cmd;
+		ReplyHandler handler;
+		qint64 deadlineMs = 0;
+		bool sent = false;
+	};
+
+	void connectNow();
+	void writeFrame(const QByteArray &payload);
+	void sendUnsent();
+	void failPending(bool sentOnly);
+	void armTimeout();
+	void setConnected(bool connected);
+
+	QString m_name;
+	QLocalSocket *m_socket = nullptr;
+	QTimer m_reconnectTimer;
+	QTimer m_timeoutTimer;
+	QElapsedTimer m_clock;
+	std::deque<Pending> m_pending;
+	QByteArray m_buffer;
+	QByteArray m_token;
+	int m_requestTimeoutMs = 1000;
+	bool m_connected = false;
+	bool m_wantOpen = false;
+};
@@ -1,22 +1,62 @@
 #include "settings.h"
+#include "log_categories.h"
 
 #include <QDir>
 #include <QStandardPaths>
 #include <QCoreApplication>
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
+#include <QDebug>
+#ifdef Q_OS_WIN
 #include <windows.h>
 #include <Aclapi.h>
 #include <AccCtrl.h>
 #include <WtsApi32.h>
 #include <ShlObj.h>
+#endif
 
-QString mpmSharedSettingsFilePath()
+namespace {
+
+// Where the INI lives; no directories, files or ACLs are touched
+QString resolveSettingsFilePath()
 {
-	// Cache result to avoid repeated Windows API calls and debug spam
-	static QString s_cachedPath;
-	if (!s_cachedPath.isEmpty()) return s_cachedPath;
+	// Explicit override (benchmarks, tests, non-default installs)
+	const QString overridePath = qEnvironmentVariable("MPM_SETTINGS_PATH");
+	if (!overridePath.isEmpty()) return QFileInfo(overridePath).absoluteFilePath();
+#ifndef Q_OS_WIN
+	// Non-Windows builds keep the INI under the generic config location
+	return QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation) + "/MPM/MqttPowerManager.ini";
+#else
+	// Resolve ProgramData
+	QString programData;
+	{
+		PWSTR wpath = nullptr;
+		HRESULT hr = SHGetKnownFolderPath(FOLDERID_ProgramData, 0, nullptr, &wpath);
+		if (SUCCEEDED(hr) && wpath) {
+			programData = QString::fromWCharArray(wpath);
+			CoTaskMemFree(wpath);
+		}
+	}
+	if (programData.isEmpty()) {
+		wchar_t buffer[MAX_PATH];
+		DWORD size = MAX_PATH;
+		if (GetEnvironmentVariableW(L"PROGRAMDATA", buffer, size) > 0) {
+			programData = QString::fromWCharArray(buffer);
+		}
+	}
+	if (programData.isEmpty()) {
+		programData = QString::fromWCharArray(L"C:/ProgramData");
+	}
+
+	return QDir(programData + "/MPM").filePath("MqttPowerManager.ini");
+#endif
+}
 
+#ifdef Q_OS_WIN
+// Creates the directory and INI and grants Authenticated Users modify rights
+QString prepareSharedSettingsFile(const QString &targetPath)
+{
 	// Helper to grant modify rights to Authenticated Users on a file or directory
 	auto ensureWritableByAuthenticatedUsers = [](const QString &path, bool isDirectory) {
 		PSID sid = nullptr;
@@ -55,32 +95,10 @@ QString mpmSharedSettingsFilePath()
 		if (pSD) LocalFree(pSD);
 	};
 
-	// Resolve ProgramData
-	QString programData;
-	{
-		PWSTR wpath = nullptr;
-		HRESULT hr = SHGetKnownFolderPath(FOLDERID_ProgramData, 0, nullptr, &wpath);
-		if (SUCCEEDED(hr) && wpath) {
-			programData = QString::fromWCharArray(wpath);
-			CoTaskMemFree(wpath);
-		}
-	}
-	if (programData.isEmpty()) {
-		wchar_t buffer[MAX_PATH];
-		DWORD size = MAX_PATH;
-		if (GetEnvironmentVariableW(L"PROGRAMDATA", buffer, size) > 0) {
-			programData = QString::fromWCharArray(buffer);
-		}
-	}
-	if (programData.isEmpty()) {
-		programData = QString::fromWCharArray(L"C:/ProgramData");
-	}
-
-	QDir pd(programData + "/MPM");
+	QDir pd = QFileInfo(targetPath).absoluteDir();
 	pd.mkpath(".");
 	ensureWritableByAuthenticatedUsers(pd.path(), true);
 
-	const QString targetPath = pd.filePath("MqttPowerManager.ini");
 	if (!QFile::exists(targetPath)) {
 		QFile f(targetPath);
 		if (f.open(QIODevice::WriteOnly)) {
@@ -90,10 +108,35 @@ QString mpmSharedSettingsFilePath()
 	}
 	ensureWritableByAuthenticatedUsers(targetPath, false);
 
-	s_cachedPath = targetPath;
+	qCDebug(lcSettings) << "[Settings] Using settings file path:" << targetPath;
+	return targetPath;
+}
+#endif
 
-	qDebug() << "[Settings] Using settings file path:" << s_cachedPath;
-	return s_cachedPath;
+} // namespace
+
+QString mpmLocateSharedSettingsFile()
+{
+	static const QString s_path = resolveSettingsFilePath();
+	return s_path;
 }
 
+QString mpmSharedSettingsFilePath()
+{
+	// Cache result to avoid repeated Windows API calls and debug spam
+	static QString s_cachedPath;
+	if (!s_cachedPath.isEmpty()) return s_cachedPath;
 
+	const QString targetPath = mpmLocateSharedSettingsFile();
+#ifdef Q_OS_WIN
+	// Overridden locations are left as the caller set them up
+	if (qEnvironmentVariableIsEmpty("MPM_SETTINGS_PATH")) {
+		s_cachedPath = prepareSharedSettingsFile(targetPath);
+		return s_cachedPath;
+	}
+#endif
+	QFileInfo(targetPath).absoluteDir().mkpath(".");
+	s_cachedPath = targetPath;
+	qCDebug(lcSettings) << "[Settings] Using settings file path:" << s_cachedPath;
+	return s_cachedPath;
+}
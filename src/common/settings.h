@@ -9,6 +9,10 @@
 // permissions to modify the INI.
 QString mpmSharedSettingsFilePath();
 
+// Same path, resolved without creating anything or adjusting ACLs. For
+// read-only fast paths that must not wait for the setup above.
+QString mpmLocateSharedSettingsFile();
+
 // Convenience to construct QSettings bound to the shared INI file.
 inline QSettings mpmCreateSharedSettings()
 {
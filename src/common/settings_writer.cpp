@@ -0,0 +1,135 @@
+#include "settings_writer.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <QSettings>
+
+namespace {
+
+// INI values come back as strings; compare typed values through their text form
+bool sameValue(const QVariant &a, const QVariant &b)
+{
+	if (a.isValid() != b.isValid()) return false;
+	if (a.userType() == b.userType()) return a == b;
+	if (a.userType() == QMetaType::QByteArray || b.userType() == QMetaType::QByteArray) return a.toByteArray() == b.toByteArray();
+	return a.toString() == b.toString();
+}
+
+bool sameArray(QSettings &S, const QString &name, const QList<QVariantMap> &rows)
+{
+	const int size = S.beginReadArray(name);
+	bool same = size == rows.size();
+	for (int i = 0; same && i < size; ++i) {
+		S.setArrayIndex(i);
+		const QVariantMap &row = rows.at(i);
+		same = S.childKeys().size() == row.size();
+		for (auto it = row.cbegin(); same && it != row.cend(); ++it) same = sameValue(S.value(it.key()), it.value());
+	}
+	S.endArray();
+	return same;
+}
+
+} // namespace
+
+SettingsWriter::SettingsWriter(const QString &path, QObject *parent)
+	: QObject(parent)
+	, m_path(path)
+{
+	m_debounce.setSingleShot(true);
+	m_debounce.setInterval(300);
+	connect(&m_debounce, &QTimer::timeout, this, [this]() { commit(); });
+}
+
+SettingsWriter::~SettingsWriter()
+{
+	if (hasPendingChanges()) commit();
+}
+
+void SettingsWriter::setValue(const QString &key, const QVariant &value)
+{
+	m_values.insert(key, value);
+	m_debounce.start();
+}
+
+void SettingsWriter::remove(const QString &key)
+{
+	m_values.insert(key, QVariant());
+	m_debounce.start();
+}
+
+void SettingsWriter::setArray(const QString &name, const QList<QVariantMap> &rows)
+{
+	m_arrays.insert(name, rows);
+	m_debounce.start();
+}
+
+bool SettingsWriter::commit()
+{
+	m_debounce.stop();
+	if (!hasPendingChanges()) return true;
+
+	// QSettings can only write to a path, so edit a scratch copy of the file and
+	// publish its bytes with QSaveFile, which replaces the INI by rename
+	const QString scratch = m_path + QStringLiteral(".pending");
+	QFile::remove(scratch);
+	if (QFile::exists(m_path) && !QFile::copy(m_path, scratch)) {
+		emit commitFailed(QStringLiteral("cannot copy %1").arg(m_path));
+		return false;
+	}
+	QStringList changed;
+	{
+		QSettings S(scratch, QSettings::IniFormat);
+		for (auto it = m_values.cbegin(); it != m_values.cend(); ++it) {
+			const QVariant current = S.value(it.key());
+			if (!it.value().isValid()) {
+				if (!S.contains(it.key())) continue;
+				S.remove(it.key());
+			} else if (S.contains(it.key()) && sameValue(current, it.value())) {
+				continue;
+			} else {
+				S.setValue(it.key(), it.value());
+			}
+			changed << it.key();
+		}
+		for (auto it = m_arrays.cbegin(); it != m_arrays.cend(); ++it) {
+			if (sameArray(S, it.key(), it.value())) continue;
+			// Drop old rows first; a shorter array would otherwise leave them behind
+			S.remove(it.key());
+			S.beginWriteArray(it.key(), it.value().size());
+			for (int i = 0; i < it.value().size(); ++i) {
+				S.setArrayIndex(i);
+				const QVariantMap &row = it.value().at(i);
+				for (auto f = row.cbegin(); f != row.cend(); ++f) S.setValue(f.key(), f.value());
+			}
+			S.endArray();
+			changed << it.key();
+		}
+		S.sync();
+		if (S.status() != QSettings::NoError) {
+			QFile::remove(scratch);
+			emit commitFailed(QStringLiteral("cannot write %1").arg(scratch));
+			return false;
+		}
+	}
+	if (changed.isEmpty()) {
+		QFile::remove(scratch);
+		m_values.clear();
+		m_arrays.clear();
+		return true;
+	}
+
+	QFile in(scratch);
+	QSaveFile out(m_path);
+	const bool ok = in.open(QIODevice::ReadOnly) && out.open(QIODevice::WriteOnly)
+	                && out.write(in.readAll()) >= 0 && out.commit();
+	in.close();
+	QFile::remove(scratch);
+	if (!ok) {
+		emit commitFailed(QStringLiteral("cannot replace %1: %2").arg(m_path, out.errorString()));
+		return false;
+	}
+	m_values.clear();
+	m_arrays.clear();
+	emit committed(changed);
+	return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QVariant>
+#include <QVariantMap>
+
+// Batches GUI edits to the shared INI. Changes are staged in memory and
+// written together once no further change arrives for the debounce interval
+// (or on commit()). Each commit applies only the keys whose value differs from
+// what is on disk and replaces the file in one rename, so a reader such as the
+// service never sees a half-written INI. committed() fires once per commit that
+// changed something; nothing is written when nothing changed.
+class SettingsWriter : public QObject {
+	Q_OBJECT
+public:
+	explicit SettingsWriter(const QString &path, QObject *parent = nullptr);
+	// Commits anything still pending
+	~SettingsWriter() override;
+
+	void setDebounceInterval(int ms) { m_debounce.setInterval(qMax(0, ms)); }
+
+	void setValue(const QString &key, const QVariant &value);
+	void remove(const QString &key);
+	// Replaces a QSettings array ("name/size", "name/N/field") with rows
+	void setArray(const QString &name, const QList<QVariantMap> &rows);
+	bool hasPendingChanges() const { return !m_values.isEmpty() || !m_arrays.isEmpty(); }
+
+	// Writes staged changes now. Returns false if the file could not be replaced;
+	// the changes then stay staged for the next attempt.
+	bool commit();
+
+signals:
+	void committed(const QStringList &changedKeys);
+	void commitFailed(const QString &error);
+
+private:
+	QString m_path;
+	QTimer m_debounce;
+	QMap<QString, QVariant> m_values;   // invalid QVariant = remove
+	QMap<QString, QList<QVariantMap>> m_arrays;
+};
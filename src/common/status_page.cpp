@@ -0,0 +1,301 @@
+#include "status_page.h"
+
+#include <QDebug>
+#include <QThread>
+#include <atomic>
+#include <string>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <sddl.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr quint32 kMagic = 0x4D504D53; // 'MPMS'
+constexpr quint32 kVersion = 2;   // 2: actionsSimulated, actionsInvalid
+constexpr int kCounterCount = 7;
+
+// Shared layout. Every field is an atomic so concurrent reads are well defined;
+// consistency across fields comes from the seqlock (odd seq = write in progress).
+struct PageLayout {
+	std::atomic<quint32> magic;
+	std::atomic<quint32> version;
+	std::atomic<quint32> seq;
+	std::atomic<quint32> generation;
+	std::atomic<qint64> pid;
+	std::atomic<qint64> heartbeatMs;
+	std::atomic<qint32> state;
+	std::atomic<qint32> flags; // bit0=reconnectActive, bit1=autoReconnect, bit2=userInitiated
+	std::atomic<qint32> lastError;
+	std::atomic<qint32> reserved;
+	std::atomic<quint64> counters[kCounterCount];
+};
+
+static_assert(std::atomic<quint64>::is_always_lock_free, "status page requires lock-free 64-bit atomics");
+static_assert(std::atomic<qint64>::is_always_lock_free, "status page requires lock-free 64-bit atomics");
+
+constexpr qint64 kPageSize = 4096;
+static_assert(sizeof(PageLayout) <= kPageSize, "status page layout exceeds one page");
+
+#ifdef Q_OS_WIN
+std::wstring globalName(const QString &name) { return (QStringLiteral("Global\\") + name).toStdWString(); }
+std::wstring localName(const QString &name) { return (QStringLiteral("Local\\") + name).toStdWString(); }
+#else
+QByteArray shmName(const QString &name) { return QByteArray("/") + name.toUtf8(); }
+#endif
+
+} // namespace
+
+QString mpmStatusPageName()
+{
+	// Overridable so benchmarks and side-by-side instances don't share a page
+	const QString overrideName = qEnvironmentVariable("MPM_STATUS_PAGE");
+	return overrideName.isEmpty() ? QStringLiteral("MPMServiceStatus") : overrideName;
+}
+
+struct StatusPageWriter::Impl {
+	PageLayout *page = nullptr;
+#ifdef Q_OS_WIN
+	HANDLE mapping = nullptr;
+#endif
+};
+
+StatusPageWriter::StatusPageWriter() : d(new Impl) {}
+
+StatusPageWriter::~StatusPageWriter()
+{
+	close();
+	delete d;
+}
+
+bool StatusPageWriter::open(const QString &name)
+{
+	if (d->page) return true;
+	void *view = nullptr;
+#ifdef Q_OS_WIN
+	// SYSTEM/Administrators full access, Authenticated Users read-only
+	PSECURITY_DESCRIPTOR sd = nullptr;
+	SECURITY_ATTRIBUTES sa{};
+	sa.nLength = sizeof(sa);
+	if (ConvertStringSecurityDescriptorToSecurityDescriptorW(L"D:(A;;GA;;;SY)(A;;GA;;;BA)(A;;GR;;;AU)", SDDL_REVISION_1, &sd, nullptr)) {
+		sa.lpSecurityDescriptor = sd;
+	}
+	const std::wstring global = globalName(name);
+	d->mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, sd ? &sa : nullptr, PAGE_READWRITE, 0, DWORD(kPageSize), global.c_str());
+	if (!d->mapping) {
+		// Console runs without SeCreateGlobalPrivilege land in the session namespace
+		const std::wstring local = localName(name);
+		d->mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, sd ? &sa : nullptr, PAGE_READWRITE, 0, DWORD(kPageSize), local.c_str());
+	}
+	if (sd) LocalFree(sd);
+	if (!d->mapping) {
+		qWarning() << "Status page: CreateFileMapping failed, err=" << GetLastError();
+		return false;
+	}
+	view = MapViewOfFile(d->mapping, FILE_MAP_ALL_ACCESS, 0, 0, SIZE_T(kPageSize));
+	if (!view) {
+		qWarning() << "Status page: MapViewOfFile failed, err=" << GetLastError();
+		CloseHandle(d->mapping);
+		d->mapping = nullptr;
+		return false;
+	}
+#else
+	const QByteArray n = shmName(name);
+	const int fd = ::shm_open(n.constData(), O_CREAT | O_RDWR, 0644);
+	if (fd < 0) {
+		qWarning() << "Status page: shm_open failed for" << name;
+		return false;
+	}
+	if (::ftruncate(fd, kPageSize) != 0) {
+		::close(fd);
+		qWarning() << "Status page: ftruncate failed for" << name;
+		return false;
+	}
+	view = ::mmap(nullptr, size_t(kPageSize), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED) {
+		qWarning() << "Status page: mmap failed for" << name;
+		return false;
+	}
+#endif
+	d->page = static_cast<PageLayout *>(view);
+	// A page left behind by a previous run keeps its seq; start from an even value
+	const quint32 seq = d->page->seq.load(std::memory_order_relaxed);
+	d->page->seq.store(seq & ~1u, std::memory_order_relaxed);
+	d->page->version.store(kVersion, std::memory_order_relaxed);
+	d->page->magic.store(kMagic, std::memory_order_release);
+	return true;
+}
+
+bool StatusPageWriter::isOpen() const
+{
+	return d->page != nullptr;
+}
+
+void StatusPageWriter::publish(const ServiceStatusSnapshot &s)
+{
+	PageLayout *p = d->page;
+	if (!p) return;
+	const quint32 seq = p->seq.load(std::memory_order_relaxed);
+	p->seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	p->generation.store(p->generation.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	p->pid.store(s.pid, std::memory_order_relaxed);
+	p->heartbeatMs.store(s.heartbeatMs, std::memory_order_relaxed);
+	p->state.store(s.state, std::memory_order_relaxed);
+	const qint32 flags = (s.reconnectActive ? 1 : 0) | (s.autoReconnect ? 2 : 0) | (s.userInitiated ? 4 : 0);
+	p->flags.store(flags, std::memory_order_relaxed);
+	p->lastError.store(s.lastError, std::memory_order_relaxed);
+	p->counters[0].store(s.messagesReceived, std::memory_order_relaxed);
+	p->counters[1].store(s.messagesIgnored, std::memory_order_relaxed);
+	p->counters[2].store(s.actionsExecuted, std::memory_order_relaxed);
+	p->counters[3].store(s.actionsFailed, std::memory_order_relaxed);
+	p->counters[4].store(s.connects, std::memory_order_relaxed);
+	p->counters[5].store(s.actionsSimulated, std::memory_order_relaxed);
+	p->counters[6].store(s.actionsInvalid, std::memory_order_relaxed);
+	p->seq.store(seq + 2, std::memory_order_release);
+}
+
+void StatusPageWriter::heartbeat(qint64 heartbeatMs)
+{
+	PageLayout *p = d->page;
+	if (!p) return;
+	const quint32 seq = p->seq.load(std::memory_order_relaxed);
+	p->seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	p->heartbeatMs.store(heartbeatMs, std::memory_order_relaxed);
+	p->seq.store(seq + 2, std::memory_order_release);
+}
+
+void StatusPageWriter::close()
+{
+	if (!d->page) return;
+	ServiceStatusSnapshot gone;
+	publish(gone);
+#ifdef Q_OS_WIN
+	UnmapViewOfFile(d->page);
+	if (d->mapping) CloseHandle(d->mapping);
+	d->mapping = nullptr;
+#else
+	::munmap(d->page, size_t(kPageSize));
+#endif
+	d->page = nullptr;
+}
+
+struct StatusPageReader::Impl {
+	const PageLayout *page = nullptr;
+#ifdef Q_OS_WIN
+	HANDLE mapping = nullptr;
+#endif
+};
+
+StatusPageReader::StatusPageReader() : d(new Impl) {}
+
+StatusPageReader::~StatusPageReader()
+{
+	detach();
+	delete d;
+}
+
+bool StatusPageReader::attach(const QString &name)
+{
+	if (d->page) return true;
+	const void *view = nullptr;
+#ifdef Q_OS_WIN
+	const std::wstring global = globalName(name);
+	d->mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, global.c_str());
+	if (!d->mapping) {
+		const std::wstring local = localName(name);
+		d->mapping = OpenFileMappingW(FILE_MAP_READ, FALSE, local.c_str());
+	}
+	if (!d->mapping) return false;
+	view = MapViewOfFile(d->mapping, FILE_MAP_READ, 0, 0, SIZE_T(kPageSize));
+	if (!view) {
+		CloseHandle(d->mapping);
+		d->mapping = nullptr;
+		return false;
+	}
+#else
+	const QByteArray n = shmName(name);
+	const int fd = ::shm_open(n.constData(), O_RDONLY, 0);
+	if (fd < 0) return false;
+	void *m = ::mmap(nullptr, size_t(kPageSize), PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (m == MAP_FAILED) return false;
+	view = m;
+#endif
+	d->page = static_cast<const PageLayout *>(view);
+	if (d->page->magic.load(std::memory_order_acquire) != kMagic
+	    || d->page->version.load(std::memory_order_relaxed) != kVersion) {
+		detach();
+		return false;
+	}
+	return true;
+}
+
+bool StatusPageReader::isAttached() const
+{
+	return d->page != nullptr;
+}
+
+void StatusPageReader::detach()
+{
+	if (!d->page) return;
+#ifdef Q_OS_WIN
+	UnmapViewOfFile(d->page);
+	if (d->mapping) CloseHandle(d->mapping);
+	d->mapping = nullptr;
+#else
+	::munmap(const_cast<PageLayout *>(d->page), size_t(kPageSize));
+#endif
+	d->page = nullptr;
+}
+
+bool StatusPageReader::read(ServiceStatusSnapshot *out) const
+{
+	const PageLayout *p = d->page;
+	if (!p || !out) return false;
+	for (int attempt = 0; attempt < 100; ++attempt) {
+		const quint32 before = p->seq.load(std::memory_order_acquire);
+		if (before & 1u) {
+			// Writer is mid-update; it only stores a handful of words
+			if (attempt > 10) QThread::yieldCurrentThread();
+			continue;
+		}
+		ServiceStatusSnapshot s;
+		s.generation = p->generation.load(std::memory_order_relaxed);
+		s.pid = p->pid.load(std::memory_order_relaxed);
+		s.heartbeatMs = p->heartbeatMs.load(std::memory_order_relaxed);
+		s.state = p->state.load(std::memory_order_relaxed);
+		const qint32 flags = p->flags.load(std::memory_order_relaxed);
+		s.reconnectActive = flags & 1;
+		s.autoReconnect = flags & 2;
+		s.userInitiated = flags & 4;
+		s.lastError = p->lastError.load(std::memory_order_relaxed);
+		s.messagesReceived = p->counters[0].load(std::memory_order_relaxed);
+		s.messagesIgnored = p->counters[1].load(std::memory_order_relaxed);
+		s.actionsExecuted = p->counters[2].load(std::memory_order_relaxed);
+		s.actionsFailed = p->counters[3].load(std::memory_order_relaxed);
+		s.connects = p->counters[4].load(std::memory_order_relaxed);
+		s.actionsSimulated = p->counters[5].load(std::memory_order_relaxed);
+		s.actionsInvalid = p->counters[6].load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (p->seq.load(std::memory_order_relaxed) == before) {
+			*out = s;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool StatusPageReader::isStale(const ServiceStatusSnapshot &s, qint64 nowMs, int maxAgeMs)
+{
+	if (s.pid == 0) return true;
+	return nowMs - s.heartbeatMs > maxAgeMs;
+}
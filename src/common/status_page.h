@@ -0,0 +1,67 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+// Fields the service publishes into the shared status page. Readers get a
+// consistent copy of all fields via StatusPageReader::read().
+struct ServiceStatusSnapshot {
+	quint32 generation = 0;   // bumped on every publish; unchanged means nothing new
+	qint64 pid = 0;           // 0 once the service has closed the page
+	qint64 heartbeatMs = 0;   // msecs since epoch of the last publish or heartbeat
+	int state = 0;            // QMqttClient::ClientState
+	bool reconnectActive = false;
+	bool autoReconnect = false;
+	bool userInitiated = false;
+	int lastError = 0;        // QMqttClient::ClientError
+	quint64 messagesReceived = 0;
+	quint64 messagesIgnored = 0;
+	quint64 actionsExecuted = 0;
+	quint64 actionsFailed = 0;
+	quint64 connects = 0;
+	quint64 actionsSimulated = 0;   // print-only dry runs; not in actionsExecuted
+	quint64 actionsInvalid = 0;     // configured actions that never match (bad template)
+};
+
+// Default name of the status page. On Windows the service creates it in the
+// Global\ namespace and falls back to Local\ for console runs.
+QString mpmStatusPageName();
+
+// Service side: creates the page and publishes snapshots under a seqlock.
+class StatusPageWriter {
+public:
+	StatusPageWriter();
+	~StatusPageWriter();
+	bool open(const QString &name = mpmStatusPageName());
+	bool isOpen() const;
+	void publish(const ServiceStatusSnapshot &s);
+	// Refreshes heartbeatMs only; generation stays, so readers see nothing new
+	void heartbeat(qint64 heartbeatMs);
+	// Marks the page as abandoned (pid=0) and unmaps it
+	void close();
+
+private:
+	Q_DISABLE_COPY(StatusPageWriter)
+	struct Impl;
+	Impl *d;
+};
+
+// Observer side: maps the page read-only. read() never blocks and never
+// enters the kernel once attached.
+class StatusPageReader {
+public:
+	StatusPageReader();
+	~StatusPageReader();
+	bool attach(const QString &name = mpmStatusPageName());
+	bool isAttached() const;
+	void detach();
+	// Returns false if not attached or no consistent snapshot could be taken
+	bool read(ServiceStatusSnapshot *out) const;
+	// A page is stale when the writer closed it or stopped heartbeating
+	static bool isStale(const ServiceStatusSnapshot &s, qint64 nowMs, int maxAgeMs = 5000);
+
+private:
+	Q_DISABLE_COPY(StatusPageReader)
+	struct Impl;
+	Impl *d;
+};
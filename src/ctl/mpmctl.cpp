@@ -0,0 +1,328 @@
+// mpmctl: command-line controller for the MPM service.
+//
+//   mpmctl status [--json]        current state and counters
+//   mpmctl logs [--follow]        print captured service log lines, optionally keep polling
+//   mpmctl reload                 re-read the shared settings file
+//   mpmctl connect | disconnect
+//   mpmctl run <action name>      execute a configured action by name
+//   mpmctl log-level <cat> <lvl>  e.g. "log-level mpm.dispatch debug"; log-levels lists them
+//   mpmctl --watch                stream state changes until interrupted
+//   mpmctl --batch                read the commands above from stdin, one per line,
+//                                 and answer each over one persistent session
+//
+// Status reads come from the shared status page when the service publishes one,
+// everything else goes over the IPC session. Exit code is 0 on success, 1 when
+// the service refused a command or could not be reached, 2 on usage errors.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCborArray>
+#include <QCborValue>
+#include <QDateTime>
+#include <QEventLoop>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <QTimer>
+
+#include "common/service_ipc_session.h"
+#include "common/service_ipc_client.h"
+#include "common/status_page.h"
+
+namespace {
+
+const char *stateName(int state)
+{
+	// QMqttClient::ClientState
+	switch (state) {
+	case 0: return "Disconnected";
+	case 1: return "Connecting";
+	case 2: return "Connected";
+	default: return "Unknown";
+	}
+}
+
+QString formatStatus(const ServiceStatusSnapshot &s)
+{
+	return QStringLiteral("state=%1 reconnectActive=%2 autoReconnect=%3 userInitiated=%4 lastError=%5 "
+	                      "received=%6 ignored=%7 executed=%8 failed=%9 connects=%10 simulated=%11 invalid=%12")
+		.arg(QString::fromLatin1(stateName(s.state)))
+		.arg(int(s.reconnectActive)).arg(int(s.autoReconnect)).arg(int(s.userInitiated))
+		.arg(s.lastError)
+		.arg(s.messagesReceived).arg(s.messagesIgnored).arg(s.actionsExecuted).arg(s.actionsFailed)
+		.arg(s.connects).arg(s.actionsSimulated).arg(s.actionsInvalid);
+}
+
+QByteArray statusJson(const ServiceStatusSnapshot &s)
+{
+	QJsonObject o;
+	o.insert("state", s.state);
+	o.insert("stateName", QString::fromLatin1(stateName(s.state)));
+	o.insert("reconnectActive", s.reconnectActive);
+	o.insert("autoReconnect", s.autoReconnect);
+	o.insert("userInitiated", s.userInitiated);
+	o.insert("lastError", s.lastError);
+	o.insert("messagesReceived", qint64(s.messagesReceived));
+	o.insert("messagesIgnored", qint64(s.messagesIgnored));
+	o.insert("actionsExecuted", qint64(s.actionsExecuted));
+	o.insert("actionsFailed", qint64(s.actionsFailed));
+	o.insert("connects", qint64(s.connects));
+	o.insert("actionsSimulated", qint64(s.actionsSimulated));
+	o.insert("actionsInvalid", qint64(s.actionsInvalid));
+	return QJsonDocument(o).toJson(QJsonDocument::Compact);
+}
+
+bool sameState(const ServiceStatusSnapshot &a, const ServiceStatusSnapshot &b)
+{
+	return a.state == b.state && a.reconnectActive == b.reconnectActive
+	    && a.autoReconnect == b.autoReconnect && a.userInitiated == b.userInitiated
+	    && a.lastError == b.lastError;
+}
+
+// Translates a CLI verb into the service's IPC command; empty for unknown verbs
+QByteArray protocolCommand(const QStringList &words)
+{
+	if (words.isEmpty()) return QByteArray();
+	const QString verb = words.first().toLower();
+	// Cursor 0 asks for the recent tail, not the oldest lines still buffered
+	if (verb == "logs") return QByteArrayLiteral("logs-since 0");
+	if (verb == "reload") return QByteArrayLiteral("reload-settings");
+	if (verb == "connect" || verb == "disconnect") return verb.toUtf8();
+	if (verb == "run" && words.size() > 1) return "run-action " + words.mid(1).join(' ').toUtf8();
+	if (verb == "log-level" && words.size() == 3) return "log-level " + words.mid(1).join(' ').toUtf8();
+	if (verb == "log-levels") return QByteArrayLiteral("log-levels");
+	return QByteArray();
+}
+
+void sleepMs(int ms)
+{
+	QEventLoop loop;
+	QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+	loop.exec();
+}
+
+// The session is asynchronous; a CLI simply waits for each answer in turn
+class Controller {
+public:
+	Controller(const QString &serverName, int timeoutMs)
+		: m_session(serverName)
+	{
+		m_session.setRequestTimeout(timeoutMs);
+	}
+
+	bool request(const QByteArray &cmd, QByteArray *reply)
+	{
+		QEventLoop loop;
+		bool done = false;
+		bool ok = false;
+		m_session.request(cmd, [&](bool r, const QByteArray &data) {
+			ok = r;
+			if (reply) *reply = data;
+			done = true;
+			loop.quit();
+		});
+		if (!done) loop.exec();
+		return ok;
+	}
+
+	bool status(ServiceStatusSnapshot *out, bool allowPage = true)
+	{
+		// Shared page first: no round trip to the service at all
+		if (allowPage && (m_page.isAttached() || m_page.attach())) {
+			ServiceStatusSnapshot s;
+			if (m_page.read(&s) && !StatusPageReader::isStale(s, QDateTime::currentMSecsSinceEpoch())) {
+				*out = s;
+				return true;
+			}
+			m_page.detach();
+		}
+		QByteArray raw;
+		if (!request(QByteArrayLiteral("batch\nstatus\ncounters"), &raw)) return false;
+		const QCborValue v = QCborValue::fromCbor(raw);
+		if (!v.isMap()) return false;
+		const QCborMap st = ServiceIpcClient::batchResult(v.toMap(), QStringLiteral("status"));
+		if (st.isEmpty()) return false;
+		const QCborMap c = ServiceIpcClient::batchResult(v.toMap(), QStringLiteral("counters"));
+		ServiceStatusSnapshot s;
+		s.state = int(st.value(QStringLiteral("state")).toInteger());
+		s.reconnectActive = st.value(QStringLiteral("reconnectActive")).toBool();
+		s.autoReconnect = st.value(QStringLiteral("autoReconnect")).toBool();
+		s.userInitiated = st.value(QStringLiteral("userInitiated")).toBool();
+		s.lastError = int(st.value(QStringLiteral("lastError")).toInteger());
+		s.messagesReceived = quint64(c.value(QStringLiteral("messagesReceived")).toInteger());
+		s.messagesIgnored = quint64(c.value(QStringLiteral("messagesIgnored")).toInteger());
+		s.actionsExecuted = quint64(c.value(QStringLiteral("actionsExecuted")).toInteger());
+		s.actionsFailed = quint64(c.value(QStringLiteral("actionsFailed")).toInteger());
+		s.connects = quint64(c.value(QStringLiteral("connects")).toInteger());
+		s.actionsSimulated = quint64(c.value(QStringLiteral("actionsSimulated")).toInteger());
+		s.actionsInvalid = quint64(st.value(QStringLiteral("invalidActions")).toArray().size());
+		*out = s;
+		return true;
+	}
+
+	// Runs one CLI command line and prints its answer; returns the exit code
+	int run(const QStringList &words, bool json, QTextStream &out, QTextStream &err)
+	{
+		if (words.isEmpty()) return 0;
+		if (words.first().compare("status", Qt::CaseInsensitive) == 0) {
+			ServiceStatusSnapshot s;
+			if (!status(&s)) {
+				err << "mpmctl: service not reachable\n";
+				err.flush();
+				return 1;
+			}
+			out << (json ? QString::fromUtf8(statusJson(s)) : formatStatus(s)) << "\n";
+			out.flush();
+			return 0;
+		}
+		const QByteArray cmd = protocolCommand(words);
+		if (cmd.isEmpty()) {
+			err << "mpmctl: unknown command: " << words.join(' ') << "\n";
+			err.flush();
+			return 2;
+		}
+		QByteArray reply;
+		if (!request(cmd, &reply)) {
+			err << "mpmctl: service not reachable\n";
+			err.flush();
+			return 1;
+		}
+		if (cmd.startsWith("logs-since ")) {
+			quint64 cursor = 0;
+			printLogs(reply, &cursor, out);
+		} else {
+			out << QString::fromUtf8(reply.trimmed()) << "\n";
+		}
+		out.flush();
+		return reply.trimmed() == "err" ? 1 : 0;
+	}
+
+	// Prints a "logs-since" reply and advances the cursor; false if malformed
+	static bool printLogs(const QByteArray &reply, quint64 *cursor, QTextStream &out)
+	{
+		const int nl = reply.indexOf('\n');
+		if (nl < 0) return false;
+		bool ok = false;
+		const quint64 next = reply.left(nl).split(' ').value(0).toULongLong(&ok);
+		if (!ok) return false;
+		*cursor = next;
+		const QByteArray text = reply.mid(nl + 1);
+		out << QString::fromUtf8(text);
+		if (!text.isEmpty() && !text.endsWith('\n')) out << "\n";
+		return true;
+	}
+
+	int followLogs(QTextStream &out, QTextStream &err)
+	{
+		quint64 cursor = 0;
+		for (;;) {
+			QByteArray reply;
+			if (request("logs-since " + QByteArray::number(cursor), &reply)) {
+				printLogs(reply, &cursor, out);
+				out.flush();
+			} else {
+				err << "mpmctl: service not reachable, retrying\n";
+				err.flush();
+			}
+			sleepMs(500);
+		}
+	}
+
+	int watch(bool json, QTextStream &out)
+	{
+		bool haveLast = false;
+		bool wasDown = false;
+		ServiceStatusSnapshot last;
+		for (;;) {
+			ServiceStatusSnapshot s;
+			const QString stamp = QDateTime::currentDateTime().toString(Qt::ISODateWithMs);
+			if (!status(&s)) {
+				if (!wasDown) {
+					out << stamp << " service=unreachable\n";
+					out.flush();
+				}
+				wasDown = true;
+				haveLast = false;
+			} else if (!haveLast || wasDown || !sameState(s, last)) {
+				out << stamp << ' ' << (json ? QString::fromUtf8(statusJson(s)) : formatStatus(s)) << "\n";
+				out.flush();
+				last = s;
+				haveLast = true;
+				wasDown = false;
+			}
+			// The page is polled cheaply; without it each tick is one IPC round trip
+			sleepMs(m_page.isAttached() ? 100 : 500);
+		}
+	}
+
+	int batch(bool json, QTextStream &in, QTextStream &out, QTextStream &err)
+	{
+		int rc = 0;
+		QString line;
+		while (in.readLineInto(&line)) {
+			line = line.trimmed();
+			if (line.isEmpty() || line.startsWith('#')) continue;
+			const QStringList words = line.split(' ', Qt::SkipEmptyParts);
+			if (words.first().compare("status", Qt::CaseInsensitive) == 0) {
+				// Scripts in batch mode expect answers from the session, not the page
+				ServiceStatusSnapshot s;
+				if (!status(&s, false)) {
+					out << "err\n";
+					out.flush();
+					rc = 1;
+					continue;
+				}
+				out << (json ? QString::fromUtf8(statusJson(s)) : formatStatus(s)) << "\n";
+				out.flush();
+				continue;
+			}
+			const int r = run(words, json, out, err);
+			if (r != 0) rc = r;
+		}
+		return rc;
+	}
+
+private:
+	ServiceIpcSession m_session;
+	StatusPageReader m_page;
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("mpmctl");
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Command-line controller for the MQTT Power Manager service");
+	parser.addHelpOption();
+	QCommandLineOption watchOpt("watch", "Stream state changes until interrupted.");
+	QCommandLineOption batchOpt("batch", "Read commands from stdin, one per line, over one session.");
+	QCommandLineOption followOpt({"f", "follow"}, "With 'logs': keep printing new lines.");
+	QCommandLineOption jsonOpt("json", "Print status as JSON.");
+	QCommandLineOption serverOpt("server", "IPC endpoint name or socket path.", "NAME", mpmIpcServerName());
+	QCommandLineOption timeoutOpt("timeout", "Per-request timeout in milliseconds.", "MS", "2000");
+	parser.addOptions({watchOpt, batchOpt, followOpt, jsonOpt, serverOpt, timeoutOpt});
+	parser.addPositionalArgument("command", "status | logs | reload | connect | disconnect | run <action> | log-level <category> <level> | log-levels");
+	parser.process(app);
+
+	QTextStream out(stdout);
+	QTextStream err(stderr);
+	Controller ctl(parser.value(serverOpt), qMax(1, parser.value(timeoutOpt).toInt()));
+	const bool json = parser.isSet(jsonOpt);
+
+	if (parser.isSet(watchOpt)) return ctl.watch(json, out);
+	if (parser.isSet(batchOpt)) {
+		QTextStream in(stdin);
+		return ctl.batch(json, in, out, err);
+	}
+	const QStringList args = parser.positionalArguments();
+	if (args.isEmpty()) {
+		err << parser.helpText();
+		return 2;
+	}
+	if (parser.isSet(followOpt) && args.first().compare("logs", Qt::CaseInsensitive) == 0) {
+		return ctl.followLogs(out, err);
+	}
+	return ctl.run(args, json, out, err);
+}
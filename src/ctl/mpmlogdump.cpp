@@ -0,0 +1,157 @@
+// mpmlogdump: renders the service's binary log (see BinaryLogWriter).
+//
+//   mpmlogdump [--since TIME] [--until TIME] [--category PREFIX]... [--level LEVEL]
+//              [--json] [FILE]
+//
+// TIME is ISO 8601 local time (2024-05-01T12:00:00) or a number of seconds
+// back from now (e.g. 600). FILE defaults to the service's binlog. The file
+// can be copied from a crashed host and decoded anywhere.
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTextStream>
+#include <limits>
+
+#include "common/binary_log.h"
+#include "service/service_logging.h"
+
+namespace {
+
+const char *levelName(int level)
+{
+	switch (level) {
+	case QtDebugMsg: return "DEBUG";
+	case QtInfoMsg: return "INFO";
+	case QtWarningMsg: return "WARN";
+	case QtCriticalMsg: return "ERROR";
+	case QtFatalMsg: return "FATAL";
+	}
+	return "?";
+}
+
+int severity(int level)
+{
+	switch (level) {
+	case QtDebugMsg: return 0;
+	case QtInfoMsg: return 1;
+	case QtWarningMsg: return 2;
+	case QtCriticalMsg: return 3;
+	case QtFatalMsg: return 4;
+	}
+	return 1;
+}
+
+int severityFromName(const QString &name)
+{
+	const QString n = name.toLower();
+	if (n == "debug") return 0;
+	if (n == "info") return 1;
+	if (n == "warn" || n == "warning") return 2;
+	if (n == "error" || n == "critical") return 3;
+	if (n == "fatal") return 4;
+	return -1;
+}
+
+// Returns msecs since epoch, or -1 if the value can't be parsed
+qint64 parseTime(const QString &value)
+{
+	bool isNumber = false;
+	const qint64 secondsBack = value.toLongLong(&isNumber);
+	if (isNumber) return QDateTime::currentMSecsSinceEpoch() - secondsBack * 1000;
+	const QDateTime dt = QDateTime::fromString(value, Qt::ISODate);
+	return dt.isValid() ? dt.toMSecsSinceEpoch() : -1;
+}
+
+QString renderText(const BinaryLogRecord &r)
+{
+	QString line = QString("%1 [%2] %3: %4")
+		.arg(QDateTime::fromMSecsSinceEpoch(r.timestampMs).toString(Qt::ISODateWithMs))
+		.arg(QLatin1String(levelName(r.level)))
+		.arg(r.category.isEmpty() ? QStringLiteral("default") : r.category)
+		.arg(r.message);
+	for (const auto &f : r.fields) {
+		QString v = f.second.toString();
+		if (f.second.userType() == QMetaType::QString && (v.contains(' ') || v.isEmpty())) v = '"' + v + '"';
+		line += QString(" %1=%2").arg(f.first, v);
+	}
+	return line;
+}
+
+QJsonObject renderJson(const BinaryLogRecord &r)
+{
+	QJsonObject o;
+	o.insert("ts", QDateTime::fromMSecsSinceEpoch(r.timestampMs).toString(Qt::ISODateWithMs));
+	o.insert("level", QLatin1String(levelName(r.level)));
+	o.insert("category", r.category);
+	o.insert("message", r.message);
+	QJsonObject fields;
+	for (const auto &f : r.fields) fields.insert(f.first, QJsonValue::fromVariant(f.second));
+	if (!fields.isEmpty()) o.insert("fields", fields);
+	return o;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("mpmlogdump");
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Decode the MPM service binary log");
+	parser.addHelpOption();
+	QCommandLineOption sinceOpt("since", "Only records at or after TIME.", "TIME");
+	QCommandLineOption untilOpt("until", "Only records before TIME.", "TIME");
+	QCommandLineOption categoryOpt("category", "Only categories starting with PREFIX (repeatable).", "PREFIX");
+	QCommandLineOption levelOpt("level", "Minimum level: debug, info, warn, error, fatal.", "LEVEL");
+	QCommandLineOption jsonOpt("json", "One JSON object per line.");
+	parser.addOptions({sinceOpt, untilOpt, categoryOpt, levelOpt, jsonOpt});
+	parser.addPositionalArgument("file", "Binary log file.", "[FILE]");
+	parser.process(app);
+
+	QTextStream out(stdout);
+	QTextStream err(stderr);
+	qint64 since = std::numeric_limits<qint64>::min();
+	qint64 until = std::numeric_limits<qint64>::max();
+	if (parser.isSet(sinceOpt) && (since = parseTime(parser.value(sinceOpt))) < 0) {
+		err << "mpmlogdump: cannot parse --since\n";
+		return 2;
+	}
+	if (parser.isSet(untilOpt) && (until = parseTime(parser.value(untilOpt))) < 0) {
+		err << "mpmlogdump: cannot parse --until\n";
+		return 2;
+	}
+	int minSeverity = 0;
+	if (parser.isSet(levelOpt) && (minSeverity = severityFromName(parser.value(levelOpt))) < 0) {
+		err << "mpmlogdump: unknown level " << parser.value(levelOpt) << "\n";
+		return 2;
+	}
+	const QStringList categories = parser.values(categoryOpt);
+	const QStringList files = parser.positionalArguments();
+	const QString path = files.isEmpty() ? serviceLogFilePath(".binlog") : files.first();
+
+	BinaryLogReader reader;
+	QString error;
+	if (!reader.load(path, &error)) {
+		err << "mpmlogdump: " << path << ": " << error << "\n";
+		return 1;
+	}
+	const bool json = parser.isSet(jsonOpt);
+	for (const BinaryLogRecord &r : reader.records()) {
+		if (r.timestampMs < since || r.timestampMs >= until) continue;
+		if (severity(r.level) < minSeverity) continue;
+		if (!categories.isEmpty()) {
+			bool match = false;
+			for (const QString &c : categories) match = match || r.category.startsWith(c);
+			if (!match) continue;
+		}
+		if (json) out << QJsonDocument(renderJson(r)).toJson(QJsonDocument::Compact) << "\n";
+		else out << renderText(r) << "\n";
+	}
+	if (reader.corruptRegions() > 0) {
+		err << "mpmlogdump: skipped " << reader.corruptRegions() << " torn or overwritten region(s)\n";
+	}
+	return 0;
+}
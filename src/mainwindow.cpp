@@ -23,13 +23,15 @@
 #include <QSettings>
 #include "common/settings.h"
 #include "common/service_ipc_client.h"
-#include "common/crypto_win.h"
+#include "common/service_ipc_session.h"
 #include <QSystemTrayIcon>
 #include <QAction>
 #include <QComboBox>
 #include <QCheckBox>
 #include <QSpinBox>
 #include <QSessionManager>
+#include <QDateTime>
+#include <QCborMap>
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -37,6 +39,11 @@ MainWindow::MainWindow(QWidget *parent)
     , m_settings(mpmSharedSettingsFilePath(), QSettings::IniFormat)
 {
     ui->setupUi(this);
+    m_settingsWriter = new SettingsWriter(m_settings.fileName(), this);
+    connect(m_settingsWriter, &SettingsWriter::committed, this, &MainWindow::onSettingsCommitted);
+    connect(m_settingsWriter, &SettingsWriter::commitFailed, this, [this](const QString &error) {
+        log("Failed to save settings: " + error);
+    });
 
     // Base app icon from resources
     setWindowIcon(QIcon(":/assets/mpm_white.png"));
@@ -119,120 +126,44 @@ MainWindow::MainWindow(QWidget *parent)
     // Load service-only preference
     const bool serviceOnly = m_settings.value("service/useOnly", false).toBool();
     if (ui->checkBoxServiceUseOnly) ui->checkBoxServiceUseOnly->setChecked(serviceOnly);
+    // Service IPC: one persistent, non-blocking session. Local socket connects
+    // complete immediately when the service is up, so no waiting is needed here.
+    m_ipc = new ServiceIpcSession(mpmIpcServerName(), this);
+    m_ipc->setRequestTimeout(500);
+    connect(m_ipc, &ServiceIpcSession::connectedChanged, this, [this](bool connected) {
+        if (!connected) return;
+        // Service came up later: take it over if service-only is enabled or we already control it
+        const bool serviceOnlyNow = ui && ui->checkBoxServiceUseOnly && ui->checkBoxServiceUseOnly->isChecked();
+        if (!serviceOnlyNow && !m_isControllingService) return;
+        if (ui->pushButtonConnect && !ui->pushButtonConnect->isEnabled()) {
+            ui->pushButtonConnect->setEnabled(true);
+            ui->pushButtonConnect->setToolTip("");
+            log(QString("Service became available via Local"));
+        }
+        if (ui->labelConnSource) ui->labelConnSource->setText("Source: Service (Local)");
+        m_isControllingService = true;
+    });
+    m_ipc->open();
     // If service IPC is available or service-only is enabled, control service instead of local client
-    const bool serviceAvailable = ServiceIpcClient::isAvailable();
+    const bool serviceAvailable = m_ipc->isConnected();
     if (serviceAvailable || serviceOnly) {
         log("Service detected: GUI will control service connection");
         m_isControllingService = true;
-        // Apply preferred IPC; small wait for preferred transport
-        bool localNow = false;
-        if (m_preferredIpc == 1) {
-            for (int i = 0; i < 5; ++i) { if (ServiceIpcClient::isAvailableLocal()) { localNow = true; break; } QThread::msleep(100); }
-        } else if (m_preferredIpc == 2) {
-            localNow = false;
-        } else {
-            for (int i = 0; i < 3; ++i) { if (ServiceIpcClient::isAvailableLocal()) { localNow = true; break; } QThread::msleep(100); }
-        }
         m_prevServiceLocal = true;
         const QString srcText = QString("Source: Service (Local)");
         if (ui->labelConnSource) ui->labelConnSource->setText(srcText);
         log(QString("IPC transport: Local"));
-        // Mirror service status into GUI periodically
-        QTimer *poll = new QTimer(this);
-        poll->setInterval(1000);
-        connect(poll, &QTimer::timeout, this, [this]() {
-            // Reflect current transport by the last used sender path
-            // Try to query service every tick; if it fails repeatedly, UI will reflect via miss counter below
-            QByteArray resp = ServiceIpcClient::sendPreferred(m_preferredIpc, QByteArrayLiteral("status2"), QStringLiteral("MPMServiceIpc"), 200);
-            if (resp.isEmpty()) {
-                resp = ServiceIpcClient::sendPreferred(m_preferredIpc, QByteArrayLiteral("status"), QStringLiteral("MPMServiceIpc"), 200);
-            }
-            if (!resp.isEmpty()) {
-                m_serviceMissCount = 0;
-                bool ok = false;
-                QMqttClient::ClientState rawState = QMqttClient::Disconnected;
-                bool recoActive = false;
-                bool userDisc = false;
-                const QString s = QString::fromUtf8(resp);
-                const QStringList parts = s.split(',');
-                if (parts.size() >= 1) {
-                    int v = parts[0].toInt(&ok);
-                    if (ok) rawState = static_cast<QMqttClient::ClientState>(v);
-                }
-                if (parts.size() >= 2) {
-                    recoActive = (parts[1].trimmed() == QLatin1String("1"));
-                }
-                if (parts.size() >= 4) {
-                    userDisc = (parts[3].trimmed() == QLatin1String("1"));
-                }
-                // Fallback when only simple status returned
-                m_serviceState = rawState;
-                m_serviceReconnectActive = recoActive;
-                m_serviceUserInitiated = userDisc;
-
-                // Compute effective state for UI: show Connecting when auto-reconnect loop is active
-                QMqttClient::ClientState effectiveState = m_serviceState;
-                if (m_serviceState == QMqttClient::Disconnected && m_serviceReconnectActive && !m_serviceUserInitiated) {
-                    effectiveState = QMqttClient::Connecting;
-                }
-
-                if (true) {
-                    updateStatusLabel(effectiveState);
-                    updateTrayIconByState();
-                    if (ui->labelConnSource) ui->labelConnSource->setText("Source: Service (Local)");
-                    if (ui && ui->pushButtonConnect) {
-                        switch (effectiveState) {
-                        case QMqttClient::Connected: ui->pushButtonConnect->setText("Disconnect"); break;
-                        case QMqttClient::Connecting: ui->pushButtonConnect->setText("Connecting.."); break;
-                        case QMqttClient::Disconnected: default: ui->pushButtonConnect->setText("Connect"); break;
-                        }
-                    }
-                }
-            } else {
-                // Missed status response
-                m_serviceMissCount = qMin(m_serviceMissCount + 1, 10);
-                if (m_serviceMissCount >= 3) {
-                    if (ui->labelConnSource) ui->labelConnSource->setText("Source: Service (Unavailable)");
-                    updateStatusLabel(QMqttClient::Disconnected);
-                    updateTrayIconByState();
-                    if (ui && ui->pushButtonConnect) ui->pushButtonConnect->setText("Connect");
-                }
-            }
-            static int tick = 0; tick = (tick + 1) % 3;
-            if (tick == 0) {
-                const QByteArray logs = ServiceIpcClient::sendPreferred(m_preferredIpc, QByteArrayLiteral("getlogs"), QStringLiteral("MPMServiceIpc"), 200);
-                if (!logs.isEmpty()) {
-                    const QString s = QString::fromUtf8(logs);
-                    if (!s.trimmed().isEmpty()) ui->textEditLog->append(s.trimmed());
-                }
-            }
-        });
-        poll->start();
         // If user forces service-only but service isn't available, avoid lag: disable connect
         if (serviceOnly && !serviceAvailable && ui && ui->pushButtonConnect) {
             ui->pushButtonConnect->setEnabled(false);
             ui->pushButtonConnect->setToolTip("Service-only mode enabled but service is not available");
         }
     }
-    // If service-only is enabled and service becomes available later, re-enable Connect and switch source label
-    QTimer *svcAvailPoll = new QTimer(this);
-    svcAvailPoll->setInterval(1000);
-    connect(svcAvailPoll, &QTimer::timeout, this, [this]() {
-        const int lt = ServiceIpcClient::lastTransport();
-        const bool local = (lt == 1) ? true : ServiceIpcClient::isAvailableLocal();
-        if (ui && ui->checkBoxServiceUseOnly && ui->checkBoxServiceUseOnly->isChecked()) {
-            if (local) {
-                if (ui->pushButtonConnect && !ui->pushButtonConnect->isEnabled()) {
-                    ui->pushButtonConnect->setEnabled(true);
-                    ui->pushButtonConnect->setToolTip("");
-                    log(QString("Service became available via Local"));
-                }
-                if (ui->labelConnSource) ui->labelConnSource->setText("Source: Service (Local)");
-                m_isControllingService = true;
-            }
-        }
-    });
-    svcAvailPoll->start();
+    // Mirror service status into GUI periodically
+    QTimer *poll = new QTimer(this);
+    poll->setInterval(1000);
+    connect(poll, &QTimer::timeout, this, &MainWindow::pollServiceStatus);
+    poll->start();
 
     ensureTray();
     // Ensure registry startup reflects setting
@@ -319,24 +250,24 @@ MainWindow::MainWindow(QWidget *parent)
     if (ui->comboBoxStartMode) {
         connect(ui->comboBoxStartMode, qOverload<int>(&QComboBox::currentIndexChanged), this, [this](int idx){
             m_startPromptMode = qBound(0, idx, 2);
-            m_settings.setValue("service/startPromptMode", m_startPromptMode);
+            m_settingsWriter->setValue("service/startPromptMode", m_startPromptMode);
         });
     }
     if (ui->comboBoxStopMode) {
         connect(ui->comboBoxStopMode, qOverload<int>(&QComboBox::currentIndexChanged), this, [this](int idx){
             m_stopPromptMode = qBound(0, idx, 2);
-            m_settings.setValue("service/stopPromptMode", m_stopPromptMode);
+            m_settingsWriter->setValue("service/stopPromptMode", m_stopPromptMode);
         });
     }
     // TCP-related UI elements removed; default to Local-only
     if (ui->checkBoxServiceUseOnly) {
         connect(ui->checkBoxServiceUseOnly, &QCheckBox::toggled, this, [this](bool on){
-            m_settings.setValue("service/useOnly", on);
+            m_settingsWriter->setValue("service/useOnly", on);
             if (on) {
                 m_isControllingService = true;
                 log("Service-only mode enabled: GUI MQTT disabled");
                 // Disable GUI connect if service not available to prevent lag
-                if (!ServiceIpcClient::isAvailable() && ui && ui->pushButtonConnect) {
+                if (!m_ipc->isConnected() && ui && ui->pushButtonConnect) {
                     ui->pushButtonConnect->setEnabled(false);
                     ui->pushButtonConnect->setToolTip("Service-only mode: service not available");
                 }
@@ -354,6 +285,9 @@ MainWindow::MainWindow(QWidget *parent)
 
 MainWindow::~MainWindow()
 {
+    // Flush pending edits while the window can still handle the notification
+    m_settingsWriter->commit();
+    disconnect(m_settingsWriter, nullptr, this, nullptr);
     delete ui;
 }
 
@@ -362,3 +296,83 @@ void MainWindow::log(const QString &msg)
     ui->textEditLog->append(msg);
 }
 
+void MainWindow::pollServiceStatus()
+{
+    if (!m_isControllingService) return;
+    // Prefer the shared status page: no socket round-trip, and the generation
+    // counter lets us skip UI work when nothing changed
+    if (!m_statusPage.isAttached()) m_statusPage.attach();
+    ServiceStatusSnapshot snap;
+    if (m_statusPage.isAttached() && m_statusPage.read(&snap)
+        && !StatusPageReader::isStale(snap, QDateTime::currentMSecsSinceEpoch())) {
+        m_serviceMissCount = 0;
+        if (snap.generation != m_lastStatusGeneration) {
+            m_lastStatusGeneration = snap.generation;
+            applyServiceStatus(static_cast<QMqttClient::ClientState>(snap.state), snap.reconnectActive, snap.userInitiated);
+        }
+    } else if (!m_statusRequestInFlight) {
+        // Page missing or abandoned (service restarted/died): reattach next tick, poll over IPC meanwhile
+        m_statusPage.detach();
+        m_lastStatusGeneration = 0;
+        m_statusRequestInFlight = true;
+        m_ipc->requestBatch({QByteArrayLiteral("status")}, [this](bool ok, const QCborMap &reply) {
+            m_statusRequestInFlight = false;
+            const QCborMap status = ok ? ServiceIpcClient::batchResult(reply, QStringLiteral("status")) : QCborMap();
+            if (!status.isEmpty()) {
+                m_serviceMissCount = 0;
+                applyServiceStatus(static_cast<QMqttClient::ClientState>(status.value(QStringLiteral("state")).toInteger()),
+                                   status.value(QStringLiteral("reconnectActive")).toBool(),
+                                   status.value(QStringLiteral("userInitiated")).toBool());
+                return;
+            }
+            // Missed status response
+            m_serviceMissCount = qMin(m_serviceMissCount + 1, 10);
+            if (m_serviceMissCount >= 3) {
+                if (ui->labelConnSource) ui->labelConnSource->setText("Source: Service (Unavailable)");
+                updateStatusLabel(QMqttClient::Disconnected);
+                updateTrayIconByState();
+                if (ui && ui->pushButtonConnect) ui->pushButtonConnect->setText("Connect");
+            }
+        });
+    }
+    m_logPollTick = (m_logPollTick + 1) % 3;
+    if (m_logPollTick == 0 && m_ipc->isConnected()) {
+        // Cursor reads leave the lines in place for other observers such as mpmctl
+        m_ipc->request("logs-since " + QByteArray::number(m_logCursor), [this](bool ok, const QByteArray &reply) {
+            if (!ok) return;
+            const int nl = reply.indexOf('\n');
+            if (nl < 0) return;
+            bool cursorOk = false;
+            const quint64 cursor = reply.left(nl).split(' ').value(0).toULongLong(&cursorOk);
+            if (!cursorOk) return;
+            m_logCursor = cursor;
+            const QString s = QString::fromUtf8(reply.mid(nl + 1));
+            if (!s.trimmed().isEmpty()) ui->textEditLog->append(s.trimmed());
+        });
+    }
+}
+
+void MainWindow::applyServiceStatus(QMqttClient::ClientState state, bool reconnectActive, bool userInitiated)
+{
+    m_serviceState = state;
+    m_serviceReconnectActive = reconnectActive;
+    m_serviceUserInitiated = userInitiated;
+
+    // Compute effective state for UI: show Connecting when auto-reconnect loop is active
+    QMqttClient::ClientState effectiveState = m_serviceState;
+    if (m_serviceState == QMqttClient::Disconnected && m_serviceReconnectActive && !m_serviceUserInitiated) {
+        effectiveState = QMqttClient::Connecting;
+    }
+
+    updateStatusLabel(effectiveState);
+    updateTrayIconByState();
+    if (ui->labelConnSource) ui->labelConnSource->setText("Source: Service (Local)");
+    if (ui && ui->pushButtonConnect) {
+        switch (effectiveState) {
+        case QMqttClient::Connected: ui->pushButtonConnect->setText("Disconnect"); break;
+        case QMqttClient::Connecting: ui->pushButtonConnect->setText("Connecting.."); break;
+        case QMqttClient::Disconnected: default: ui->pushButtonConnect->setText("Connect"); break;
+        }
+    }
+}
+
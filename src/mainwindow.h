@@ -10,12 +10,20 @@
 #include <QAction>
 #include <QVector>
 #include <QCloseEvent>
+#include <memory>
 #include "actions/actions.h"
+#include "actions/dispatcher.h"
+#include "actions/backend.h"
+#include "common/status_page.h"
+#include "common/settings_writer.h"
+#include "common/secret_store.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
 QT_END_NAMESPACE
 
+class ServiceIpcSession;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -48,7 +56,9 @@ private:
     QMqttClient *m_client = nullptr;
     QTimer m_connectTimeoutTimer;
     QTimer m_reconnectTimer;
-    QSettings m_settings;
+    QSettings m_settings;                       // reads; writes go through m_settingsWriter
+    SettingsWriter *m_settingsWriter = nullptr;
+    SecretCache m_passwordCache{defaultSecretStore()};
     bool m_userInitiatedDisconnect = false;
     bool m_isControllingService = false;
     QMqttClient::ClientState m_serviceState = QMqttClient::Disconnected;
@@ -60,6 +70,14 @@ private:
     bool m_prevServiceLocal = false;
     int m_preferredIpc = 0; // 0=auto,1=local,2=tcp
     int m_serviceMissCount = 0; // consecutive missed status polls
+    StatusPageReader m_statusPage;
+    quint32 m_lastStatusGeneration = 0;
+    ServiceIpcSession *m_ipc = nullptr;
+    bool m_statusRequestInFlight = false;
+    int m_logPollTick = 0;
+    quint64 m_logCursor = 0;
+    void pollServiceStatus();
+    void applyServiceStatus(QMqttClient::ClientState state, bool reconnectActive, bool userInitiated);
 
     // MQTT
     QString getSubscribeTopic() const; // mqttpowermanager/%1/+
@@ -76,15 +94,14 @@ private:
     void updateStatusLabel(QMqttClient::ClientState state, QMqttClient::ClientError error = QMqttClient::NoError);
     void scheduleReconnectIfNeeded();
     void saveAllSettingsForce();
+    void onSettingsCommitted(const QStringList &changedKeys);
 
     // Actions persistence and UI
-    struct UserActionCfg {
-        QString customName;       // Used in MQTT topic suffix
-        ActionType type;          // What to run
-        QString expectedMessage;  // e.g. PRESS
-        QString exePath;          // used when type == OpenExe
-    };
+    using UserActionCfg = ActionConfig;
     QVector<UserActionCfg> m_actions;
+    ActionDispatcher m_dispatcher;  // matches inbound messages against m_actions
+    std::unique_ptr<ActionBackend> m_actionBackend;  // native, or print-only while the box is ticked
+    ActionBackend *actionBackend();
     void loadActions();
     void saveActions();
     void refreshActionsList();
@@ -116,6 +133,7 @@ protected:
     bool isServiceRunning() const;
     bool startService();
     bool stopService();
+    bool stopServiceViaScm();
 };
 
 #endif // MAINWINDOW_H
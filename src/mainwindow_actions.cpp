@@ -11,9 +11,7 @@ void MainWindow::onAddAction()
 {
     ActionDialog dlg(this);
     if (dlg.exec() != QDialog::Accepted) return;
-    const auto res = dlg.getResult();
-    UserActionCfg a{ res.customName, res.type, res.expectedMessage, res.exePath };
-    m_actions.push_back(a);
+    m_actions.push_back(dlg.getResult());
     saveActions();
     refreshActionsList();
 }
@@ -23,11 +21,9 @@ void MainWindow::onEditSelectedAction()
     const int row = ui->listWidgetActions->currentRow();
     if (row < 0 || row >= m_actions.size()) return;
     ActionDialog dlg(this);
-    ActionDialog::Result init{ m_actions[row].customName, m_actions[row].type, m_actions[row].expectedMessage, m_actions[row].exePath };
-    dlg.setInitial(init);
+    dlg.setInitial(m_actions[row]);
     if (dlg.exec() != QDialog::Accepted) return;
-    const auto res = dlg.getResult();
-    m_actions[row] = UserActionCfg{ res.customName, res.type, res.expectedMessage, res.exePath };
+    m_actions[row] = dlg.getResult();
     saveActions();
     refreshActionsList();
 }
@@ -44,35 +40,19 @@ void MainWindow::onDeleteSelectedAction()
 
 void MainWindow::loadActions()
 {
-    m_actions.clear();
-    int size = m_settings.beginReadArray("actions");
-    for (int i = 0; i < size; ++i) {
-        m_settings.setArrayIndex(i);
-        UserActionCfg a;
-        a.customName = m_settings.value("name").toString();
-        a.expectedMessage = m_settings.value("message", "PRESS").toString();
-        a.exePath = m_settings.value("exePath").toString();
-        QString typeStr = m_settings.value("type", "Shutdown").toString();
-        ActionType t;
-        if (!ActionsRegistry::fromString(typeStr, t)) t = ActionType::Shutdown;
-        a.type = t;
-        if (!a.customName.isEmpty()) m_actions.push_back(a);
-    }
-    m_settings.endArray();
+    m_actions = ActionTypeRegistry::instance().readActions(m_settings);
+    m_dispatcher.setActions(m_actions);
+    for (const QString &invalid : m_dispatcher.invalidActions()) log("Action never matches, " + invalid);
     refreshActionsList();
 }
 
 void MainWindow::saveActions()
 {
-    m_settings.beginWriteArray("actions");
-    for (int i = 0; i < m_actions.size(); ++i) {
-        m_settings.setArrayIndex(i);
-        m_settings.setValue("name", m_actions[i].customName);
-        m_settings.setValue("message", m_actions[i].expectedMessage);
-        m_settings.setValue("exePath", m_actions[i].exePath);
-        m_settings.setValue("type", ActionsRegistry::toString(m_actions[i].type));
-    }
-    m_settings.endArray();
+    QList<QVariantMap> rows;
+    rows.reserve(m_actions.size());
+    for (const auto &a : m_actions) rows.push_back(ActionTypeRegistry::toSettingsRow(a));
+    m_settingsWriter->setArray("actions", rows);
+    m_dispatcher.setActions(m_actions);
 }
 
 void MainWindow::refreshActionsList()
@@ -81,8 +61,15 @@ void MainWindow::refreshActionsList()
     const QSignalBlocker blocker(ui->listWidgetActions);
     const int previousRow = ui->listWidgetActions->currentRow();
     ui->listWidgetActions->clear();
-    for (const auto &a : m_actions) {
-        ui->listWidgetActions->addItem(a.customName);
+    for (int i = 0; i < m_actions.size(); ++i) {
+        ui->listWidgetActions->addItem(m_actions[i].customName);
+        // An action that doesn't compile never matches; don't let that go unnoticed
+        const QString error = m_dispatcher.compileError(i);
+        if (error.isEmpty()) continue;
+        QListWidgetItem *item = ui->listWidgetActions->item(ui->listWidgetActions->count() - 1);
+        item->setText(m_actions[i].customName + " (invalid)");
+        item->setForeground(Qt::red);
+        item->setToolTip(error);
     }
     int row = previousRow >= 0 ? previousRow : 0;
     if (row >= ui->listWidgetActions->count()) row = ui->listWidgetActions->count() - 1;
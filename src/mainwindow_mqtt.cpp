@@ -3,26 +3,27 @@
 #include <QTimer>
 #include <QClipboard>
 #include <QApplication>
-#include "common/service_ipc_client.h"
-#include "common/crypto_win.h"
+#include "common/service_ipc_session.h"
+#include "common/secret_store.h"
 #include <QSettings>
 
 void MainWindow::onConnectClicked()
 {
     saveAllSettingsForce();
+    // Flushes now; a resulting reload-settings is queued ahead of "connect"
+    m_settingsWriter->commit();
     applyUiToClient();
 
-    if (m_isControllingService || ServiceIpcClient::isAvailable()) {
+    if (m_isControllingService || m_ipc->isConnected()) {
         m_isControllingService = true;
         const bool effectiveConnecting = (m_serviceState == QMqttClient::Connecting)
             || (m_serviceState == QMqttClient::Disconnected && m_serviceReconnectActive && !m_serviceUserInitiated);
         if (m_serviceState == QMqttClient::Connected || effectiveConnecting) {
             log("Service: disconnect requested");
-            ServiceIpcClient::sendPreferred(m_preferredIpc, QByteArrayLiteral("disconnect"), QStringLiteral("MPMServiceIpc"), 200);
+            m_ipc->request(QByteArrayLiteral("disconnect"));
         } else {
-            ServiceIpcClient::sendPreferred(m_preferredIpc, QByteArrayLiteral("reload-settings"), QStringLiteral("MPMServiceIpc"), 200);
             log("Service: connect requested");
-            ServiceIpcClient::sendPreferred(m_preferredIpc, QByteArrayLiteral("connect"), QStringLiteral("MPMServiceIpc"), 200);
+            m_ipc->request(QByteArrayLiteral("connect"));
         }
         return;
     }
@@ -113,14 +114,8 @@ void MainWindow::onConnectTimeout()
 void MainWindow::onSaveSettingsClicked()
 {
     saveAllSettingsForce();
-    QStringList lines;
-    log("Settings saved");
-
-    if (m_isControllingService || ServiceIpcClient::isAvailable()) {
-        // Push settings and let service hot-apply without disconnecting
-        const QByteArray r = ServiceIpcClient::send("reload-settings");
-        if (r == "ok") log("Service: settings reloaded"); else log("Service: failed to reload settings");
-    }
+    // The service is told through onSettingsCommitted() and hot-applies without disconnecting
+    if (m_settingsWriter->commit()) log("Settings saved");
 }
 
 void MainWindow::scheduleReconnectIfNeeded()
@@ -145,32 +140,37 @@ QString MainWindow::getSubscribeTopic() const
 void MainWindow::onMessageReceived(const QByteArray &message, const QMqttTopicName &topic)
 {
     QString msg = QString::fromUtf8(message);
-    if (topic.name().endsWith("/health")) {
+    // Same matching as the service (ActionDispatcher)
+    const ActionDispatcher::Route route = m_dispatcher.route(topic.name(), message);
+    if (route.kind == ActionDispatcher::Route::Internal) {
         return;
     }
     log("Received message: " + msg + " on topic: " + topic.name());
-    if (ui->checkBoxPrintOnly->isChecked()) {
-        log("Print only mode enabled — ignoring commands.");
-        return;
-    }
-    const QStringList parts = topic.name().split('/');
-    QString actionName = parts.size() >= 3 ? parts.last() : QString();
-    if (ui->checkBoxPrintOnly->isChecked()) {
+    if (route.kind == ActionDispatcher::Route::Batch) {
+        log("Batch message ignored; batches are run by the service.");
         return;
     }
-    auto it = std::find_if(m_actions.begin(), m_actions.end(), [&](const UserActionCfg &a){
-        return a.customName.compare(actionName, Qt::CaseInsensitive) == 0
-               && msg.compare(a.expectedMessage, Qt::CaseInsensitive) == 0;
-    });
-    if (it == m_actions.end()) {
+    if (route.kind != ActionDispatcher::Route::Run) {
         log("Message ignored (no matching configured action).");
         return;
     }
-    if (!ActionsRegistry::execute(it->type, it->exePath)) {
+    ActionBackend *backend = actionBackend();
+    // The backend logs the dry run itself; this only reports the outcome
+    if (!backend->execute(*route.action, route.call)) {
         log("Action executed as no-op or not supported on this OS.");
+    } else if (backend->simulates()) {
+        log("Simulated " + route.action->customName + " (print only).");
     }
 }
 
+ActionBackend *MainWindow::actionBackend()
+{
+    // Print-only is just another backend; swap when the checkbox changes
+    const QString name = ui->checkBoxPrintOnly->isChecked() ? QStringLiteral("print-only") : QStringLiteral("native");
+    if (!m_actionBackend || m_actionBackend->name() != name) m_actionBackend = createActionBackend(name);
+    return m_actionBackend.get();
+}
+
 void MainWindow::updateStatusLabel(QMqttClient::ClientState state, QMqttClient::ClientError error)
 {
     if (!ui->labelStatus) return;
@@ -207,14 +207,16 @@ void MainWindow::loadSettings()
     ui->spinBoxPort->setValue(m_settings.value("mqtt/port", 1883).toInt());
     ui->lineEditMqttUsername->setText(m_settings.value("mqtt/username").toString());
     {
+        SecretStore &store = defaultSecretStore();
         QByteArray enc = m_settings.value("mqtt/passwordEnc").toByteArray();
         if (enc.isEmpty()) {
             const QString legacy = m_settings.value("mqtt/password").toString();
             if (!legacy.isEmpty()) {
-                QByteArray cipher = dpapiEncryptMachineScope(legacy.toUtf8());
+                QByteArray cipher = store.protect(legacy.toUtf8());
                 if (!cipher.isEmpty()) {
-                    m_settings.setValue("mqtt/passwordEnc", cipher);
-                    m_settings.remove("mqtt/password");
+                    m_settingsWriter->setValue("mqtt/passwordEnc", cipher);
+                    m_settingsWriter->setValue("mqtt/passwordStore", store.name());
+                    m_settingsWriter->remove("mqtt/password");
                     ui->lineEditMqttPassword->setText(legacy);
                 } else {
                     ui->lineEditMqttPassword->setText(legacy);
@@ -223,12 +225,15 @@ void MainWindow::loadSettings()
                 ui->lineEditMqttPassword->clear();
             }
         } else {
-            QByteArray plain = dpapiDecryptBase64(enc);
-            ui->lineEditMqttPassword->setText(QString::fromUtf8(plain));
-            if (!plain.isEmpty()) {
-                QByteArray machineEnc = dpapiEncryptMachineScope(plain);
+            const SecretBuffer &plain = m_passwordCache.reveal(enc);
+            ui->lineEditMqttPassword->setText(plain.toString());
+            // Older builds may have stored user-scope DPAPI; re-protect once
+            // with the current store, not on every load
+            if (!plain.isEmpty() && m_settings.value("mqtt/passwordStore").toString() != store.name()) {
+                QByteArray machineEnc = store.protect(QByteArray(plain.data(), plain.size()));
                 if (!machineEnc.isEmpty()) {
-                    m_settings.setValue("mqtt/passwordEnc", machineEnc);
+                    m_settingsWriter->setValue("mqtt/passwordEnc", machineEnc);
+                    m_settingsWriter->setValue("mqtt/passwordStore", store.name());
                 }
             }
         }
@@ -258,43 +263,57 @@ void MainWindow::applyUiToClient()
 
 void MainWindow::saveAllSettingsForce()
 {
-    // Persist all UI values regardless of Remember and current flags
-    m_settings.setValue("user/customId", ui->lineEditUsername->text());
-    m_settings.setValue("mqtt/host", ui->lineEditHost->text());
-    m_settings.setValue("mqtt/port", ui->spinBoxPort->value());
-    m_settings.setValue("mqtt/username", ui->lineEditMqttUsername->text());
+    // Stages every UI value; the writer only touches keys that differ on disk
+    m_settingsWriter->setValue("user/customId", ui->lineEditUsername->text());
+    m_settingsWriter->setValue("mqtt/host", ui->lineEditHost->text());
+    m_settingsWriter->setValue("mqtt/port", ui->spinBoxPort->value());
+    m_settingsWriter->setValue("mqtt/username", ui->lineEditMqttUsername->text());
     // Password saved encrypted for service-side decryption
     {
         const QString pw = ui->lineEditMqttPassword->text();
         if (pw.isEmpty()) {
-            m_settings.remove("mqtt/passwordEnc");
+            m_settingsWriter->remove("mqtt/passwordEnc");
+            m_settingsWriter->remove("mqtt/passwordStore");
         } else {
-            QByteArray enc = dpapiEncryptMachineScope(pw.toUtf8());
-            if (!enc.isEmpty()) m_settings.setValue("mqtt/passwordEnc", enc);
+            // Protected output differs on every call; re-encrypt only a changed
+            // password. The cache decrypts the stored value once per change.
+            const QByteArray stored = m_settings.value("mqtt/passwordEnc").toByteArray();
+            const QByteArray typed = pw.toUtf8();
+            if (stored.isEmpty() || !m_passwordCache.reveal(stored).equals(typed.constData(), typed.size())) {
+                SecretStore &store = defaultSecretStore();
+                QByteArray enc = store.protect(typed);
+                if (!enc.isEmpty()) {
+                    m_settingsWriter->setValue("mqtt/passwordEnc", enc);
+                    m_settingsWriter->setValue("mqtt/passwordStore", store.name());
+                }
+            }
         }
-        m_settings.remove("mqtt/password");
+        m_settingsWriter->remove("mqtt/password");
     }
     // Options
-    m_settings.setValue("options/printOnly", ui->checkBoxPrintOnly->isChecked());
-    m_settings.setValue("options/timeoutSec", ui->spinBoxTimeoutSec->value());
-    m_settings.setValue("options/autoConnect", ui->checkBoxAutoConnect->isChecked());
-    m_settings.setValue("options/autoReconnect", ui->checkBoxAutoReconnect->isChecked());
-    m_settings.setValue("options/reconnectSec", ui->spinBoxReconnectSec->value());
-    m_settings.setValue("options/startWithWindows", ui->checkBoxStartWithWindows->isChecked());
-    m_settings.setValue("options/startMinimized", ui->checkBoxStartMinimized->isChecked());
-    m_settings.setValue("options/startupPathLocked", ui->checkBoxLockStartupPath->isChecked());
-    m_settings.setValue("options/startupPath", ui->lineEditStartupPath->text());
-    // Actions array
-    m_settings.beginWriteArray("actions");
-    for (int i = 0; i < m_actions.size(); ++i) {
-        m_settings.setArrayIndex(i);
-        m_settings.setValue("name", m_actions[i].customName);
-        m_settings.setValue("message", m_actions[i].expectedMessage);
-        m_settings.setValue("exePath", m_actions[i].exePath);
-        m_settings.setValue("type", ActionsRegistry::toString(m_actions[i].type));
-    }
-    m_settings.endArray();
+    m_settingsWriter->setValue("options/printOnly", ui->checkBoxPrintOnly->isChecked());
+    m_settingsWriter->setValue("options/timeoutSec", ui->spinBoxTimeoutSec->value());
+    m_settingsWriter->setValue("options/autoConnect", ui->checkBoxAutoConnect->isChecked());
+    m_settingsWriter->setValue("options/autoReconnect", ui->checkBoxAutoReconnect->isChecked());
+    m_settingsWriter->setValue("options/reconnectSec", ui->spinBoxReconnectSec->value());
+    m_settingsWriter->setValue("options/startWithWindows", ui->checkBoxStartWithWindows->isChecked());
+    m_settingsWriter->setValue("options/startMinimized", ui->checkBoxStartMinimized->isChecked());
+    m_settingsWriter->setValue("options/startupPathLocked", ui->checkBoxLockStartupPath->isChecked());
+    m_settingsWriter->setValue("options/startupPath", ui->lineEditStartupPath->text());
+    saveActions();
+}
+
+void MainWindow::onSettingsCommitted(const QStringList &changedKeys)
+{
+    // Pick up the new file in the read-side QSettings
     m_settings.sync();
+    if (!m_ipc || !(m_isControllingService || m_ipc->isConnected())) return;
+    // One reload per commit; the service also notices the file change, but
+    // this makes it apply before any request queued behind it
+    m_ipc->request(QByteArrayLiteral("reload-settings"), [this, changedKeys](bool ok, const QByteArray &r) {
+        if (ok && r == "ok") log("Service: settings reloaded (" + changedKeys.join(", ") + ")");
+        else log("Service: failed to reload settings");
+    });
 }
 
 void MainWindow::saveSettingsIfNeeded()
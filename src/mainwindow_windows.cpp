@@ -7,7 +7,7 @@
 #include <QFileInfo>
 #include <QDir>
 #include <QCoreApplication>
-#include "common/service_ipc_client.h"
+#include "common/service_ipc_session.h"
 #include <windows.h>
 #include <winsvc.h>
 #include <shobjidl.h>
@@ -17,7 +17,7 @@
 void MainWindow::onStartWithWindowsToggled(bool enabled)
 {
     updateWindowsStartup(enabled);
-    m_settings.setValue("options/startWithWindows", enabled);
+    m_settingsWriter->setValue("options/startWithWindows", enabled);
 }
 
 void MainWindow::updateWindowsStartup(bool enabled)
@@ -138,8 +138,19 @@ bool MainWindow::startService()
 
 bool MainWindow::stopService()
 {
-    const QByteArray r = ServiceIpcClient::send("shutdown-service");
-    if (r == "ok") return true;
+    if (m_ipc && m_ipc->isConnected()) {
+        // Ask the service to exit gracefully; fall back to the SCM if it doesn't confirm
+        m_ipc->request(QByteArrayLiteral("shutdown-service"), [this](bool ok, const QByteArray &r) {
+            if (!ok || r != "ok") stopServiceViaScm();
+        });
+        m_ipc->flush();
+        return true;
+    }
+    return stopServiceViaScm();
+}
+
+bool MainWindow::stopServiceViaScm()
+{
     SC_HANDLE scm = OpenSCManagerW(nullptr, nullptr, SC_MANAGER_CONNECT);
     if (!scm) return false;
     SC_HANDLE svc = OpenServiceW(scm, L"MPMService", SERVICE_STOP);
@@ -0,0 +1,91 @@
+#include "batch_executor.h"
+
+#include <QJsonDocument>
+#include <QJsonObject>
+
+BatchExecutor::BatchExecutor(StepRunner runner, QObject *parent)
+	: QObject(parent), m_runner(std::move(runner))
+{
+	m_delay.setSingleShot(true);
+	m_delay.setTimerType(Qt::PreciseTimer);
+	connect(&m_delay, &QTimer::timeout, this, [this]() {
+		m_delayDone = true;
+		runSteps();
+	});
+}
+
+bool BatchExecutor::submit(BatchRequest request)
+{
+	if (m_queue.size() >= kMaxQueued) return false;
+	m_queue.enqueue(std::move(request));
+	if (!m_running) startNext();
+	return true;
+}
+
+void BatchExecutor::cancelAll()
+{
+	m_queue.clear();
+	if (!m_running) return;
+	m_delay.stop();
+	for (; m_next < m_current.steps.size(); ++m_next) {
+		m_results.append(QJsonObject{{"action", m_current.steps[m_next].action}, {"skipped", true}});
+	}
+	m_ok = false;
+	finishBatch();
+}
+
+void BatchExecutor::startNext()
+{
+	if (m_running || m_queue.isEmpty()) return;
+	m_current = m_queue.dequeue();
+	m_running = true;
+	m_next = 0;
+	m_delayDone = false;
+	m_ok = true;
+	m_results = QJsonArray();
+	m_elapsed.start();
+	runSteps();
+}
+
+void BatchExecutor::runSteps()
+{
+	while (m_running && m_next < m_current.steps.size()) {
+		const BatchStep &step = m_current.steps[m_next];
+		if (step.delayMs > 0 && !m_delayDone) {
+			m_delay.start(step.delayMs);
+			return;
+		}
+		m_delayDone = false;
+		QElapsedTimer stepTimer;
+		stepTimer.start();
+		QString error;
+		const bool ok = m_runner(step, m_current.id, &error);
+		QJsonObject result{{"action", step.action}, {"ok", ok}, {"ms", stepTimer.elapsed()}};
+		if (!ok) result.insert("error", error);
+		m_results.append(result);
+		++m_next;
+		if (!ok) {
+			m_ok = false;
+			if (m_current.stopOnFailure) {
+				for (; m_next < m_current.steps.size(); ++m_next) {
+					m_results.append(QJsonObject{{"action", m_current.steps[m_next].action}, {"skipped", true}});
+				}
+			}
+		}
+	}
+	if (m_running) finishBatch();
+}
+
+void BatchExecutor::finishBatch()
+{
+	QJsonObject result{{"ok", m_ok}, {"elapsedMs", m_elapsed.elapsed()}, {"steps", m_results}};
+	if (!m_current.id.isEmpty()) result.insert("id", m_current.id);
+	const bool ok = m_ok;
+	m_running = false;
+	m_current = BatchRequest();
+	m_results = QJsonArray();
+	emit finished(QJsonDocument(result).toJson(QJsonDocument::Compact), ok);
+	// Later batches start from the event loop, not from inside the slot that
+	// handled this one's finished()
+	if (!m_queue.isEmpty()) QTimer::singleShot(0, this, &BatchExecutor::startNext);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QJsonArray>
+#include <QQueue>
+#include <QTimer>
+#include <functional>
+#include "../actions/batch.h"
+
+// Runs BatchRequests one at a time, steps in order, on the owner's thread.
+// Steps without a delay run back to back in one event loop turn; a delay
+// is a single-shot timer, so nothing blocks while waiting. When a step fails
+// and the batch says stopOnFailure, the remaining steps are skipped. Each
+// batch ends with one finished() carrying the combined result:
+//   {"id":"evening","ok":false,"elapsedMs":512,"steps":[
+//     {"action":"Lock","ok":true,"ms":3},
+//     {"action":"Browser","ok":false,"error":"message does not match"},
+//     {"action":"PC","skipped":true}]}
+class BatchExecutor : public QObject {
+	Q_OBJECT
+public:
+	// Runs one step; false with a reason in *error if it failed
+	using StepRunner = std::function<bool(const BatchStep &step, const QString &batchId, QString *error)>;
+	static constexpr int kMaxQueued = 8;
+
+	explicit BatchExecutor(StepRunner runner, QObject *parent = nullptr);
+
+	// Queues a batch behind the running one; false if kMaxQueued are waiting
+	bool submit(BatchRequest request);
+	// Drops queued batches and skips what is left of the running one
+	void cancelAll();
+	bool isBusy() const { return m_running; }
+
+signals:
+	void finished(const QByteArray &resultJson, bool ok);
+
+private:
+	void startNext();
+	// Runs steps until one has to wait or the batch is done
+	void runSteps();
+	void finishBatch();
+
+	StepRunner m_runner;
+	QTimer m_delay;
+	QQueue<BatchRequest> m_queue;
+	BatchRequest m_current;
+	bool m_running = false;
+	int m_next = 0;               // index of the step to run next
+	bool m_delayDone = false;     // step m_next already waited its delay
+	bool m_ok = true;
+	QJsonArray m_results;
+	QElapsedTimer m_elapsed;
+};
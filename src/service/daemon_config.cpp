@@ -0,0 +1,194 @@
+#include "daemon_config.h"
+#include "../common/log_categories.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStringList>
+
+namespace {
+
+constexpr quint32 kSnapshotMagic = 0x4D504D43; // "MPMC"
+constexpr quint16 kSnapshotVersion = 4;   // 2: action types by name, parameter maps; 3: payload format; 4: macros
+
+} // namespace
+
+DaemonConfig::SourceStamp DaemonConfig::stampFile(const QString &iniPath, bool withHash)
+{
+	SourceStamp st;
+	const QFileInfo fi(iniPath);
+	if (!fi.exists()) return st;
+	st.size = fi.size();
+	st.mtimeMs = fi.lastModified().toMSecsSinceEpoch();
+	if (withHash) {
+		QFile f(iniPath);
+		if (f.open(QIODevice::ReadOnly)) {
+			QCryptographicHash h(QCryptographicHash::Sha256);
+			h.addData(&f);
+			st.sha256 = h.result();
+		}
+	}
+	return st;
+}
+
+DaemonConfig DaemonConfig::fromSettings(QSettings &S)
+{
+	DaemonConfig c;
+	c.username = S.value("user/customId").toString().trimmed();
+	c.host = S.value("mqtt/host", "127.0.0.1").toString();
+	c.port = static_cast<quint16>(S.value("mqtt/port", 1883).toInt());
+	c.mqttUser = S.value("mqtt/username").toString();
+	c.passwordEnc = S.value("mqtt/passwordEnc").toByteArray();
+	c.legacyPassword = S.value("mqtt/password").toString();
+
+	c.autoConnect = S.value("options/autoConnect", false).toBool();
+	c.autoReconnect = S.value("options/autoReconnect", false).toBool();
+	c.reconnectSec = qMax(1, S.value("options/reconnectSec", 5).toInt());
+	c.printOnly = S.value("options/printOnly", false).toBool();
+
+	c.actions = ActionTypeRegistry::instance().readActions(S);
+	c.macros = MacroConfig::readAll(S);
+
+	c.logLevels = readLogLevels(S);
+	MqttLogForwarder::Options &fwd = c.logForward;
+	fwd.enabled = S.value("logForward/enabled", false).toBool();
+	const QString fwdLevel = S.value("logForward/level", "info").toString().toLower();
+	fwd.minLevel = fwdLevel == "debug" ? QtDebugMsg : fwdLevel.startsWith("warn") ? QtWarningMsg
+	             : (fwdLevel == "error" || fwdLevel == "critical") ? QtCriticalMsg : QtInfoMsg;
+	fwd.intervalMs = S.value("logForward/intervalMs", fwd.intervalMs).toInt();
+	fwd.maxBatchBytes = S.value("logForward/maxBatchBytes", fwd.maxBatchBytes).toInt();
+	fwd.maxPublishesPerMinute = S.value("logForward/maxPublishesPerMinute", fwd.maxPublishesPerMinute).toInt();
+	return c;
+}
+
+int DaemonConfig::diff(const DaemonConfig &a, const DaemonConfig &b)
+{
+	int changed = 0;
+	if (a.username != b.username || a.host != b.host || a.port != b.port || a.mqttUser != b.mqttUser) {
+		changed |= ConnectionSection;
+	}
+	if (a.autoConnect != b.autoConnect || a.autoReconnect != b.autoReconnect
+	    || a.reconnectSec != b.reconnectSec || a.printOnly != b.printOnly) {
+		changed |= OptionsSection;
+	}
+	if (a.actions != b.actions || a.macros != b.macros) changed |= ActionsSection;
+	const MqttLogForwarder::Options &fa = a.logForward;
+	const MqttLogForwarder::Options &fb = b.logForward;
+	if (a.logLevels != b.logLevels || fa.enabled != fb.enabled || fa.minLevel != fb.minLevel
+	    || fa.intervalMs != fb.intervalMs || fa.maxBatchBytes != fb.maxBatchBytes
+	    || fa.maxPublishesPerMinute != fb.maxPublishesPerMinute || fa.maxBacklogBytes != fb.maxBacklogBytes) {
+		changed |= LoggingSection;
+	}
+	return changed;
+}
+
+QString DaemonConfig::describe(int sections)
+{
+	QStringList parts;
+	if (sections & ConnectionSection) parts << "connection";
+	if (sections & OptionsSection) parts << "options";
+	if (sections & ActionsSection) parts << "actions";
+	if (sections & LoggingSection) parts << "logging";
+	return parts.isEmpty() ? QStringLiteral("nothing") : parts.join(", ");
+}
+
+QString DaemonConfig::snapshotPathFor(const QString &iniPath)
+{
+	const QFileInfo fi(iniPath);
+	return fi.absoluteDir().filePath(fi.completeBaseName() + QStringLiteral(".snapshot"));
+}
+
+bool DaemonConfig::writeSnapshot(const QString &path, const SourceStamp &source) const
+{
+	QSaveFile f(path);
+	if (!f.open(QIODevice::WriteOnly)) return false;
+	QDataStream out(&f);
+	out.setVersion(QDataStream::Qt_5_15);
+	out << kSnapshotMagic << kSnapshotVersion;
+	out << source.size << source.mtimeMs << source.sha256;
+	out << username << host << port << mqttUser << passwordEnc << legacyPassword;
+	out << autoConnect << autoReconnect << qint32(reconnectSec) << printOnly;
+	out << quint32(actions.size());
+	// Type names, not ids: ids depend on which plugins this process loaded
+	for (const Action &a : actions) out << a.customName << a.typeName << a.expectedMessage << qint32(a.payloadFormat) << a.params;
+	out << quint32(macros.size());
+	for (const MacroConfig &m : macros) {
+		out << m.name << m.expectedMessage << quint32(m.steps.size());
+		for (const MacroStepConfig &st : m.steps) out << st.id << st.action << st.message << st.after << qint32(st.timeoutMs);
+	}
+	out << logLevels;
+	out << logForward.enabled << qint32(logForward.minLevel) << qint32(logForward.intervalMs)
+	    << qint32(logForward.maxBatchBytes) << qint32(logForward.maxPublishesPerMinute)
+	    << qint32(logForward.maxBacklogBytes);
+	return out.status() == QDataStream::Ok && f.commit();
+}
+
+bool DaemonConfig::readSnapshot(const QString &path, const SourceStamp &current, DaemonConfig *out, SourceStamp *stored)
+{
+	QFile f(path);
+	if (!f.open(QIODevice::ReadOnly) || f.size() <= 0) return false;
+	uchar *mapped = f.map(0, f.size());
+	if (!mapped) return false;
+	// Decoded straight from the mapping; the QByteArray does not copy
+	const QByteArray bytes = QByteArray::fromRawData(reinterpret_cast<const char *>(mapped), int(f.size()));
+	QDataStream in(bytes);
+	in.setVersion(QDataStream::Qt_5_15);
+	quint32 magic = 0;
+	quint16 version = 0;
+	in >> magic >> version;
+	if (magic != kSnapshotMagic || version != kSnapshotVersion) return false;
+	SourceStamp st;
+	in >> st.size >> st.mtimeMs >> st.sha256;
+	if (in.status() != QDataStream::Ok || !st.sameFile(current)) return false;
+
+	DaemonConfig c;
+	qint32 reconnectSec = 0;
+	in >> c.username >> c.host >> c.port >> c.mqttUser >> c.passwordEnc >> c.legacyPassword;
+	in >> c.autoConnect >> c.autoReconnect >> reconnectSec >> c.printOnly;
+	c.reconnectSec = qMax(1, int(reconnectSec));
+	quint32 count = 0;
+	in >> count;
+	// Guards the reserve() below against a damaged count
+	if (in.status() != QDataStream::Ok || count > quint32(f.size())) return false;
+	c.actions.reserve(int(count));
+	for (quint32 i = 0; i < count; ++i) {
+		Action a;
+		qint32 format = 0;
+		in >> a.customName >> a.typeName >> a.expectedMessage >> format >> a.params;
+		if (format != qint32(PayloadFormat::Text) && format != qint32(PayloadFormat::Json)) return false;
+		a.payloadFormat = PayloadFormat(format);
+		a.type = ActionTypeRegistry::instance().find(a.typeName);
+		c.actions.push_back(a);
+	}
+	in >> count;
+	if (in.status() != QDataStream::Ok || count > quint32(f.size())) return false;
+	c.macros.reserve(int(count));
+	for (quint32 i = 0; i < count; ++i) {
+		MacroConfig m;
+		quint32 steps = 0;
+		in >> m.name >> m.expectedMessage >> steps;
+		if (in.status() != QDataStream::Ok || steps > quint32(f.size())) return false;
+		m.steps.resize(int(steps));
+		for (MacroStepConfig &st : m.steps) {
+			qint32 timeoutMs = 0;
+			in >> st.id >> st.action >> st.message >> st.after >> timeoutMs;
+			st.timeoutMs = timeoutMs;
+		}
+		c.macros.push_back(std::move(m));
+	}
+	in >> c.logLevels;
+	qint32 minLevel = 0, intervalMs = 0, maxBatchBytes = 0, maxPublishes = 0, maxBacklog = 0;
+	in >> c.logForward.enabled >> minLevel >> intervalMs >> maxBatchBytes >> maxPublishes >> maxBacklog;
+	c.logForward.minLevel = static_cast<QtMsgType>(minLevel);
+	c.logForward.intervalMs = intervalMs;
+	c.logForward.maxBatchBytes = maxBatchBytes;
+	c.logForward.maxPublishesPerMinute = maxPublishes;
+	c.logForward.maxBacklogBytes = maxBacklog;
+	if (in.status() != QDataStream::Ok) return false;
+	*out = std::move(c);
+	if (stored) *stored = st;
+	return true;
+}
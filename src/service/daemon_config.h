@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QByteArray>
+#include <QMap>
+#include <QSettings>
+#include <QString>
+#include <QVector>
+#include "actions/actions.h"
+#include "actions/macro.h"
+#include "log_forwarder.h"
+
+// The service's view of the shared INI, parsed in one pass. Parsing never
+// decrypts: the password is kept as stored so a reload can tell whether it
+// changed without calling DPAPI.
+struct DaemonConfig {
+	enum Section {
+		ConnectionSection = 0x1, // identity, broker, credentials
+		OptionsSection = 0x2,    // connect/reconnect behaviour, print-only
+		ActionsSection = 0x4,    // actions and macros
+		LoggingSection = 0x8,    // log levels and forwarding
+		AllSections = 0xF
+	};
+
+	using Action = ActionConfig;
+
+	QString username;
+	QString host = QStringLiteral("127.0.0.1");
+	quint16 port = 1883;
+	QString mqttUser;
+	QByteArray passwordEnc;     // DPAPI ciphertext, base64
+	QString legacyPassword;     // plaintext fallback from old INIs
+
+	bool autoConnect = false;
+	bool autoReconnect = false;
+	int reconnectSec = 5;
+	bool printOnly = false;
+
+	QVector<Action> actions;
+	QVector<MacroConfig> macros;
+
+	QMap<QString, QString> logLevels;
+	MqttLogForwarder::Options logForward;
+
+	// Identifies the INI contents a config was parsed from
+	struct SourceStamp {
+		qint64 size = -1;
+		qint64 mtimeMs = 0;
+		QByteArray sha256;      // empty when not computed
+		bool sameFile(const SourceStamp &o) const { return size == o.size && mtimeMs == o.mtimeMs; }
+	};
+	static SourceStamp stampFile(const QString &iniPath, bool withHash);
+
+	static DaemonConfig fromSettings(QSettings &S);
+
+	// Compiled snapshot: the parsed config in a compact binary form next to
+	// the INI, so a cold start can skip QSettings entirely. Like the INI it
+	// holds the password only as ciphertext.
+	static QString snapshotPathFor(const QString &iniPath);
+	bool writeSnapshot(const QString &path, const SourceStamp &source) const;
+	// Maps the snapshot and decodes it; fails if it is unreadable, from another
+	// format version, or was built from an INI with a different size or mtime
+	static bool readSnapshot(const QString &path, const SourceStamp &current, DaemonConfig *out, SourceStamp *stored);
+	// Sections that differ between a and b. The stored password is left out:
+	// its ciphertext changes on every save, so callers compare the plaintext.
+	static int diff(const DaemonConfig &a, const DaemonConfig &b);
+	// "connection, actions" etc. for log lines
+	static QString describe(int sections);
+};
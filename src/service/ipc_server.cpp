@@ -1,52 +1,218 @@
 #include "ipc_server.h"
 #include <QTextStream>
 #include <QCoreApplication>
+#include <QCborArray>
+#include <QCborValue>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
+#include <QtEndian>
 #include "../common/settings.h"
 #include "../common/ipc_auth.h"
 #include "../common/logging.h"
+#include "../common/log_categories.h"
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 IpcServer::IpcServer(MqttDaemon *daemon, QObject *parent)
     : QObject(parent), m_daemon(daemon)
 {
+    connect(&m_tokenWatcher, &QFileSystemWatcher::fileChanged, this, [this]() {
+        qCInfo(lcIpc) << "IPC token file changed; reloading";
+        loadToken();
+    });
 }
 
 bool IpcServer::start(const QString &serverName)
 {
+    loadToken();
     QLocalServer::removeServer(serverName);
     // Allow cross-user access so GUI (user) can reach service (LocalSystem)
     m_server.setSocketOptions(QLocalServer::WorldAccessOption);
     if (!m_server.listen(serverName)) {
-        qWarning() << "IPC Local listen failed for" << serverName << ":" << m_server.errorString();
+        qCWarning(lcIpc) << "IPC Local listen failed for" << serverName << ":" << m_server.errorString();
     } else {
-        qInfo() << "IPC Local listening at" << serverName;
+        qCInfo(lcIpc) << "IPC Local listening at" << serverName;
         connect(&m_server, &QLocalServer::newConnection, this, &IpcServer::onNewConnection);
     }
     return true;
 }
 
+bool IpcServer::adopt(qintptr listenFd)
+{
+#ifdef Q_OS_LINUX
+    loadToken();
+    const int fd = int(listenFd);
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+    m_inherited = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(m_inherited, &QSocketNotifier::activated, this, &IpcServer::onInheritedReadable);
+    qCInfo(lcIpc) << "IPC serving inherited socket fd" << fd;
+    return true;
+#else
+    Q_UNUSED(listenFd);
+    return false;
+#endif
+}
+
+void IpcServer::onInheritedReadable()
+{
+#ifdef Q_OS_LINUX
+    const int listenFd = int(m_inherited->socket());
+    for (;;) {
+        const int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC | SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) qCWarning(lcIpc) << "IPC accept failed, errno" << errno;
+            return;
+        }
+        auto *sock = new QLocalSocket(this);
+        if (!sock->setSocketDescriptor(fd, QLocalSocket::ConnectedState, QIODevice::ReadWrite)) {
+            ::close(fd);
+            delete sock;
+            continue;
+        }
+        qCDebug(lcIpc) << "IPC client connected via inherited socket";
+        handleSocket(sock);
+    }
+#endif
+}
+
 void IpcServer::onNewConnection()
 {
     while (QLocalSocket *sock = m_server.nextPendingConnection()) {
-        //qDebug() << "IPC client connected via Local";
+        qCDebug(lcIpc) << "IPC client connected via Local";
         handleSocket(sock);
     }
 }
 
 void IpcServer::handleSocket(QLocalSocket *sock)
 {
-    connect(sock, &QLocalSocket::disconnected, sock, &QLocalSocket::deleteLater);
-    if (!sock->waitForReadyRead(1000)) { sock->disconnectFromServer(); return; }
-    const QByteArray req = sock->readAll();
-    QByteArray resp;
-    const QString token = loadOrCreateIpcToken();
-    // Expect commands in form: TOKEN\nCMD
-    QList<QByteArray> parts = req.split('\n');
-    if (parts.size() < 2 || QString::fromUtf8(parts[0]).trimmed() != token) {
-        qWarning() << "IPC unauthorized Local request";
-        sock->write("unauthorized"); sock->flush(); sock->waitForBytesWritten(200); sock->disconnectFromServer(); return;
+    // Fully event driven: a slow or idle client never stalls MQTT dispatch
+    m_clients.insert(sock, Client());
+    emit clientCountChanged(m_clients.size());
+    connect(sock, &QLocalSocket::readyRead, this, [this, sock]() { onClientReadyRead(sock); });
+    connect(sock, &QLocalSocket::disconnected, this, [this, sock]() {
+        m_clients.remove(sock);
+        sock->deleteLater();
+        emit clientCountChanged(m_clients.size());
+    });
+    // Drop clients that connect but never send a request
+    QTimer::singleShot(1000, sock, [this, sock]() {
+        const auto it = m_clients.constFind(sock);
+        if (it != m_clients.constEnd() && it->mode != Client::Session && it->mode != Client::Done) sock->disconnectFromServer();
+    });
+    if (sock->bytesAvailable() > 0) onClientReadyRead(sock);
+}
+
+void IpcServer::onClientReadyRead(QLocalSocket *sock)
+{
+    auto it = m_clients.find(sock);
+    if (it == m_clients.end()) return;
+    Client &c = *it;
+    if (c.mode == Client::Done) { sock->readAll(); return; }
+    c.buffer.append(sock->readAll());
+
+    if (c.mode == Client::AwaitingToken) {
+        // Expect commands in form: TOKEN\nCMD
+        const int nl = c.buffer.indexOf('\n');
+        if (nl < 0) {
+            if (c.buffer.size() > 4096) sock->disconnectFromServer();
+            return;
+        }
+        if (!isAuthorized(c.buffer.left(nl))) {
+            qCWarning(lcIpc) << "IPC unauthorized Local request";
+            c.mode = Client::Done;
+            sock->write("unauthorized");
+            sock->disconnectFromServer();
+            return;
+        }
+        c.buffer.remove(0, nl + 1);
+        c.mode = Client::AwaitingCommand;
+    }
+
+    if (c.mode == Client::AwaitingCommand) {
+        static const QByteArray kSession("session\n");
+        if (c.buffer.isEmpty() || (c.buffer.size() < kSession.size() && kSession.startsWith(c.buffer))) return;
+        if (c.buffer.startsWith(kSession)) {
+            // Persistent session: length-prefixed frames in both directions
+            c.buffer.remove(0, kSession.size());
+            c.mode = Client::Session;
+        } else {
+            // One-shot request: ends at its newline, a batch at the first empty
+            // line. Reads can split a request anywhere, so wait for the end.
+            // "batch\n\n" is an empty batch and gets an empty result list.
+            const bool batch = c.buffer.startsWith("batch\n") || c.buffer.startsWith("batch-json\n");
+            const int end = batch ? c.buffer.indexOf("\n\n") : c.buffer.indexOf('\n');
+            if (end < 0) {
+                if (c.buffer.size() > int(kMaxFrameBytes)) {
+                    qCWarning(lcIpc) << "IPC one-shot request too large";
+                    c.mode = Client::Done;
+                    sock->disconnectFromServer();
+                }
+                return;
+            }
+            const QByteArray resp = dispatchRequest(c.buffer.left(end));
+            c.buffer.clear();
+            c.mode = Client::Done;
+            sock->write(resp);
+            sock->disconnectFromServer();
+            return;
+        }
+    }
+
+    while (c.buffer.size() >= 4) {
+        const quint32 len = qFromBigEndian<quint32>(reinterpret_cast<const uchar *>(c.buffer.constData()));
+        if (len > kMaxFrameBytes) {
+            qCWarning(lcIpc) << "IPC session frame too large:" << len;
+            c.mode = Client::Done;
+            sock->disconnectFromServer();
+            return;
+        }
+        if (c.buffer.size() < 4 + int(len)) break;
+        const QByteArray cmd = c.buffer.mid(4, int(len));
+        c.buffer.remove(0, 4 + int(len));
+        const QByteArray resp = dispatchRequest(cmd);
+        uchar header[4];
+        qToBigEndian<quint32>(quint32(resp.size()), header);
+        sock->write(reinterpret_cast<const char *>(header), 4);
+        sock->write(resp);
+    }
+}
+
+void IpcServer::loadToken()
+{
+    m_token = loadOrCreateIpcToken();
+    // Editors and loadOrCreateIpcToken() replace the file, which drops the watch
+    const QString path = ipcTokenFilePath();
+    if (!m_tokenWatcher.files().contains(path)) m_tokenWatcher.addPath(path);
+}
+
+bool IpcServer::isAuthorized(const QByteArray &tokenLine)
+{
+    // Compared against the cached token only: a stream of bad attempts costs
+    // no file I/O. The watcher reloads it when the file is recreated.
+    return QString::fromUtf8(tokenLine).trimmed() == m_token;
+}
+
+QByteArray IpcServer::dispatchRequest(const QByteArray &cmd)
+{
+    qCDebug(lcIpc) << "IPC Local command:" << cmd.left(cmd.indexOf('\n'));
+    const QList<QByteArray> lines = cmd.split('\n');
+    if (lines.first() == "batch" || lines.first() == "batch-json") {
+        return executeBatch(lines.mid(1), lines.first() == "batch-json");
     }
-    const QByteArray cmd = parts.mid(1).join("\n");
-    //qDebug() << "IPC Local command:" << cmd;
+    return execute(cmd);
+}
+
+QByteArray IpcServer::execute(const QByteArray &cmd)
+{
+    QByteArray resp;
     if (cmd == "status") {
         const auto state = m_daemon ? m_daemon->state() : QMqttClient::Disconnected;
         resp = QByteArray::number(static_cast<int>(state));
@@ -64,6 +230,17 @@ void IpcServer::handleSocket(QLocalSocket *sock)
         resp.append(userDisc ? '1' : '0');
     } else if (cmd == "getlogs") {
         resp = takeRecentLogs().toUtf8();
+    } else if (cmd.startsWith("logs-since ")) {
+        bool ok = false;
+        const quint64 cursor = cmd.mid(int(sizeof("logs-since ")) - 1).trimmed().toULongLong(&ok);
+        if (ok) {
+            const RecentLogs logs = recentLogsSince(cursor);
+            resp = QByteArray::number(logs.cursor) + ' ' + QByteArray::number(logs.missed) + '\n' + logs.text.toUtf8();
+        } else {
+            resp = "err";
+        }
+    } else if (cmd == "config-hash") {
+        resp = settingsFileHash().toHex();
     } else if (cmd == "reload-settings") {
         if (m_daemon) m_daemon->reloadSettings();
         resp = "ok";
@@ -71,12 +248,21 @@ void IpcServer::handleSocket(QLocalSocket *sock)
         if (m_daemon) m_daemon->forceConnect();
         resp = "ok";
     } else if (cmd == "disconnect") {
-        if (m_daemon) { m_daemon->forceDisconnect(); }
-        // Mark user-initiated so auto-reconnect pauses until next connect
-        if (m_daemon) {
-            // best-effort via reloadSettings flipping flag; handled in daemon
-        }
+        // Marks the disconnect user-initiated so auto-reconnect pauses until next connect
+        if (m_daemon) m_daemon->forceDisconnect();
         resp = "ok";
+    } else if (cmd.startsWith("log-level ")) {
+        // "log-level mpm.dispatch debug"; lasts until a reload changes [log-levels]
+        const QList<QByteArray> args = cmd.simplified().split(' ');
+        const bool ok = args.size() == 3 && setLogLevel(QString::fromUtf8(args.at(1)), QString::fromUtf8(args.at(2)));
+        resp = ok ? "ok" : "err";
+    } else if (cmd == "log-levels") {
+        resp = logLevelSummary().toUtf8();
+    } else if (cmd.startsWith("run-action ")) {
+        const QString name = QString::fromUtf8(cmd.mid(int(sizeof("run-action ")) - 1)).trimmed();
+        // A print-only service answers "simulated": nothing ran
+        if (!m_daemon || !m_daemon->runAction(name)) resp = "err";
+        else resp = m_daemon->isSimulating() ? "simulated" : "ok";
     } else if (cmd == "shutdown-service") {
         // Request the service process to exit
         QCoreApplication::quit();
@@ -84,10 +270,93 @@ void IpcServer::handleSocket(QLocalSocket *sock)
     } else {
         resp = "err";
     }
-    sock->write(resp);
-    sock->flush();
-    sock->waitForBytesWritten(500);
-    sock->disconnectFromServer();
+    return resp;
+}
+
+QCborMap IpcServer::executeStructured(const QByteArray &cmd)
+{
+    QCborMap result;
+    result.insert(QStringLiteral("cmd"), QString::fromUtf8(cmd));
+    bool ok = true;
+    QCborMap data;
+    if (cmd == "status" || cmd == "status2") {
+        const auto state = m_daemon ? m_daemon->state() : QMqttClient::Disconnected;
+        data.insert(QStringLiteral("state"), static_cast<int>(state));
+        data.insert(QStringLiteral("reconnectActive"), m_daemon ? m_daemon->isReconnectActive() : false);
+        data.insert(QStringLiteral("autoReconnect"), m_daemon ? m_daemon->isAutoReconnectEnabled() : false);
+        data.insert(QStringLiteral("userInitiated"), m_daemon ? m_daemon->isUserInitiatedDisconnect() : false);
+        data.insert(QStringLiteral("lastError"), m_daemon ? static_cast<int>(m_daemon->lastError()) : 0);
+        // Actions that will never match: "name: reason"
+        if (m_daemon && !m_daemon->invalidActions().isEmpty()) {
+            data.insert(QStringLiteral("invalidActions"), QCborArray::fromStringList(m_daemon->invalidActions()));
+        }
+        if (m_daemon && m_daemon->macroThreadsStuck() > 0) {
+            data.insert(QStringLiteral("macroThreadsStuck"), qint64(m_daemon->macroThreadsStuck()));
+        }
+    } else if (cmd == "counters") {
+        if (m_daemon) {
+            const MqttDaemon::Counters &c = m_daemon->counters();
+            data.insert(QStringLiteral("messagesReceived"), qint64(c.messagesReceived));
+            data.insert(QStringLiteral("messagesIgnored"), qint64(c.messagesIgnored));
+            data.insert(QStringLiteral("actionsExecuted"), qint64(c.actionsExecuted));
+            data.insert(QStringLiteral("actionsFailed"), qint64(c.actionsFailed));
+            data.insert(QStringLiteral("actionsSimulated"), qint64(c.actionsSimulated));
+            data.insert(QStringLiteral("connects"), qint64(c.connects));
+            data.insert(QStringLiteral("reloads"), qint64(c.reloads));
+            data.insert(QStringLiteral("lastReloadUs"), c.lastReloadUs);
+            data.insert(QStringLiteral("secretDecrypts"), qint64(m_daemon->secretDecrypts()));
+            data.insert(QStringLiteral("logForwardDropped"), qint64(m_daemon->logLinesDropped()));
+            data.insert(QStringLiteral("logQueueDropped"), qint64(droppedLogLines()));
+        }
+    } else if (cmd == "getlogs") {
+        data.insert(QStringLiteral("text"), takeRecentLogs());
+    } else if (cmd.startsWith("logs-since ")) {
+        const quint64 cursor = cmd.mid(int(sizeof("logs-since ")) - 1).trimmed().toULongLong(&ok);
+        if (ok) {
+            const RecentLogs logs = recentLogsSince(cursor);
+            data.insert(QStringLiteral("cursor"), qint64(logs.cursor));
+            data.insert(QStringLiteral("missed"), qint64(logs.missed));
+            data.insert(QStringLiteral("text"), logs.text);
+        }
+    } else if (cmd == "config-hash") {
+        data.insert(QStringLiteral("sha256"), QString::fromLatin1(settingsFileHash().toHex()));
+    } else if (cmd == "batch" || cmd == "batch-json" || cmd.isEmpty()) {
+        ok = false;
+    } else {
+        // Control commands keep their plain-text semantics
+        const QByteArray resp = execute(cmd);
+        ok = resp == "ok" || resp == "simulated";
+        if (resp == "simulated") data.insert(QStringLiteral("simulated"), true);
+    }
+    result.insert(QStringLiteral("ok"), ok);
+    if (!data.isEmpty()) result.insert(QStringLiteral("data"), data);
+    return result;
+}
+
+QByteArray IpcServer::executeBatch(const QList<QByteArray> &cmds, bool json)
+{
+    // Runs to completion on the service thread, so no MQTT event or other
+    // IPC request is interleaved between the commands of one batch
+    QCborArray results;
+    for (const QByteArray &c : cmds) {
+        const QByteArray trimmed = c.trimmed();
+        if (trimmed.isEmpty()) continue;
+        results.append(executeStructured(trimmed));
+    }
+    QCborMap doc;
+    doc.insert(QStringLiteral("v"), kBatchProtocolVersion);
+    doc.insert(QStringLiteral("results"), results);
+    if (json) return QJsonDocument(doc.toJsonObject()).toJson(QJsonDocument::Compact);
+    return doc.toCborValue().toCbor();
+}
+
+QByteArray IpcServer::settingsFileHash() const
+{
+    QFile f(mpmSharedSettingsFilePath());
+    if (!f.open(QIODevice::ReadOnly)) return QByteArray();
+    QCryptographicHash h(QCryptographicHash::Sha256);
+    h.addData(&f);
+    return h.result();
 }
 
 // No TCP handler anymore; IPC is local-only
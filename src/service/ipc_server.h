@@ -3,21 +3,82 @@
 #include <QObject>
 #include <QLocalServer>
 #include <QLocalSocket>
+#include <QCborMap>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QSocketNotifier>
 #include "mqtt_daemon.h"
+#include "../common/ipc_auth.h"
 
+// Local IPC endpoint of the service. Requests are "TOKEN\nCMD". Besides the
+// plain-text commands, "batch\nCMD1\nCMD2..." (or "batch-json\n...") runs
+// several commands in one round-trip and answers with a CBOR (or JSON) map:
+//   { "v": 1, "results": [ { "cmd": "status", "ok": true, "data": { ... } }, ... ] }
+// New fields are only ever added to "data"; parsers must ignore unknown keys.
+//
+// "logs-since SEQ" returns the recent log lines numbered after SEQ without
+// consuming them: "CURSOR MISSED\nTEXT", where CURSOR is the SEQ to send next
+// and MISSED counts lines evicted before the reader got to them. SEQ 0 returns
+// the most recent lines, without a gap marker. "getlogs" is
+// the legacy form and keeps one shared cursor inside the service.
+//
+// "log-level CATEGORY LEVEL" changes a logging category (mpm.mqtt, mpm.dispatch,
+// mpm.ipc, mpm.actions, mpm.settings, mpm.service or "mpm" for all) until the next settings
+// reload; "log-levels" lists the active overrides.
+//
+// A one-shot request ends with a newline, a batch with an empty line; the
+// client gets the reply and the connection is closed. Sending
+// "TOKEN\nsession\n" instead keeps the connection open; each request and each
+// reply is then a frame of a 4-byte big-endian length followed by the payload,
+// answered in order.
+//
+// On Linux the endpoint can come from systemd socket activation: adopt() serves
+// the inherited listening socket, so the first client connect starts the
+// daemon and no one unlinks and rebinds the path systemd owns.
 class IpcServer : public QObject {
 	Q_OBJECT
 public:
+	static constexpr int kBatchProtocolVersion = 1;
+	static constexpr quint32 kMaxFrameBytes = 1024 * 1024;
+
 	explicit IpcServer(MqttDaemon *daemon, QObject *parent = nullptr);
-	bool start(const QString &serverName = QStringLiteral("MPMServiceIpc"));
+	bool start(const QString &serverName = mpmIpcServerName());
+	// Serves an already-listening Unix socket (e.g. from LISTEN_FDS); false on
+	// platforms without descriptor adoption
+	bool adopt(qintptr listenFd);
+	int clientCount() const { return m_clients.size(); }
+
+signals:
+	void clientCountChanged(int count);
 
 private slots:
 	void onNewConnection();
+	void onInheritedReadable();
 	void handleSocket(QLocalSocket *sock);
 
 private:
+	struct Client {
+		enum Mode { AwaitingToken, AwaitingCommand, Session, Done };
+		Mode mode = AwaitingToken;
+		QByteArray buffer;
+	};
+
+	void onClientReadyRead(QLocalSocket *sock);
+	// Loads (or creates) the token and watches its file for replacement
+	void loadToken();
+	bool isAuthorized(const QByteArray &tokenLine);
+	QByteArray dispatchRequest(const QByteArray &cmd);
+	QByteArray execute(const QByteArray &cmd);
+	QCborMap executeStructured(const QByteArray &cmd);
+	QByteArray executeBatch(const QList<QByteArray> &cmds, bool json);
+	QByteArray settingsFileHash() const;
+
 	MqttDaemon *m_daemon;
 	QLocalServer m_server;
+	QSocketNotifier *m_inherited = nullptr;   // adopted listener; QLocalServer would unlink its path on close
+	QHash<QLocalSocket *, Client> m_clients;
+	QString m_token;
+	QFileSystemWatcher m_tokenWatcher;
 };
 
 
@@ -0,0 +1,122 @@
+#include "log_forwarder.h"
+
+#include <QMutexLocker>
+
+namespace {
+
+int severity(QtMsgType type)
+{
+	switch (type) {
+	case QtDebugMsg: return 0;
+	case QtInfoMsg: return 1;
+	case QtWarningMsg: return 2;
+	case QtCriticalMsg: return 3;
+	case QtFatalMsg: return 4;
+	}
+	return 1;
+}
+
+constexpr int kBurstPublishes = 5;
+
+} // namespace
+
+MqttLogForwarder::MqttLogForwarder(QMqttClient *client, QObject *parent)
+	: QObject(parent), m_client(client)
+{
+	m_clock.start();
+	connect(&m_timer, &QTimer::timeout, this, &MqttLogForwarder::flush);
+}
+
+MqttLogForwarder::~MqttLogForwarder()
+{
+	if (m_attached) setLogSink(nullptr);
+}
+
+void MqttLogForwarder::configure(const QString &topic, const Options &options)
+{
+	m_topic = topic;
+	m_options = options;
+	{
+		QMutexLocker lock(&m_mutex);
+		m_minSeverity = severity(options.minLevel);
+		m_maxBatchBytes = qMax(1024, options.maxBatchBytes);
+		m_maxBacklogBytes = qMax(m_maxBatchBytes, options.maxBacklogBytes);
+	}
+	const bool enable = options.enabled && !topic.isEmpty();
+	if (enable && !m_attached) {
+		m_tokens = kBurstPublishes;
+		m_lastRefillMs = m_clock.elapsed();
+		setLogSink(this);
+	} else if (!enable && m_attached) {
+		setLogSink(nullptr);
+		QMutexLocker lock(&m_mutex);
+		m_backlog.clear();
+	}
+	m_attached = enable;
+	if (enable) m_timer.start(qMax(100, options.intervalMs));
+	else m_timer.stop();
+}
+
+quint64 MqttLogForwarder::droppedLines() const
+{
+	QMutexLocker lock(&m_mutex);
+	return m_dropped;
+}
+
+void MqttLogForwarder::consume(QtMsgType type, const char *category, const QByteArray &line)
+{
+	Q_UNUSED(category);
+	QMutexLocker lock(&m_mutex);
+	if (severity(type) < m_minSeverity) return;
+	if (m_backlog.size() + line.size() > m_maxBacklogBytes) {
+		++m_dropped;
+		return;
+	}
+	m_backlog.append(line);
+	if (m_backlog.size() >= m_maxBatchBytes && !m_flushQueued) {
+		m_flushQueued = true;
+		QMetaObject::invokeMethod(this, "flush", Qt::QueuedConnection);
+	}
+}
+
+bool MqttLogForwarder::takeToken()
+{
+	const qint64 now = m_clock.elapsed();
+	const double perMs = double(qMax(1, m_options.maxPublishesPerMinute)) / 60000.0;
+	m_tokens = qMin<double>(kBurstPublishes, m_tokens + double(now - m_lastRefillMs) * perMs);
+	m_lastRefillMs = now;
+	if (m_tokens < 1.0) return false;
+	m_tokens -= 1.0;
+	return true;
+}
+
+void MqttLogForwarder::flush()
+{
+	QByteArray payload;
+	{
+		QMutexLocker lock(&m_mutex);
+		m_flushQueued = false;
+		if (m_backlog.isEmpty()) return;
+		// Keep the backlog while offline or over budget; consume() drops what no longer fits
+		if (!m_client || m_client->state() != QMqttClient::Connected) return;
+		if (!takeToken()) return;
+		int cut = m_backlog.size();
+		if (cut > m_maxBatchBytes) {
+			cut = m_backlog.lastIndexOf('\n', m_maxBatchBytes - 1) + 1;
+			if (cut <= 0) cut = m_maxBatchBytes;
+		}
+		if (m_dropped != m_droppedReported) {
+			payload = QByteArray("[... ") + QByteArray::number(m_dropped - m_droppedReported) + " log line(s) dropped ...]\n";
+			m_droppedReported = m_dropped;
+		}
+		payload.append(m_backlog.constData(), cut);
+		m_backlog.remove(0, cut);
+		if (!m_backlog.isEmpty() && !m_flushQueued && m_backlog.size() >= m_maxBatchBytes) {
+			m_flushQueued = true;
+			QMetaObject::invokeMethod(this, "flush", Qt::QueuedConnection);
+		}
+	}
+	// Anything the client logs while publishing must not come back here
+	LogSinkSuppressor suppress;
+	m_client->publish(m_topic, payload, 0, false);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <QObject>
+#include <QMqttClient>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QTimer>
+#include "../common/logging.h"
+
+// Publishes service log lines to mqttpowermanager/<user>/log. Lines collected
+// on the log writer thread are sent as one message per interval, or sooner
+// once a batch fills up. A token bucket caps publishes per minute; lines that
+// don't fit in the bounded backlog are dropped, and the next batch says how
+// many were lost.
+class MqttLogForwarder : public QObject, public LogSink {
+	Q_OBJECT
+public:
+	struct Options {
+		bool enabled = false;
+		QtMsgType minLevel = QtInfoMsg;
+		int intervalMs = 2000;
+		int maxBatchBytes = 16 * 1024;
+		int maxPublishesPerMinute = 30;
+		int maxBacklogBytes = 256 * 1024;
+	};
+
+	MqttLogForwarder(QMqttClient *client, QObject *parent = nullptr);
+	~MqttLogForwarder() override;
+
+	// Attaches to or detaches from the logger as options.enabled says
+	void configure(const QString &topic, const Options &options);
+	quint64 droppedLines() const;
+
+	void consume(QtMsgType type, const char *category, const QByteArray &line) override;
+
+private slots:
+	void flush();
+
+private:
+	bool takeToken();
+
+	QMqttClient *m_client = nullptr;
+	QTimer m_timer;
+	QString m_topic;
+	Options m_options;
+	bool m_attached = false;
+	QElapsedTimer m_clock;
+	double m_tokens = 0;
+	qint64 m_lastRefillMs = 0;
+
+	// Shared with the log writer thread
+	mutable QMutex m_mutex;
+	QByteArray m_backlog;
+	int m_minSeverity = 1;
+	int m_maxBatchBytes = 16 * 1024;
+	int m_maxBacklogBytes = 256 * 1024;
+	quint64 m_dropped = 0;
+	quint64 m_droppedReported = 0;
+	bool m_flushQueued = false;
+};
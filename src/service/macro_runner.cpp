@@ -0,0 +1,234 @@
+#include "macro_runner.h"
+#include "../common/log_categories.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
+#include <utility>
+
+MacroRunner::MacroRunner(StepPreparer preparer, QObject *parent)
+	: QObject(parent), m_preparer(std::move(preparer)), m_owner(std::make_shared<Owner>()), m_pool(new QThreadPool)
+{
+	m_owner->runner = this;
+	m_pool->setMaxThreadCount(kMaxThreads);
+}
+
+MacroRunner::~MacroRunner()
+{
+	{
+		// Completions from now on are dropped; ones already queued go with this object
+		QMutexLocker lock(&m_owner->mutex);
+		m_owner->runner = nullptr;
+	}
+	m_pool->clear();
+	for (const Run &run : std::as_const(m_runs)) {
+		for (const StepRun &s : run.steps) {
+			if (s.task) s.task->dropped = true;
+		}
+	}
+	// A handler stuck past its timeout must not hold up shutdown. Its job owns
+	// copies of everything it touches, so its thread can outlive the runner.
+	if (m_pool->waitForDone(kShutdownWaitMs)) {
+		delete m_pool;
+	} else {
+		// ~QThreadPool would wait for them too
+		qCWarning(lcActions) << "Leaving" << m_pool->activeThreadCount() << "macro thread(s) behind; their actions have not returned";
+	}
+}
+
+bool MacroRunner::start(const MacroGraph &graph, QString *error)
+{
+	for (auto it = m_runs.cbegin(); it != m_runs.cend(); ++it) {
+		if (it->graph.name.compare(graph.name, Qt::CaseInsensitive) == 0) {
+			if (error) *error = QStringLiteral("already running");
+			return false;
+		}
+	}
+	if (m_runs.size() >= kMaxRunning) {
+		if (error) *error = QStringLiteral("too many macros running");
+		return false;
+	}
+	const quint64 runId = m_nextRunId++;
+	Run &run = m_runs[runId];
+	run.graph = graph;
+	run.steps.resize(graph.steps.size());
+	run.open = graph.steps.size();
+	for (int i = 0; i < graph.steps.size(); ++i) run.steps[i].waiting = graph.steps[i].after.size();
+	run.elapsed.start();
+	for (int i = 0; i < graph.steps.size(); ++i) {
+		if (run.steps[i].waiting == 0 && run.steps[i].state == StepState::Waiting) launch(run, runId, i);
+	}
+	// Every root may have failed to prepare
+	finishIfDone(runId);
+	return true;
+}
+
+void MacroRunner::cancelAll()
+{
+	const QList<quint64> ids = m_runs.keys();
+	for (const quint64 runId : ids) {
+		Run &run = m_runs[runId];
+		const qint64 now = run.elapsed.elapsed();
+		for (StepRun &s : run.steps) {
+			if (s.state == StepState::Waiting) {
+				s.state = StepState::Skipped;
+			} else if (s.state == StepState::Running) {
+				// Still queued: the pool thread drops it instead of running it
+				s.task->dropped = true;
+				s.state = StepState::Failed;
+				s.endMs = now;
+				s.error = QStringLiteral("cancelled");
+			}
+		}
+		run.open = 0;
+		finishRun(runId);
+	}
+}
+
+void MacroRunner::launch(Run &run, quint64 runId, int index)
+{
+	const MacroStep &step = run.graph.steps[index];
+	StepRun &s = run.steps[index];
+	// Replaced by the time a pool thread picks the step up
+	s.startMs = run.elapsed.elapsed();
+	if (m_stuck >= kMaxThreads) {
+		settle(run, runId, index, StepState::Failed, QStringLiteral("no free thread"));
+		return;
+	}
+	Job job;
+	QString error;
+	if (!m_preparer(step, run.graph.name, &job, &error)) {
+		settle(run, runId, index, StepState::Failed, error);
+		return;
+	}
+	s.state = StepState::Running;
+	s.task = std::make_shared<Task>();
+	m_pool->start([owner = m_owner, runId, index, task = s.task, started = std::move(job.started),
+	               work = std::move(job.run), done = std::move(job.done)]() {
+		if (task->dropped) return;
+		// Queued ahead of the completion below, so the owner sees them in order
+		owner->post([runId, index, task, started](MacroRunner *self) {
+			task->started = true;
+			if (started) started();
+			self->onStepStarted(runId, index);
+		});
+		const bool ok = work();
+		owner->post([runId, index, task, ok, done](MacroRunner *self) {
+			if (task->stuck) {
+				task->stuck = false;
+				--self->m_stuck;
+			}
+			if (done) done(ok);
+			self->onStepDone(runId, index, ok);
+		});
+	});
+}
+
+void MacroRunner::onStepStarted(quint64 runId, int index)
+{
+	auto it = m_runs.find(runId);
+	if (it == m_runs.end() || it->steps[index].state != StepState::Running) return;
+	it->steps[index].startMs = it->elapsed.elapsed();
+	// Stale timeouts find the step settled (or the run gone) and do nothing
+	QTimer::singleShot(it->graph.steps[index].timeoutMs, this, [this, runId, index]() { onStepTimeout(runId, index); });
+}
+
+void MacroRunner::onStepDone(quint64 runId, int index, bool ok)
+{
+	auto it = m_runs.find(runId);
+	if (it == m_runs.end() || it->steps[index].state != StepState::Running) return;
+	if (ok) {
+		settle(*it, runId, index, StepState::Ok);
+	} else {
+		settle(*it, runId, index, StepState::Failed, QStringLiteral("action failed"));
+	}
+	finishIfDone(runId);
+}
+
+void MacroRunner::onStepTimeout(quint64 runId, int index)
+{
+	auto it = m_runs.find(runId);
+	if (it == m_runs.end() || it->steps[index].state != StepState::Running) return;
+	// The handler keeps its pool thread until it returns; only the macro stops waiting
+	const MacroStep &step = it->graph.steps[index];
+	it->steps[index].task->stuck = true;
+	++m_stuck;
+	emit threadStuck(it->graph.name, step.id, m_stuck);
+	settle(*it, runId, index, StepState::TimedOut, QStringLiteral("timed out"));
+	finishIfDone(runId);
+	// Steps still waiting for a thread would wait for good
+	if (m_stuck >= kMaxThreads) failQueued(QStringLiteral("no free thread"));
+}
+
+void MacroRunner::failQueued(const QString &error)
+{
+	const QList<quint64> ids = m_runs.keys();
+	for (const quint64 runId : ids) {
+		Run &run = m_runs[runId];
+		for (int i = 0; i < run.steps.size(); ++i) {
+			StepRun &s = run.steps[i];
+			if (s.state != StepState::Running || s.task->started) continue;
+			s.task->dropped = true;
+			settle(run, runId, i, StepState::Failed, error);
+		}
+		finishIfDone(runId);
+	}
+}
+
+void MacroRunner::settle(Run &run, quint64 runId, int index, StepState state, const QString &error)
+{
+	StepRun &s = run.steps[index];
+	s.state = state;
+	s.endMs = run.elapsed.elapsed();
+	s.error = error;
+	s.task.reset();
+	--run.open;
+	if (state != StepState::Ok) {
+		skipDependents(run, index);
+		return;
+	}
+	for (const int d : run.graph.steps[index].dependents) {
+		if (--run.steps[d].waiting == 0 && run.steps[d].state == StepState::Waiting) launch(run, runId, d);
+	}
+}
+
+void MacroRunner::skipDependents(Run &run, int index)
+{
+	for (const int d : run.graph.steps[index].dependents) {
+		if (run.steps[d].state != StepState::Waiting) continue;
+		run.steps[d].state = StepState::Skipped;
+		--run.open;
+		skipDependents(run, d);
+	}
+}
+
+void MacroRunner::finishIfDone(quint64 runId)
+{
+	auto it = m_runs.constFind(runId);
+	if (it != m_runs.cend() && it->open == 0) finishRun(runId);
+}
+
+void MacroRunner::finishRun(quint64 runId)
+{
+	const Run run = m_runs.take(runId);
+	bool ok = true;
+	QJsonArray steps;
+	for (int i = 0; i < run.steps.size(); ++i) {
+		const MacroStep &step = run.graph.steps[i];
+		const StepRun &s = run.steps[i];
+		QJsonObject result{{"id", step.id}, {"action", step.action}};
+		if (s.state == StepState::Skipped) {
+			result.insert("skipped", true);
+		} else {
+			result.insert("ok", s.state == StepState::Ok);
+			result.insert("startMs", s.startMs);
+			result.insert("ms", s.endMs - s.startMs);
+			if (!s.error.isEmpty()) result.insert("error", s.error);
+		}
+		if (s.state != StepState::Ok) ok = false;
+		steps.append(result);
+	}
+	const QJsonObject result{{"macro", run.graph.name}, {"ok", ok}, {"elapsedMs", run.elapsed.elapsed()}, {"steps", steps}};
+	emit finished(run.graph.name, QJsonDocument(result).toJson(QJsonDocument::Compact), ok);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include "../actions/macro.h"
+
+// Runs MacroGraphs. A step starts as soon as every step it waits for has
+// succeeded, so independent steps run side by side on a small thread pool and
+// a macro takes as long as its longest dependency chain, not the sum of its
+// steps. Each step has its own timeout; a step that fails or times out skips
+// everything that depends on it while unrelated branches carry on. Each run
+// ends with one finished() carrying the combined result:
+//   {"macro":"Evening","ok":false,"elapsedMs":812,"steps":[
+//     {"id":"Browser","action":"Browser","ok":true,"startMs":0,"ms":640},
+//     {"id":"Mail","action":"Mail","ok":false,"startMs":0,"ms":5000,"error":"timed out"},
+//     {"id":"Lock","action":"Lock","skipped":true}]}
+// All bookkeeping, the preparer, Job::started and Job::done run on the
+// owner's thread; only Job::run goes to the pool. A step's timeout (and its
+// startMs) counts from the moment a pool thread picks it up, not from when it
+// was queued, and a step settled while still queued (cancelAll()) never runs.
+// A handler that outlives its timeout keeps its thread; threadStuck() reports
+// each one, stuckThreads() counts them, and once all kMaxThreads are held,
+// steps that can't get a thread fail with "no free thread" instead of
+// waiting forever.
+class MacroRunner : public QObject {
+	Q_OBJECT
+public:
+	struct Job {
+		std::function<void()> started;      // on the owner's thread when a pool thread picks the step up
+		std::function<bool()> run;          // on a pool thread; must not touch the owner
+		std::function<void(bool ok)> done;  // on the owner's thread once run returns, even after a timeout
+	};
+	// Resolves one step into the work to do; false with a reason in *error if
+	// it cannot run
+	using StepPreparer = std::function<bool(const MacroStep &step, const QString &macro, Job *job, QString *error)>;
+	static constexpr int kMaxThreads = 8;
+	static constexpr int kMaxRunning = 8;
+	// How long destruction waits for handlers still running
+	static constexpr int kShutdownWaitMs = 1000;
+
+	explicit MacroRunner(StepPreparer preparer, QObject *parent = nullptr);
+	// Waits up to kShutdownWaitMs for steps still running on the pool, then
+	// leaves their threads behind (and logs how many)
+	~MacroRunner() override;
+
+	// Starts a run of graph; false with a reason if that macro is already
+	// running or kMaxRunning macros are
+	bool start(const MacroGraph &graph, QString *error);
+	// Skips whatever has not finished; steps still queued for a thread never
+	// run, steps already running go on to the end, but their results are dropped
+	void cancelAll();
+	bool isBusy() const { return !m_runs.isEmpty(); }
+	// Pool threads still inside a handler whose step already timed out
+	int stuckThreads() const { return m_stuck; }
+
+signals:
+	void finished(const QString &macro, const QByteArray &resultJson, bool ok);
+	// A step timed out while its handler still runs; stuck counts them all
+	void threadStuck(const QString &macro, const QString &step, int stuck);
+
+private:
+	enum class StepState { Waiting, Running, Ok, Failed, TimedOut, Skipped };
+	// Where pool threads post their results; cleared when the runner goes, as
+	// a stuck handler may outlive it
+	struct Owner {
+		QMutex mutex;
+		MacroRunner *runner = nullptr;
+		// Queues f(runner) to the runner's thread unless the runner is gone
+		template <typename F>
+		void post(F f)
+		{
+			QMutexLocker lock(&mutex);
+			if (!runner) return;
+			MacroRunner *r = runner;
+			QMetaObject::invokeMethod(r, [r, f]() { f(r); }, Qt::QueuedConnection);
+		}
+	};
+	// Shared by a step's bookkeeping and its pool task, which may outlive the run
+	struct Task {
+		std::atomic<bool> dropped{false};  // settled while queued: the pool thread skips it
+		bool started = false;              // owner's thread: a pool thread picked it up
+		bool stuck = false;                // owner's thread: timed out, handler still running
+	};
+	struct StepRun {
+		StepState state = StepState::Waiting;
+		int waiting = 0;          // dependencies not yet succeeded
+		qint64 startMs = 0;
+		qint64 endMs = 0;
+		QString error;
+		std::shared_ptr<Task> task;   // while Running
+	};
+	struct Run {
+		MacroGraph graph;
+		QVector<StepRun> steps;
+		int open = 0;             // steps not yet in a final state
+		QElapsedTimer elapsed;
+	};
+
+	// Prepares the step and hands it to the pool
+	void launch(Run &run, quint64 runId, int index);
+	void onStepStarted(quint64 runId, int index);
+	void onStepDone(quint64 runId, int index, bool ok);
+	void onStepTimeout(quint64 runId, int index);
+	// Fails every step still queued for a thread, e.g. when none is left
+	void failQueued(const QString &error);
+	// Records a final state and releases or skips the dependents
+	void settle(Run &run, quint64 runId, int index, StepState state, const QString &error = QString());
+	void skipDependents(Run &run, int index);
+	void finishIfDone(quint64 runId);
+	void finishRun(quint64 runId);
+
+	StepPreparer m_preparer;
+	std::shared_ptr<Owner> m_owner;
+	QThreadPool *m_pool;   // left to the process if a handler never returns
+	QHash<quint64, Run> m_runs;
+	quint64 m_nextRunId = 1;
+	int m_stuck = 0;
+};
@@ -0,0 +1,61 @@
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include "mqtt_daemon.h"
+#include "service_logging.h"
+#include "ipc_server.h"
+#include "systemd_host.h"
+#include "../common/ipc_auth.h"
+// Linux entry point: runs the same daemon core as MPMService, either in a
+// terminal (perf/heaptrack) or as a systemd Type=notify service.
+
+static void printUsage()
+{
+	QTextStream ts(stdout);
+	ts << "Usage:\n";
+	ts << "  mpm-daemon           Run the service in the foreground\n";
+	ts << "  mpm-daemon --idle-exit SECONDS\n";
+	ts << "                       Exit after SECONDS without IPC clients or broker session\n";
+	ts << "                       (only while autoConnect is off; for socket activation)\n";
+	ts << "  mpm-daemon --init-token\n";
+	ts << "                       Create the IPC token if missing and exit (mpm-daemon.socket\n";
+	ts << "                       runs this so clients can authenticate before the first start)\n";
+	ts << "  mpm-daemon --help    Show this help\n";
+	ts << "SIGTERM or SIGINT publishes the offline status and exits; SIGHUP reloads the settings.\n";
+	ts << "Under systemd (NOTIFY_SOCKET set) readiness and the watchdog are reported via sd_notify.\n";
+}
+
+int main(int argc, char *argv[])
+{
+	QStringList args;
+	for (int i = 0; i < argc; ++i) args << QString::fromLocal8Bit(argv[i]);
+	if (args.contains("--help") || args.contains("-h")) {
+		printUsage();
+		return 0;
+	}
+
+	QCoreApplication app(argc, argv);
+	QCoreApplication::setApplicationName("mpm-daemon");
+	if (args.contains("--init-token")) return loadOrCreateIpcToken().isEmpty() ? 1 : 0;
+	initializeServiceLogging();
+	qInfo() << "mpm-daemon starting (v1.0.0)";
+
+	SystemdHost host;
+	if (!host.installSignalHandlers()) return 1;
+
+	MqttDaemon daemon;
+	IpcServer ipc(&daemon);
+	// Socket activation hands over the listening endpoint; otherwise bind it here
+	const qintptr listenFd = SystemdHost::takeListenFd();
+	if (listenFd >= 0) ipc.adopt(listenFd);
+	else ipc.start();
+	host.attach(&daemon);
+	const int idleIdx = args.indexOf("--idle-exit");
+	if (idleIdx != -1 && idleIdx + 1 < args.size()) host.enableIdleExit(args.at(idleIdx + 1).toInt(), &ipc);
+	QObject::connect(&app, &QCoreApplication::aboutToQuit, &daemon, [&daemon]() {
+		qInfo() << "mpm-daemon stopping";
+		daemon.notifyGoingOffline();
+	});
+	daemon.start();
+	return app.exec();
+}
@@ -6,7 +6,7 @@
 #include "win_service.h"
 #include "mqtt_daemon.h"
 #include "../common/settings.h"
-#include "../common/logging.h"
+#include "service_logging.h"
 #include "ipc_server.h"
 #include <windows.h>
 #include <shellapi.h>
@@ -222,8 +222,7 @@ int main(int argc, char *argv[])
 		char appName[] = "MPMService";
 		char *qtArgv[] = { appName };
 		QCoreApplication app(qtArgc, qtArgv);
-		initializeFileLogger("C:/ProgramData/MPM/MPMService.log", true);
-		enableInMemoryLogCapture(500);
+		initializeServiceLogging();
 		qInfo() << "MPMService console run starting";
 		MqttDaemon daemon;
 		IpcServer ipc(&daemon);
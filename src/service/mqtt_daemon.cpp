@@ -1,14 +1,24 @@
 #include "mqtt_daemon.h"
 #include "../common/settings.h"
-#include "../common/crypto_win.h"
+#include "../common/secret_store.h"
+#include "../common/logging.h"
+#include "../common/log_categories.h"
+#include "log_forwarder.h"
+#include "batch_executor.h"
 
 #include <QCoreApplication>
 #include <QDebug>
 #include <QTimer>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QJsonDocument>
+#include <QJsonObject>
 
 MqttDaemon::MqttDaemon(QObject *parent)
 	: QObject(parent)
-	, m_settings(mpmCreateSharedSettings())
 {
 	m_client = new QMqttClient(this);
 	connect(m_client, &QMqttClient::connected, this, &MqttDaemon::onConnected);
@@ -17,92 +27,217 @@ MqttDaemon::MqttDaemon(QObject *parent)
 	connect(m_client, &QMqttClient::errorChanged, this, &MqttDaemon::onErrorChanged);
 	m_reconnectTimer = new QTimer(this);
 	m_reconnectTimer->setSingleShot(false);
+	// Keeps the status page heartbeat fresh so observers can detect a dead service
+	m_heartbeatTimer = new QTimer(this);
+	m_heartbeatTimer->setInterval(1000);
+	connect(m_heartbeatTimer, &QTimer::timeout, this, &MqttDaemon::heartbeatStatus);
+	m_logForwarder = new MqttLogForwarder(m_client, this);
+	m_batches = new BatchExecutor([this](const BatchStep &step, const QString &batchId, QString *error) {
+		return runBatchStep(step, batchId, error);
+	}, this);
+	connect(m_batches, &BatchExecutor::finished, this, &MqttDaemon::publishBatchResult);
+	m_macroRunner = new MacroRunner([this](const MacroStep &step, const QString &macro, MacroRunner::Job *job, QString *error) {
+		return prepareMacroStep(step, macro, job, error);
+	}, this);
+	connect(m_macroRunner, &MacroRunner::finished, this, &MqttDaemon::publishMacroResult);
+	connect(m_macroRunner, &MacroRunner::threadStuck, this, [](const QString &macro, const QString &step, int stuck) {
+		qCWarning(lcActions) << "Macro" << macro << "step" << step << "timed out; its handler still holds a thread ("
+		                     << stuck << "of" << MacroRunner::kMaxThreads << "held)";
+	});
+	// Editors and QSettings write in bursts; coalesce them into one reload
+	m_reloadDebounce = new QTimer(this);
+	m_reloadDebounce->setSingleShot(true);
+	m_reloadDebounce->setInterval(250);
+	connect(m_reloadDebounce, &QTimer::timeout, this, &MqttDaemon::reloadSettings);
 }
 
 void MqttDaemon::start()
 {
-	loadSettings();
+	// Cold start from the compiled snapshot if the INI hasn't changed since it
+	// was built; the INI itself is checked once the broker connection is up
+	m_startedFromSnapshot = loadSnapshot();
+	if (!m_startedFromSnapshot) loadSettings();
 	applyToClient();
-	if (m_autoConnect) {
-		qInfo() << "Auto-connect enabled";
+	if (!m_statusPage.open()) qCWarning(lcIpc) << "Status page unavailable; observers must poll over IPC";
+	m_heartbeatTimer->start();
+	publishStatus();
+	if (m_config.autoConnect) {
+		qCInfo(lcMqtt) << "Auto-connect enabled";
 		m_userInitiatedDisconnect = false;
 		m_client->connectToHost();
 	}
 	// Auto-reconnect loop
-	m_reconnectTimer->setInterval(qMax(1000, m_reconnectSec * 1000));
+	m_reconnectTimer->setInterval(qMax(1000, m_config.reconnectSec * 1000));
 	connect(m_reconnectTimer, &QTimer::timeout, this, [this]() {
-		if (!m_autoReconnect) return;
+		if (!m_config.autoReconnect) return;
 		if (m_userInitiatedDisconnect) return;
 		if (m_client->state() == QMqttClient::Disconnected) {
-			qInfo() << "MQTT reconnecting...";
+			qCInfo(lcMqtt) << "MQTT reconnecting...";
 			m_client->connectToHost();
 		}
 	});
+	// onConnected() finishes earlier; the timeout covers an unreachable broker
+	const bool waitForBroker = m_startedFromSnapshot && m_config.autoConnect;
+	QTimer::singleShot(waitForBroker ? 10000 : 0, this, &MqttDaemon::finishStartup);
 }
 
-void MqttDaemon::reloadSettings()
+void MqttDaemon::finishStartup()
 {
-	qInfo() << "Reloading settings";
-	m_settings.sync();
-	const QString oldHost = m_host;
-	const quint16 oldPort = m_port;
-	const QString oldUser = m_mqttUser;
-	const QString oldPass = m_mqttPassword;
-	const bool oldAutoReconnect = m_autoReconnect;
-	// Fresh QSettings to force reread
-	QSettings fresh(mpmSharedSettingsFilePath(), QSettings::IniFormat);
-	loadSettings(&fresh);
-	applyToClient();
-	m_reconnectTimer->setInterval(qMax(1000, m_reconnectSec * 1000));
-	// If connection parameters changed and we're connected, reconnect to apply
-	if (m_client->state() == QMqttClient::Connected && (m_host != oldHost || m_port != oldPort || m_mqttUser != oldUser || m_mqttPassword != oldPass)) {
-		qInfo() << "Connection params changed; reconnecting";
-		m_userInitiatedDisconnect = false;
-		m_client->disconnectFromHost();
-		// Let onStateChanged schedule reconnect
+	if (m_startupFinished) return;
+	m_startupFinished = true;
+	// Creates the INI and fixes its ACLs on first run
+	const QString path = mpmSharedSettingsFilePath();
+	watchSettingsFile();
+	if (!m_startedFromSnapshot) {
+		writeSnapshot(m_snapshotSource);
+		return;
 	}
-	// If autoConnect is enabled and we're disconnected, connect now
-	// Do not auto-connect if user explicitly requested disconnect
-	if (m_autoConnect && m_client->state() == QMqttClient::Disconnected && !m_userInitiatedDisconnect) {
-		m_client->connectToHost();
+	const DaemonConfig::SourceStamp current = DaemonConfig::stampFile(path, true);
+	if (!current.sha256.isEmpty() && current.sha256 == m_snapshotSource.sha256) {
+		qCDebug(lcSettings) << "Settings snapshot confirmed against" << path;
+		return;
 	}
-	// If autoReconnect toggled on while disconnected, start timer
-	if (!oldAutoReconnect && m_autoReconnect && m_client->state() == QMqttClient::Disconnected && !m_userInitiatedDisconnect) {
-		m_reconnectTimer->start();
+	qCInfo(lcSettings) << "Settings snapshot is stale; reloading" << path;
+	reloadSettings();
+}
+
+bool MqttDaemon::loadSnapshot()
+{
+	const QString ini = mpmLocateSharedSettingsFile();
+	const QString path = DaemonConfig::snapshotPathFor(ini);
+	DaemonConfig config;
+	if (!DaemonConfig::readSnapshot(path, DaemonConfig::stampFile(ini, false), &config, &m_snapshotSource)) {
+		qCDebug(lcSettings) << "No usable settings snapshot at" << path;
+		return false;
+	}
+	applyConfig(std::move(config), DaemonConfig::AllSections, true);
+	qCInfo(lcSettings) << "Settings loaded from snapshot" << path;
+	return true;
+}
+
+void MqttDaemon::writeSnapshot(const DaemonConfig::SourceStamp &source)
+{
+	const QString path = DaemonConfig::snapshotPathFor(mpmLocateSharedSettingsFile());
+	// Nothing to stamp until the INI exists
+	if (source.size < 0) return;
+	if (!m_config.writeSnapshot(path, source)) {
+		qCWarning(lcSettings) << "Could not write settings snapshot" << path;
+		return;
 	}
+	m_snapshotSource = source;
 }
 
-void MqttDaemon::loadSettings(QSettings *source)
+void MqttDaemon::watchSettingsFile()
 {
-	QSettings &S = source ? *source : m_settings;
-	m_username = S.value("user/customId").toString().trimmed();
-	m_host = S.value("mqtt/host", "127.0.0.1").toString();
-	m_port = static_cast<quint16>(S.value("mqtt/port", 1883).toInt());
-	m_mqttUser = S.value("mqtt/username").toString();
-	{
-		const QByteArray enc = S.value("mqtt/passwordEnc").toByteArray();
-		QByteArray plain = dpapiDecryptBase64(enc);
-		if (plain.isEmpty()) {
-			// Fallback to legacy plaintext if present
-			m_mqttPassword = S.value("mqtt/password").toString();
-		} else {
-			m_mqttPassword = QString::fromUtf8(plain);
+	const QString path = mpmSharedSettingsFilePath();
+	m_settingsWatcher = new QFileSystemWatcher(this);
+	m_settingsWatcher->addPath(path);
+	// Save-by-rename drops the file watch; the directory tells us when it is back
+	m_settingsWatcher->addPath(QFileInfo(path).absolutePath());
+	auto rewatch = [this, path]() {
+		if (m_settingsWatcher->files().contains(path) || !QFile::exists(path)) return false;
+		m_settingsWatcher->addPath(path);
+		return true;
+	};
+	connect(m_settingsWatcher, &QFileSystemWatcher::fileChanged, this, [this, rewatch]() {
+		rewatch();
+		m_reloadDebounce->start();
+	});
+	connect(m_settingsWatcher, &QFileSystemWatcher::directoryChanged, this, [this, rewatch]() {
+		if (rewatch()) m_reloadDebounce->start();
+	});
+}
+
+void MqttDaemon::reloadSettings()
+{
+	m_reloadDebounce->stop();
+	QElapsedTimer timer;
+	timer.start();
+	const QString path = mpmSharedSettingsFilePath();
+	// Stamped before parsing so a write racing the parse leaves the snapshot stale, not wrong
+	const DaemonConfig::SourceStamp source = DaemonConfig::stampFile(path, true);
+	// Fresh QSettings to force reread
+	QSettings fresh(path, QSettings::IniFormat);
+	DaemonConfig next = DaemonConfig::fromSettings(fresh);
+	const int sections = DaemonConfig::diff(m_config, next);
+	const int changed = applyConfig(std::move(next), sections, false);
+	const qint64 us = timer.nsecsElapsed() / 1000;
+	if (source.sha256 != m_snapshotSource.sha256) writeSnapshot(source);
+	++m_counters.reloads;
+	m_counters.lastReloadUs = us;
+	qCInfo(lcSettings) << "Settings reloaded in" << us << "us; changed:" << DaemonConfig::describe(changed);
+	publishStatus();
+}
+
+void MqttDaemon::loadSettings()
+{
+	const QString path = mpmLocateSharedSettingsFile();
+	m_snapshotSource = DaemonConfig::stampFile(path, true);
+	QSettings S(path, QSettings::IniFormat);
+	applyConfig(DaemonConfig::fromSettings(S), DaemonConfig::AllSections, true);
+}
+
+int MqttDaemon::applyConfig(DaemonConfig next, int sections, bool initial)
+{
+	const bool wasAutoReconnect = m_config.autoReconnect;
+	// The cache decrypts only when the ciphertext changes, wiping the old
+	// plaintext. Re-protecting the same password still yields new ciphertext,
+	// so compare plaintext against what the client holds before reconnecting.
+	if (initial || next.passwordEnc != m_config.passwordEnc || next.legacyPassword != m_config.legacyPassword) {
+		const SecretBuffer &plain = m_passwordCache.reveal(next.passwordEnc);
+		// Fallback to legacy plaintext if present
+		const QString password = plain.isEmpty() ? next.legacyPassword : plain.toString();
+		if (password != m_client->password()) sections |= DaemonConfig::ConnectionSection;
+	}
+	// Swapped in one assignment on the event-loop thread, so a message is
+	// always matched against either the old or the new action list
+	m_config = std::move(next);
+	if (sections & DaemonConfig::ActionsSection) {
+		m_dispatcher.setActions(m_config.actions);
+		m_invalidActions = m_dispatcher.invalidActions();
+		compileMacros();
+	}
+	if (sections & DaemonConfig::OptionsSection) selectActionBackend();
+	if (sections & DaemonConfig::LoggingSection) applyLogLevels(m_config.logLevels);
+	// The log topic follows the user id
+	if (sections & (DaemonConfig::LoggingSection | DaemonConfig::ConnectionSection)) {
+		m_logForwarder->configure(logTopic(), m_config.logForward);
+	}
+	if (initial) return sections;
+
+	if (sections & DaemonConfig::ConnectionSection) {
+		applyToClient();
+		// Reconnect so the new broker, credentials and topics take effect
+		if (m_client->state() != QMqttClient::Disconnected) {
+			qCInfo(lcMqtt) << "Connection params changed; reconnecting";
+			m_userInitiatedDisconnect = false;
+			// onStateChanged connects again once the old session is down,
+			// with or without autoReconnect
+			m_reconnectPending = m_config.autoConnect;
+			m_client->disconnectFromHost();
+		} else if (m_config.autoConnect && !m_userInitiatedDisconnect) {
+			m_client->connectToHost();
 		}
 	}
-	m_autoConnect = S.value("options/autoConnect", false).toBool();
-	m_autoReconnect = S.value("options/autoReconnect", false).toBool();
-	m_reconnectSec = qMax(1, S.value("options/reconnectSec", 5).toInt());
-	m_printOnly = S.value("options/printOnly", false).toBool();
-	loadActions(&S);
+	if (sections & DaemonConfig::OptionsSection) {
+		m_reconnectTimer->setInterval(qMax(1000, m_config.reconnectSec * 1000));
+		const bool idle = m_client->state() == QMqttClient::Disconnected && !m_userInitiatedDisconnect;
+		// Do not auto-connect if user explicitly requested disconnect
+		if (m_config.autoConnect && idle) m_client->connectToHost();
+		if (!wasAutoReconnect && m_config.autoReconnect && idle) m_reconnectTimer->start();
+		if (!m_config.autoReconnect) m_reconnectTimer->stop();
+	}
+	return sections;
 }
 
 void MqttDaemon::applyToClient()
 {
-	m_client->setHostname(m_host);
-	m_client->setPort(m_port);
+	m_client->setHostname(m_config.host);
+	m_client->setPort(m_config.port);
 	m_client->setClientId("MPMService");
-	m_client->setUsername(m_mqttUser);
-	m_client->setPassword(m_mqttPassword);
+	m_client->setUsername(m_config.mqttUser);
+	const SecretBuffer &password = m_passwordCache.current();
+	m_client->setPassword(password.isEmpty() ? m_config.legacyPassword : password.toString());
 	// LWT
 	const QString topic = availabilityTopic();
 	if (!topic.isEmpty()) {
@@ -115,50 +250,136 @@ void MqttDaemon::applyToClient()
 
 QString MqttDaemon::subscribeTopic() const
 {
-	if (m_username.isEmpty()) return QString();
-	return QString("mqttpowermanager/%1/+" ).arg(m_username);
+	if (m_config.username.isEmpty()) return QString();
+	return QString("mqttpowermanager/%1/+" ).arg(m_config.username);
+}
+
+QString MqttDaemon::logTopic() const
+{
+	if (m_config.username.isEmpty()) return QString();
+	return QString("mqttpowermanager/%1/log").arg(m_config.username);
+}
+
+QString MqttDaemon::batchResultTopic() const
+{
+	if (m_config.username.isEmpty()) return QString();
+	return QString("mqttpowermanager/%1/batch/result").arg(m_config.username);
+}
+
+QString MqttDaemon::macroResultTopic() const
+{
+	if (m_config.username.isEmpty()) return QString();
+	return QString("mqttpowermanager/%1/macro/result").arg(m_config.username);
+}
+
+quint64 MqttDaemon::logLinesDropped() const
+{
+	return m_logForwarder ? m_logForwarder->droppedLines() : 0;
 }
 
 QString MqttDaemon::availabilityTopic() const
 {
-	if (m_username.isEmpty()) return QString();
-	return QString("mqttpowermanager/%1/health").arg(m_username);
+	if (m_config.username.isEmpty()) return QString();
+	return QString("mqttpowermanager/%1/health").arg(m_config.username);
 }
 
 void MqttDaemon::onConnected()
 {
 	const QString topic = subscribeTopic();
 	if (!topic.isEmpty()) {
-		qInfo() << "Subscribed to" << topic;
+		qCInfo(lcMqtt) << "Subscribed to" << topic;
 		m_client->subscribe(topic, 0);
 	} else {
-		qWarning() << "Username/customId is empty; no subscription";
+		qCWarning(lcMqtt) << "Username/customId is empty; no subscription";
 	}
 	if (m_client->state() == QMqttClient::Connected) {
 		m_client->publish(availabilityTopic(), QByteArrayLiteral("online"), 0, true);
 	}
 	m_userInitiatedDisconnect = false;
+	++m_counters.connects;
+	publishStatus();
+	emit sessionReady();
+	if (!m_startupFinished) QTimer::singleShot(0, this, &MqttDaemon::finishStartup);
 }
 
 void MqttDaemon::onStateChanged(QMqttClient::ClientState state)
 {
 	switch (state) {
-	case QMqttClient::Disconnected: qInfo() << "MQTT state: Disconnected"; break;
-	case QMqttClient::Connecting: qInfo() << "MQTT state: Connecting"; break;
-	case QMqttClient::Connected: qInfo() << "MQTT state: Connected"; break;
+	case QMqttClient::Disconnected: qCInfo(lcMqtt) << "MQTT state: Disconnected"; break;
+	case QMqttClient::Connecting: qCInfo(lcMqtt) << "MQTT state: Connecting"; break;
+	case QMqttClient::Connected: qCInfo(lcMqtt) << "MQTT state: Connected"; break;
+	}
+	if (state == QMqttClient::Disconnected && m_reconnectPending) {
+		m_reconnectPending = false;
+		// Not from inside the client's own state change
+		if (!m_userInitiatedDisconnect) {
+			QTimer::singleShot(0, this, [this]() {
+				if (!m_userInitiatedDisconnect && m_client->state() == QMqttClient::Disconnected) m_client->connectToHost();
+			});
+		}
 	}
 	// Manage reconnect timer based on state and flags
-	if (!m_autoReconnect || m_userInitiatedDisconnect) {
+	if (!m_config.autoReconnect || m_userInitiatedDisconnect) {
 		m_reconnectTimer->stop();
 	} else {
 		if (state == QMqttClient::Disconnected) m_reconnectTimer->start();
 		else m_reconnectTimer->stop();
 	}
+	publishStatus();
+	emit brokerStateChanged(state);
 }
 
 void MqttDaemon::onErrorChanged(QMqttClient::ClientError error)
 {
-	if (error != QMqttClient::NoError) qWarning() << "MQTT error:" << static_cast<int>(error);
+	if (error != QMqttClient::NoError) qCWarning(lcMqtt) << "MQTT error:" << static_cast<int>(error);
+	m_lastError = error;
+	publishStatus();
+}
+
+ServiceStatusSnapshot MqttDaemon::statusSnapshot() const
+{
+	ServiceStatusSnapshot s;
+	s.pid = QCoreApplication::applicationPid();
+	s.heartbeatMs = QDateTime::currentMSecsSinceEpoch();
+	s.state = static_cast<int>(state());
+	s.reconnectActive = isReconnectActive();
+	s.autoReconnect = m_config.autoReconnect;
+	s.userInitiated = m_userInitiatedDisconnect;
+	s.lastError = static_cast<int>(m_lastError);
+	s.messagesReceived = m_counters.messagesReceived;
+	s.messagesIgnored = m_counters.messagesIgnored;
+	s.actionsExecuted = m_counters.actionsExecuted;
+	s.actionsFailed = m_counters.actionsFailed;
+	s.actionsSimulated = m_counters.actionsSimulated;
+	s.actionsInvalid = quint64(m_invalidActions.size());
+	s.connects = m_counters.connects;
+	return s;
+}
+
+void MqttDaemon::publishStatus()
+{
+	if (!m_statusPage.isOpen()) return;
+	m_lastStatus = statusSnapshot();
+	m_statusPage.publish(m_lastStatus);
+}
+
+void MqttDaemon::heartbeatStatus()
+{
+	if (!m_statusPage.isOpen()) return;
+	const ServiceStatusSnapshot s = statusSnapshot();
+	const ServiceStatusSnapshot &l = m_lastStatus;
+	// Anything that changed without a publishStatus() still goes out as a new generation
+	const bool same = s.pid == l.pid && s.state == l.state && s.reconnectActive == l.reconnectActive
+	               && s.autoReconnect == l.autoReconnect && s.userInitiated == l.userInitiated
+	               && s.lastError == l.lastError && s.messagesReceived == l.messagesReceived
+	               && s.messagesIgnored == l.messagesIgnored && s.actionsExecuted == l.actionsExecuted
+	               && s.actionsFailed == l.actionsFailed && s.connects == l.connects
+	               && s.actionsSimulated == l.actionsSimulated && s.actionsInvalid == l.actionsInvalid;
+	if (!same) {
+		publishStatus();
+		return;
+	}
+	m_statusPage.heartbeat(s.heartbeatMs);
 }
 
 void MqttDaemon::publishAvailabilityOnline()
@@ -181,56 +402,266 @@ void MqttDaemon::publishAvailabilityOffline()
 
 void MqttDaemon::notifyGoingOffline()
 {
-	qInfo() << "Service shutting down: publishing offline";
+	qCInfo(lcMqtt) << "Service shutting down: publishing offline";
+	// Delayed steps must not fire while (or after) the process goes down
+	m_batches->cancelAll();
+	m_macroRunner->cancelAll();
 	publishAvailabilityOffline();
 }
 
-void MqttDaemon::loadActions(QSettings *source)
+bool MqttDaemon::runAction(const QString &name)
+{
+	const ActionConfig *it = m_dispatcher.findByName(name);
+	if (!it) {
+		if (const MacroGraph *macro = findMacro(name)) return startMacro(*macro, QStringLiteral("ipc"));
+		qCWarning(lcActions) << "Run action: no configured action named" << name;
+		return false;
+	}
+	// No payload to fill placeholders from
+	ActionCall call;
+	if (!m_dispatcher.argumentsFor(it, &call.args)) {
+		qCWarning(lcActions) << "Run action:" << it->customName << "needs a message matching" << it->expectedMessage;
+		return false;
+	}
+	qCInfo(lcActions) << "Executing action (IPC) name=" << it->customName << "type=" << it->typeName << "params=" << it->params;
+	return executeAction(*it, call, QStringLiteral("ipc"));
+}
+
+void MqttDaemon::setActionBackend(std::unique_ptr<ActionBackend> backend)
 {
-	m_actions.clear();
-	QSettings &S = source ? *source : m_settings;
-	int size = S.beginReadArray("actions");
-	for (int i = 0; i < size; ++i) {
-		S.setArrayIndex(i);
-		UserActionCfg a;
-		a.customName = S.value("name").toString();
-		a.expectedMessage = S.value("message", "PRESS").toString();
-		a.exePath = S.value("exePath").toString();
-		QString typeStr = S.value("type", "Shutdown").toString();
-		ActionType t;
-		if (!ActionsRegistry::fromString(typeStr, t)) t = ActionType::Shutdown;
-		a.type = t;
-		if (!a.customName.isEmpty()) m_actions.push_back(a);
+	m_backendPinned = backend != nullptr;
+	if (backend) {
+		m_backend = std::move(backend);
+		qCInfo(lcActions) << "Action backend:" << m_backend->name() << "(pinned)";
+	} else {
+		selectActionBackend();
+	}
+}
+
+void MqttDaemon::selectActionBackend()
+{
+	if (m_backendPinned) return;
+	// MPM_ACTION_BACKEND (e.g. "recording") turns any host into a dry-run rig
+	QString name = qEnvironmentVariable("MPM_ACTION_BACKEND");
+	if (name.isEmpty()) name = m_config.printOnly ? QStringLiteral("print-only") : QStringLiteral("native");
+	if (m_backend && m_backend->name().compare(name, Qt::CaseInsensitive) == 0) return;
+	std::unique_ptr<ActionBackend> next = createActionBackend(name);
+	if (!next) {
+		qCWarning(lcActions) << "Unknown action backend" << name << "; known:" << actionBackendNames().join(", ");
+		next = createActionBackend(m_config.printOnly ? QStringLiteral("print-only") : QStringLiteral("native"));
 	}
-	S.endArray();
+	m_backend = std::move(next);
+	qCInfo(lcActions) << "Action backend:" << m_backend->name();
+}
+
+bool MqttDaemon::executeAction(const DaemonConfig::Action &action, const ActionCall &call, const QString &source)
+{
+	beginAction(action, call, source);
+	if (!m_backend) selectActionBackend();
+	const bool ok = m_backend->execute(action, call);
+	finishAction(action, ok);
+	return ok;
+}
+
+void MqttDaemon::beginAction(const DaemonConfig::Action &action, const ActionCall &call, const QString &source)
+{
+	QStringList params;
+	for (auto p = action.params.cbegin(); p != action.params.cend(); ++p) params << p.key() + '=' + p.value();
+	// Written straight into the mapped file, so it survives if the action takes the process down
+	logBinaryEvent(QtInfoMsg, "mpm.actions", QStringLiteral("action.start"),
+	               {{"name", action.customName}, {"type", action.typeName}, {"params", params.join(' ')}, {"args", call.args.join(' ')}, {"source", source}});
+}
+
+void MqttDaemon::finishAction(const DaemonConfig::Action &action, bool ok)
+{
+	logBinaryEvent(ok ? QtInfoMsg : QtWarningMsg, "mpm.actions", QStringLiteral("action.end"),
+	               {{"name", action.customName}, {"ok", ok}});
+	if (ok && isSimulating()) {
+		++m_counters.actionsSimulated;
+	} else if (ok) {
+		++m_counters.actionsExecuted;
+	} else {
+		++m_counters.actionsFailed;
+		qCWarning(lcActions) << "Action execution returned false for" << action.typeName << "params=" << action.params;
+	}
+	publishStatus();
 }
 
 void MqttDaemon::onMessageReceived(const QByteArray &message, const QMqttTopicName &topic)
 {
-	const QString msg = QString::fromUtf8(message);
-	if (topic.name().endsWith("/health")) return;
-	qInfo() << "Received message:" << msg << "on topic:" << topic.name();
-	const QStringList parts = topic.name().split('/');
-	const QString actionName = parts.size() >= 3 ? parts.last() : QString();
-	if (m_printOnly) { qInfo() << "Print only mode enabled — ignoring commands."; return; }
-	auto it = std::find_if(m_actions.begin(), m_actions.end(), [&](const UserActionCfg &a){
-		return a.customName.compare(actionName, Qt::CaseInsensitive) == 0 &&
-		       msg.compare(a.expectedMessage, Qt::CaseInsensitive) == 0;
-	});
-	if (it == m_actions.end()) {
-		qInfo() << "Message ignored" << msg << "topic" << topic.name();
+	dispatchMessage(message, topic.name());
+}
+
+void MqttDaemon::dispatchMessage(const QByteArray &message, const QString &topic)
+{
+	const ActionDispatcher::Route route = m_dispatcher.route(topic, message);
+	if (route.kind == ActionDispatcher::Route::Internal) return;
+	++m_counters.messagesReceived;
+	qCDebug(lcDispatch) << "Received message:" << QString::fromUtf8(message) << "on topic:" << topic;
+	if (route.kind == ActionDispatcher::Route::Batch) {
+		submitBatch(message);
+		return;
+	}
+	const ActionConfig *it = route.action;
+	if (!it) {
+		// Actions win over a macro of the same name
+		const MacroGraph *macro = findMacro(route.actionName);
+		if (macro && QString::fromUtf8(message).compare(macro->expectedMessage, Qt::CaseInsensitive) == 0) {
+			startMacro(*macro, topic);
+			return;
+		}
+		qCDebug(lcDispatch) << "Message ignored" << QString::fromUtf8(message) << "topic" << topic;
+		++m_counters.messagesIgnored;
+		publishStatus();
 		return;
 	}
-	const QString typeStr = ActionsRegistry::toString(it->type);
-	qInfo() << "Executing action name=" << it->customName
-	       << "type=" << typeStr
+	qCInfo(lcActions) << "Executing action name=" << it->customName
+	       << "type=" << it->typeName
 	       << "expectedMsg=" << it->expectedMessage
-	       << "topic=" << topic.name()
-	       << "exePath=" << it->exePath;
-	const bool ok = ActionsRegistry::execute(it->type, it->exePath);
-	if (!ok) {
-		qWarning() << "Action execution returned false for" << typeStr << "exePath=" << it->exePath;
+	       << "topic=" << topic
+	       << "params=" << it->params;
+	executeAction(*it, route.call, topic);
+}
+
+void MqttDaemon::submitBatch(const QByteArray &message)
+{
+	BatchRequest request;
+	QString error;
+	if (!BatchRequest::parse(message, &request, &error)) {
+		qCWarning(lcDispatch) << "Batch message refused:" << error;
+		++m_counters.messagesIgnored;
+		publishBatchResult(QJsonDocument(QJsonObject{{"ok", false}, {"error", error}}).toJson(QJsonDocument::Compact), false);
+		publishStatus();
+		return;
+	}
+	const QString id = request.id;
+	const int steps = request.steps.size();
+	if (!m_batches->submit(std::move(request))) {
+		qCWarning(lcDispatch) << "Batch" << id << "refused: too many batches queued";
+		QJsonObject result{{"ok", false}, {"error", QStringLiteral("busy")}};
+		if (!id.isEmpty()) result.insert("id", id);
+		publishBatchResult(QJsonDocument(result).toJson(QJsonDocument::Compact), false);
+		return;
 	}
+	qCInfo(lcActions) << "Batch" << id << "queued with" << steps << "step(s)";
 }
 
+bool MqttDaemon::resolveStep(const QString &actionName, const QByteArray &message, const ActionConfig **action,
+                             ActionCall *call, QString *error) const
+{
+	if (message.isNull()) {
+		*action = m_dispatcher.findByName(actionName);
+		if (!*action) {
+			*error = QStringLiteral("no such action");
+			return false;
+		}
+		if (!m_dispatcher.argumentsFor(*action, &call->args)) {
+			*error = QStringLiteral("action needs a message");
+			return false;
+		}
+		return true;
+	}
+	ActionDispatcher::Route route = m_dispatcher.match(actionName, message);
+	if (route.kind != ActionDispatcher::Route::Run) {
+		*error = m_dispatcher.findByName(actionName) ? QStringLiteral("message does not match") : QStringLiteral("no such action");
+		return false;
+	}
+	*action = route.action;
+	*call = std::move(route.call);
+	return true;
+}
+
+bool MqttDaemon::runBatchStep(const BatchStep &step, const QString &batchId, QString *error)
+{
+	const QString source = batchId.isEmpty() ? QStringLiteral("batch") : QStringLiteral("batch:") + batchId;
+	const ActionConfig *action = nullptr;
+	ActionCall call;
+	if (!resolveStep(step.action, step.message, &action, &call, error)) return false;
+	if (!executeAction(*action, call, source)) {
+		*error = QStringLiteral("action failed");
+		return false;
+	}
+	return true;
+}
+
+void MqttDaemon::publishBatchResult(const QByteArray &result, bool ok)
+{
+	logBinaryEvent(ok ? QtInfoMsg : QtWarningMsg, "mpm.actions", QStringLiteral("batch.end"),
+	               {{"result", QString::fromUtf8(result)}});
+	const QString topic = batchResultTopic();
+	if (topic.isEmpty() || m_client->state() != QMqttClient::Connected) {
+		qCWarning(lcMqtt) << "Batch result not published (not connected):" << result;
+		return;
+	}
+	m_client->publish(topic, result, 1, false);
+}
+
+void MqttDaemon::compileMacros()
+{
+	m_macros.clear();
+	m_macros.reserve(m_config.macros.size());
+	for (const MacroConfig &config : m_config.macros) {
+		MacroGraph graph;
+		QString error;
+		if (!MacroGraph::compile(config, &graph, &error)) {
+			qCWarning(lcActions) << "Macro" << config.name << "disabled:" << error;
+			continue;
+		}
+		if (m_dispatcher.findByName(graph.name)) {
+			qCWarning(lcActions) << "Macro" << graph.name << "shares its name with an action; messages matching the action run the action";
+		}
+		m_macros.push_back(std::move(graph));
+	}
+}
+
+const MacroGraph *MqttDaemon::findMacro(const QString &name) const
+{
+	for (const MacroGraph &macro : m_macros) {
+		if (macro.name.compare(name, Qt::CaseInsensitive) == 0) return &macro;
+	}
+	return nullptr;
+}
+
+bool MqttDaemon::startMacro(const MacroGraph &macro, const QString &source)
+{
+	QString error;
+	if (!m_macroRunner->start(macro, &error)) {
+		qCWarning(lcActions) << "Macro" << macro.name << "refused:" << error;
+		publishMacroResult(macro.name, QJsonDocument(QJsonObject{{"macro", macro.name}, {"ok", false}, {"error", error}})
+		                                   .toJson(QJsonDocument::Compact), false);
+		return false;
+	}
+	qCInfo(lcActions) << "Macro" << macro.name << "started from" << source << "with" << macro.steps.size()
+	                  << "step(s)," << macro.depth << "on the longest chain";
+	return true;
+}
+
+bool MqttDaemon::prepareMacroStep(const MacroStep &step, const QString &macro, MacroRunner::Job *job, QString *error)
+{
+	const ActionConfig *action = nullptr;
+	ActionCall call;
+	if (!resolveStep(step.action, step.message, &action, &call, error)) return false;
+	if (!m_backend) selectActionBackend();
+	// Copies: the pool may still be running the step after a reload replaced
+	// the action list or the backend
+	std::shared_ptr<ActionBackend> backend = m_backend;
+	// Logged once a thread picks the step up; a step dropped while queued never starts
+	job->started = [this, config = *action, call, source = QStringLiteral("macro:") + macro]() {
+		beginAction(config, call, source);
+	};
+	job->run = [backend, config = *action, call]() { return backend->execute(config, call); };
+	job->done = [this, config = *action](bool ok) { finishAction(config, ok); };
+	return true;
+}
 
+void MqttDaemon::publishMacroResult(const QString &macro, const QByteArray &result, bool ok)
+{
+	logBinaryEvent(ok ? QtInfoMsg : QtWarningMsg, "mpm.actions", QStringLiteral("macro.end"),
+	               {{"name", macro}, {"result", QString::fromUtf8(result)}});
+	const QString topic = macroResultTopic();
+	if (topic.isEmpty() || m_client->state() != QMqttClient::Connected) {
+		qCWarning(lcMqtt) << "Macro result not published (not connected):" << result;
+		return;
+	}
+	m_client->publish(topic, result, 1, false);
+}
@@ -6,7 +6,19 @@
 #include <QMqttTopicName>
 #include <QVector>
 #include <QTimer>
+#include <memory>
 #include "actions/actions.h"
+#include "actions/dispatcher.h"
+#include "actions/backend.h"
+#include "../common/status_page.h"
+#include "daemon_config.h"
+#include "macro_runner.h"
+#include "../common/secret_store.h"
+
+class MqttLogForwarder;
+class BatchExecutor;
+struct BatchStep;
+class QFileSystemWatcher;
 
 // Headless MQTT daemon used by the Windows Service; reuses settings and actions from shared INI.
 class MqttDaemon : public QObject {
@@ -27,14 +39,56 @@ public:
 		if (m_client->state() != QMqttClient::Disconnected) {
 			m_client->disconnectFromHost();
 		}
+		publishStatus();
 	}
+	// Re-parses the INI and applies only the sections that changed; also runs
+	// on its own shortly after the file is written
 	void reloadSettings();
 	void notifyGoingOffline();
+	// Routes one inbound message to the matching action; the MQTT client feeds this
+	void dispatchMessage(const QByteArray &message, const QString &topic);
+	// Runs a configured action by name, without matching a payload (IPC "run-action");
+	// falls back to starting the macro of that name
+	bool runAction(const QString &name);
+	// Replaces the settings-driven backend (native or print-only) until called
+	// with nullptr; benchmarks install a RecordingActionBackend here
+	void setActionBackend(std::unique_ptr<ActionBackend> backend);
+	ActionBackend *actionBackend() const { return m_backend.get(); }
+	// Print-only: actions "succeed" without running
+	bool isSimulating() const { return m_backend && m_backend->simulates(); }
 
 	// Extended status helpers
 	bool isReconnectActive() const { return m_reconnectTimer && m_reconnectTimer->isActive(); }
-	bool isAutoReconnectEnabled() const { return m_autoReconnect; }
+	bool isAutoReconnectEnabled() const { return m_config.autoReconnect; }
+	bool isAutoConnectEnabled() const { return m_config.autoConnect; }
 	bool isUserInitiatedDisconnect() const { return m_userInitiatedDisconnect; }
+	QMqttClient::ClientError lastError() const { return m_lastError; }
+
+	struct Counters {
+		quint64 messagesReceived = 0;
+		quint64 messagesIgnored = 0;
+		quint64 actionsExecuted = 0;
+		quint64 actionsFailed = 0;
+		quint64 actionsSimulated = 0;   // successes of a backend that only simulates
+		quint64 connects = 0;
+		quint64 reloads = 0;
+		qint64 lastReloadUs = -1;   // parse + diff + apply of the last reload
+	};
+	const Counters &counters() const { return m_counters; }
+	// Configured actions whose templates don't compile, as "name: reason"
+	const QStringList &invalidActions() const { return m_invalidActions; }
+	// Macro pool threads still held by handlers whose step timed out
+	int macroThreadsStuck() const { return m_macroRunner->stuckThreads(); }
+	// Log lines the MQTT log forwarder had to drop
+	quint64 logLinesDropped() const;
+	// Password decryptions so far; grows only when the stored ciphertext changes
+	quint64 secretDecrypts() const { return m_passwordCache.decryptCount(); }
+	ServiceStatusSnapshot statusSnapshot() const;
+
+signals:
+	// Broker session established and the command topic subscribed
+	void sessionReady();
+	void brokerStateChanged(QMqttClient::ClientState state);
 
 private slots:
 	void onConnected();
@@ -43,35 +97,84 @@ private slots:
 	void onErrorChanged(QMqttClient::ClientError error);
 
 private:
-	void loadSettings(QSettings *source = nullptr);
+	// Parses the INI at its resolved location, without the first-run setup
+	void loadSettings();
+	// Cold-start fast path; true if the compiled snapshot matched the INI
+	bool loadSnapshot();
+	void writeSnapshot(const DaemonConfig::SourceStamp &source);
+	// Deferred part of start(): INI setup, file watch and snapshot revalidation
+	void finishStartup();
+	// Installs next as the current config and applies the given sections (plus
+	// the connection if the password changed); returns what was applied. The
+	// initial load only primes state: start() connects afterwards.
+	int applyConfig(DaemonConfig next, int sections, bool initial);
+	void watchSettingsFile();
 	void applyToClient();
 	QString subscribeTopic() const;
 	QString availabilityTopic() const;
+	QString logTopic() const;
+	// Where the combined result of each batch message goes
+	QString batchResultTopic() const;
+	// Where the combined result of each macro run goes
+	QString macroResultTopic() const;
 	void publishAvailabilityOnline();
 	void publishAvailabilityOffline();
+	// Pushes the current state into the shared status page
+	void publishStatus();
+	// Heartbeat timer: refreshes only heartbeatMs unless something changed
+	void heartbeatStatus();
 
-	struct UserActionCfg {
-		QString customName;
-		ActionType type;
-		QString expectedMessage;
-		QString exePath;
-	};
-	void loadActions(QSettings *source = nullptr);
+	// Picks the backend from MPM_ACTION_BACKEND or options/printOnly unless pinned
+	void selectActionBackend();
+	// Runs one action, records it in the binary log and updates the counters
+	bool executeAction(const DaemonConfig::Action &action, const ActionCall &call, const QString &source);
+	// The bookkeeping halves of executeAction(), for actions run elsewhere
+	void beginAction(const DaemonConfig::Action &action, const ActionCall &call, const QString &source);
+	void finishAction(const DaemonConfig::Action &action, bool ok);
+	// The action a step names and what to call it with: matched against its
+	// message like a publish to its topic, or run like "mpmctl run" if the
+	// message is null
+	bool resolveStep(const QString &actionName, const QByteArray &message, const ActionConfig **action,
+	                 ActionCall *call, QString *error) const;
+	// Parses a batch message and queues it, or publishes why it was refused
+	void submitBatch(const QByteArray &message);
+	// BatchExecutor's StepRunner: matches the step as its own message would be
+	bool runBatchStep(const BatchStep &step, const QString &batchId, QString *error);
+	void publishBatchResult(const QByteArray &result, bool ok);
+	// Compiles m_config.macros; ones that don't compile are logged and left out
+	void compileMacros();
+	const MacroGraph *findMacro(const QString &name) const;
+	bool startMacro(const MacroGraph &macro, const QString &source);
+	// MacroRunner's StepPreparer: resolves the step here and leaves only the
+	// backend call for the pool
+	bool prepareMacroStep(const MacroStep &step, const QString &macro, MacroRunner::Job *job, QString *error);
+	void publishMacroResult(const QString &macro, const QByteArray &result, bool ok);
 
 	QMqttClient *m_client = nullptr;
-	QSettings m_settings;
-	QVector<UserActionCfg> m_actions;
-	QString m_username;
-	QString m_host;
-	quint16 m_port = 1883;
-	QString m_mqttUser;
-	QString m_mqttPassword;
-	bool m_autoConnect = false;
-	bool m_autoReconnect = false;
-	int m_reconnectSec = 5;
+	DaemonConfig m_config;
+	ActionDispatcher m_dispatcher;
+	QStringList m_invalidActions;   // "name: reason" of actions that never match
+	// Shared with macro steps still running on the pool when it is replaced
+	std::shared_ptr<ActionBackend> m_backend;
+	bool m_backendPinned = false;
+	SecretCache m_passwordCache{defaultSecretStore()};
 	QTimer *m_reconnectTimer = nullptr;
 	bool m_userInitiatedDisconnect = false;
-	bool m_printOnly = false;
+	bool m_reconnectPending = false;   // connection settings changed: connect again once disconnected
+	QMqttClient::ClientError m_lastError = QMqttClient::NoError;
+	Counters m_counters;
+	StatusPageWriter m_statusPage;
+	ServiceStatusSnapshot m_lastStatus;   // as last published, for heartbeatStatus()
+	QTimer *m_heartbeatTimer = nullptr;
+	MqttLogForwarder *m_logForwarder = nullptr;
+	BatchExecutor *m_batches = nullptr;
+	MacroRunner *m_macroRunner = nullptr;
+	QVector<MacroGraph> m_macros;
+	QFileSystemWatcher *m_settingsWatcher = nullptr;
+	QTimer *m_reloadDebounce = nullptr;
+	bool m_startedFromSnapshot = false;
+	bool m_startupFinished = false;
+	DaemonConfig::SourceStamp m_snapshotSource;   // INI the config and snapshot were built from
 };
 
 
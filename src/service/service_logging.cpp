@@ -0,0 +1,41 @@
+#include "service_logging.h"
+#include "../common/logging.h"
+#include "../common/settings.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+QString serviceLogFilePath(const QString &suffix)
+{
+	QString dir = qEnvironmentVariable("MPM_LOG_DIR");
+#ifdef Q_OS_WIN
+	if (dir.isEmpty()) dir = QStringLiteral("C:/ProgramData/MPM");
+	const QString base = QStringLiteral("MPMService");
+#else
+	// systemd passes a colon-separated list when LogsDirectory= names several
+	if (dir.isEmpty()) dir = qEnvironmentVariable("LOGS_DIRECTORY").section(':', 0, 0);
+	if (dir.isEmpty()) dir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation) + "/MPM";
+	const QString base = QStringLiteral("mpm-daemon");
+#endif
+	return QDir(dir).filePath(base + suffix);
+}
+
+void initializeServiceLogging()
+{
+	// Read-only; the daemon does the INI setup once it is running
+	QSettings S(mpmLocateSharedSettingsFile(), QSettings::IniFormat);
+	// Keep history across restarts; rotate daily or at 10 MB and keep 10 compressed segments
+	LogWriterOptions logOptions;
+	logOptions.rotateBytes = 10 * 1024 * 1024;
+	logOptions.rotateAgeSec = 24 * 60 * 60;
+	logOptions.retainSegments = 10;
+	if (S.value("logging/binaryLog", false).toBool()) {
+		logOptions.binaryLogPath = serviceLogFilePath(".binlog");
+		logOptions.binaryLogBytes = qint64(qBound(1, S.value("logging/binaryLogSizeMB", 4).toInt(), 256)) * 1024 * 1024;
+	}
+	const QString logPath = serviceLogFilePath(".log");
+	QDir().mkpath(QFileInfo(logPath).absolutePath());
+	initializeFileLogger(logPath, false, logOptions);
+	enableInMemoryLogCapture();
+}
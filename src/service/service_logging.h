@@ -0,0 +1,13 @@
+#pragma once
+
+#include <QString>
+
+// Sets up the service log: rotating text log (see serviceLogFilePath), the
+// in-memory ring served over IPC and, if [logging] binaryLog=true in the
+// shared INI, the crash-survivable binary log next to it.
+void initializeServiceLogging();
+
+// Where the service writes its logs. MPM_LOG_DIR overrides the platform
+// default: ProgramData\MPM on Windows; on Linux systemd's LogsDirectory= if
+// set, else ~/.local/share/MPM. Suffix is ".log" or ".binlog".
+QString serviceLogFilePath(const QString &suffix);
@@ -0,0 +1,237 @@
+#include "systemd_host.h"
+
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QTimer>
+#include "ipc_server.h"
+#include "mqtt_daemon.h"
+#include "../common/log_categories.h"
+#include <cerrno>
+#include <csignal>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// [0] is written from the signal handler, [1] is read by the event loop
+int s_signalFds[2] = { -1, -1 };
+
+void onSignal(int signo)
+{
+	// Only async-signal-safe work here
+	const int savedErrno = errno;
+	const char b = char(signo);
+	const ssize_t n = ::write(s_signalFds[0], &b, 1);
+	(void)n;
+	errno = savedErrno;
+}
+
+} // namespace
+
+SystemdHost::SystemdHost(QObject *parent)
+	: QObject(parent)
+{
+	const QByteArray path = qgetenv("NOTIFY_SOCKET");
+	// "@name" is a socket in the abstract namespace; anything else is a path
+	if (!path.isEmpty() && (path.startsWith('/') || path.startsWith('@'))
+	    && size_t(path.size()) < sizeof(sockaddr_un::sun_path)) {
+		sockaddr_un addr {};
+		addr.sun_family = AF_UNIX;
+		std::memcpy(addr.sun_path, path.constData(), size_t(path.size()));
+		if (path.startsWith('@')) addr.sun_path[0] = '\0';
+		m_notifyAddr = QByteArray(reinterpret_cast<const char *>(&addr), int(offsetof(sockaddr_un, sun_path)) + path.size());
+		m_notifyFd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+		if (m_notifyFd < 0) qCWarning(lcService) << "Cannot create notify socket:" << std::strerror(errno);
+	}
+	// Children must not pick these up and confuse the service manager
+	qunsetenv("NOTIFY_SOCKET");
+
+	// WATCHDOG_PID names the process the watchdog is meant for
+	bool pidOk = false;
+	const qint64 watchdogPid = qgetenv("WATCHDOG_PID").toLongLong(&pidOk);
+	bool usecOk = false;
+	const qint64 watchdogUsec = qgetenv("WATCHDOG_USEC").toLongLong(&usecOk);
+	if (usecOk && watchdogUsec > 0 && (!pidOk || watchdogPid == qint64(::getpid()))) {
+		m_watchdogMs = qMax<qint64>(1, watchdogUsec / 1000);
+	}
+	qunsetenv("WATCHDOG_USEC");
+	qunsetenv("WATCHDOG_PID");
+
+	if (m_watchdogMs > 0) {
+		m_watchdog = new QTimer(this);
+		m_watchdog->setTimerType(Qt::PreciseTimer);
+		m_watchdog->setInterval(int(qMax<qint64>(1, m_watchdogMs / 2)));
+		connect(m_watchdog, &QTimer::timeout, this, &SystemdHost::onWatchdogTick);
+		m_watchdog->start();
+		m_sinceTick.start();
+	}
+	connect(this, &SystemdHost::stopRequested, qApp, &QCoreApplication::quit, Qt::QueuedConnection);
+}
+
+SystemdHost::~SystemdHost()
+{
+	if (m_notifyFd >= 0) ::close(m_notifyFd);
+	if (m_signalNotifier) {
+		struct sigaction sa {};
+		sa.sa_handler = SIG_DFL;
+		sigaction(SIGTERM, &sa, nullptr);
+		sigaction(SIGINT, &sa, nullptr);
+		sigaction(SIGHUP, &sa, nullptr);
+		::close(s_signalFds[0]);
+		::close(s_signalFds[1]);
+		s_signalFds[0] = s_signalFds[1] = -1;
+	}
+}
+
+bool SystemdHost::installSignalHandlers()
+{
+	if (m_signalNotifier) return true;
+	if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, s_signalFds) != 0) {
+		qCCritical(lcService) << "Cannot create signal socket pair:" << std::strerror(errno);
+		return false;
+	}
+	m_signalNotifier = new QSocketNotifier(s_signalFds[1], QSocketNotifier::Read, this);
+	connect(m_signalNotifier, &QSocketNotifier::activated, this, &SystemdHost::onSignalPipe);
+	struct sigaction sa {};
+	sa.sa_handler = onSignal;
+	sigemptyset(&sa.sa_mask);
+	sa.sa_flags = SA_RESTART;
+	sigaction(SIGTERM, &sa, nullptr);
+	sigaction(SIGINT, &sa, nullptr);
+	sigaction(SIGHUP, &sa, nullptr);
+	return true;
+}
+
+void SystemdHost::attach(MqttDaemon *daemon)
+{
+	m_daemon = daemon;
+	connect(daemon, &MqttDaemon::sessionReady, this, [this]() {
+		markReady(QByteArrayLiteral("Connected to broker"));
+	});
+	connect(daemon, &MqttDaemon::brokerStateChanged, this, [this](QMqttClient::ClientState state) {
+		updateIdle();
+		if (!m_ready || m_stopping) return;
+		if (state == QMqttClient::Disconnected) {
+			notify(m_daemon->isReconnectActive() ? QByteArrayLiteral("STATUS=Broker connection lost; reconnecting")
+			                                     : QByteArrayLiteral("STATUS=Disconnected from broker"));
+		}
+	});
+	// Ready once the event loop runs: IPC is served and actions work. The
+	// broker session follows (or not) on its own and only updates STATUS=,
+	// so a broker that is down never holds up systemctl start.
+	QTimer::singleShot(0, this, [this]() {
+		if (m_ready || !m_daemon) return;
+		markReady(m_daemon->isAutoConnectEnabled() ? QByteArrayLiteral("Connecting to broker")
+		                                           : QByteArrayLiteral("Auto-connect disabled; waiting for IPC"));
+	});
+}
+
+void SystemdHost::enableIdleExit(int seconds, IpcServer *ipc)
+{
+	if (seconds <= 0 || !ipc) return;
+	m_ipc = ipc;
+	m_idleTimer = new QTimer(this);
+	m_idleTimer->setSingleShot(true);
+	m_idleTimer->setInterval(seconds * 1000);
+	connect(m_idleTimer, &QTimer::timeout, this, [this]() {
+		if (!isIdle()) return;
+		m_stopping = true;
+		qCInfo(lcService) << "Idle for" << m_idleTimer->interval() / 1000 << "s; exiting until the next client connects";
+		notify(QByteArrayLiteral("STOPPING=1\nSTATUS=Idle exit"));
+		emit stopRequested();
+	});
+	connect(ipc, &IpcServer::clientCountChanged, this, &SystemdHost::updateIdle);
+	QTimer::singleShot(0, this, &SystemdHost::updateIdle);
+}
+
+bool SystemdHost::isIdle() const
+{
+	return !m_stopping && m_ipc && m_ipc->clientCount() == 0 && m_daemon
+	       && !m_daemon->isAutoConnectEnabled() && m_daemon->state() == QMqttClient::Disconnected;
+}
+
+void SystemdHost::updateIdle()
+{
+	if (!m_idleTimer) return;
+	// Re-arming only from "busy" keeps a steady idle state counting down
+	if (!isIdle()) m_idleTimer->stop();
+	else if (!m_idleTimer->isActive()) m_idleTimer->start();
+}
+
+qintptr SystemdHost::takeListenFd()
+{
+	// SD_LISTEN_FDS_START: passed descriptors begin at 3
+	constexpr int kFirstFd = 3;
+	bool pidOk = false, countOk = false;
+	const qint64 pid = qgetenv("LISTEN_PID").toLongLong(&pidOk);
+	const int count = qgetenv("LISTEN_FDS").toInt(&countOk);
+	qunsetenv("LISTEN_PID");
+	qunsetenv("LISTEN_FDS");
+	qunsetenv("LISTEN_FDNAMES");
+	if (!pidOk || !countOk || pid != qint64(::getpid()) || count < 1) return -1;
+	if (count > 1) qCWarning(lcService) << "Socket activation passed" << count << "sockets; using the first";
+	for (int fd = kFirstFd; fd < kFirstFd + count; ++fd) ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+	return kFirstFd;
+}
+
+bool SystemdHost::notify(const QByteArray &state)
+{
+	if (m_notifyFd < 0) return false;
+	const ssize_t sent = ::sendto(m_notifyFd, state.constData(), size_t(state.size()), MSG_NOSIGNAL,
+	                              reinterpret_cast<const sockaddr *>(m_notifyAddr.constData()),
+	                              socklen_t(m_notifyAddr.size()));
+	if (sent < 0) {
+		qCWarning(lcService) << "sd_notify failed:" << std::strerror(errno);
+		return false;
+	}
+	return true;
+}
+
+void SystemdHost::markReady(const QByteArray &status)
+{
+	if (m_stopping) return;
+	if (m_ready) {
+		notify("STATUS=" + status);
+		return;
+	}
+	m_ready = true;
+	qCInfo(lcService) << "Service ready:" << status;
+	notify("READY=1\nSTATUS=" + status + "\nMAINPID=" + QByteArray::number(qint64(::getpid())));
+}
+
+void SystemdHost::onSignalPipe()
+{
+	char b = 0;
+	if (::read(s_signalFds[1], &b, 1) != 1) return;
+	const int signo = b;
+	if (signo == SIGHUP) {
+		if (!m_daemon || m_stopping) return;
+		qCInfo(lcService) << "SIGHUP: reloading settings";
+		notify(QByteArrayLiteral("RELOADING=1"));
+		m_daemon->reloadSettings();
+		notify(QByteArrayLiteral("READY=1"));
+		return;
+	}
+	if (m_stopping) return;
+	m_stopping = true;
+	qCInfo(lcService) << "Stop requested by signal" << signo;
+	notify(QByteArrayLiteral("STOPPING=1\nSTATUS=Publishing offline state"));
+	emit stopRequested();
+}
+
+void SystemdHost::onWatchdogTick()
+{
+	// The ping is only sent when this timer fires, so a stalled event loop stops
+	// it and systemd restarts the service. A tick that arrives late is worth a
+	// warning well before that point.
+	const qint64 elapsed = m_sinceTick.restart();
+	const qint64 lag = elapsed - m_watchdog->interval();
+	if (lag > m_watchdogMs / 4) {
+		qCWarning(lcService) << "Event loop stalled for" << lag << "ms (watchdog" << m_watchdogMs << "ms)";
+	}
+	notify(QByteArrayLiteral("WATCHDOG=1"));
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+
+class IpcServer;
+class MqttDaemon;
+class QSocketNotifier;
+class QTimer;
+
+// Runs the daemon as a systemd Type=notify service. Speaks the sd_notify
+// datagram protocol on $NOTIFY_SOCKET directly (no libsystemd): READY=1 once
+// the event loop runs (the broker session only changes STATUS=),
+// RELOADING=1/READY=1 around a SIGHUP reload, WATCHDOG=1 at half of
+// $WATCHDOG_USEC, STOPPING=1 when a stop signal starts the drain. SIGTERM,
+// SIGINT and SIGHUP arrive through a self-pipe watched by the event loop.
+// Without $NOTIFY_SOCKET only the signal handling is active, so the same
+// binary runs unchanged in a terminal; pointing $NOTIFY_SOCKET at any local
+// datagram socket shows exactly what systemd would receive.
+class SystemdHost : public QObject {
+	Q_OBJECT
+public:
+	explicit SystemdHost(QObject *parent = nullptr);
+	~SystemdHost() override;
+
+	// Installs the signal handlers; false if the self-pipe can't be created
+	bool installSignalHandlers();
+	// Ties readiness, status lines and reload to the daemon
+	void attach(MqttDaemon *daemon);
+	// Quits after the given idle time: no IPC clients, no broker session and
+	// autoConnect off. Meant for socket activation, where the next client
+	// connect starts the daemon again.
+	void enableIdleExit(int seconds, IpcServer *ipc);
+
+	// First socket passed by socket activation (LISTEN_FDS), or -1. Clears the
+	// LISTEN_* variables so they don't leak into spawned actions.
+	static qintptr takeListenFd();
+
+	bool notifyEnabled() const { return m_notifyFd >= 0; }
+	qint64 watchdogIntervalMs() const { return m_watchdogMs; }
+	// Sends one newline-separated state block; no-op without $NOTIFY_SOCKET
+	bool notify(const QByteArray &state);
+
+signals:
+	// SIGTERM/SIGINT after STOPPING=1 was sent; the host quits the app by default
+	void stopRequested();
+
+private slots:
+	void onSignalPipe();
+	void onWatchdogTick();
+
+private:
+	void markReady(const QByteArray &status);
+	bool isIdle() const;
+	void updateIdle();
+
+	MqttDaemon *m_daemon = nullptr;
+	int m_notifyFd = -1;
+	QByteArray m_notifyAddr;        // sockaddr_un bytes for sendto()
+	qint64 m_watchdogMs = 0;
+	QTimer *m_watchdog = nullptr;
+	QElapsedTimer m_sinceTick;
+	QSocketNotifier *m_signalNotifier = nullptr;
+	IpcServer *m_ipc = nullptr;
+	QTimer *m_idleTimer = nullptr;
+	bool m_ready = false;
+	bool m_stopping = false;
+};
@@ -3,7 +3,7 @@
 #include <QCoreApplication>
 #include <QTimer>
 #include "mqtt_daemon.h"
-#include "../common/logging.h"
+#include "service_logging.h"
 #include "ipc_server.h"
 #include <Aclapi.h>
 #include <string>
@@ -209,8 +209,7 @@ void WINAPI MpmWinService::ServiceMain(DWORD, LPWSTR*)
         int qtArgc = 1;
         char **qtArgv = fakeArgv;
         QCoreApplication app(qtArgc, qtArgv);
-        initializeFileLogger("C:/ProgramData/MPM/MPMService.log", true);
-        enableInMemoryLogCapture(500);
+        initializeServiceLogging();
         qInfo() << "MPMService started (v1.0.0)";
         MqttDaemon daemon;
         QObject::connect(&app, &QCoreApplication::aboutToQuit, &daemon, [&daemon](){ daemon.notifyGoingOffline(); });
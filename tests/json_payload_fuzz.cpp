@@ -0,0 +1,194 @@
+// Fuzz target for the streaming JSON payload reader, built with ASan and
+// UBSan. Every input goes through readJsonPayload and, if it parses, through
+// every accessor the dispatcher uses, walking nested values with the object
+// and array readers. The bytes sit in a heap block of exactly their size, so
+// a read one past the end is caught.
+//
+// With -DMPM_FUZZ=ON (clang) this is a libFuzzer target:
+//   mpm_json_payload_fuzz [corpus dir] [-runs=N]
+// Otherwise its own main() runs a seeded loop of mutated seed payloads and
+// random JSON-ish text, which is what CTest runs:
+//   mpm_json_payload_fuzz [iterations] [seed]
+
+#include "actions/json_payload.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+
+namespace {
+
+const QVector<PayloadField> &fuzzSchema()
+{
+	static const QVector<PayloadField> schema{{QStringLiteral("delay"), PayloadField::Int, false, 0, 3600},
+	                                          {QStringLiteral("force"), PayloadField::Bool, false},
+	                                          {QStringLiteral("note"), PayloadField::String, false},
+	                                          {QStringLiteral("n"), PayloadField::Int, false}};
+	return schema;
+}
+
+[[noreturn]] void invariantFailed(const char *what)
+{
+	std::fprintf(stderr, "invariant failed: %s\n", what);
+	std::abort();
+}
+
+void check(bool condition, const char *what)
+{
+	if (!condition) invariantFailed(what);
+}
+
+void touch(const JsonScalar &v, int depth);
+
+void walkObject(const JsonScalar &nested, int depth)
+{
+	JsonObjectReader reader(nested);
+	JsonScalar key;
+	JsonScalar value;
+	while (reader.next(&key, &value)) {
+		check(key.type == JsonScalar::String, "object key is not a string");
+		key.toString();
+		touch(value, depth + 1);
+	}
+	// skipNested() already accepted these bytes
+	check(!reader.error(), "nested object rejected on the second read");
+}
+
+void walkArray(const JsonScalar &nested, int depth)
+{
+	JsonArrayReader reader(nested);
+	JsonScalar value;
+	while (reader.next(&value)) touch(value, depth + 1);
+	check(!reader.error(), "nested array rejected on the second read");
+}
+
+void touch(const JsonScalar &v, int depth)
+{
+	check(depth <= 40, "nesting beyond the reader's limit");
+	switch (v.type) {
+	case JsonScalar::String:
+		v.toString();
+		v.equals(QStringLiteral("cmd"));
+		break;
+	case JsonScalar::Number: {
+		qint64 n = 0;
+		if (v.toInt64(&n)) check(v.integral, "fraction read as an integer");
+		break;
+	}
+	case JsonScalar::Nested:
+		check(v.size >= 2, "nested value shorter than its brackets");
+		if (*v.data == '{') walkObject(v, depth);
+		else walkArray(v, depth);
+		break;
+	default:
+		break;
+	}
+}
+
+// True if the payload was accepted
+bool fuzzOne(const uint8_t *data, size_t size)
+{
+	if (size > 1 << 20) return false;
+	// Exactly size bytes, no terminator: ASan flags any overread
+	char *copy = static_cast<char *>(std::malloc(size ? size : 1));
+	if (size) std::memcpy(copy, data, size);
+	const QByteArray payload = QByteArray::fromRawData(copy, int(size));
+
+	const QVector<PayloadField> &schema = fuzzSchema();
+	JsonScalar cmd;
+	JsonScalar fields[4];
+	const char *error = nullptr;
+	const bool accepted = readJsonPayload(payload, schema, &cmd, fields, &error);
+	if (accepted) {
+		check(cmd.type == JsonScalar::String, "cmd is not a string");
+		cmd.toString();
+		const QVariantMap values = jsonPayloadValues(schema, fields);
+		if (values.contains(QStringLiteral("delay"))) {
+			const qint64 delay = values.value(QStringLiteral("delay")).toLongLong();
+			check(delay >= 0 && delay <= 3600, "delay outside its range");
+		}
+		// The whole object once more, nested values included
+		JsonObjectReader reader(payload);
+		JsonScalar key;
+		JsonScalar value;
+		while (reader.next(&key, &value)) touch(value, 1);
+		check(!reader.error(), "accepted payload rejected on the second read");
+	} else {
+		check(error != nullptr, "rejected without a reason");
+	}
+	std::free(copy);
+	return accepted;
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	fuzzOne(data, size);
+	return 0;
+}
+
+#ifndef MPM_LIBFUZZER
+
+namespace {
+
+const char *const kSeeds[] = {
+	R"({"cmd":"shutdown","delay":60,"force":true})",
+	R"({"cmd":"shut\ud83d\ude00","note":"a\"b\\c","n":-9223372036854775808})",
+	R"({"cmd":"x","y":{"a":[1,2.5e-3,{"b":null,"c":[true,false]}],"d":"}]"},"z":[]})",
+	R"( { "cmd" : "spaced" , "delay" : 0 , "n" : 9223372036854775807 } )",
+	R"({"cmd":"deep","x":[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[1]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]})",
+};
+
+// Bytes that steer mutations toward the grammar's edges
+const char kTokens[] = "{}[]\",:\\u0123456789-+.eEtrfalsnu \t\n";
+
+std::string mutate(std::string s, std::mt19937 &rng)
+{
+	const int edits = 1 + int(rng() % 6);
+	for (int e = 0; e < edits; ++e) {
+		const size_t pos = s.empty() ? 0 : rng() % s.size();
+		const char token = rng() % 2 ? kTokens[rng() % (sizeof kTokens - 1)] : char(rng());
+		switch (rng() % 5) {
+		case 0: if (!s.empty()) s[pos] = token; break;
+		case 1: s.insert(s.begin() + std::ptrdiff_t(pos), token); break;
+		case 2: if (!s.empty()) s.erase(pos, 1 + rng() % 4); break;
+		case 3: s.resize(pos); break;
+		default: {
+			// Duplicate a slice: repeated members, deeper nesting
+			const size_t len = s.empty() ? 0 : 1 + rng() % qMin<size_t>(16, s.size() - pos);
+			s.insert(pos, s.substr(pos, len));
+			break;
+		}
+		}
+	}
+	return s;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+	const long iterations = argc > 1 ? std::strtol(argv[1], nullptr, 10) : 200000;
+	const unsigned seed = argc > 2 ? unsigned(std::strtoul(argv[2], nullptr, 10)) : 1u;
+	std::mt19937 rng(seed);
+	for (const char *s : kSeeds) check(fuzzOne(reinterpret_cast<const uint8_t *>(s), std::strlen(s)), "seed payload rejected");
+	for (long i = 0; i < iterations; ++i) {
+		std::string input;
+		if (rng() % 8 == 0) {
+			// Raw noise drawn from the JSON alphabet
+			input.resize(rng() % 64);
+			for (char &c : input) c = kTokens[rng() % (sizeof kTokens - 1)];
+		} else {
+			input = mutate(kSeeds[rng() % (sizeof kSeeds / sizeof *kSeeds)], rng);
+		}
+		fuzzOne(reinterpret_cast<const uint8_t *>(input.data()), input.size());
+	}
+	std::printf("%ld inputs, seed %u: no crash, no sanitizer report\n", iterations, seed);
+	return 0;
+}
+
+#endif // MPM_LIBFUZZER
@@ -0,0 +1,207 @@
+// readJsonPayload against a table of well-formed, malformed and edge-case
+// payloads (nesting depth, \u escapes and surrogates, int64 limits, repeated
+// members), plus the Shutdown schema end to end through the dispatcher.
+#include <QtTest>
+#include "actions/dispatcher.h"
+#include "actions/json_payload.h"
+
+namespace {
+
+// The Shutdown/Restart schema plus a free-form string
+QVector<PayloadField> testSchema()
+{
+	return {{QStringLiteral("delay"), PayloadField::Int, false, 0, 3600},
+	        {QStringLiteral("force"), PayloadField::Bool, false},
+	        {QStringLiteral("note"), PayloadField::String, false}};
+}
+
+QByteArray nested(int depth)
+{
+	return R"({"cmd":"s","x":)" + QByteArray(depth, '[') + QByteArray(depth, ']') + "}";
+}
+
+} // namespace
+
+class JsonPayloadTest : public QObject {
+	Q_OBJECT
+
+private slots:
+	void payload_data();
+	void payload();
+	void escapes_data();
+	void escapes();
+	void int64Limits_data();
+	void int64Limits();
+	void negativeDelayDoesNotMatch();
+};
+
+void JsonPayloadTest::payload_data()
+{
+	QTest::addColumn<QByteArray>("json");
+	QTest::addColumn<bool>("accepted");
+
+	QTest::newRow("minimal") << QByteArray(R"({"cmd":"shutdown"})") << true;
+	QTest::newRow("all fields") << QByteArray(R"({"cmd":"shutdown","delay":60,"force":true,"note":"n"})") << true;
+	QTest::newRow("whitespace") << QByteArray(" \t\r\n{ \"cmd\" : \"s\" , \"delay\" : 1 }\n") << true;
+	QTest::newRow("null is absent") << QByteArray(R"({"cmd":"s","delay":null})") << true;
+	QTest::newRow("unknown members") << QByteArray(R"({"cmd":"s","x":1,"y":"z","w":false})") << true;
+
+	// Repeated members
+	QTest::newRow("repeated cmd") << QByteArray(R"({"cmd":"a","cmd":"b"})") << false;
+	QTest::newRow("repeated field") << QByteArray(R"({"cmd":"s","delay":1,"delay":2})") << false;
+	QTest::newRow("repeated null field") << QByteArray(R"({"cmd":"s","delay":null,"delay":2})") << false;
+	QTest::newRow("repeated unknown member") << QByteArray(R"({"cmd":"s","x":1,"x":2})") << true;
+
+	// Shape and kinds
+	QTest::newRow("empty") << QByteArray() << false;
+	QTest::newRow("array") << QByteArray(R"(["cmd"])") << false;
+	QTest::newRow("no cmd") << QByteArray(R"({"delay":1})") << false;
+	QTest::newRow("cmd not a string") << QByteArray(R"({"cmd":1})") << false;
+	QTest::newRow("bool as string") << QByteArray(R"({"cmd":"s","force":"yes"})") << false;
+	QTest::newRow("string as int") << QByteArray(R"({"cmd":"s","delay":"60"})") << false;
+	QTest::newRow("int as string") << QByteArray(R"({"cmd":"s","note":5})") << false;
+	QTest::newRow("trailing data") << QByteArray(R"({"cmd":"s"} x)") << false;
+	QTest::newRow("two objects") << QByteArray(R"({"cmd":"s"}{})") << false;
+	QTest::newRow("trailing comma") << QByteArray(R"({"cmd":"s",})") << false;
+	QTest::newRow("missing comma") << QByteArray(R"({"cmd":"s" "delay":1})") << false;
+	QTest::newRow("unterminated") << QByteArray(R"({"cmd":"s")") << false;
+	QTest::newRow("bare word") << QByteArray(R"({"cmd":"s","force":tru})") << false;
+	QTest::newRow("leading zero") << QByteArray(R"({"cmd":"s","x":01})") << false;
+	QTest::newRow("lone minus") << QByteArray(R"({"cmd":"s","x":-})") << false;
+	QTest::newRow("bare fraction") << QByteArray(R"({"cmd":"s","x":1.})") << false;
+	QTest::newRow("control character") << QByteArray("{\"cmd\":\"a\tb\"}") << false;
+
+	// Nested values of unknown members follow the same grammar
+	QTest::newRow("nested ok") << QByteArray(R"({"cmd":"s","x":{"a":[1,{"b":null}],"c":"}]"},"y":[]})") << true;
+	QTest::newRow("nested empty") << QByteArray(R"({"cmd":"s","x":[{},[],{"a":[ ]}]})") << true;
+	QTest::newRow("nested double comma") << QByteArray(R"({"cmd":"shutdown","x":[1,,]})") << false;
+	QTest::newRow("nested trailing comma") << QByteArray(R"({"cmd":"s","x":[1,]})") << false;
+	QTest::newRow("nested missing colon") << QByteArray(R"({"cmd":"s","x":{"a" 1}})") << false;
+	QTest::newRow("nested missing value") << QByteArray(R"({"cmd":"s","x":{"a":}})") << false;
+	QTest::newRow("nested number key") << QByteArray(R"({"cmd":"s","x":{1:2}})") << false;
+	QTest::newRow("nested member in array") << QByteArray(R"({"cmd":"s","x":["a":1]})") << false;
+	QTest::newRow("nested missing comma") << QByteArray(R"({"cmd":"s","x":[1 2]})") << false;
+	QTest::newRow("nested mismatched") << QByteArray(R"({"cmd":"s","x":[1}})") << false;
+	QTest::newRow("nested bad literal") << QByteArray(R"({"cmd":"s","x":[nul]})") << false;
+	QTest::newRow("nested bad escape") << QByteArray(R"({"cmd":"s","x":["\q"]})") << false;
+	QTest::newRow("nested unterminated") << QByteArray(R"({"cmd":"s","x":[[1]})") << false;
+
+	// Depth: 32 nested containers inside the top-level object
+	QTest::newRow("depth 32") << nested(32) << true;
+	QTest::newRow("depth 33") << nested(33) << false;
+	QTest::newRow("depth 10000") << nested(10000) << false;
+}
+
+void JsonPayloadTest::payload()
+{
+	QFETCH(QByteArray, json);
+	QFETCH(bool, accepted);
+	const QVector<PayloadField> schema = testSchema();
+	JsonScalar cmd;
+	JsonScalar fields[3];
+	const char *error = nullptr;
+	const bool ok = readJsonPayload(json, schema, &cmd, fields, &error);
+	QVERIFY2(ok == accepted, ok ? "accepted" : error);
+	if (ok) {
+		QCOMPARE(cmd.type, JsonScalar::String);
+	} else {
+		QVERIFY(error);
+	}
+}
+
+void JsonPayloadTest::escapes_data()
+{
+	QTest::addColumn<QByteArray>("json");
+	QTest::addColumn<bool>("accepted");
+	QTest::addColumn<QString>("cmd");
+
+	QTest::newRow("plain") << QByteArray(R"({"cmd":"shutdown"})") << true << QStringLiteral("shutdown");
+	QTest::newRow("simple escapes") << QByteArray(R"({"cmd":"a\"b\\c\/d\n\t"})") << true << QStringLiteral("a\"b\\c/d\n\t");
+	QTest::newRow("\\u ascii") << QByteArray(R"({"cmd":"\u0073hutdown"})") << true << QStringLiteral("shutdown");
+	QTest::newRow("\\u upper hex") << QByteArray(R"({"cmd":"\u00E9\u00e9"})") << true << QString::fromUtf8("\xC3\xA9\xC3\xA9");
+	QTest::newRow("escaped key") << QByteArray(R"({"c\u006dd":"k"})") << true << QStringLiteral("k");
+	QTest::newRow("utf-8 raw") << QByteArray("{\"cmd\":\"\xC3\xA9\"}") << true << QString::fromUtf8("\xC3\xA9");
+	QTest::newRow("surrogate pair") << QByteArray(R"({"cmd":"\ud83d\ude00"})") << true << QString::fromUtf8("\xF0\x9F\x98\x80");
+	// Syntactically valid JSON; passed on as the unpaired UTF-16 unit
+	QTest::newRow("lone high surrogate") << QByteArray(R"({"cmd":"\ud800"})") << true << QString(QChar(0xD800));
+	QTest::newRow("lone low surrogate") << QByteArray(R"({"cmd":"x\udc00"})") << true << QStringLiteral("x") + QChar(0xDC00);
+	QTest::newRow("\\u truncated") << QByteArray(R"({"cmd":"\u12"})") << false << QString();
+	QTest::newRow("\\u at end") << QByteArray(R"({"cmd":"\u)") << false << QString();
+	QTest::newRow("\\u not hex") << QByteArray(R"({"cmd":"\uZZZZ"})") << false << QString();
+	QTest::newRow("unknown escape") << QByteArray(R"({"cmd":"\x41"})") << false << QString();
+	QTest::newRow("backslash at end") << QByteArray("{\"cmd\":\"\\") << false << QString();
+}
+
+void JsonPayloadTest::escapes()
+{
+	QFETCH(QByteArray, json);
+	QFETCH(bool, accepted);
+	QFETCH(QString, cmd);
+	JsonScalar value;
+	const char *error = nullptr;
+	const bool ok = readJsonPayload(json, {}, &value, nullptr, &error);
+	QVERIFY2(ok == accepted, ok ? "accepted" : error);
+	if (ok) QCOMPARE(value.toString(), cmd);
+}
+
+void JsonPayloadTest::int64Limits_data()
+{
+	QTest::addColumn<QByteArray>("number");
+	QTest::addColumn<bool>("integer");
+	QTest::addColumn<qint64>("value");
+
+	QTest::newRow("zero") << QByteArray("0") << true << qint64(0);
+	QTest::newRow("minus zero") << QByteArray("-0") << true << qint64(0);
+	QTest::newRow("max") << QByteArray("9223372036854775807") << true << std::numeric_limits<qint64>::max();
+	QTest::newRow("max + 1") << QByteArray("9223372036854775808") << false << qint64(0);
+	QTest::newRow("min") << QByteArray("-9223372036854775808") << true << std::numeric_limits<qint64>::min();
+	QTest::newRow("min - 1") << QByteArray("-9223372036854775809") << false << qint64(0);
+	QTest::newRow("huge") << QByteArray("184467440737095516160") << false << qint64(0);
+	QTest::newRow("fraction") << QByteArray("1.5") << false << qint64(0);
+	QTest::newRow("exponent") << QByteArray("1e3") << false << qint64(0);
+}
+
+void JsonPayloadTest::int64Limits()
+{
+	QFETCH(QByteArray, number);
+	QFETCH(bool, integer);
+	QFETCH(qint64, value);
+	// Unbounded field: only whether it is an int64 decides
+	const QVector<PayloadField> schema{{QStringLiteral("n"), PayloadField::Int, true}};
+	JsonScalar cmd;
+	JsonScalar field;
+	const char *error = nullptr;
+	const bool ok = readJsonPayload(R"({"cmd":"s","n":)" + number + "}", schema, &cmd, &field, &error);
+	QVERIFY2(ok == integer, ok ? "accepted" : error);
+	if (!ok) return;
+	qint64 n = 1;
+	QVERIFY(field.toInt64(&n));
+	QCOMPARE(n, value);
+}
+
+void JsonPayloadTest::negativeDelayDoesNotMatch()
+{
+	const ActionTypeRegistry &registry = ActionTypeRegistry::instance();
+	ActionConfig action;
+	action.customName = QStringLiteral("pc");
+	action.typeName = QStringLiteral("Shutdown");
+	action.type = registry.find(action.typeName);
+	action.expectedMessage = QStringLiteral("shutdown");
+	action.payloadFormat = PayloadFormat::Json;
+	ActionDispatcher dispatcher;
+	dispatcher.setActions({action});
+	const QString topic = QStringLiteral("mqttpowermanager/test/pc");
+
+	const ActionDispatcher::Route later = dispatcher.route(topic, R"({"cmd":"shutdown","delay":60})");
+	QCOMPARE(later.kind, ActionDispatcher::Route::Run);
+	QCOMPARE(later.call.fields.value(QStringLiteral("delay")).toLongLong(), qlonglong(60));
+	QCOMPARE(dispatcher.route(topic, R"({"cmd":"shutdown","delay":0})").kind, ActionDispatcher::Route::Run);
+	// Must not be read as "power off now"
+	QCOMPARE(dispatcher.route(topic, R"({"cmd":"shutdown","delay":-5})").kind, ActionDispatcher::Route::NoMatch);
+	QCOMPARE(dispatcher.route(topic, R"({"cmd":"shutdown","delay":-9223372036854775808})").kind,
+	         ActionDispatcher::Route::NoMatch);
+	QCOMPARE(dispatcher.route(topic, R"({"cmd":"shutdown","x":[1,,]})").kind, ActionDispatcher::Route::NoMatch);
+}
+
+QTEST_GUILESS_MAIN(JsonPayloadTest)
+#include "json_payload_test.moc"
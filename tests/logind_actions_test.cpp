@@ -0,0 +1,225 @@
+// Linux power actions against a mock systemd-logind on a private
+// dbus-daemon: which Manager method each action calls, with which
+// arguments, and what a refused call returns.
+#include <QtTest>
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QDBusContext>
+#include <QDBusMessage>
+#include <QDateTime>
+#include <QMutex>
+#include <QProcess>
+#include <QStandardPaths>
+#include <QThread>
+#include <utility>
+#include "actions/actions.h"
+
+namespace {
+
+const QString kLogindService = QStringLiteral("org.freedesktop.login1");
+const QString kLogindPath = QStringLiteral("/org/freedesktop/login1");
+
+// Stands in for org.freedesktop.login1.Manager. Lives on its own thread:
+// the actions block on the reply, so the main thread can't serve the call.
+class MockLogind : public QObject, protected QDBusContext {
+	Q_OBJECT
+	Q_CLASSINFO("D-Bus Interface", "org.freedesktop.login1.Manager")
+
+public:
+	struct Call {
+		QString method;
+		QVariantList args;
+	};
+
+	QList<Call> takeCalls()
+	{
+		QMutexLocker lock(&m_mutex);
+		return std::exchange(m_calls, {});
+	}
+
+	// Answer every call with AccessDenied, as polkit does for an unprivileged caller
+	void setRefuse(bool refuse)
+	{
+		QMutexLocker lock(&m_mutex);
+		m_refuse = refuse;
+	}
+
+public slots:
+	void PowerOff(bool interactive) { record(QStringLiteral("PowerOff"), {interactive}); }
+	void Reboot(bool interactive) { record(QStringLiteral("Reboot"), {interactive}); }
+	void Suspend(bool interactive) { record(QStringLiteral("Suspend"), {interactive}); }
+	void Hibernate(bool interactive) { record(QStringLiteral("Hibernate"), {interactive}); }
+	void LockSessions() { record(QStringLiteral("LockSessions"), {}); }
+	void ScheduleShutdown(const QString &type, qulonglong usec) { record(QStringLiteral("ScheduleShutdown"), {type, usec}); }
+
+private:
+	void record(const QString &method, const QVariantList &args)
+	{
+		QMutexLocker lock(&m_mutex);
+		m_calls.push_back({method, args});
+		if (m_refuse) sendErrorReply(QDBusError::AccessDenied, QStringLiteral("Interactive authentication required."));
+	}
+
+	QMutex m_mutex;
+	QList<Call> m_calls;
+	bool m_refuse = false;
+};
+
+} // namespace
+
+class LogindActionsTest : public QObject {
+	Q_OBJECT
+
+private slots:
+	void initTestCase();
+	void cleanupTestCase();
+	void init();
+	void powerMethods_data();
+	void powerMethods();
+	void lock();
+	void delayedShutdown_data();
+	void delayedShutdown();
+	void refused();
+	void logindMissing();
+
+private:
+	bool run(const QString &type, const QVariantMap &fields = {});
+
+	QProcess m_busDaemon;
+	QString m_address;
+	QThread m_mockThread;
+	MockLogind *m_mock = nullptr;
+};
+
+void LogindActionsTest::initTestCase()
+{
+	const QString daemon = QStandardPaths::findExecutable(QStringLiteral("dbus-daemon"));
+	if (daemon.isEmpty()) QSKIP("dbus-daemon is not installed");
+	m_busDaemon.start(daemon, {QStringLiteral("--session"), QStringLiteral("--nofork"), QStringLiteral("--print-address")});
+	QVERIFY(m_busDaemon.waitForStarted());
+	while (!m_busDaemon.canReadLine()) QVERIFY(m_busDaemon.waitForReadyRead(5000));
+	m_address = QString::fromUtf8(m_busDaemon.readLine()).trimmed();
+	QVERIFY(!m_address.isEmpty());
+	// Read once, by the first action that runs
+	qputenv("MPM_LOGIND_BUS", m_address.toUtf8());
+
+	QDBusConnection bus = QDBusConnection::connectToBus(m_address, QStringLiteral("mock-logind"));
+	QVERIFY(bus.isConnected());
+	m_mock = new MockLogind;
+	m_mock->moveToThread(&m_mockThread);
+	connect(&m_mockThread, &QThread::finished, m_mock, &QObject::deleteLater);
+	m_mockThread.start();
+	QVERIFY(bus.registerObject(kLogindPath, m_mock, QDBusConnection::ExportAllSlots));
+	QVERIFY(bus.registerService(kLogindService));
+}
+
+void LogindActionsTest::cleanupTestCase()
+{
+	QDBusConnection::disconnectFromBus(QStringLiteral("mock-logind"));
+	m_mockThread.quit();
+	m_mockThread.wait();
+	if (m_busDaemon.state() != QProcess::NotRunning) {
+		m_busDaemon.terminate();
+		m_busDaemon.waitForFinished(3000);
+	}
+}
+
+void LogindActionsTest::init()
+{
+	m_mock->setRefuse(false);
+	m_mock->takeCalls();
+}
+
+bool LogindActionsTest::run(const QString &type, const QVariantMap &fields)
+{
+	const ActionTypeRegistry &registry = ActionTypeRegistry::instance();
+	const ActionTypeInfo *info = registry.info(registry.find(type));
+	if (!info) return false;
+	ActionConfig config;
+	config.customName = QStringLiteral("test-") + type;
+	config.typeName = info->name;
+	config.type = registry.find(type);
+	ActionCall call;
+	call.fields = fields;
+	return info->run(config, call);
+}
+
+void LogindActionsTest::powerMethods_data()
+{
+	QTest::addColumn<QString>("type");
+	QTest::addColumn<QString>("method");
+	QTest::newRow("shutdown") << "Shutdown" << "PowerOff";
+	QTest::newRow("restart") << "Restart" << "Reboot";
+	QTest::newRow("suspend") << "Suspend" << "Suspend";
+	// logind has no separate sleep state
+	QTest::newRow("sleep") << "Sleep" << "Suspend";
+	QTest::newRow("hibernate") << "Hibernate" << "Hibernate";
+}
+
+void LogindActionsTest::powerMethods()
+{
+	QFETCH(QString, type);
+	QFETCH(QString, method);
+	QVERIFY(run(type));
+	const QList<MockLogind::Call> calls = m_mock->takeCalls();
+	QCOMPARE(calls.size(), 1);
+	QCOMPARE(calls.at(0).method, method);
+	// interactive=false: never wait on a polkit prompt nobody will answer
+	QCOMPARE(calls.at(0).args, QVariantList{false});
+}
+
+void LogindActionsTest::lock()
+{
+	QVERIFY(run(QStringLiteral("Lock")));
+	const QList<MockLogind::Call> calls = m_mock->takeCalls();
+	QCOMPARE(calls.size(), 1);
+	QCOMPARE(calls.at(0).method, QStringLiteral("LockSessions"));
+	QVERIFY(calls.at(0).args.isEmpty());
+}
+
+void LogindActionsTest::delayedShutdown_data()
+{
+	QTest::addColumn<QString>("type");
+	QTest::addColumn<QString>("scheduleType");
+	QTest::newRow("shutdown") << "Shutdown" << "poweroff";
+	QTest::newRow("restart") << "Restart" << "reboot";
+}
+
+void LogindActionsTest::delayedShutdown()
+{
+	QFETCH(QString, type);
+	QFETCH(QString, scheduleType);
+	const quint64 before = quint64(QDateTime::currentMSecsSinceEpoch()) * 1000;
+	QVERIFY(run(type, {{QStringLiteral("delay"), 60}}));
+	const quint64 after = quint64(QDateTime::currentMSecsSinceEpoch()) * 1000;
+	const QList<MockLogind::Call> calls = m_mock->takeCalls();
+	QCOMPARE(calls.size(), 1);
+	QCOMPARE(calls.at(0).method, QStringLiteral("ScheduleShutdown"));
+	QCOMPARE(calls.at(0).args.size(), 2);
+	QCOMPARE(calls.at(0).args.at(0).toString(), scheduleType);
+	// Absolute CLOCK_REALTIME microseconds, 60 s from the call
+	const quint64 at = calls.at(0).args.at(1).toULongLong();
+	QVERIFY(at >= before + 60000000ull);
+	QVERIFY(at <= after + 60000000ull);
+}
+
+void LogindActionsTest::refused()
+{
+	m_mock->setRefuse(true);
+	QVERIFY(!run(QStringLiteral("Shutdown")));
+	QVERIFY(!run(QStringLiteral("Lock")));
+	// The call reached logind; the failure is its answer
+	QCOMPARE(m_mock->takeCalls().size(), 2);
+}
+
+void LogindActionsTest::logindMissing()
+{
+	QDBusConnection bus(QStringLiteral("mock-logind"));
+	QVERIFY(bus.unregisterService(kLogindService));
+	QVERIFY(!run(QStringLiteral("Suspend")));
+	QVERIFY(m_mock->takeCalls().isEmpty());
+	QVERIFY(bus.registerService(kLogindService));
+}
+
+QTEST_GUILESS_MAIN(LogindActionsTest)
+#include "logind_actions_test.moc"
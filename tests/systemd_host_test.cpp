@@ -0,0 +1,200 @@
+// SystemdHost against a stand-in notify socket: what systemd would receive
+// for startup, the watchdog, a SIGHUP reload and a SIGTERM stop.
+#include <QtTest>
+#include <QSettings>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <memory>
+#include "service/mqtt_daemon.h"
+#include "service/systemd_host.h"
+#include <csignal>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+// The receiving end of $NOTIFY_SOCKET, read without blocking
+class NotifySocket {
+public:
+	~NotifySocket()
+	{
+		if (m_fd >= 0) ::close(m_fd);
+	}
+
+	bool bind(const QString &path)
+	{
+		const QByteArray native = QFile::encodeName(path);
+		sockaddr_un addr {};
+		if (size_t(native.size()) >= sizeof addr.sun_path) return false;
+		addr.sun_family = AF_UNIX;
+		std::memcpy(addr.sun_path, native.constData(), size_t(native.size()));
+		m_fd = ::socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+		return m_fd >= 0 && ::bind(m_fd, reinterpret_cast<const sockaddr *>(&addr), sizeof addr) == 0;
+	}
+
+	// Processes events until a datagram carries the line, e.g. "READY=1"
+	bool waitFor(const QByteArray &line, int timeoutMs = 5000)
+	{
+		QDeadlineTimer deadline(timeoutMs);
+		for (;;) {
+			char buf[4096];
+			ssize_t n;
+			while ((n = ::recv(m_fd, buf, sizeof buf, MSG_DONTWAIT)) > 0) m_received << QByteArray(buf, int(n));
+			for (int i = m_seen; i < m_received.size(); ++i) {
+				if (m_received.at(i).split('\n').contains(line)) {
+					m_match = m_received.at(i);
+					m_seen = i + 1;
+					return true;
+				}
+			}
+			if (deadline.hasExpired()) return false;
+			QTest::qWait(10);
+		}
+	}
+
+	// The whole datagram the last successful waitFor() matched
+	const QByteArray &lastMatch() const { return m_match; }
+
+private:
+	int m_fd = -1;
+	QList<QByteArray> m_received;
+	QByteArray m_match;
+	int m_seen = 0;   // waitFor() looks past the datagram it matched last
+};
+
+} // namespace
+
+class SystemdHostTest : public QObject {
+	Q_OBJECT
+
+private slots:
+	void initTestCase();
+	void init();
+	void cleanup();
+	void readyWithoutBroker();
+	void watchdogPings();
+	void reloadOnSighup();
+	void stoppingOnSigterm();
+	void silentWithoutNotifySocket();
+
+private:
+	void writeSettings(bool autoConnect);
+
+	QTemporaryDir m_dir;
+	QString m_iniPath;
+	std::unique_ptr<NotifySocket> m_socket;
+	int m_round = 0;
+};
+
+void SystemdHostTest::initTestCase()
+{
+	QVERIFY(m_dir.isValid());
+	m_iniPath = m_dir.filePath("MqttPowerManager.ini");
+	// Isolate from any real installation before the daemon touches settings
+	qputenv("MPM_SETTINGS_PATH", m_iniPath.toUtf8());
+	qputenv("MPM_STATUS_PAGE", QByteArray("MPMTestStatus-") + QByteArray::number(QCoreApplication::applicationPid()));
+	qputenv("MPM_ACTION_BACKEND", "recording");
+}
+
+void SystemdHostTest::init()
+{
+	// A fresh socket per test; SystemdHost consumes the variables it reads
+	const QString path = m_dir.filePath(QStringLiteral("notify-%1").arg(++m_round));
+	m_socket.reset(new NotifySocket);
+	QVERIFY(m_socket->bind(path));
+	qputenv("NOTIFY_SOCKET", QFile::encodeName(path));
+	qunsetenv("WATCHDOG_USEC");
+	qunsetenv("WATCHDOG_PID");
+	writeSettings(false);
+}
+
+void SystemdHostTest::cleanup()
+{
+	m_socket.reset();
+}
+
+void SystemdHostTest::writeSettings(bool autoConnect)
+{
+	QSettings s(m_iniPath, QSettings::IniFormat);
+	s.setValue("user/customId", "systemd-test");
+	// Nothing listens on port 1: the broker is "down"
+	s.setValue("mqtt/host", "127.0.0.1");
+	s.setValue("mqtt/port", 1);
+	s.setValue("options/autoConnect", autoConnect);
+	s.setValue("options/autoReconnect", false);
+	s.sync();
+}
+
+void SystemdHostTest::readyWithoutBroker()
+{
+	writeSettings(true);
+	SystemdHost host;
+	QVERIFY(host.notifyEnabled());
+	QVERIFY(qEnvironmentVariableIsEmpty("NOTIFY_SOCKET"));
+	MqttDaemon daemon;
+	host.attach(&daemon);
+	daemon.start();
+	// Readiness must not wait for a broker that never answers
+	QVERIFY(m_socket->waitFor("READY=1", 2000));
+	const QByteArray ready = m_socket->lastMatch();
+	QVERIFY(ready.contains("STATUS=Connecting to broker"));
+	QVERIFY(ready.contains("MAINPID=" + QByteArray::number(qint64(::getpid()))));
+}
+
+void SystemdHostTest::watchdogPings()
+{
+	qputenv("WATCHDOG_USEC", "100000");
+	qputenv("WATCHDOG_PID", QByteArray::number(qint64(::getpid())));
+	SystemdHost host;
+	QCOMPARE(host.watchdogIntervalMs(), qint64(100));
+	QVERIFY(qEnvironmentVariableIsEmpty("WATCHDOG_USEC"));
+	QVERIFY(m_socket->waitFor("WATCHDOG=1", 1000));
+	QVERIFY(m_socket->waitFor("WATCHDOG=1", 1000));
+}
+
+void SystemdHostTest::reloadOnSighup()
+{
+	SystemdHost host;
+	QVERIFY(host.installSignalHandlers());
+	MqttDaemon daemon;
+	host.attach(&daemon);
+	daemon.start();
+	QVERIFY(m_socket->waitFor("READY=1"));
+	::raise(SIGHUP);
+	QVERIFY(m_socket->waitFor("RELOADING=1"));
+	QVERIFY(m_socket->waitFor("READY=1"));
+}
+
+void SystemdHostTest::stoppingOnSigterm()
+{
+	SystemdHost host;
+	QVERIFY(host.installSignalHandlers());
+	// Observe the stop instead of letting it quit the test runner
+	host.disconnect(qApp);
+	QSignalSpy stopped(&host, &SystemdHost::stopRequested);
+	MqttDaemon daemon;
+	host.attach(&daemon);
+	daemon.start();
+	QVERIFY(m_socket->waitFor("READY=1"));
+	::raise(SIGTERM);
+	QVERIFY(m_socket->waitFor("STOPPING=1"));
+	QCOMPARE(stopped.count(), 1);
+	// A second signal during the drain is not reported again
+	::raise(SIGTERM);
+	QTest::qWait(50);
+	QCOMPARE(stopped.count(), 1);
+}
+
+void SystemdHostTest::silentWithoutNotifySocket()
+{
+	qunsetenv("NOTIFY_SOCKET");
+	SystemdHost host;
+	QVERIFY(!host.notifyEnabled());
+	QVERIFY(!host.notify("READY=1"));
+	QVERIFY(!m_socket->waitFor("READY=1", 100));
+}
+
+QTEST_GUILESS_MAIN(SystemdHostTest)
+#include "systemd_host_test.moc"